@@ -45,6 +45,17 @@ typedef enum {
 	GIT_BLAME_FIRST_PARENT = (1<<4),
 } git_blame_flag_t;
 
+/**
+ * Blame progress callback
+ *
+ * Called each time a commit has been blamed for some lines of the file,
+ * with the number of lines whose origin is known so far and the number
+ * of lines being blamed.  Return a non-zero value to cancel the blame,
+ * which will then fail with GIT_EUSER.
+ */
+typedef int (*git_blame_progress_cb)(
+	uint32_t lines_blamed, uint32_t total_lines, void *payload);
+
 /**
  * Blame options structure
  *
@@ -66,6 +77,8 @@ typedef enum {
  *	             numbers start with 1).
  *	- `max_line` is the last line in the file to blame.  The default is the last
  *	             line of the file.
+ * - `progress_cb` is called as lines are blamed; see `git_blame_progress_cb`.
+ * - `progress_payload` is passed to `progress_cb`.
  */
 
 typedef struct git_blame_options {
@@ -77,9 +90,11 @@ typedef struct git_blame_options {
 	git_oid oldest_commit;
 	uint32_t min_line;
 	uint32_t max_line;
+	git_blame_progress_cb progress_cb;
+	void *progress_payload;
 } git_blame_options;
 
-#define GIT_BLAME_OPTIONS_VERSION 1
+#define GIT_BLAME_OPTIONS_VERSION 2
 #define GIT_BLAME_OPTIONS_INIT {GIT_BLAME_OPTIONS_VERSION}
 
 /**
@@ -176,6 +191,53 @@ GIT_EXTERN(int) git_blame_file(
 		const char *path,
 		git_blame_options *options);
 
+/**
+ * Start an incremental blame of a single file.
+ *
+ * No history is looked at until the hunks are asked for with
+ * `git_blame_next`.  The options are the same as for `git_blame_file`;
+ * a line range outside of the file is an error.
+ *
+ * @param out pointer that will receive the blame object
+ * @param repo repository whose history is to be walked
+ * @param path path to file to consider
+ * @param options options for the blame operation.  If NULL, this is treated as
+ *                though GIT_BLAME_OPTIONS_INIT were passed.
+ * @return 0 on success, or an error code. (use giterr_last for information
+ *         about the error.)
+ */
+GIT_EXTERN(int) git_blame_file_start(
+		git_blame **out,
+		git_repository *repo,
+		const char *path,
+		git_blame_options *options);
+
+/**
+ * Get the next hunk of an incremental blame.
+ *
+ * Hunks are returned as soon as the commit they come from is known, in the
+ * order they are found (like `git blame --incremental`) rather than in the
+ * order of the lines.  The hunk is owned by the blame and lives as long as
+ * it does.
+ *
+ * Once every line has been blamed GIT_ITEROVER is returned, and the blame
+ * can be queried with `git_blame_get_hunk_byindex` and the other functions
+ * like one made by `git_blame_file`; adjacent hunks from the same commit
+ * may have been merged by then.
+ *
+ * Blaming can be stopped at any point by freeing the blame; when an error
+ * (or a cancellation from the progress callback) is returned, calling this
+ * again picks up where the blame stopped.
+ *
+ * @param out pointer that will receive the next hunk
+ * @param blame the blame started with `git_blame_file_start`
+ * @return 0 on success, GIT_ITEROVER when all lines are blamed, or an
+ *         error code
+ */
+GIT_EXTERN(int) git_blame_next(
+		const git_blame_hunk **out,
+		git_blame *blame);
+
 
 /**
  * Get blame data for a file that has been modified in memory. The `reference`
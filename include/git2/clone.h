@@ -54,6 +54,9 @@ typedef enum {
  *   means use the remote's HEAD.
  * - `signature` is the identity used when updating the reflog. NULL means to
  *   use the default signature using the config.
+ * - `depth` creates a shallow clone with this many commits of history
+ *   (see `git_remote_set_fetch_depth`).  0 clones the whole history.
+ *   Local clones always copy the whole history.
  */
 
 typedef struct git_clone_options {
@@ -68,9 +71,10 @@ typedef struct git_clone_options {
 	const char *remote_name;
 	const char* checkout_branch;
 	git_signature *signature;
+	unsigned int depth;
 } git_clone_options;
 
-#define GIT_CLONE_OPTIONS_VERSION 1
+#define GIT_CLONE_OPTIONS_VERSION 2
 #define GIT_CLONE_OPTIONS_INIT {GIT_CLONE_OPTIONS_VERSION, {GIT_CHECKOUT_OPTIONS_VERSION, GIT_CHECKOUT_SAFE_CREATE}, GIT_REMOTE_CALLBACKS_INIT}
 
 /**
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_git_describe_h__
+#define INCLUDE_git_describe_h__
+
+#include "common.h"
+#include "types.h"
+#include "oid.h"
+#include "buffer.h"
+
+/**
+ * @file git2/describe.h
+ * @brief Git describing routines
+ * @defgroup git_describe Git describing routines
+ * @ingroup Git
+ * @{
+ */
+GIT_BEGIN_DECL
+
+/**
+ * Reference lookup strategy
+ *
+ * These behave like the --tags and --all options to git-describe,
+ * namely they say to look for any reference in either refs/tags/ or
+ * refs/ respectively.
+ */
+typedef enum {
+	GIT_DESCRIBE_DEFAULT,
+	GIT_DESCRIBE_TAGS,
+	GIT_DESCRIBE_ALL,
+} git_describe_strategy_t;
+
+/**
+ * Describe options structure
+ *
+ * Initialize with `GIT_DESCRIBE_OPTIONS_INIT` macro to correctly set
+ * the `version` field.  E.g.
+ *
+ *		git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+ *
+ * - `max_candidates_tags` is the number of tags which are considered
+ *   as the nearest one (`--candidates`); the default is 10.  With 0,
+ *   only an exact match describes a commit.
+ * - `describe_strategy` is one of the `git_describe_strategy_t` values.
+ * - `pattern` restricts the tags used to the ones matching this glob
+ *   (`--match`).
+ * - `only_follow_first_parent` only considers the first parent of merge
+ *   commits when looking for the nearest tag (`--first-parent`).
+ * - `show_commit_oid_as_fallback` describes a commit that no tag
+ *   reaches with its abbreviated id (`--always`).
+ */
+typedef struct git_describe_options {
+	unsigned int version;
+
+	unsigned int max_candidates_tags;
+	unsigned int describe_strategy;
+	const char *pattern;
+	int only_follow_first_parent;
+	int show_commit_oid_as_fallback;
+} git_describe_options;
+
+#define GIT_DESCRIBE_DEFAULT_MAX_CANDIDATES_TAGS 10
+#define GIT_DESCRIBE_DEFAULT_ABBREVIATED_SIZE 7
+
+#define GIT_DESCRIBE_OPTIONS_VERSION 1
+#define GIT_DESCRIBE_OPTIONS_INIT { \
+	GIT_DESCRIBE_OPTIONS_VERSION, \
+	GIT_DESCRIBE_DEFAULT_MAX_CANDIDATES_TAGS, \
+}
+
+/**
+ * Initializes a `git_describe_options` with default values. Equivalent
+ * to creating an instance with GIT_DESCRIBE_OPTIONS_INIT.
+ *
+ * @param opts The `git_describe_options` struct to initialize
+ * @param version Version of struct; pass `GIT_DESCRIBE_OPTIONS_VERSION`
+ * @return Zero on success; -1 on failure.
+ */
+GIT_EXTERN(int) git_describe_init_options(
+	git_describe_options *opts,
+	unsigned int version);
+
+/**
+ * Options for formatting the describe string
+ *
+ * - `abbreviated_size` is the least number of hexadecimal digits of the
+ *   commit id to show; the default is 7.  With 0, only the name of the
+ *   nearest tag is shown (`--abbrev=0`).
+ * - `always_use_long_format` shows the distance and the commit id even
+ *   when the commit is tagged itself (`--long`).
+ * - `dirty_suffix` is appended when a working directory was described
+ *   and it has changes (`--dirty`).
+ */
+typedef struct {
+	unsigned int version;
+
+	unsigned int abbreviated_size;
+	int always_use_long_format;
+	const char *dirty_suffix;
+} git_describe_format_options;
+
+#define GIT_DESCRIBE_FORMAT_OPTIONS_VERSION 1
+#define GIT_DESCRIBE_FORMAT_OPTIONS_INIT { \
+	GIT_DESCRIBE_FORMAT_OPTIONS_VERSION, \
+	GIT_DESCRIBE_DEFAULT_ABBREVIATED_SIZE, \
+}
+
+/**
+ * Initializes a `git_describe_format_options` with default values.
+ * Equivalent to creating an instance with
+ * GIT_DESCRIBE_FORMAT_OPTIONS_INIT.
+ *
+ * @param opts The `git_describe_format_options` struct to initialize
+ * @param version Version of struct; pass
+ *        `GIT_DESCRIBE_FORMAT_OPTIONS_VERSION`
+ * @return Zero on success; -1 on failure.
+ */
+GIT_EXTERN(int) git_describe_init_format_options(
+	git_describe_format_options *opts,
+	unsigned int version);
+
+/** The result of describing a commit or a working directory */
+typedef struct git_describe_result git_describe_result;
+
+/**
+ * Describe a commit
+ *
+ * Find the tag nearest to a commit, and how many commits it is away
+ * from it, as `git describe <committish>` does.
+ *
+ * @param result pointer to store the result; free it with
+ *        `git_describe_result_free`
+ * @param committish a commit-ish object to describe
+ * @param opts the lookup options, or NULL for the defaults
+ * @return 0 on success, GIT_ENOTFOUND if no tag describes the commit,
+ *         or an error code
+ */
+GIT_EXTERN(int) git_describe_commit(
+	git_describe_result **result,
+	git_object *committish,
+	git_describe_options *opts);
+
+/**
+ * Describe many commits at once
+ *
+ * This gives the same results as describing each of the commits, but
+ * the references are only read once, and the history that the commits
+ * share is only parsed once.
+ *
+ * @param results an array of `count` pointers to store the results in;
+ *        free each of them with `git_describe_result_free`.  On error,
+ *        all of them are set to NULL.
+ * @param repo the repository holding the commits
+ * @param commits the ids of the commits to describe
+ * @param count the number of commits
+ * @param opts the lookup options, or NULL for the defaults
+ * @return 0 on success, GIT_ENOTFOUND if no tag describes one of the
+ *         commits, or an error code
+ */
+GIT_EXTERN(int) git_describe_many(
+	git_describe_result **results,
+	git_repository *repo,
+	const git_oid *commits,
+	size_t count,
+	git_describe_options *opts);
+
+/**
+ * Describe a working directory
+ *
+ * Describe the commit at HEAD, and record whether the working directory
+ * or the index have changes against it, as `git describe --dirty` does.
+ *
+ * @param out pointer to store the result; free it with
+ *        `git_describe_result_free`
+ * @param repo the repository whose working directory to describe
+ * @param opts the lookup options, or NULL for the defaults
+ * @return 0 on success, or an error code
+ */
+GIT_EXTERN(int) git_describe_workdir(
+	git_describe_result **out,
+	git_repository *repo,
+	git_describe_options *opts);
+
+/**
+ * Print the describe result to a buffer
+ *
+ * @param out The buffer to store the result
+ * @param result the result from `git_describe_commit()` or
+ *        `git_describe_workdir()`
+ * @param opts the formatting options, or NULL for the defaults
+ * @return 0 on success, or an error code
+ */
+GIT_EXTERN(int) git_describe_format(
+	git_buf *out,
+	const git_describe_result *result,
+	const git_describe_format_options *opts);
+
+/**
+ * Free the describe result.
+ *
+ * @param result the result to free
+ */
+GIT_EXTERN(void) git_describe_result_free(git_describe_result *result);
+
+/** @} */
+GIT_END_DECL
+
+#endif
@@ -356,6 +356,10 @@ typedef int (*git_diff_notify_cb)(
  * - `notify_payload` is the payload data to pass to the `notify_cb` function
  * - `ignore_submodules` overrides the submodule ignore setting for all
  *   submodules in the diff.
+ * - `threads` is the number of threads `git_diff_foreach` generates the
+ *   text of the files on (default 1).  Callbacks are still made in order
+ *   and on the calling thread.  Diffs with the working directory are always
+ *   generated on the calling thread.
  */
 typedef struct {
 	unsigned int version;      /**< version for the struct */
@@ -376,10 +380,11 @@ typedef struct {
 	git_off_t   max_size;         /**< defaults to 512MB */
 	const char *old_prefix;       /**< defaults to "a" */
 	const char *new_prefix;       /**< defaults to "b" */
+	unsigned int threads;         /**< defaults to 1 */
 } git_diff_options;
 
 /* The current version of the diff options structure */
-#define GIT_DIFF_OPTIONS_VERSION 1
+#define GIT_DIFF_OPTIONS_VERSION 2
 
 /* Stack initializer for diff options.  Alternatively use
  * `git_diff_options_init` programmatic initialization.
@@ -588,7 +593,8 @@ typedef struct {
  * - `rename_limit` is the maximum number of matches to consider for
  *   a particular file.  This is a little different from the `-l` option
  *   to regular Git because we will still process up to this many matches
- *   before abandoning the search.
+ *   before abandoning the search.  Files with identical contents are
+ *   always paired, whatever the limit.
  *
  * The `metric` option allows you to plug in a custom similarity metric.
  * Set it to NULL for the default internal metric which is based on sampling
@@ -622,9 +628,15 @@ typedef struct {
 
 	/** Pluggable similarity metric; pass NULL to use internal metric */
 	git_diff_similarity_metric *metric;
+
+	/** Number of threads to compare files on (default 1).  The result
+	 *  is the same whatever the number; with more than one, a custom
+	 *  `metric` must be safe to call from several threads at once.
+	 */
+	unsigned int threads;
 } git_diff_find_options;
 
-#define GIT_DIFF_FIND_OPTIONS_VERSION 1
+#define GIT_DIFF_FIND_OPTIONS_VERSION 2
 #define GIT_DIFF_FIND_OPTIONS_INIT {GIT_DIFF_FIND_OPTIONS_VERSION}
 
 /**
@@ -883,6 +895,12 @@ GIT_EXTERN(int) git_diff_is_sorted_icase(const git_diff *diff);
  * Returning a non-zero value from any of the callbacks will terminate
  * the iteration and return the value to the user.
  *
+ * Hunks and lines are not kept once their callbacks return, and the
+ * content of each file is released before moving on to the next one, so
+ * the memory used grows with the size of the largest file in the diff
+ * and not with the size of the diff.  Use `git_patch_from_diff` to keep
+ * the text diff of a file instead.
+ *
  * @param diff A git_diff generated by one of the above functions.
  * @param file_cb Callback function to make per file in the diff.
  * @param hunk_cb Optional callback to make per hunk of text diff.  This
@@ -931,6 +949,10 @@ typedef enum {
  * Returning a non-zero value from the callbacks will terminate the
  * iteration and return the non-zero value to the caller.
  *
+ * The text is handed to `print_cb` as it is generated and is not kept,
+ * as with `git_diff_foreach`, so that a patch of any size can be written
+ * out a file at a time.
+ *
  * @param diff A git_diff generated by one of the above functions.
  * @param format A git_diff_format_t value to pick the text format.
  * @param print_cb Callback to make per line of diff text.
@@ -1057,6 +1079,68 @@ GIT_EXTERN(int) git_diff_buffers(
 	git_diff_line_cb line_cb,
 	void *payload);
 
+/**
+ * A blob split into lines, to be diffed against many other blobs.
+ */
+typedef struct git_diff_prepared_blob git_diff_prepared_blob;
+
+/**
+ * Split a blob into lines once for all the diffs it is part of.
+ *
+ * Each diff of a blob splits its content into lines and hashes every
+ * one of them.  When the same blob is diffed again and again, as when
+ * comparing a base against each of its revisions, a prepared blob keeps
+ * these lines so that the work is only done once.
+ *
+ * The lines are hashed according to the whitespace flags of `options`;
+ * diffs made with other whitespace flags split the blob again.  A
+ * prepared blob is not changed by diffing it, and so can be used by
+ * diffs on several threads at once.
+ *
+ * @param out Output pointer to the prepared blob
+ * @param blob Blob to prepare, or NULL for empty blob
+ * @param as_path Treat blob as if it had this filename; can be NULL
+ * @param options Options for the diffs, or NULL for default options
+ * @return 0 on success or error code < 0
+ */
+GIT_EXTERN(int) git_diff_prepared_blob_new(
+	git_diff_prepared_blob **out,
+	const git_blob *blob,
+	const char *as_path,
+	const git_diff_options *options);
+
+/**
+ * Free a prepared blob.
+ *
+ * @param blob The prepared blob to free
+ */
+GIT_EXTERN(void) git_diff_prepared_blob_free(git_diff_prepared_blob *blob);
+
+/**
+ * Directly run a diff on two prepared blobs.
+ *
+ * This is just like `git_diff_blobs()`, using the blobs and the paths
+ * the prepared blobs were made with, but without splitting either of
+ * them into lines again.
+ *
+ * @param old_blob Prepared blob for old side of diff
+ * @param new_blob Prepared blob for new side of diff
+ * @param options Options for diff, or NULL for default options
+ * @param file_cb Callback for "file"; made once if there is a diff; can be NULL
+ * @param hunk_cb Callback for each hunk in diff; can be NULL
+ * @param line_cb Callback for each line in diff; can be NULL
+ * @param payload Payload passed to each callback function
+ * @return 0 on success, non-zero callback return value, or error code
+ */
+GIT_EXTERN(int) git_diff_prepared_blobs(
+	const git_diff_prepared_blob *old_blob,
+	const git_diff_prepared_blob *new_blob,
+	const git_diff_options *options,
+	git_diff_file_cb file_cb,
+	git_diff_hunk_cb hunk_cb,
+	git_diff_line_cb line_cb,
+	void *payload);
+
 /**
  * This is an opaque structure which is allocated by `git_diff_get_stats`.
  * You are responsible for releasing the object memory when done, using the
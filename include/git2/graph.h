@@ -36,6 +36,41 @@ GIT_BEGIN_DECL
  */
 GIT_EXTERN(int) git_graph_ahead_behind(size_t *ahead, size_t *behind, git_repository *repo, const git_oid *local, const git_oid *upstream);
 
+/**
+ * Count the unique commits between many commits and a common base
+ *
+ * This gives the same counts as calling `git_graph_ahead_behind` with
+ * each of the `tips` as `local` and `base` as `upstream`, but the
+ * history is walked only once for all of them, so the commits that
+ * several tips share are looked at only once.
+ *
+ * When libgit2 is built with thread support, the tips can be split over
+ * several threads, each walking the history for a part of them.
+ *
+ * @param ahead array receiving, for each tip, the number of commits
+ *        which are only in the tip's history
+ * @param behind array receiving, for each tip, the number of commits
+ *        which are only in the history of `base`
+ * @param merge_bases NULL, or an array receiving the most recent merge
+ *        base of each tip and `base`; an id is zeroed when there is none
+ * @param repo the repository where the commits exist
+ * @param base the commit that all of the tips are compared to
+ * @param tips the commits to compare to `base`
+ * @param count the number of tips, and the size of the output arrays
+ * @param threads the largest number of threads to use, or 0 for as many
+ *        as there are CPUs; few tips are always handled on one thread
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_graph_ahead_behind_many(
+	size_t *ahead,
+	size_t *behind,
+	git_oid *merge_bases,
+	git_repository *repo,
+	const git_oid *base,
+	const git_oid *tips,
+	size_t count,
+	unsigned int threads);
+
 
 /**
  * Determine if a commit is the descendant of another commit.
@@ -50,6 +85,67 @@ GIT_EXTERN(int) git_graph_descendant_of(
 	const git_oid *commit,
 	const git_oid *ancestor);
 
+/**
+ * Build an index for many reachability queries on the history of tips.
+ *
+ * `git_graph_descendant_of` walks the history for every question it
+ * answers.  When many questions are asked about the same history (for
+ * example when validating every updated reference of a push), it pays
+ * to label the commits once: the index numbers the commits reachable
+ * from `tips` in a single walk, after which most queries are answered
+ * from the labels alone, and the others only visit the commits which
+ * the labels can't rule out.
+ *
+ * The index describes the history as it was when it was built; it is
+ * not updated as new commits are made.
+ *
+ * @param out Pointer to store the index
+ * @param repo the repository where the commits exist
+ * @param tips the commits whose history is indexed
+ * @param count the number of commits in `tips`
+ * @return 0 on success, or an error code
+ */
+GIT_EXTERN(int) git_graph_reachability_new(
+	git_graph_reachability **out,
+	git_repository *repo,
+	const git_oid *tips,
+	size_t count);
+
+/**
+ * Determine if a commit is the descendant of another one using an index.
+ *
+ * The answer is the same as from `git_graph_descendant_of`.  When either
+ * commit wasn't indexed, the history is walked as that function does.
+ *
+ * An index may only be queried from one thread at a time.
+ *
+ * @param index the index built by `git_graph_reachability_new`
+ * @param commit a commit
+ * @param ancestor a potential ancestor commit
+ * @return 1 if the given commit is a descendant of the potential ancestor,
+ * 0 if not, error code otherwise.
+ */
+GIT_EXTERN(int) git_graph_reachability_descendant_of(
+	git_graph_reachability *index,
+	const git_oid *commit,
+	const git_oid *ancestor);
+
+/**
+ * Get the number of commits in an index.
+ *
+ * @param index the index
+ * @return the number of commits reachable from the indexed tips
+ */
+GIT_EXTERN(size_t) git_graph_reachability_size(
+	git_graph_reachability *index);
+
+/**
+ * Free an index built by `git_graph_reachability_new`.
+ *
+ * @param index the index to free
+ */
+GIT_EXTERN(void) git_graph_reachability_free(git_graph_reachability *index);
+
 /** @} */
 GIT_END_DECL
 #endif
@@ -123,6 +123,10 @@ typedef struct git_index_entry {
 #define GIT_IDXENTRY_UNPACKED          (1 << 8)
 #define GIT_IDXENTRY_NEW_SKIP_WORKTREE (1 << 9)
 
+/* unchanged in the working directory since the file system monitor token
+ * of the index (see git2/sys/fsmonitor.h) */
+#define GIT_IDXENTRY_FSMONITOR_VALID   (1 << 10)
+
 /** Capabilities of system that affect index actions. */
 typedef enum {
 	GIT_INDEXCAP_IGNORE_CASE = 1,
@@ -581,6 +585,105 @@ GIT_EXTERN(int) git_index_find(size_t *at_pos, git_index *index, const char *pat
 
 /**@}*/
 
+/** @name Batch Index Entry Functions
+ *
+ * These functions collect changes to an index and apply them all at once,
+ * which is much faster than adding or removing a large number of entries
+ * one at a time.  The changes are not visible in the index (and nothing
+ * is checked for file / directory collisions) until the batch is
+ * committed; when several changes in a batch affect the same path and
+ * stage, the last one wins.
+ */
+/**@{*/
+
+/**
+ * Create a new batch of changes to an index
+ *
+ * @param out Pointer to the new batch
+ * @param index The index that the batch will be applied to
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_index_batch_new(git_index_batch **out, git_index *index);
+
+/**
+ * Add or update an index entry as part of a batch
+ *
+ * This is the batch version of `git_index_add`; the entry is copied.
+ *
+ * @param batch The batch
+ * @param source_entry new entry object
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_index_batch_add(
+	git_index_batch *batch, const git_index_entry *source_entry);
+
+/**
+ * Add or update an index entry from a file on disk as part of a batch
+ *
+ * This is the batch version of `git_index_add_bypath`: the file is read
+ * (and written to the object database) immediately, and any conflict on
+ * the path is moved to the "resolve undo" (REUC) section when the batch
+ * is committed.
+ *
+ * @param batch The batch
+ * @param path filename to add
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_index_batch_add_bypath(
+	git_index_batch *batch, const char *path);
+
+/**
+ * Remove an entry from the index as part of a batch
+ *
+ * This is the batch version of `git_index_remove`; removing an entry
+ * that does not exist is not an error.
+ *
+ * @param batch The batch
+ * @param path path to remove
+ * @param stage stage to remove
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_index_batch_remove(
+	git_index_batch *batch, const char *path, int stage);
+
+/**
+ * Remove an index entry corresponding to a file on disk as part of a
+ * batch
+ *
+ * This is the batch version of `git_index_remove_bypath`.
+ *
+ * @param batch The batch
+ * @param path filename to remove
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_index_batch_remove_bypath(
+	git_index_batch *batch, const char *path);
+
+/**
+ * Apply the changes of a batch to its index
+ *
+ * The changes are sorted once and merged into the index in a single
+ * pass.  Entries already in the index that collide with new entries (a
+ * file where the batch adds a directory or vice versa) are removed.  If
+ * the batch itself adds both a file and a directory of the same name, an
+ * error is returned and the index is left unchanged.
+ *
+ * After a successful commit the batch is empty and may be reused.
+ *
+ * @param batch The batch
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_index_batch_commit(git_index_batch *batch);
+
+/**
+ * Free a batch, discarding any changes that were not committed
+ *
+ * @param batch The batch
+ */
+GIT_EXTERN(void) git_index_batch_free(git_index_batch *batch);
+
+/**@}*/
+
 /** @name Conflict Index Entry Functions
  *
  * These functions work on conflict index entries specifically (ie, stages 1-3)
@@ -294,11 +294,14 @@ GIT_EXTERN(void) git_odb_stream_free(git_odb_stream *stream);
 /**
  * Open a stream to read an object from the ODB
  *
- * Note that most backends do *not* support streaming reads
- * because they store their objects as compressed/delta'ed blobs.
+ * Note that not all backends support streaming reads.  The builtin
+ * backends stream loose objects and whole objects in packfiles, but
+ * not objects stored in a packfile as deltas, which can only be read
+ * as a whole.
  *
  * It's recommended to use `git_odb_read` instead, which is
- * assured to work on all backends.
+ * assured to work on all backends, unless only the start of a
+ * large object is needed.
  *
  * The returned stream will be of type `GIT_STREAM_RDONLY` and
  * will have the following methods:
@@ -79,6 +79,25 @@ GIT_EXTERN(int) git_patch_from_blobs(
 	const char *new_as_path,
 	const git_diff_options *opts);
 
+/**
+ * Directly generate a patch from the difference between two prepared blobs.
+ *
+ * This is just like `git_diff_prepared_blobs()` except it generates a
+ * patch object for the difference instead of directly making callbacks.
+ * You must call `git_patch_free()` on the patch when done.
+ *
+ * @param out The generated patch; NULL on error
+ * @param old_blob Prepared blob for old side of diff
+ * @param new_blob Prepared blob for new side of diff
+ * @param opts Options for diff, or NULL for default options
+ * @return 0 on success or error code < 0
+ */
+GIT_EXTERN(int) git_patch_from_prepared_blobs(
+	git_patch **out,
+	const git_diff_prepared_blob *old_blob,
+	const git_diff_prepared_blob *new_blob,
+	const git_diff_options *opts);
+
 /**
  * Directly generate a patch from the difference between a blob and a buffer.
  *
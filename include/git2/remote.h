@@ -602,6 +602,32 @@ GIT_EXTERN(int) git_remote_update_fetchhead(git_remote *remote);
  */
 GIT_EXTERN(void) git_remote_set_update_fetchhead(git_remote *remote, int value);
 
+/**
+ * Retrieve the depth of history fetched from the remote.
+ *
+ * @param remote the remote to query
+ * @return the number of commits fetched from each tip, or 0 for all
+ */
+GIT_EXTERN(unsigned int) git_remote_fetch_depth(git_remote *remote);
+
+/**
+ * Limit the history fetched from the remote to a number of commits.
+ *
+ * Like `git fetch --depth`, only the last `depth` commits of the
+ * history of each fetched reference are downloaded, and the commits
+ * at that boundary are recorded in the `shallow` file of the
+ * repository.  Fetching with a larger depth deepens the history of a
+ * shallow repository again.  By default (0) the whole history is
+ * fetched.
+ *
+ * Only the smart protocols support shallow fetches; fetching with a
+ * depth fails if the server doesn't support them.
+ *
+ * @param remote the remote to configure
+ * @param depth the number of commits to fetch from each tip, or 0
+ */
+GIT_EXTERN(void) git_remote_set_fetch_depth(git_remote *remote, unsigned int depth);
+
 /**
  * Ensure the remote name is well-formed.
  *
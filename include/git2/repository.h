@@ -711,6 +711,76 @@ GIT_EXTERN(const char *) git_repository_get_namespace(git_repository *repo);
  */
 GIT_EXTERN(int) git_repository_is_shallow(git_repository *repo);
 
+/**
+ * Keep the history learnt by revision walks for later ones
+ *
+ * Every revision walk (and every merge-base or descendant query, which
+ * walk the history as well) reads and parses the commits it visits
+ * again.  With the commit graph cache enabled, the parents, time and
+ * generation number of visited commits are remembered by the repository
+ * and shared by all of the walks on it, including walks on different
+ * threads.  This pays off for applications running many small history
+ * queries against one repository.
+ *
+ * When the cache holds `max_commits` commits, it is emptied and filled
+ * again.  Passing 0 disables the cache and frees its memory; this must
+ * not be done while other threads are using the repository.
+ *
+ * @param repo The repository
+ * @param max_commits The number of commits to keep, or 0 to disable
+ * @return 0 on success, or an error code
+ */
+GIT_EXTERN(int) git_repository_set_graph_cache(
+	git_repository *repo, size_t max_commits);
+
+/**
+ * Keep the similarity signatures of blobs for later rename detection
+ *
+ * Finding renames and copies in a diff computes a signature of the
+ * contents of every file compared, which means reading and hashing all
+ * of them, on every diff.  With the signature cache enabled, the
+ * signatures of blobs computed by the builtin similarity metric are
+ * remembered by the repository, so that diffs across the same history
+ * don't load those blobs again.  Files in the working directory are not
+ * cached.
+ *
+ * When the cache holds `max_signatures` signatures, the least recently
+ * used ones are dropped.  If `path` is given, the signatures saved in
+ * that file are loaded, and the ones computed by each diff are added to
+ * it (a file in the repository's `.git` directory is a good place).
+ * Passing 0 disables the cache and frees its memory; this must not be
+ * done while other threads are using the repository.
+ *
+ * @param repo The repository
+ * @param max_signatures The number of signatures to keep, or 0 to disable
+ * @param path The file to keep the signatures in, or NULL
+ * @return 0 on success, or an error code
+ */
+GIT_EXTERN(int) git_repository_set_signature_cache(
+	git_repository *repo, size_t max_signatures, const char *path);
+
+/**
+ * Remember which large blobs are binary for later diffs
+ *
+ * A diff decides whether a blob is binary from its first few kilobytes,
+ * which for large blobs are read on their own rather than loading the
+ * whole blob, and a binary blob is then never loaded at all.  With the
+ * binary cache enabled, the answer for each of those large blobs is
+ * also remembered by the repository, so that later diffs touching the
+ * same blobs (such as diffs across the history of a repository holding
+ * large binary assets) don't read them at all.
+ *
+ * When the cache holds `max_blobs` blobs, it is emptied and filled
+ * again.  Passing 0 disables the cache and frees its memory; this must
+ * not be done while other threads are using the repository.
+ *
+ * @param repo The repository
+ * @param max_blobs The number of blobs to keep, or 0 to disable
+ * @return 0 on success, or an error code
+ */
+GIT_EXTERN(int) git_repository_set_binary_cache(
+	git_repository *repo, size_t max_blobs);
+
 /** @} */
 GIT_END_DECL
 #endif
@@ -10,6 +10,7 @@
 #include "common.h"
 #include "types.h"
 #include "oid.h"
+#include "strarray.h"
 
 /**
  * @file git2/revwalk.h
@@ -32,6 +33,11 @@ GIT_BEGIN_DECL
  * Sort the repository contents in topological order
  * (parents before children); this sorting mode
  * can be combined with time sorting.
+ *
+ * Once generation numbers have been recorded with
+ * `git_revwalk_write_path_filters`, commits are returned
+ * as soon as they are known to be in order, instead of
+ * after the whole history has been walked.
  */
 #define GIT_SORT_TOPOLOGICAL (1 << 0)
 
@@ -63,6 +69,10 @@ GIT_BEGIN_DECL
  * it is possible to have several revision walkers in
  * several different threads walking the same repository.
  *
+ * The walker follows the grafts of the repository (`info/grafts`)
+ * and stops at the boundary of a shallow clone: the commits listed
+ * in the `shallow` file are walked as if they had no parents.
+ *
  * @param out pointer to the new revision walker
  * @param repo the repo to walk through
  * @return 0 or an error code
@@ -244,6 +254,51 @@ GIT_EXTERN(int) git_revwalk_push_range(git_revwalk *walk, const char *range);
  */
 GIT_EXTERN(void) git_revwalk_simplify_first_parent(git_revwalk *walk);
 
+/**
+ * Limit the walk to commits that modify the given paths
+ *
+ * Only commits whose tree differs from that of their parents at one of
+ * the given paths will be returned, as for `git log -- <paths>`.  A merge
+ * which matches one of its parents at all of the paths is not returned,
+ * and only the history of that parent is followed.
+ *
+ * The paths are relative to the root of the repository and are matched
+ * literally (no wildcards); a directory covers everything underneath it.
+ *
+ * Changing the paths resets the walker.
+ *
+ * @param walk the walker being used for the traversal
+ * @param paths the paths to limit the walk to, or NULL to walk all commits
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_revwalk_limit_paths(
+	git_revwalk *walk, const git_strarray *paths);
+
+/**
+ * Record which paths the commits of the walk change
+ *
+ * The walk is run, and for each commit that it returns, a Bloom filter
+ * of the paths that the commit changes relative to its first parent is
+ * written to `objects/info/commit-path-filters`, next to the filters of
+ * commits that were recorded before.  Walks limited with
+ * `git_revwalk_limit_paths` and blame use the filters to skip the
+ * commits which cannot have changed the paths they are looking at,
+ * without loading their trees.
+ *
+ * The generation number of each commit is recorded as well, which lets
+ * topological walks return their first commits before having seen the
+ * whole history.  It is only known for commits whose parents have all
+ * been recorded, so the walk should cover complete histories.  For the
+ * same reason, no filters are written for shallow repositories or ones
+ * with grafts, and walks in those don't use them.
+ *
+ * The walker is switched to reverse topological sorting.
+ *
+ * @param walk the walker returning the commits to record
+ * @return 0 or an error code
+ */
+GIT_EXTERN(int) git_revwalk_write_path_filters(git_revwalk *walk);
+
 
 /**
  * Free a revision walker previously allocated.
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_sys_git_fsmonitor_h__
+#define INCLUDE_sys_git_fsmonitor_h__
+
+#include "git2/common.h"
+#include "git2/types.h"
+#include "git2/buffer.h"
+
+/**
+ * @file git2/sys/fsmonitor.h
+ * @brief Git file system monitor provider functions
+ * @defgroup git_fsmonitor Git file system monitor provider API
+ * @ingroup Git
+ * @{
+ *
+ * A file system monitor tells libgit2 which paths in the working
+ * directory may have changed since a previous point in time.  With one
+ * set on a repository, scans of the working directory trust the stat
+ * data recorded in the index for files that were unchanged at the last
+ * scan and that the monitor does not report, instead of calling `lstat`
+ * on each of them.
+ *
+ * Points in time are described by opaque tokens that the monitor hands
+ * out.  The token for the last scan is kept in the index (in the "FSMN"
+ * extension, along with which entries were unchanged) so it survives
+ * across processes if the monitor can answer for tokens from earlier
+ * instances.
+ */
+GIT_BEGIN_DECL
+
+/**
+ * Callback for each path reported by a file system monitor.
+ *
+ * `path` is relative to the working directory.  A path naming a
+ * directory (with or without a trailing slash) covers everything
+ * beneath it; the empty path covers the whole working directory.
+ */
+typedef int (*git_fsmonitor_changed_cb)(const char *path, void *payload);
+
+/** A file system monitor */
+struct git_fsmonitor {
+	unsigned int version;
+
+	/**
+	 * Report every path that may have changed since the point in time
+	 * described by `token` (which is NULL if there is none) and set
+	 * `token_out` to a token for the current point in time.  Changes
+	 * made while the query runs may be reported now and again by the
+	 * next query, but must not be missed by both.
+	 *
+	 * Return GIT_ENOTFOUND (still setting `token_out`) if the changes
+	 * since `token` are not known - for instance because the token was
+	 * handed out by another monitor or history was lost - and all paths
+	 * must be assumed to have changed.  A monitor must provide this
+	 * function.
+	 */
+	int (*query)(
+		git_buf *token_out,
+		git_fsmonitor *fsmonitor,
+		const char *token,
+		git_fsmonitor_changed_cb changed_cb,
+		void *payload);
+
+	/**
+	 * Free the monitor.  A monitor must provide this function.
+	 */
+	void (*free)(git_fsmonitor *fsmonitor);
+};
+
+#define GIT_FSMONITOR_VERSION 1
+#define GIT_FSMONITOR_INIT {GIT_FSMONITOR_VERSION}
+
+/**
+ * Initializes a `git_fsmonitor` with default values. Equivalent to
+ * creating an instance with GIT_FSMONITOR_INIT.
+ *
+ * @param fsmonitor the `git_fsmonitor` struct to initialize
+ * @param version Version of struct; pass `GIT_FSMONITOR_VERSION`
+ * @return Zero on success; -1 on failure.
+ */
+GIT_EXTERN(int) git_fsmonitor_init(
+	git_fsmonitor *fsmonitor,
+	unsigned int version);
+
+/**
+ * Create the built-in file system monitor for a working directory
+ *
+ * This monitor watches the directories of the working directory (except
+ * for the `.git` directory) with inotify from the moment it is created,
+ * so it can only answer for tokens that it handed out itself; the first
+ * scan of each index after creating it examines every file.  It is only
+ * available on Linux; elsewhere this returns an error.
+ *
+ * @param out Pointer to the new monitor
+ * @param workdir Path to the working directory to watch
+ * @return 0 on success, <0 error code on failure
+ */
+GIT_EXTERN(int) git_fsmonitor_inotify_new(
+	git_fsmonitor **out,
+	const char *workdir);
+
+/**
+ * Set the file system monitor for a repository
+ *
+ * The monitor will be consulted when scanning the working directory of
+ * the repository with its own index.  Pass NULL to remove the current
+ * monitor.
+ *
+ * The repository takes ownership of the monitor, so you should NOT free
+ * it after calling this function; it will be freed with the repository
+ * or when it is replaced.
+ *
+ * @param repo A repository object
+ * @param fsmonitor The monitor, or NULL
+ * @return 0 on success; error code otherwise
+ */
+GIT_EXTERN(int) git_repository_set_fsmonitor(
+	git_repository *repo,
+	git_fsmonitor *fsmonitor);
+
+/** @} */
+GIT_END_DECL
+#endif
@@ -98,6 +98,9 @@ typedef struct git_refdb git_refdb;
 /** A custom backend for refs */
 typedef struct git_refdb_backend git_refdb_backend;
 
+/** A file system monitor for a working directory */
+typedef struct git_fsmonitor git_fsmonitor;
+
 /**
  * Representation of an existing git repository,
  * including all its object contents
@@ -110,6 +113,9 @@ typedef struct git_object git_object;
 /** Representation of an in-progress walk through the commits in a repo */
 typedef struct git_revwalk git_revwalk;
 
+/** An index for answering many reachability queries on a history */
+typedef struct git_graph_reachability git_graph_reachability;
+
 /** Parsed representation of a tag object. */
 typedef struct git_tag git_tag;
 
@@ -134,6 +140,9 @@ typedef struct git_index git_index;
 /** An iterator for conflicts in the index. */
 typedef struct git_index_conflict_iterator git_index_conflict_iterator;
 
+/** A set of changes to be applied to an index at once. */
+typedef struct git_index_batch git_index_batch;
+
 /** Memory representation of a set of config files */
 typedef struct git_config git_config;
 
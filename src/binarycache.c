@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "binarycache.h"
+
+GIT__USE_OIDMAP;
+
+int git_binarycache_new(git_binarycache **out, size_t max_entries)
+{
+	git_binarycache *cache;
+
+	assert(out && max_entries > 0);
+
+	cache = git__calloc(1, sizeof(git_binarycache));
+	GITERR_CHECK_ALLOC(cache);
+
+	if (git_rwlock_init(&cache->lock)) {
+		giterr_set(GITERR_OS, "Failed to initialize lock");
+		git__free(cache);
+		return -1;
+	}
+
+	if (git_pool_init(&cache->pool, sizeof(git_binarycache_entry), 0) < 0 ||
+		(cache->map = git_oidmap_alloc()) == NULL) {
+		git_binarycache_free(cache);
+		giterr_set_oom();
+		return -1;
+	}
+
+	cache->max_entries = max_entries;
+
+	*out = cache;
+	return 0;
+}
+
+int git_binarycache_get(git_binarycache *cache, const git_oid *blob_id)
+{
+	khiter_t pos;
+	int binary = GIT_ENOTFOUND;
+
+	assert(cache && blob_id);
+
+	if (git_rwlock_rdlock(&cache->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to lock binary blob cache");
+		return -1;
+	}
+
+	pos = kh_get(oid, cache->map, blob_id);
+	if (pos != kh_end(cache->map))
+		binary = ((git_binarycache_entry *)kh_value(cache->map, pos))->binary;
+
+	git_rwlock_rdunlock(&cache->lock);
+	return binary;
+}
+
+int git_binarycache_put(
+	git_binarycache *cache, const git_oid *blob_id, int binary)
+{
+	git_binarycache_entry *entry;
+	khiter_t pos;
+	int ret, error = 0;
+
+	assert(cache && blob_id);
+
+	if (git_rwlock_wrlock(&cache->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to lock binary blob cache");
+		return -1;
+	}
+
+	if (kh_get(oid, cache->map, blob_id) != kh_end(cache->map))
+		goto done;
+
+	/* nothing can be referring to entries, so a full cache is emptied */
+	if (kh_size(cache->map) >= cache->max_entries) {
+		kh_clear(oid, cache->map);
+		git_pool_clear(&cache->pool);
+	}
+
+	if ((entry = git_pool_malloc(&cache->pool, 1)) == NULL) {
+		giterr_set_oom();
+		error = -1;
+		goto done;
+	}
+
+	git_oid_cpy(&entry->oid, blob_id);
+	entry->binary = (binary != 0);
+
+	pos = kh_put(oid, cache->map, &entry->oid, &ret);
+	if (ret < 0) {
+		giterr_set_oom();
+		error = -1;
+		goto done;
+	}
+	kh_value(cache->map, pos) = entry;
+
+done:
+	git_rwlock_wrunlock(&cache->lock);
+	return error;
+}
+
+size_t git_binarycache_size(git_binarycache *cache)
+{
+	size_t size;
+
+	if (git_rwlock_rdlock(&cache->lock) < 0)
+		return 0;
+
+	size = (size_t)kh_size(cache->map);
+
+	git_rwlock_rdunlock(&cache->lock);
+	return size;
+}
+
+void git_binarycache_free(git_binarycache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	git_oidmap_free(cache->map);
+	git_pool_clear(&cache->pool);
+	git_rwlock_free(&cache->lock);
+	git__free(cache);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_binarycache_h__
+#define INCLUDE_binarycache_h__
+
+#include "common.h"
+#include "git2/oid.h"
+#include "thread-utils.h"
+#include "oidmap.h"
+#include "pool.h"
+
+/*
+ * Binary blob cache
+ *
+ * Diffs decide whether a blob is binary by looking for a NUL in its
+ * first bytes, which for a large blob means opening and inflating the
+ * start of the object on every diff.  A repository can remember what
+ * was found for each blob; as blobs never change, the answer is keyed
+ * by the id of the blob alone.
+ *
+ * The cache is shared between threads, and the whole cache is dropped
+ * when it is full.
+ */
+
+typedef struct {
+	git_oid oid;
+	int binary;
+} git_binarycache_entry;
+
+typedef struct {
+	git_rwlock lock;
+	git_oidmap *map;
+	git_pool pool;
+	size_t max_entries;
+} git_binarycache;
+
+extern int git_binarycache_new(git_binarycache **out, size_t max_entries);
+
+/*
+ * Look up whether a blob is binary, returning 1 if it is, 0 if it is
+ * text, or GIT_ENOTFOUND if the blob is not in the cache.
+ */
+extern int git_binarycache_get(git_binarycache *cache, const git_oid *blob_id);
+
+/* Remember whether a blob is binary */
+extern int git_binarycache_put(
+	git_binarycache *cache, const git_oid *blob_id, int binary);
+
+extern size_t git_binarycache_size(git_binarycache *cache);
+
+extern void git_binarycache_free(git_binarycache *cache);
+
+#endif
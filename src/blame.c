@@ -5,6 +5,8 @@
  * a Linking Exception. For full terms see the included COPYING file.
  */
 
+#include <stddef.h>
+
 #include "blame.h"
 #include "git2/commit.h"
 #include "git2/revparse.h"
@@ -119,6 +121,7 @@ git_blame* git_blame__alloc(
 	gbr->options = opts;
 
 	if (git_vector_init(&gbr->hunks, 8, hunk_cmp) < 0 ||
+		git_vector_init(&gbr->finished, 8, NULL) < 0 ||
 		git_vector_init(&gbr->paths, 8, paths_cmp) < 0 ||
 		(gbr->path = git__strdup(path)) == NULL ||
 		git_vector_insert(&gbr->paths, git__strdup(path)) < 0)
@@ -134,6 +137,7 @@ void git_blame_free(git_blame *blame)
 {
 	size_t i;
 	git_blame_hunk *hunk;
+	git_blame__entry *ent;
 
 	if (!blame) return;
 
@@ -141,7 +145,18 @@ void git_blame_free(git_blame *blame)
 		free_hunk(hunk);
 	git_vector_free(&blame->hunks);
 
+	git_vector_foreach(&blame->finished, i, hunk)
+		free_hunk(hunk);
+	git_vector_free(&blame->finished);
+
+	/* an incremental blame may be stopped before all lines are blamed */
+	while ((ent = blame->ent) != NULL) {
+		blame->ent = ent->next;
+		git_blame__free_entry(ent);
+	}
+
 	git_vector_free_deep(&blame->paths);
+	git_bloom_file_free(blame->path_filters);
 
 	git_array_clear(blame->line_index);
 
@@ -182,7 +197,9 @@ static void normalize_options(
 	git_blame_options dummy = GIT_BLAME_OPTIONS_INIT;
 	if (!in) in = &dummy;
 
-	memcpy(out, in, sizeof(git_blame_options));
+	/* version 1 of the options ends before `progress_cb` */
+	memcpy(out, in, in->version < 2 ?
+		offsetof(git_blame_options, progress_cb) : sizeof(git_blame_options));
 
 	/* No newest_commit => HEAD */
 	if (git_oid_iszero(&out->newest_commit)) {
@@ -296,38 +313,103 @@ cleanup:
 
 static int blame_internal(git_blame *blame)
 {
-	int error;
+	int error, num_lines;
+	uint32_t max_line;
 	git_blame__entry *ent = NULL;
 	git_blame__origin *o;
 
 	if ((error = load_blob(blame)) < 0 ||
 	    (error = git_blame__get_origin(&o, blame, blame->final, blame->path)) < 0)
-		goto cleanup;
+		return error;
 	blame->final_buf = git_blob_rawcontent(blame->final_blob);
 	blame->final_buf_size = git_blob_rawsize(blame->final_blob);
 
 	ent = git__calloc(1, sizeof(git_blame__entry));
-	ent->num_lines = index_blob_lines(blame);
+	GITERR_CHECK_ALLOC(ent);
+	ent->suspect = o;
+	blame->ent = ent;
+
+	if ((num_lines = index_blob_lines(blame)) < 0)
+		return num_lines;
+
+	max_line = blame->options.max_line ?
+		blame->options.max_line : (uint32_t)num_lines;
+
+	if ((blame->options.min_line > 1 || blame->options.max_line > 0) &&
+		(max_line > (uint32_t)num_lines || blame->options.min_line > max_line)) {
+		giterr_set(GITERR_INVALID, "Invalid line range %u-%u for '%s' with %d lines",
+			blame->options.min_line, max_line, blame->path, num_lines);
+		return -1;
+	}
+
 	ent->lno = blame->options.min_line - 1;
-	ent->num_lines = ent->num_lines - blame->options.min_line + 1;
+	ent->num_lines = num_lines - blame->options.min_line + 1;
 	if (blame->options.max_line > 0)
 		ent->num_lines = blame->options.max_line - blame->options.min_line + 1;
 	ent->s_lno = ent->lno;
-	ent->suspect = o;
 
-	blame->ent = ent;
-	blame->path = blame->path;
+	blame->lines_total = (uint32_t)ent->num_lines;
+	return 0;
+}
 
-	git_blame__like_git(blame, blame->options.flags);
+/* Turn the entries of a blame which is over into its hunks */
+static int blame_finish(git_blame *blame)
+{
+	git_blame__entry *ent;
+	git_blame_hunk *hunk;
+	int error = 0;
 
-cleanup:
-	for (ent = blame->ent; ent; ) {
-		git_blame__entry *e = ent->next;
+	git_blame__coalesce(blame);
 
-		git_vector_insert(&blame->hunks, hunk_from_entry(ent));
+	while ((ent = blame->ent) != NULL) {
+		blame->ent = ent->next;
+
+		if (!error &&
+			((hunk = hunk_from_entry(ent)) == NULL ||
+			 git_vector_insert(&blame->hunks, hunk) < 0))
+			error = -1;
 
 		git_blame__free_entry(ent);
-		ent = e;
+	}
+
+	blame->done = true;
+	return error;
+}
+
+/*
+ * Look at the next commit in the history of the file; the entries which
+ * were blamed on it are counted, and kept as hunks for git_blame_next.
+ */
+static int blame_step(git_blame *blame, bool keep_hunks)
+{
+	git_blame__entry *ent;
+	git_blame_hunk *hunk;
+	int error;
+
+	if ((error = git_blame__step(blame, blame->options.flags)) == GIT_ITEROVER) {
+		if ((error = blame_finish(blame)) < 0)
+			return error;
+		return GIT_ITEROVER;
+	}
+
+	for (ent = blame->ent; !error && ent; ent = ent->next) {
+		if (!ent->guilty || ent->reported)
+			continue;
+
+		ent->reported = true;
+		blame->lines_blamed += ent->num_lines;
+
+		if (keep_hunks &&
+			((hunk = hunk_from_entry(ent)) == NULL ||
+			 git_vector_insert(&blame->finished, hunk) < 0))
+			error = -1;
+	}
+
+	if (!error && blame->options.progress_cb &&
+		blame->options.progress_cb(blame->lines_blamed,
+			blame->lines_total, blame->options.progress_payload)) {
+		giterr_clear();
+		error = GIT_EUSER;
 	}
 
 	return error;
@@ -337,7 +419,7 @@ cleanup:
  * File blaming
  ******************************************************************************/
 
-int git_blame_file(
+int git_blame_file_start(
 		git_blame **out,
 		git_repository *repo,
 		const char *path,
@@ -348,6 +430,7 @@ int git_blame_file(
 	git_blame *blame = NULL;
 
 	assert(out && repo && path);
+	GITERR_CHECK_VERSION(options, GIT_BLAME_OPTIONS_VERSION, "git_blame_options");
 	normalize_options(&normOptions, options, repo);
 
 	blame = git_blame__alloc(repo, normOptions, path);
@@ -356,6 +439,12 @@ int git_blame_file(
 	if ((error = load_blob(blame)) < 0)
 		goto on_error;
 
+	error = git_bloom_file_open(&blame->path_filters, repo);
+	if (error == GIT_ENOTFOUND)
+		giterr_clear();
+	else if (error < 0)
+		goto on_error;
+
 	if ((error = blame_internal(blame)) < 0)
 		goto on_error;
 
@@ -367,6 +456,50 @@ on_error:
 	return error;
 }
 
+int git_blame_next(const git_blame_hunk **out, git_blame *blame)
+{
+	int error;
+
+	assert(out && blame);
+
+	*out = NULL;
+
+	while (blame->finished_pos >= blame->finished.length) {
+		if (blame->done)
+			return GIT_ITEROVER;
+
+		if ((error = blame_step(blame, true)) < 0)
+			return error;
+	}
+
+	*out = git_vector_get(&blame->finished, blame->finished_pos++);
+	return 0;
+}
+
+int git_blame_file(
+		git_blame **out,
+		git_repository *repo,
+		const char *path,
+		git_blame_options *options)
+{
+	git_blame *blame;
+	int error;
+
+	if ((error = git_blame_file_start(&blame, repo, path, options)) < 0)
+		return error;
+
+	while (!(error = blame_step(blame, false)))
+		/* blame every line */;
+
+	if (error != GIT_ITEROVER) {
+		git_blame_free(blame);
+		return error;
+	}
+
+	*out = blame;
+	return 0;
+}
+
 /*******************************************************************************
  * Buffer blaming
  *******************************************************************************/
@@ -6,6 +6,7 @@
 #include "vector.h"
 #include "diff.h"
 #include "array.h"
+#include "bloom.h"
 #include "git2/oid.h"
 
 /*
@@ -61,6 +62,11 @@ typedef struct git_blame__entry {
 	/* Whether this entry has been tracked to a boundary commit.
 	 */
 	bool is_boundary;
+
+	/* true once the entry has been counted as blamed (and returned by
+	 * git_blame_next).
+	 */
+	bool reported;
 } git_blame__entry;
 
 struct git_blame {
@@ -70,6 +76,7 @@ struct git_blame {
 
 	git_vector hunks;
 	git_vector paths;
+	git_bloom_file *path_filters;
 
 	git_blob *final_blob;
 	git_array_t(size_t) line_index;
@@ -83,6 +90,13 @@ struct git_blame {
 	int num_lines;
 	const char *final_buf;
 	git_off_t final_buf_size;
+
+	/* Incremental blame */
+	git_vector finished;
+	size_t finished_pos;
+	uint32_t lines_blamed;
+	uint32_t lines_total;
+	bool done;
 };
 
 git_blame *git_blame__alloc(
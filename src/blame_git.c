@@ -53,7 +53,10 @@ static int make_origin(git_blame__origin **out, git_commit *commit, const char *
 	return error;
 }
 
-/* Locate an existing origin or create a new one. */
+/*
+ * Locate an existing origin or create a new one.  The origin takes over
+ * the reference to the commit.
+ */
 int git_blame__get_origin(
 		git_blame__origin **out,
 		git_blame *blame,
@@ -62,9 +65,13 @@ int git_blame__get_origin(
 {
 	git_blame__entry *e;
 
+	/* share the origin, and with it the blob, with the entries using it */
 	for (e = blame->ent; e; e = e->next) {
-		if (e->suspect->commit == commit && !strcmp(e->suspect->path, path)) {
+		if (!git_oid_cmp(git_commit_id(e->suspect->commit), git_commit_id(commit)) &&
+			!strcmp(e->suspect->path, path)) {
 			*out = origin_incref(e->suspect);
+			git_commit_free(commit);
+			return 0;
 		}
 	}
 	return make_origin(out, commit, path);
@@ -394,6 +401,37 @@ static int paths_on_dup(void **old, void *new)
 	return -1;
 }
 
+/*
+ * Whether the changed-path filter of a commit rules out any change to
+ * the paths we're interested in relative to its first parent.
+ */
+static bool unchanged_by_filter(
+		git_blame *blame,
+		git_commit *parent,
+		git_blame__origin *origin)
+{
+	git_bloom_filter filter;
+	git_bloom_key key;
+	const git_oid *first_parent;
+	const char *path;
+	size_t i;
+
+	if (!blame->path_filters ||
+		(first_parent = git_commit_parent_id(origin->commit, 0)) == NULL ||
+		!git_oid_equal(first_parent, git_commit_id(parent)) ||
+		git_bloom_file_lookup(&filter, blame->path_filters,
+			git_commit_id(origin->commit)) < 0)
+		return false;
+
+	git_vector_foreach(&blame->paths, i, path) {
+		git_bloom_key_init(&key, path, strlen(path));
+		if (git_bloom_filter_contains(&filter, &key))
+			return false;
+	}
+
+	return true;
+}
+
 static git_blame__origin* find_origin(
 		git_blame *blame,
 		git_commit *parent,
@@ -404,6 +442,11 @@ static git_blame__origin* find_origin(
 	git_diff_options diffopts = GIT_DIFF_OPTIONS_INIT;
 	git_tree *otree=NULL, *ptree=NULL;
 
+	if (unchanged_by_filter(blame, parent, origin)) {
+		git_blame__get_origin(&porigin, blame, parent, origin->path);
+		return porigin;
+	}
+
 	/* Get the trees from this commit and its parent */
 	if (0 != git_commit_tree(&otree, origin->commit) ||
 	    0 != git_commit_tree(&ptree, parent))
@@ -563,7 +606,7 @@ finish:
  * contiguous lines in the same origin (i.e. <commit, path> pair),
  * merge them together.
  */
-static void coalesce(git_blame *blame)
+void git_blame__coalesce(git_blame *blame)
 {
 	git_blame__entry *ent, *next;
 
@@ -584,36 +627,34 @@ static void coalesce(git_blame *blame)
 	}
 }
 
-void git_blame__like_git(git_blame *blame, uint32_t opt)
+int git_blame__step(git_blame *blame, uint32_t opt)
 {
-	while (true) {
-		git_blame__entry *ent;
-		git_blame__origin *suspect = NULL;
-
-		/* Find a suspect to break down */
-		for (ent = blame->ent; !suspect && ent; ent = ent->next)
-			if (!ent->guilty)
-				suspect = ent->suspect;
-		if (!suspect)
-			return; /* all done */
-
-		/* We'll use this suspect later in the loop, so hold on to it for now. */
-		origin_incref(suspect);
-		pass_blame(blame, suspect, opt);
-
-		/* Take responsibility for the remaining entries */
-		for (ent = blame->ent; ent; ent = ent->next) {
-			if (same_suspect(ent->suspect, suspect)) {
-				ent->guilty = true;
-				ent->is_boundary = !git_oid_cmp(
-						git_commit_id(suspect->commit),
-						&blame->options.oldest_commit);
-			}
+	git_blame__entry *ent;
+	git_blame__origin *suspect = NULL;
+
+	/* Find a suspect to break down */
+	for (ent = blame->ent; !suspect && ent; ent = ent->next)
+		if (!ent->guilty)
+			suspect = ent->suspect;
+	if (!suspect)
+		return GIT_ITEROVER; /* all done */
+
+	/* We'll use this suspect later in the loop, so hold on to it for now. */
+	origin_incref(suspect);
+	pass_blame(blame, suspect, opt);
+
+	/* Take responsibility for the remaining entries */
+	for (ent = blame->ent; ent; ent = ent->next) {
+		if (same_suspect(ent->suspect, suspect)) {
+			ent->guilty = true;
+			ent->is_boundary = !git_oid_cmp(
+					git_commit_id(suspect->commit),
+					&blame->options.oldest_commit);
 		}
-		origin_decref(suspect);
 	}
+	origin_decref(suspect);
 
-	coalesce(blame);
+	return 0;
 }
 
 void git_blame__free_entry(git_blame__entry *ent)
@@ -15,6 +15,15 @@ int git_blame__get_origin(
 		git_commit *commit,
 		const char *path);
 void git_blame__free_entry(git_blame__entry *ent);
-void git_blame__like_git(git_blame *sb, uint32_t flags);
+
+/*
+ * Find the origin of the lines of one suspect, blaming it for the ones
+ * which don't come from its parents.  Returns GIT_ITEROVER once every
+ * line has been blamed.
+ */
+int git_blame__step(git_blame *sb, uint32_t flags);
+
+/* Merge the neighbouring entries which were blamed on the same origin */
+void git_blame__coalesce(git_blame *sb);
 
 #endif
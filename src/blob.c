@@ -151,6 +151,38 @@ static int write_symlink(
 	return error;
 }
 
+int git_blob__create_from_file(
+	git_oid *id,
+	git_odb *odb,
+	const char *content_path,
+	mode_t mode,
+	git_off_t size,
+	git_filter_list *fl)
+{
+	if (S_ISLNK(mode))
+		return write_symlink(id, odb, content_path, (size_t)size);
+
+	/* No filters need to be applied to the document: we can stream
+	 * directly from disk */
+	if (fl == NULL)
+		return write_file_stream(id, odb, content_path, size);
+
+	/*
+	 * TODO: eventually support streaming filtered files, for files
+	 * which are bigger than a given threshold. This is not a priority
+	 * because applying a filter in streaming mode changes the final
+	 * size of the blob, and without knowing its final size, the blob
+	 * cannot be written in stream mode to the ODB.
+	 *
+	 * The plan is to do streaming writes to a tempfile on disk and then
+	 * opening streaming that file to the ODB, using
+	 * `write_file_stream`.
+	 *
+	 * CAREFULLY DESIGNED APIS YO
+	 */
+	return write_file_filtered(id, &size, odb, content_path, fl);
+}
+
 int git_blob__create_from_paths(
 	git_oid *id,
 	struct stat *out_st,
@@ -166,6 +198,7 @@ int git_blob__create_from_paths(
 	git_off_t size;
 	mode_t mode;
 	git_buf path = GIT_BUF_INIT;
+	git_filter_list *fl = NULL;
 
 	assert(hint_path || !try_load_filters);
 
@@ -190,44 +223,17 @@ int git_blob__create_from_paths(
 	size = st.st_size;
 	mode = hint_mode ? hint_mode : st.st_mode;
 
-	if (S_ISLNK(mode)) {
-		error = write_symlink(id, odb, content_path, (size_t)size);
-	} else {
-		git_filter_list *fl = NULL;
-
-		if (try_load_filters)
-			/* Load the filters for writing this file to the ODB */
-			error = git_filter_list_load(
-				&fl, repo, NULL, hint_path,
-				GIT_FILTER_TO_ODB, GIT_FILTER_OPT_DEFAULT);
+	if (try_load_filters && !S_ISLNK(mode))
+		/* Load the filters for writing this file to the ODB */
+		error = git_filter_list_load(
+			&fl, repo, NULL, hint_path,
+			GIT_FILTER_TO_ODB, GIT_FILTER_OPT_DEFAULT);
 
-		if (error < 0)
-			/* well, that didn't work */;
-		else if (fl == NULL)
-			/* No filters need to be applied to the document: we can stream
-			 * directly from disk */
-			error = write_file_stream(id, odb, content_path, size);
-		else {
-			/* We need to apply one or more filters */
-			error = write_file_filtered(id, &size, odb, content_path, fl);
-
-			git_filter_list_free(fl);
-		}
+	if (!error)
+		error = git_blob__create_from_file(
+			id, odb, content_path, mode, size, fl);
 
-		/*
-		 * TODO: eventually support streaming filtered files, for files
-		 * which are bigger than a given threshold. This is not a priority
-		 * because applying a filter in streaming mode changes the final
-		 * size of the blob, and without knowing its final size, the blob
-		 * cannot be written in stream mode to the ODB.
-		 *
-		 * The plan is to do streaming writes to a tempfile on disk and then
-		 * opening streaming that file to the ODB, using
-		 * `write_file_stream`.
-		 *
-		 * CAREFULLY DESIGNED APIS YO
-		 */
-	}
+	git_filter_list_free(fl);
 
 done:
 	git_odb_free(odb);
@@ -11,6 +11,7 @@
 #include "repository.h"
 #include "odb.h"
 #include "fileops.h"
+#include "git2/filter.h"
 
 struct git_blob {
 	git_object object;
@@ -21,6 +22,18 @@ void git_blob__free(void *blob);
 int git_blob__parse(void *blob, git_odb_object *obj);
 int git_blob__getbuf(git_buf *buffer, git_blob *blob);
 
+/* Write the file (or symlink, given its `mode`) at `content_path` to the
+ * ODB, applying the given filters.  Nothing is loaded from the repository,
+ * so this can be called on any thread.
+ */
+extern int git_blob__create_from_file(
+	git_oid *out_oid,
+	git_odb *odb,
+	const char *content_path,
+	mode_t mode,
+	git_off_t size,
+	git_filter_list *fl);
+
 extern int git_blob__create_from_paths(
 	git_oid *out_oid,
 	struct stat *out_st,
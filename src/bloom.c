@@ -0,0 +1,637 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "bloom.h"
+#include "repository.h"
+#include "filebuf.h"
+#include "fileops.h"
+#include "odb.h"
+#include "oidmap.h"
+#include "path.h"
+#include "pool.h"
+#include "vector.h"
+
+#include "git2/commit.h"
+#include "git2/diff.h"
+#include "git2/revwalk.h"
+
+GIT__USE_OIDMAP;
+
+/*
+ * The file starts with a header, followed by a table of commit ids
+ * sorted by id, each with its generation number and the offset at
+ * which its filter ends within the data that follows the table.  All
+ * numbers are in network order.
+ *
+ *   "PFLT" | version | commit count
+ *   commit count * (commit id | generation | end of filter)
+ *   filters
+ *
+ * An empty filter is stored for commits which changed too many paths.
+ */
+
+#define BLOOM_SIGNATURE "PFLT"
+#define BLOOM_VERSION 2
+#define BLOOM_HEADER_SIZE 12
+#define BLOOM_RECORD_SIZE (GIT_OID_RAWSZ + 8)
+#define BLOOM_RECORD_GENERATION GIT_OID_RAWSZ
+#define BLOOM_RECORD_END (GIT_OID_RAWSZ + 4)
+#define BLOOM_FILE_MODE 0444
+
+#define BLOOM_SEED_1 0x293ae76f
+#define BLOOM_SEED_2 0x7e646e2c
+
+struct git_bloom_file {
+	git_buf contents;
+	size_t count;
+	const unsigned char *table;
+	const unsigned char *data;
+	size_t data_len;
+};
+
+static uint32_t read_u32(const unsigned char *buffer)
+{
+	uint32_t val;
+	memcpy(&val, buffer, sizeof(val));
+	return ntohl(val);
+}
+
+static int write_u32(git_filebuf *file, uint32_t val)
+{
+	val = htonl(val);
+	return git_filebuf_write(file, &val, sizeof(val));
+}
+
+GIT_INLINE(uint32_t) rotl32(uint32_t value, int count)
+{
+	return (value << count) | (value >> (32 - count));
+}
+
+/* 32-bit MurmurHash3 */
+static uint32_t murmur3(uint32_t seed, const char *data, size_t len)
+{
+	const unsigned char *ptr = (const unsigned char *)data;
+	const uint32_t c1 = 0xcc9e2d51, c2 = 0x1b873593;
+	uint32_t hash = seed, k;
+	size_t i;
+
+	for (i = 0; i < len / 4; ++i, ptr += 4) {
+		k = (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+			((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+
+		k *= c1;
+		k = rotl32(k, 15);
+		k *= c2;
+
+		hash ^= k;
+		hash = rotl32(hash, 13);
+		hash = hash * 5 + 0xe6546b64;
+	}
+
+	k = 0;
+
+	switch (len & 3) {
+	case 3:
+		k ^= (uint32_t)ptr[2] << 16;
+		/* fall through */
+	case 2:
+		k ^= (uint32_t)ptr[1] << 8;
+		/* fall through */
+	case 1:
+		k ^= (uint32_t)ptr[0];
+		k *= c1;
+		k = rotl32(k, 15);
+		k *= c2;
+		hash ^= k;
+	}
+
+	hash ^= (uint32_t)len;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+void git_bloom_key_init(git_bloom_key *key, const char *path, size_t path_len)
+{
+	uint32_t hash1 = murmur3(BLOOM_SEED_1, path, path_len);
+	uint32_t hash2 = murmur3(BLOOM_SEED_2, path, path_len);
+	int i;
+
+	for (i = 0; i < GIT_BLOOM_HASHES; ++i)
+		key->hashes[i] = hash1 + i * hash2;
+}
+
+bool git_bloom_filter_contains(
+	const git_bloom_filter *filter, const git_bloom_key *key)
+{
+	size_t bits = filter->len * 8, bit;
+	int i;
+
+	if (!filter->len)
+		return true;
+
+	for (i = 0; i < GIT_BLOOM_HASHES; ++i) {
+		bit = key->hashes[i] % bits;
+
+		if (!(filter->data[bit / 8] & (1 << (bit % 8))))
+			return false;
+	}
+
+	return true;
+}
+
+static void bloom_filter_add(
+	unsigned char *data, size_t len, const git_bloom_key *key)
+{
+	size_t bit;
+	int i;
+
+	for (i = 0; i < GIT_BLOOM_HASHES; ++i) {
+		bit = key->hashes[i] % (len * 8);
+		data[bit / 8] |= (1 << (bit % 8));
+	}
+}
+
+static int bloom_file_path(git_buf *out, git_repository *repo)
+{
+	return git_buf_joinpath(
+		out, repo->path_repository, GIT_OBJECTS_DIR "info/" GIT_BLOOM_FILE);
+}
+
+static int bloom_file_error(const char *msg)
+{
+	giterr_set(GITERR_ODB, "Invalid commit path filters - %s", msg);
+	return -1;
+}
+
+static int bloom_file_parse(git_bloom_file *file)
+{
+	const unsigned char *buffer = (const unsigned char *)file->contents.ptr;
+	size_t size = file->contents.size, i, end, prev = 0;
+
+	if (size < BLOOM_HEADER_SIZE ||
+		memcmp(buffer, BLOOM_SIGNATURE, 4) != 0)
+		return bloom_file_error("incorrect header signature");
+
+	if (read_u32(buffer + 4) != BLOOM_VERSION)
+		return bloom_file_error("unsupported version");
+
+	file->count = read_u32(buffer + 8);
+	file->table = buffer + BLOOM_HEADER_SIZE;
+
+	if ((size - BLOOM_HEADER_SIZE) / BLOOM_RECORD_SIZE < file->count)
+		return bloom_file_error("truncated commit table");
+
+	file->data = file->table + file->count * BLOOM_RECORD_SIZE;
+	file->data_len = size - (file->data - buffer);
+
+	for (i = 0; i < file->count; ++i) {
+		const unsigned char *record = file->table + i * BLOOM_RECORD_SIZE;
+
+		end = read_u32(record + BLOOM_RECORD_END);
+
+		if (end < prev || end > file->data_len)
+			return bloom_file_error("filter out of bounds");
+
+		if (i > 0 &&
+			memcmp(record - BLOOM_RECORD_SIZE, record, GIT_OID_RAWSZ) >= 0)
+			return bloom_file_error("commits are not sorted");
+
+		prev = end;
+	}
+
+	return 0;
+}
+
+int git_bloom_file_open(git_bloom_file **out, git_repository *repo)
+{
+	git_bloom_file *file;
+	git_buf path = GIT_BUF_INIT;
+	int error;
+
+	*out = NULL;
+
+	if ((error = bloom_file_path(&path, repo)) < 0)
+		return error;
+
+	if (!git_path_isfile(path.ptr)) {
+		git_buf_free(&path);
+		return GIT_ENOTFOUND;
+	}
+
+	file = git__calloc(1, sizeof(git_bloom_file));
+	GITERR_CHECK_ALLOC(file);
+
+	if ((error = git_futils_readbuffer(&file->contents, path.ptr)) < 0 ||
+		(error = bloom_file_parse(file)) < 0)
+		git_bloom_file_free(file);
+	else
+		*out = file;
+
+	git_buf_free(&path);
+	return error;
+}
+
+static void bloom_file_filter(
+	git_bloom_filter *out, git_bloom_file *file, size_t pos)
+{
+	const unsigned char *record = file->table + pos * BLOOM_RECORD_SIZE;
+	size_t start = 0, end = read_u32(record + BLOOM_RECORD_END);
+
+	if (pos > 0)
+		start = read_u32(record - BLOOM_RECORD_SIZE + BLOOM_RECORD_END);
+
+	out->data = file->data + start;
+	out->len = end - start;
+}
+
+static int bloom_file_find(
+	size_t *out, git_bloom_file *file, const git_oid *commit_id)
+{
+	size_t lo = 0, hi = file->count, mid;
+	int cmp;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = memcmp(commit_id->id,
+			file->table + mid * BLOOM_RECORD_SIZE, GIT_OID_RAWSZ);
+
+		if (!cmp) {
+			*out = mid;
+			return 0;
+		}
+
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return GIT_ENOTFOUND;
+}
+
+int git_bloom_file_lookup(
+	git_bloom_filter *out, git_bloom_file *file, const git_oid *commit_id)
+{
+	size_t pos;
+
+	if (bloom_file_find(&pos, file, commit_id) < 0)
+		return GIT_ENOTFOUND;
+
+	bloom_file_filter(out, file, pos);
+	return 0;
+}
+
+uint32_t git_bloom_file_generation(
+	git_bloom_file *file, const git_oid *commit_id)
+{
+	size_t pos;
+
+	if (bloom_file_find(&pos, file, commit_id) < 0)
+		return GIT_BLOOM_GENERATION_UNKNOWN;
+
+	return read_u32(
+		file->table + pos * BLOOM_RECORD_SIZE + BLOOM_RECORD_GENERATION);
+}
+
+void git_bloom_file_free(git_bloom_file *file)
+{
+	if (file == NULL)
+		return;
+
+	git_buf_free(&file->contents);
+	git__free(file);
+}
+
+/*
+ * Writing filters
+ */
+
+typedef struct {
+	git_oid id;
+	uint32_t generation;
+	size_t offset;
+	size_t len;
+} bloom_entry;
+
+static int bloom_entry_cmp(const void *a, const void *b)
+{
+	const bloom_entry *entry_a = a, *entry_b = b;
+	return git_oid__cmp(&entry_a->id, &entry_b->id);
+}
+
+/* Collect the paths changed by a commit, with their leading directories */
+static int bloom_changed_paths(
+	git_vector *paths,
+	git_pool *pool,
+	git_repository *repo,
+	const git_oid *commit_id)
+{
+	git_commit *commit = NULL, *parent = NULL;
+	git_tree *tree = NULL, *parent_tree = NULL;
+	git_diff *diff = NULL;
+	const git_diff_delta *delta;
+	const char *path, *slash;
+	char *copy;
+	size_t i;
+	int error;
+
+	if ((error = git_commit_lookup(&commit, repo, commit_id)) < 0 ||
+		(error = git_commit_tree(&tree, commit)) < 0)
+		goto done;
+
+	if (git_commit_parentcount(commit) > 0 &&
+		((error = git_commit_parent(&parent, commit, 0)) < 0 ||
+		 (error = git_commit_tree(&parent_tree, parent)) < 0))
+		goto done;
+
+	if ((error = git_diff_tree_to_tree(
+			&diff, repo, parent_tree, tree, NULL)) < 0)
+		goto done;
+
+	for (i = 0; i < git_diff_num_deltas(diff); ++i) {
+		delta = git_diff_get_delta(diff, i);
+		path = delta->new_file.path;
+
+		for (slash = path + strlen(path); slash != NULL;
+			 slash = git__memrchr(path, '/', slash - path)) {
+			copy = git_pool_strndup(pool, path, slash - path);
+
+			if (!copy || git_vector_insert(paths, copy) < 0) {
+				error = -1;
+				goto done;
+			}
+		}
+	}
+
+	git_vector_uniq(paths, NULL);
+
+done:
+	git_diff_free(diff);
+	git_tree_free(parent_tree);
+	git_tree_free(tree);
+	git_commit_free(parent);
+	git_commit_free(commit);
+	return error;
+}
+
+/*
+ * The generation of a commit is one more than the largest generation of
+ * its parents, so it is always larger than that of any of its ancestors.
+ * It stays unknown when the generation of any parent is unknown.
+ */
+static int bloom_generation(
+	bloom_entry *entry,
+	git_repository *repo,
+	git_oidmap *computed,
+	git_bloom_file *existing)
+{
+	git_commit *commit;
+	const git_oid *parent_id;
+	uint32_t parent_generation;
+	unsigned int i;
+	khiter_t pos;
+	int error;
+
+	if ((error = git_commit_lookup(&commit, repo, &entry->id)) < 0)
+		return error;
+
+	entry->generation = 1;
+
+	for (i = 0; i < git_commit_parentcount(commit); ++i) {
+		parent_id = git_commit_parent_id(commit, i);
+		parent_generation = GIT_BLOOM_GENERATION_UNKNOWN;
+
+		pos = kh_get(oid, computed, parent_id);
+		if (pos != kh_end(computed))
+			parent_generation = ((bloom_entry *)kh_value(computed, pos))->generation;
+		else if (existing)
+			parent_generation = git_bloom_file_generation(existing, parent_id);
+
+		if (parent_generation == GIT_BLOOM_GENERATION_UNKNOWN ||
+			parent_generation == GIT_BLOOM_GENERATION_MAX) {
+			entry->generation = GIT_BLOOM_GENERATION_UNKNOWN;
+			break;
+		}
+
+		if (parent_generation >= entry->generation)
+			entry->generation = parent_generation + 1;
+	}
+
+	git_commit_free(commit);
+	return 0;
+}
+
+static int bloom_compute(
+	bloom_entry *entry, git_buf *data, git_repository *repo)
+{
+	git_vector paths = GIT_VECTOR_INIT;
+	git_pool pool;
+	git_bloom_key key;
+	const char *path;
+	size_t i;
+	int error;
+
+	if ((error = git_vector_init(&paths, 16, git__strcmp_cb)) < 0 ||
+		(error = git_pool_init(&pool, 1, 0)) < 0)
+		return error;
+
+	if ((error = bloom_changed_paths(&paths, &pool, repo, &entry->id)) < 0)
+		goto done;
+
+	entry->offset = data->size;
+	entry->len = 0;
+
+	if (paths.length <= GIT_BLOOM_MAX_CHANGED_PATHS) {
+		entry->len = (paths.length * GIT_BLOOM_BITS_PER_ENTRY + 7) / 8;
+		if (!entry->len)
+			entry->len = 1;
+
+		if ((error = git_buf_grow(data, data->size + entry->len + 1)) < 0)
+			goto done;
+
+		memset(data->ptr + data->size, 0, entry->len);
+
+		git_vector_foreach(&paths, i, path) {
+			git_bloom_key_init(&key, path, strlen(path));
+			bloom_filter_add(
+				(unsigned char *)data->ptr + entry->offset, entry->len, &key);
+		}
+
+		data->size += entry->len;
+	}
+
+done:
+	git_vector_free(&paths);
+	git_pool_clear(&pool);
+	return error;
+}
+
+static int bloom_file_write(
+	git_repository *repo, git_vector *entries, git_buf *data)
+{
+	git_filebuf file = GIT_FILEBUF_INIT;
+	git_buf path = GIT_BUF_INIT;
+	bloom_entry *entry;
+	size_t i, end = 0;
+	int error;
+
+	git_vector_sort(entries);
+
+	if ((error = bloom_file_path(&path, repo)) < 0 ||
+		(error = git_futils_mkpath2file(path.ptr, GIT_OBJECT_DIR_MODE)) < 0 ||
+		(error = git_filebuf_open(&file, path.ptr, 0, BLOOM_FILE_MODE)) < 0)
+		goto done;
+
+	error = git_filebuf_write(&file, BLOOM_SIGNATURE, 4);
+	if (!error)
+		error = write_u32(&file, BLOOM_VERSION);
+	if (!error)
+		error = write_u32(&file, (uint32_t)entries->length);
+
+	git_vector_foreach(entries, i, entry) {
+		if (error < 0)
+			break;
+
+		end += entry->len;
+
+		if (!(error = git_filebuf_write(&file, entry->id.id, GIT_OID_RAWSZ)) &&
+			!(error = write_u32(&file, entry->generation)))
+			error = write_u32(&file, (uint32_t)end);
+	}
+
+	git_vector_foreach(entries, i, entry) {
+		if (error < 0)
+			break;
+
+		error = git_filebuf_write(&file, data->ptr + entry->offset, entry->len);
+	}
+
+	if (!error)
+		error = git_filebuf_commit(&file);
+	else
+		git_filebuf_cleanup(&file);
+
+done:
+	git_buf_free(&path);
+	return error;
+}
+
+int git_revwalk_write_path_filters(git_revwalk *walk)
+{
+	git_repository *repo;
+	git_bloom_file *existing = NULL;
+	git_grafts *grafts;
+	git_bloom_filter filter;
+	git_vector entries = GIT_VECTOR_INIT;
+	git_oidmap *computed = NULL;
+	git_buf data = GIT_BUF_INIT;
+	git_pool pool;
+	bloom_entry *entry;
+	git_oid id;
+	khiter_t pos;
+	size_t i;
+	int error, ret;
+
+	assert(walk);
+
+	repo = git_revwalk_repository(walk);
+
+	if ((error = git_repository__grafts(&grafts, repo)) < 0)
+		return error;
+
+	ret = (git_grafts_size(grafts) > 0);
+	git_grafts_free(grafts);
+
+	if (ret) {
+		giterr_set(GITERR_INVALID,
+			"Cannot write path filters for a repository with grafts");
+		return -1;
+	}
+
+	if ((error = git_vector_init(&entries, 64, bloom_entry_cmp)) < 0 ||
+		(error = git_pool_init(&pool, sizeof(bloom_entry), 0)) < 0)
+		return error;
+
+	if ((computed = git_oidmap_alloc()) == NULL) {
+		giterr_set_oom();
+		error = -1;
+		goto done;
+	}
+
+	if ((error = git_bloom_file_open(&existing, repo)) == GIT_ENOTFOUND) {
+		giterr_clear();
+		error = 0;
+	}
+
+	/* parents have to be visited before their children to derive the
+	 * generation numbers of the children from theirs */
+	git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+
+	while (!error && (error = git_revwalk_next(&id, walk)) == 0) {
+		if (existing && !git_bloom_file_lookup(&filter, existing, &id))
+			continue;
+
+		if ((entry = git_pool_malloc(&pool, 1)) == NULL) {
+			error = -1;
+			break;
+		}
+
+		git_oid_cpy(&entry->id, &id);
+
+		if ((error = bloom_generation(entry, repo, computed, existing)) < 0 ||
+			(error = bloom_compute(entry, &data, repo)) < 0 ||
+			(error = git_vector_insert(&entries, entry)) < 0)
+			break;
+
+		pos = kh_put(oid, computed, &entry->id, &ret);
+		if (ret < 0) {
+			giterr_set_oom();
+			error = -1;
+			break;
+		}
+		kh_value(computed, pos) = entry;
+	}
+
+	if (error != GIT_ITEROVER)
+		goto done;
+
+	/* keep the filters which were already recorded */
+	for (i = 0; existing && i < existing->count; ++i) {
+		if ((entry = git_pool_malloc(&pool, 1)) == NULL) {
+			error = -1;
+			goto done;
+		}
+
+		git_oid_fromraw(&entry->id, existing->table + i * BLOOM_RECORD_SIZE);
+		entry->generation = read_u32(existing->table +
+			i * BLOOM_RECORD_SIZE + BLOOM_RECORD_GENERATION);
+		bloom_file_filter(&filter, existing, i);
+
+		entry->offset = data.size;
+		entry->len = filter.len;
+
+		if ((error = git_buf_put(
+				&data, (const char *)filter.data, filter.len)) < 0 ||
+			(error = git_vector_insert(&entries, entry)) < 0)
+			goto done;
+	}
+
+	error = bloom_file_write(repo, &entries, &data);
+
+done:
+	git_bloom_file_free(existing);
+	git_oidmap_free(computed);
+	git_vector_free(&entries);
+	git_pool_clear(&pool);
+	git_buf_free(&data);
+	return error;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_bloom_h__
+#define INCLUDE_bloom_h__
+
+#include "common.h"
+#include "buffer.h"
+#include "git2/oid.h"
+
+/*
+ * Changed-path Bloom filters
+ *
+ * For each commit, the paths that it changes relative to its first
+ * parent (and all of their leading directories) are recorded in a small
+ * Bloom filter.  History queries can then skip the commits which can't
+ * have touched the paths they are interested in without reading trees.
+ *
+ * Next to its filter, every commit has a generation number, which is
+ * larger than that of all of its ancestors; a walk can stop looking for
+ * descendants of a commit once it gets below the commit's generation.
+ * The filters are kept in `objects/info/commit-path-filters`.
+ */
+
+#define GIT_BLOOM_FILE "commit-path-filters"
+
+#define GIT_BLOOM_HASHES 7
+#define GIT_BLOOM_BITS_PER_ENTRY 10
+
+/* commits changing more paths than this get a filter matching anything */
+#define GIT_BLOOM_MAX_CHANGED_PATHS 512
+
+#define GIT_BLOOM_GENERATION_UNKNOWN 0
+#define GIT_BLOOM_GENERATION_MAX 0xffffffff
+
+typedef struct {
+	uint32_t hashes[GIT_BLOOM_HASHES];
+} git_bloom_key;
+
+typedef struct {
+	const unsigned char *data;
+	size_t len;
+} git_bloom_filter;
+
+typedef struct git_bloom_file git_bloom_file;
+
+/* Prepare a path (without a trailing slash) to be looked up in filters */
+extern void git_bloom_key_init(
+	git_bloom_key *key, const char *path, size_t path_len);
+
+/* Whether the path may have been changed; false positives are possible,
+ * but a path that was changed is never reported as unchanged */
+extern bool git_bloom_filter_contains(
+	const git_bloom_filter *filter, const git_bloom_key *key);
+
+/* Load the filters of a repository, or GIT_ENOTFOUND if there are none */
+extern int git_bloom_file_open(git_bloom_file **out, git_repository *repo);
+
+/* Find the filter of a commit, or GIT_ENOTFOUND if it wasn't recorded */
+extern int git_bloom_file_lookup(
+	git_bloom_filter *out, git_bloom_file *file, const git_oid *commit_id);
+
+/* Find the generation number of a commit, or GIT_BLOOM_GENERATION_UNKNOWN
+ * if it wasn't recorded */
+extern uint32_t git_bloom_file_generation(
+	git_bloom_file *file, const git_oid *commit_id);
+
+extern void git_bloom_file_free(git_bloom_file *file);
+
+#endif
@@ -169,12 +169,13 @@ static bool checkout_is_workdir_modified(
 
 	/* Look at the cache to decide if the workdir is modified.  If not,
 	 * we can simply compare the oid in the cache to the baseitem instead
-	 * of hashing the file.
+	 * of hashing the file.  Racily clean entries can't be trusted.
 	 */
 	if ((ie = git_index_get_bypath(data->index, wditem->path, 0)) != NULL) {
 		if (wditem->mtime.seconds == ie->mtime.seconds &&
 			wditem->mtime.nanoseconds == ie->mtime.nanoseconds &&
-			wditem->file_size == ie->file_size)
+			wditem->file_size == ie->file_size &&
+			!git_index__entry_is_racy(data->index, ie))
 			return (git_oid__cmp(&baseitem->id, &ie->id) != 0);
 	}
 
@@ -6,6 +6,7 @@
  */
 
 #include <assert.h>
+#include <stddef.h>
 
 #include "git2/clone.h"
 #include "git2/remote.h"
@@ -259,6 +260,8 @@ static int create_and_configure_origin(
 	if (options->ignore_cert_errors)
 		git_remote_check_cert(origin, 0);
 
+	git_remote_set_fetch_depth(origin, options->depth);
+
 	if ((error = git_remote_set_callbacks(origin, &options->remote_callbacks)) < 0)
 		goto on_error;
 
@@ -384,10 +387,12 @@ int git_clone(
 
 	assert(out && url && local_path);
 
-	if (_options)
-		memcpy(&options, _options, sizeof(git_clone_options));
+	GITERR_CHECK_VERSION(_options, GIT_CLONE_OPTIONS_VERSION, "git_clone_options");
 
-	GITERR_CHECK_VERSION(&options, GIT_CLONE_OPTIONS_VERSION, "git_clone_options");
+	/* version 1 of the options ends before `depth` */
+	if (_options)
+		memcpy(&options, _options, _options->version < 2 ?
+			offsetof(git_clone_options, depth) : sizeof(git_clone_options));
 
 	/* Only clone to a new directory or an empty directory */
 	if (git_path_exists(local_path) && !git_path_is_empty_dir(local_path)) {
@@ -328,35 +328,74 @@ int git_commit_amend(
 	return error;
 }
 
+int git_commit__scan_header(
+	git_commit__header *out, const char *data, size_t len)
+{
+	const char *end = data + len, *line;
+
+	/* The tree is always the first field */
+	if (len < GIT_COMMIT__TREE_LINE ||
+		memcmp(data, "tree ", strlen("tree ")) != 0 ||
+		data[GIT_COMMIT__TREE_LINE - 1] != '\n')
+		return -1;
+
+	out->tree = data + strlen("tree ");
+	out->parents = line = data + GIT_COMMIT__TREE_LINE;
+	out->parent_count = 0;
+
+	/* parent lines all have the same length */
+	while ((size_t)(end - line) >= GIT_COMMIT__PARENT_LINE &&
+		memcmp(line, "parent ", strlen("parent ")) == 0 &&
+		line[GIT_COMMIT__PARENT_LINE - 1] == '\n') {
+		out->parent_count++;
+		line += GIT_COMMIT__PARENT_LINE;
+	}
+
+	out->author = line;
+
+	if ((line = memchr(line, '\n', end - line)) == NULL)
+		return -1;
+
+	out->committer = ++line;
+
+	if ((line = memchr(line, '\n', end - line)) == NULL)
+		return -1;
+
+	out->committer_end = line;
+	return 0;
+}
+
 int git_commit__parse(void *_commit, git_odb_object *odb_obj)
 {
 	git_commit *commit = _commit;
 	const char *buffer_start = git_odb_object_data(odb_obj), *buffer;
 	const char *buffer_end = buffer_start + git_odb_object_size(odb_obj);
-	git_oid parent_id;
-	size_t header_len;
-
-	buffer = buffer_start;
+	git_commit__header header;
+	size_t header_len, i;
 
-	/* Allocate for one, which will allow not to realloc 90% of the time  */
-	git_array_init_to_size(commit->parent_ids, 1);
-	GITERR_CHECK_ARRAY(commit->parent_ids);
-
-	/* The tree is always the first field */
-	if (git_oid__parse(&commit->tree_id, &buffer, buffer_end, "tree ") < 0)
+	if (git_commit__scan_header(
+			&header, buffer_start, git_odb_object_size(odb_obj)) < 0 ||
+		git_oid__fromhex(&commit->tree_id, header.tree) < 0)
 		goto bad_buffer;
 
 	/*
 	 * TODO: commit grafts!
 	 */
 
-	while (git_oid__parse(&parent_id, &buffer, buffer_end, "parent ") == 0) {
+	/* Allocate for at least one, so root commits aren't special */
+	git_array_init_to_size(commit->parent_ids, max(header.parent_count, 1));
+	GITERR_CHECK_ARRAY(commit->parent_ids);
+
+	for (i = 0; i < header.parent_count; ++i) {
 		git_oid *new_id = git_array_alloc(commit->parent_ids);
 		GITERR_CHECK_ALLOC(new_id);
 
-		git_oid_cpy(new_id, &parent_id);
+		if (git_commit__header_parent(new_id, &header, i) < 0)
+			goto bad_buffer;
 	}
 
+	buffer = header.author;
+
 	commit->author = git__malloc(sizeof(git_signature));
 	GITERR_CHECK_ALLOC(commit->author);
 
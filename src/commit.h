@@ -11,6 +11,7 @@
 #include "tree.h"
 #include "repository.h"
 #include "array.h"
+#include "oid.h"
 
 #include <time.h>
 
@@ -30,7 +31,35 @@ struct git_commit {
 	char *summary;
 };
 
+/*
+ * The fields at the start of a raw commit, as found by a single scan
+ * over its header.  All of the pointers point into the commit data.
+ */
+typedef struct {
+	const char *tree; /* hex id of the tree */
+	const char *parents; /* first of parent_count "parent" lines */
+	size_t parent_count;
+	const char *author; /* start of the author line */
+	const char *committer; /* start of the committer line */
+	const char *committer_end; /* newline ending the committer line */
+} git_commit__header;
+
+#define GIT_COMMIT__TREE_LINE (sizeof("tree ") - 1 + GIT_OID_HEXSZ + 1)
+#define GIT_COMMIT__PARENT_LINE (sizeof("parent ") - 1 + GIT_OID_HEXSZ + 1)
+
 void git_commit__free(void *commit);
 int git_commit__parse(void *commit, git_odb_object *obj);
 
+/* Find the tree, parents, author and committer of a raw commit; returns
+ * -1 without setting an error when the header is malformed */
+int git_commit__scan_header(
+	git_commit__header *out, const char *data, size_t len);
+
+GIT_INLINE(int) git_commit__header_parent(
+	git_oid *out, const git_commit__header *header, size_t n)
+{
+	return git_oid__fromhex(out,
+		header->parents + n * GIT_COMMIT__PARENT_LINE + sizeof("parent ") - 1);
+}
+
 #endif
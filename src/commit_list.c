@@ -10,6 +10,8 @@
 #include "revwalk.h"
 #include "pool.h"
 #include "odb.h"
+#include "commit.h"
+#include "repository.h"
 
 int git_commit_list_time_cmp(const void *a, const void *b)
 {
@@ -19,6 +21,17 @@ int git_commit_list_time_cmp(const void *a, const void *b)
 	return (commit_a->time < commit_b->time);
 }
 
+int git_commit_list_generation_cmp(const void *a, const void *b)
+{
+	const git_commit_list_node *commit_a = a;
+	const git_commit_list_node *commit_b = b;
+
+	if (commit_a->generation != commit_b->generation)
+		return (commit_a->generation < commit_b->generation);
+
+	return (commit_a->time < commit_b->time);
+}
+
 git_commit_list *git_commit_list_insert(git_commit_list_node *item, git_commit_list **list_p)
 {
 	git_commit_list *new_list = git__malloc(sizeof(git_commit_list));
@@ -106,46 +119,41 @@ static int commit_quick_parse(
 	const uint8_t *buffer,
 	size_t buffer_len)
 {
-	const size_t parent_len = strlen("parent ") + GIT_OID_HEXSZ + 1;
-	const uint8_t *buffer_end = buffer + buffer_len;
-	const uint8_t *parents_start, *committer_start;
-	int i, parents = 0;
+	git_commit__header header;
+	const git_commit_graft *graft = NULL;
+	const uint8_t *committer_start;
+	size_t i, parent_count;
 	int commit_time;
 
-	buffer += strlen("tree ") + GIT_OID_HEXSZ + 1;
+	if (git_commit__scan_header(&header, (const char *)buffer, buffer_len) < 0)
+		return commit_error(commit, "object is corrupted");
+
+	if (walk->grafts)
+		graft = git_grafts_get(walk->grafts, &commit->oid);
 
-	parents_start = buffer;
-	while (buffer + parent_len < buffer_end && memcmp(buffer, "parent ", strlen("parent ")) == 0) {
-		parents++;
-		buffer += parent_len;
-	}
+	parent_count = graft ? graft->parent_count : header.parent_count;
 
-	commit->parents = alloc_parents(walk, commit, parents);
+	commit->parents = alloc_parents(walk, commit, parent_count);
 	GITERR_CHECK_ALLOC(commit->parents);
 
-	buffer = parents_start;
-	for (i = 0; i < parents; ++i) {
+	for (i = 0; i < parent_count; ++i) {
 		git_oid oid;
 
-		if (git_oid_fromstr(&oid, (const char *)buffer + strlen("parent ")) < 0)
+		if (graft)
+			git_oid_cpy(&oid, &graft->parents[i]);
+		else if (git_commit__header_parent(&oid, &header, i) < 0)
 			return -1;
 
 		commit->parents[i] = git_revwalk__commit_lookup(walk, &oid);
 		if (commit->parents[i] == NULL)
 			return -1;
-
-		buffer += parent_len;
 	}
 
-	commit->out_degree = (unsigned short)parents;
+	commit->out_degree = (unsigned short)parent_count;
 
-	if ((committer_start = buffer = memchr(buffer, '\n', buffer_end - buffer)) == NULL)
-		return commit_error(commit, "object is corrupted");
-
-	buffer++;
-
-	if ((buffer = memchr(buffer, '\n', buffer_end - buffer)) == NULL)
-		return commit_error(commit, "object is corrupted");
+	/* the time is at the end of the committer line */
+	committer_start = (const uint8_t *)header.committer - 1;
+	buffer = (const uint8_t *)header.committer_end;
 
 	/* Skip trailing spaces */
 	while (buffer > committer_start && git__isspace(*buffer))
@@ -174,14 +182,83 @@ static int commit_quick_parse(
 	return 0;
 }
 
+typedef struct {
+	git_revwalk *walk;
+	git_commit_list_node *commit;
+} cached_commit_data;
+
+static int commit_from_cache(const git_graphcache_entry *entry, void *payload)
+{
+	cached_commit_data *data = payload;
+	git_revwalk *walk = data->walk;
+	git_commit_list_node *commit = data->commit;
+	size_t i;
+
+	commit->parents = alloc_parents(walk, commit, entry->parent_count);
+	GITERR_CHECK_ALLOC(commit->parents);
+
+	for (i = 0; i < entry->parent_count; ++i) {
+		commit->parents[i] =
+			git_revwalk__commit_lookup(walk, &entry->parents[i]);
+		if (commit->parents[i] == NULL)
+			return -1;
+	}
+
+	commit->out_degree = entry->parent_count;
+	commit->time = entry->time;
+	if (entry->generation != GIT_BLOOM_GENERATION_UNKNOWN)
+		commit->generation = entry->generation;
+	commit->parsed = 1;
+	return 0;
+}
+
+static int commit_to_cache(
+	git_graphcache *cache, git_revwalk *walk, git_commit_list_node *commit)
+{
+	git_oid parents[PARENTS_PER_COMMIT], *ids = parents;
+	uint32_t generation = GIT_BLOOM_GENERATION_UNKNOWN;
+	unsigned short i;
+	int error;
+
+	if (commit->out_degree > PARENTS_PER_COMMIT) {
+		ids = git__malloc(commit->out_degree * sizeof(git_oid));
+		GITERR_CHECK_ALLOC(ids);
+	}
+
+	for (i = 0; i < commit->out_degree; ++i)
+		git_oid_cpy(&ids[i], &commit->parents[i]->oid);
+
+	if (walk->bloom)
+		generation = git_bloom_file_generation(walk->bloom, &commit->oid);
+
+	error = git_graphcache_put(cache, &commit->oid,
+		commit->time, generation, ids, commit->out_degree);
+
+	if (ids != parents)
+		git__free(ids);
+	return error;
+}
+
 int git_commit_list_parse(git_revwalk *walk, git_commit_list_node *commit)
 {
+	git_graphcache *cache = walk->repo->graphcache;
 	git_odb_object *obj;
+	cached_commit_data data;
 	int error;
 
 	if (commit->parsed)
 		return 0;
 
+	if (cache) {
+		data.walk = walk;
+		data.commit = commit;
+
+		error = git_graphcache_with(
+			cache, &commit->oid, commit_from_cache, &data);
+		if (error != GIT_ENOTFOUND)
+			return error;
+	}
+
 	if ((error = git_odb_read(&obj, walk->odb, &commit->oid)) < 0)
 		return error;
 
@@ -195,6 +272,9 @@ int git_commit_list_parse(git_revwalk *walk, git_commit_list_node *commit)
 			git_odb_object_size(obj));
 
 	git_odb_object_free(obj);
+
+	if (!error && cache)
+		error = commit_to_cache(cache, walk, commit);
+
 	return error;
 }
-
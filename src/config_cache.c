@@ -51,6 +51,19 @@ static git_cvar_map _cvar_map_autocrlf[] = {
 	{GIT_CVAR_STRING, "input", GIT_AUTO_CRLF_INPUT}
 };
 
+/*
+ *	core.untrackedcache
+ *		Keep a cache of the untracked entries of each directory in the
+ *	index, so that unchanged directories need not be read again when
+ *	scanning the working directory.  "keep" uses an existing cache but
+ *	never creates one.
+ */
+static git_cvar_map _cvar_map_untrackedcache[] = {
+	{GIT_CVAR_FALSE, NULL, GIT_UNTRACKEDCACHE_FALSE},
+	{GIT_CVAR_TRUE, NULL, GIT_UNTRACKEDCACHE_TRUE},
+	{GIT_CVAR_STRING, "keep", GIT_UNTRACKEDCACHE_KEEP}
+};
+
 /*
  * Generic map for integer values
  */
@@ -70,6 +83,8 @@ static struct map_data _cvar_maps[] = {
 	{"core.precomposeunicode", NULL, 0, GIT_PRECOMPOSE_DEFAULT },
 	{"core.safecrlf", NULL, 0, GIT_SAFE_CRLF_DEFAULT},
 	{"core.logallrefupdates", NULL, 0, GIT_LOGALLREFUPDATES_DEFAULT },
+	{"core.untrackedcache", _cvar_map_untrackedcache, ARRAY_SIZE(_cvar_map_untrackedcache), GIT_UNTRACKEDCACHE_DEFAULT },
+	{"core.preloadindex", NULL, 0, GIT_PRELOADINDEX_DEFAULT },
 };
 
 int git_config__cvar(int *out, git_config *config, git_cvar_cached cvar)
@@ -0,0 +1,669 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "git2/commit.h"
+#include "git2/describe.h"
+#include "git2/diff.h"
+#include "git2/revparse.h"
+#include "git2/tag.h"
+
+#include "common.h"
+#include "revwalk.h"
+#include "commit_list.h"
+#include "fnmatch.h"
+#include "pool.h"
+#include "refs.h"
+#include "tag.h"
+
+/*
+ * This is a port of the candidate search of git's builtin/describe.c.
+ *
+ * Walking back from the commit in date order, the first tags found are
+ * the candidates.  Every commit carries a bit for each of the candidates
+ * it is an ancestor of, and the depth of a candidate is the number of
+ * commits seen which aren't.  Once the candidates are all found (or the
+ * history runs out), the best of them is the one with the least depth,
+ * which is only final once every commit left in the queue is below it.
+ */
+
+#define DESCRIBE_MAX_CANDIDATES 31
+#define DESCRIBE_SEEN 1u
+
+enum {
+	DESCRIBE_PRIO_REF = 0,
+	DESCRIBE_PRIO_LIGHTWEIGHT = 1,
+	DESCRIBE_PRIO_ANNOTATED = 2,
+};
+
+typedef struct {
+	git_oid peeled;
+	const char *path;
+	int prio;
+	git_time_t tag_time;
+} describe_name;
+
+typedef struct {
+	describe_name *name;
+	size_t depth;
+	uint32_t flag_within;
+	unsigned int found_order;
+} describe_candidate;
+
+/* what is kept between the commits described in one call */
+typedef struct {
+	git_repository *repo;
+	git_describe_options opts;
+	git_revwalk *walk;
+
+	git_oidmap *names;
+	git_pool name_pool;
+
+	/* the candidate bits of the commits of the current search */
+	git_oidmap *flags;
+	git_pool flags_pool;
+	git_pqueue queue;
+} describe_state;
+
+struct git_describe_result {
+	int dirty;
+	int exact_match;
+	int fallback_to_id;
+	git_oid commit_id;
+	git_repository *repo;
+	char *name;
+	size_t depth;
+};
+
+int git_describe_init_options(git_describe_options *opts, unsigned int version)
+{
+	GIT_INIT_STRUCTURE_FROM_TEMPLATE(
+		opts, version, git_describe_options, GIT_DESCRIBE_OPTIONS_INIT);
+	return 0;
+}
+
+int git_describe_init_format_options(
+	git_describe_format_options *opts, unsigned int version)
+{
+	GIT_INIT_STRUCTURE_FROM_TEMPLATE(
+		opts, version, git_describe_format_options,
+		GIT_DESCRIBE_FORMAT_OPTIONS_INIT);
+	return 0;
+}
+
+static describe_name *find_name(describe_state *st, const git_oid *commit)
+{
+	khiter_t pos = kh_get(oid, st->names, commit);
+
+	return pos == kh_end(st->names) ? NULL : kh_value(st->names, pos);
+}
+
+/* Whether a name should replace the one a commit already has; two
+ * annotated tags are told apart by their dates */
+static bool replaces_name(const describe_name *existing, int prio, git_time_t tag_time)
+{
+	if (existing == NULL || existing->prio < prio)
+		return true;
+
+	return existing->prio == DESCRIBE_PRIO_ANNOTATED &&
+		prio == DESCRIBE_PRIO_ANNOTATED &&
+		existing->tag_time < tag_time;
+}
+
+static int add_name(describe_state *st, const char *refname)
+{
+	const char *path = refname + strlen(GIT_REFS_DIR);
+	bool is_tag = !git__prefixcmp(refname, GIT_REFS_TAGS_DIR);
+	git_object *object = NULL, *peeled = NULL;
+	git_time_t tag_time = 0;
+	describe_name *name;
+	git_oid id;
+	khiter_t pos;
+	int prio, ret, error;
+
+	if (st->opts.describe_strategy != GIT_DESCRIBE_ALL && !is_tag)
+		return 0;
+
+	if (st->opts.pattern && (!is_tag ||
+		p_fnmatch(st->opts.pattern, refname + strlen(GIT_REFS_TAGS_DIR), 0) != 0))
+		return 0;
+
+	if ((error = git_reference_name_to_id(&id, st->repo, refname)) < 0 ||
+		(error = git_object_lookup(&object, st->repo, &id, GIT_OBJ_ANY)) < 0)
+		goto done;
+
+	/* tags of something else than a commit can't describe anything */
+	if (git_object_peel(&peeled, object, GIT_OBJ_COMMIT) < 0) {
+		giterr_clear();
+		goto done;
+	}
+
+	if (!is_tag)
+		prio = DESCRIBE_PRIO_REF;
+	else if (git_object_type(object) == GIT_OBJ_TAG) {
+		const git_signature *tagger = git_tag_tagger((git_tag *)object);
+
+		prio = DESCRIBE_PRIO_ANNOTATED;
+		tag_time = tagger ? tagger->when.time : 0;
+	} else
+		prio = DESCRIBE_PRIO_LIGHTWEIGHT;
+
+	/* unless asked for, only annotated tags describe commits */
+	if (st->opts.describe_strategy == GIT_DESCRIBE_DEFAULT &&
+		prio != DESCRIBE_PRIO_ANNOTATED)
+		goto done;
+
+	name = find_name(st, git_object_id(peeled));
+	if (!replaces_name(name, prio, tag_time))
+		goto done;
+
+	if (name == NULL) {
+		if ((name = git_pool_mallocz(
+				&st->name_pool, sizeof(describe_name))) == NULL) {
+			error = -1;
+			goto done;
+		}
+		git_oid_cpy(&name->peeled, git_object_id(peeled));
+
+		pos = kh_put(oid, st->names, &name->peeled, &ret);
+		if (ret < 0) {
+			giterr_set_oom();
+			error = -1;
+			goto done;
+		}
+		kh_value(st->names, pos) = name;
+	}
+
+	name->prio = prio;
+	name->tag_time = tag_time;
+	name->path = git_pool_strdup(&st->name_pool,
+		st->opts.describe_strategy == GIT_DESCRIBE_ALL ?
+			path : refname + strlen(GIT_REFS_TAGS_DIR));
+	if (name->path == NULL)
+		error = -1;
+
+done:
+	git_object_free(peeled);
+	git_object_free(object);
+	return error;
+}
+
+static int load_names(describe_state *st)
+{
+	git_strarray refs = {0};
+	size_t i;
+	int error;
+
+	if ((error = git_reference_list(&refs, st->repo)) < 0)
+		return error;
+
+	/* the first of the equally good names wins, as in git */
+	git__tsort((void **)refs.strings, refs.count, git__strcmp_cb);
+
+	for (i = 0; i < refs.count && !error; ++i)
+		error = add_name(st, refs.strings[i]);
+
+	git_strarray_free(&refs);
+	return error;
+}
+
+static int describe_state_init(
+	describe_state *st, git_repository *repo, const git_describe_options *opts)
+{
+	git_describe_options defaults = GIT_DESCRIBE_OPTIONS_INIT;
+
+	memset(st, 0, sizeof(*st));
+
+	if (opts) {
+		GITERR_CHECK_VERSION(
+			opts, GIT_DESCRIBE_OPTIONS_VERSION, "git_describe_options");
+		memcpy(&st->opts, opts, sizeof(st->opts));
+	} else
+		memcpy(&st->opts, &defaults, sizeof(st->opts));
+
+	if (st->opts.max_candidates_tags > DESCRIBE_MAX_CANDIDATES)
+		st->opts.max_candidates_tags = DESCRIBE_MAX_CANDIDATES;
+
+	st->repo = repo;
+
+	if (git_pool_init(&st->name_pool, 1, 0) < 0 ||
+		git_pool_init(&st->flags_pool, sizeof(uint32_t), 0) < 0 ||
+		git_pqueue_init(&st->queue, 0, 16, git_commit_list_time_cmp) < 0 ||
+		git_revwalk_new(&st->walk, repo) < 0)
+		return -1;
+
+	st->names = git_oidmap_alloc();
+	st->flags = git_oidmap_alloc();
+	if (!st->names || !st->flags) {
+		giterr_set_oom();
+		return -1;
+	}
+
+	return load_names(st);
+}
+
+static void describe_state_free(describe_state *st)
+{
+	git_revwalk_free(st->walk);
+	git_oidmap_free(st->names);
+	git_oidmap_free(st->flags);
+	git_pool_clear(&st->name_pool);
+	git_pool_clear(&st->flags_pool);
+	git_pqueue_free(&st->queue);
+}
+
+static uint32_t *commit_flags(describe_state *st, git_commit_list_node *commit)
+{
+	uint32_t *flags;
+	khiter_t pos;
+	int ret;
+
+	pos = kh_get(oid, st->flags, &commit->oid);
+	if (pos != kh_end(st->flags))
+		return kh_value(st->flags, pos);
+
+	if ((flags = git_pool_mallocz(&st->flags_pool, 1)) == NULL)
+		return NULL;
+
+	pos = kh_put(oid, st->flags, &commit->oid, &ret);
+	if (ret < 0) {
+		giterr_set_oom();
+		return NULL;
+	}
+	kh_value(st->flags, pos) = flags;
+
+	return flags;
+}
+
+/* Hand the bits of a commit down to its parents, queueing the unseen */
+static int push_parents(
+	describe_state *st, git_commit_list_node *commit, uint32_t flags)
+{
+	git_commit_list_node *parent;
+	uint32_t *parent_flags;
+	unsigned short p;
+	int error;
+
+	for (p = 0; p < commit->out_degree; ++p) {
+		parent = commit->parents[p];
+
+		if ((error = git_commit_list_parse(st->walk, parent)) < 0)
+			return error;
+		if ((parent_flags = commit_flags(st, parent)) == NULL)
+			return -1;
+
+		if (!(*parent_flags & DESCRIBE_SEEN) &&
+			(error = git_pqueue_insert(&st->queue, parent)) < 0)
+			return error;
+
+		*parent_flags |= flags;
+
+		if (st->opts.only_follow_first_parent)
+			break;
+	}
+
+	return 0;
+}
+
+static int compare_candidates(const void *a_, const void *b_, void *payload)
+{
+	const describe_candidate *a = a_, *b = b_;
+
+	GIT_UNUSED(payload);
+
+	if (a->depth != b->depth)
+		return a->depth < b->depth ? -1 : 1;
+	if (a->found_order != b->found_order)
+		return a->found_order < b->found_order ? -1 : 1;
+	return 0;
+}
+
+/* Count the commits which aren't below the best candidate, until all of
+ * the queued ones are */
+static int finish_depth(describe_state *st, describe_candidate *best)
+{
+	git_commit_list_node *commit, *queued;
+	uint32_t flags;
+	size_t i;
+	int error;
+
+	while ((commit = git_pqueue_pop(&st->queue)) != NULL) {
+		flags = *commit_flags(st, commit);
+
+		if (flags & best->flag_within) {
+			for (i = 0; i < git_pqueue_size(&st->queue); ++i) {
+				queued = git_pqueue_get(&st->queue, i);
+				if (!(*commit_flags(st, queued) & best->flag_within))
+					break;
+			}
+
+			if (i == git_pqueue_size(&st->queue))
+				break;
+		} else
+			best->depth++;
+
+		if ((error = push_parents(st, commit, flags)) < 0)
+			return error;
+	}
+
+	return 0;
+}
+
+static int describe_not_found(const git_oid *commit_id, const char *msg)
+{
+	char oid_str[GIT_OID_HEXSZ + 1];
+
+	git_oid_tostr(oid_str, sizeof(oid_str), commit_id);
+	giterr_set(GITERR_DESCRIBE, msg, oid_str);
+
+	return GIT_ENOTFOUND;
+}
+
+static int describe(
+	git_describe_result *result, describe_state *st, const git_oid *commit_id)
+{
+	describe_candidate candidates[DESCRIBE_MAX_CANDIDATES];
+	git_commit_list_node *start, *commit, *gave_up_on = NULL;
+	unsigned int match_count = 0, annotated_count = 0, i;
+	size_t seen_commits = 0;
+	describe_name *name;
+	uint32_t *flags;
+	int error;
+
+	git_oid_cpy(&result->commit_id, commit_id);
+	result->repo = st->repo;
+
+	/* a commit which has a name of its own needs no walk */
+	if ((name = find_name(st, commit_id)) != NULL) {
+		result->exact_match = 1;
+		result->name = git__strdup(name->path);
+		GITERR_CHECK_ALLOC(result->name);
+		return 0;
+	}
+
+	if (!st->opts.max_candidates_tags) {
+		if (st->opts.show_commit_oid_as_fallback) {
+			result->fallback_to_id = 1;
+			return 0;
+		}
+
+		return describe_not_found(
+			commit_id, "No tag exactly matches '%s'");
+	}
+
+	kh_clear(oid, st->flags);
+	git_pool_clear(&st->flags_pool);
+	git_pqueue_clear(&st->queue);
+
+	if ((start = git_revwalk__commit_lookup(st->walk, commit_id)) == NULL ||
+		(flags = commit_flags(st, start)) == NULL)
+		return -1;
+
+	if ((error = git_commit_list_parse(st->walk, start)) < 0)
+		return error;
+
+	*flags = DESCRIBE_SEEN;
+	if ((error = git_pqueue_insert(&st->queue, start)) < 0)
+		return error;
+
+	while ((commit = git_pqueue_pop(&st->queue)) != NULL) {
+		flags = commit_flags(st, commit);
+		seen_commits++;
+
+		if ((name = find_name(st, &commit->oid)) != NULL) {
+			if (match_count < st->opts.max_candidates_tags) {
+				describe_candidate *c = &candidates[match_count++];
+
+				c->name = name;
+				c->depth = seen_commits - 1;
+				c->flag_within = 1u << match_count;
+				c->found_order = match_count;
+				*flags |= c->flag_within;
+
+				if (name->prio == DESCRIBE_PRIO_ANNOTATED)
+					annotated_count++;
+			} else {
+				gave_up_on = commit;
+				break;
+			}
+		}
+
+		for (i = 0; i < match_count; ++i) {
+			if (!(*flags & candidates[i].flag_within))
+				candidates[i].depth++;
+		}
+
+		/* the only path left is already below the candidates */
+		if (annotated_count && !git_pqueue_size(&st->queue))
+			break;
+
+		if ((error = push_parents(st, commit, *flags)) < 0)
+			return error;
+	}
+
+	if (!match_count) {
+		if (st->opts.show_commit_oid_as_fallback) {
+			result->fallback_to_id = 1;
+			return 0;
+		}
+
+		return describe_not_found(commit_id, "No tags can describe '%s'");
+	}
+
+	git__qsort_r(candidates, match_count,
+		sizeof(describe_candidate), compare_candidates, NULL);
+
+	if (gave_up_on && (error = git_pqueue_insert(&st->queue, gave_up_on)) < 0)
+		return error;
+
+	if ((error = finish_depth(st, &candidates[0])) < 0)
+		return error;
+
+	result->depth = candidates[0].depth;
+	result->name = git__strdup(candidates[0].name->path);
+	GITERR_CHECK_ALLOC(result->name);
+
+	return 0;
+}
+
+int git_describe_many(
+	git_describe_result **results,
+	git_repository *repo,
+	const git_oid *commits,
+	size_t count,
+	git_describe_options *opts)
+{
+	describe_state st;
+	size_t i;
+	int error;
+
+	assert(results && repo && (commits || !count));
+
+	memset(results, 0, count * sizeof(git_describe_result *));
+
+	if ((error = describe_state_init(&st, repo, opts)) < 0)
+		goto done;
+
+	for (i = 0; i < count; ++i) {
+		if ((results[i] = git__calloc(1, sizeof(git_describe_result))) == NULL ||
+			(error = describe(results[i], &st, &commits[i])) < 0) {
+			error = results[i] ? error : -1;
+			break;
+		}
+	}
+
+done:
+	if (error < 0) {
+		for (i = 0; i < count; ++i) {
+			git_describe_result_free(results[i]);
+			results[i] = NULL;
+		}
+	}
+
+	describe_state_free(&st);
+	return error;
+}
+
+int git_describe_commit(
+	git_describe_result **result,
+	git_object *committish,
+	git_describe_options *opts)
+{
+	git_object *commit;
+	int error;
+
+	assert(result && committish);
+
+	if ((error = git_object_peel(&commit, committish, GIT_OBJ_COMMIT)) < 0)
+		return error;
+
+	error = git_describe_many(result, git_object_owner(committish),
+		git_object_id(commit), 1, opts);
+
+	git_object_free(commit);
+	return error;
+}
+
+static int workdir_is_dirty(int *dirty, git_repository *repo, git_object *head)
+{
+	git_tree *tree = NULL;
+	git_diff *diff = NULL;
+	int error;
+
+	*dirty = 0;
+
+	if ((error = git_commit_tree(&tree, (git_commit *)head)) < 0 ||
+		(error = git_diff_tree_to_index(&diff, repo, tree, NULL, NULL)) < 0)
+		goto done;
+
+	if (git_diff_num_deltas(diff) > 0) {
+		*dirty = 1;
+		goto done;
+	}
+
+	git_diff_free(diff);
+	diff = NULL;
+
+	if ((error = git_diff_index_to_workdir(&diff, repo, NULL, NULL)) < 0)
+		goto done;
+
+	*dirty = git_diff_num_deltas(diff) > 0;
+
+done:
+	git_diff_free(diff);
+	git_tree_free(tree);
+	return error;
+}
+
+int git_describe_workdir(
+	git_describe_result **out,
+	git_repository *repo,
+	git_describe_options *opts)
+{
+	git_object *head;
+	int error;
+
+	assert(out && repo);
+
+	if ((error = git_revparse_single(&head, repo, "HEAD^{commit}")) < 0)
+		return error;
+
+	if ((error = git_describe_commit(out, head, opts)) == 0 &&
+		(error = workdir_is_dirty(&(*out)->dirty, repo, head)) < 0) {
+		git_describe_result_free(*out);
+		*out = NULL;
+	}
+
+	git_object_free(head);
+	return error;
+}
+
+/* The shortest prefix of at least `len` digits which is unambiguous */
+static int find_unique_abbrev(
+	git_buf *out, git_repository *repo, const git_oid *id, size_t len)
+{
+	git_oid prefix = {{0}};
+	git_odb *odb;
+	int error;
+
+	if ((error = git_repository_odb__weakptr(&odb, repo)) < 0)
+		return error;
+
+	for (; len < GIT_OID_HEXSZ; ++len) {
+		memcpy(&prefix.id, &id->id, (len + 1) / 2);
+		if (len & 1)
+			prefix.id[len / 2] &= 0xf0;
+
+		error = git_odb_exists_prefix(NULL, odb, &prefix, len);
+		if (error != GIT_EAMBIGUOUS)
+			break;
+
+		giterr_clear();
+	}
+
+	if (error < 0 && error != GIT_EAMBIGUOUS)
+		return error;
+
+	if (git_buf_grow(out, out->size + len + 1) < 0)
+		return -1;
+
+	git_oid_tostr(out->ptr + out->size, len + 1, id);
+	out->size += len;
+
+	return 0;
+}
+
+int git_describe_format(
+	git_buf *out,
+	const git_describe_result *result,
+	const git_describe_format_options *given)
+{
+	git_describe_format_options opts = GIT_DESCRIBE_FORMAT_OPTIONS_INIT;
+	int error;
+
+	assert(out && result);
+
+	if (given) {
+		GITERR_CHECK_VERSION(given, GIT_DESCRIBE_FORMAT_OPTIONS_VERSION,
+			"git_describe_format_options");
+		memcpy(&opts, given, sizeof(opts));
+	}
+
+	git_buf_sanitize(out);
+	git_buf_clear(out);
+
+	if (result->fallback_to_id) {
+		if ((error = find_unique_abbrev(out, result->repo,
+				&result->commit_id, opts.abbreviated_size ?
+				opts.abbreviated_size : GIT_DESCRIBE_DEFAULT_ABBREVIATED_SIZE)) < 0)
+			return error;
+	} else {
+		git_buf_puts(out, result->name);
+
+		if (opts.abbreviated_size &&
+			(!result->exact_match || opts.always_use_long_format)) {
+			git_buf_printf(out, "-%" PRIuZ "-g", result->depth);
+
+			if ((error = find_unique_abbrev(out, result->repo,
+					&result->commit_id, opts.abbreviated_size)) < 0)
+				return error;
+		}
+	}
+
+	if (result->dirty && opts.dirty_suffix)
+		git_buf_puts(out, opts.dirty_suffix);
+
+	return git_buf_oom(out) ? -1 : 0;
+}
+
+void git_describe_result_free(git_describe_result *result)
+{
+	if (result == NULL)
+		return;
+
+	git__free(result->name);
+	git__free(result);
+}
@@ -4,6 +4,8 @@
  * This file is part of libgit2, distributed under the GNU GPL v2 with
  * a Linking Exception. For full terms see the included COPYING file.
  */
+#include <stddef.h>
+
 #include "common.h"
 #include "diff.h"
 #include "fileops.h"
@@ -343,6 +345,18 @@ static void diff_set_ignore_case(git_diff *diff, bool ignore_case)
 	git_vector_sort(&diff->deltas);
 }
 
+void git_diff__copy_options(
+	git_diff_options *out, const git_diff_options *opts)
+{
+	git_diff_options dflt = GIT_DIFF_OPTIONS_INIT;
+
+	memcpy(out, &dflt, sizeof(*out));
+
+	/* version 1 of the options ends before `threads` */
+	memcpy(out, opts, opts->version < 2 ?
+		offsetof(git_diff_options, threads) : sizeof(*out));
+}
+
 static git_diff *diff_list_alloc(
 	git_repository *repo,
 	git_iterator *old_iter,
@@ -389,7 +403,7 @@ static int diff_list_apply_options(
 	if (opts) {
 		/* copy user options (except case sensitivity info from iterators) */
 		bool icase = DIFF_FLAG_IS_SET(diff, GIT_DIFF_IGNORE_CASE);
-		memcpy(&diff->opts, opts, sizeof(diff->opts));
+		git_diff__copy_options(&diff->opts, opts);
 		DIFF_FLAG_SET(diff, GIT_DIFF_IGNORE_CASE, icase);
 
 		/* initialize pathspec from options */
@@ -425,7 +439,16 @@ static int diff_list_apply_options(
 	/* Don't set GIT_DIFFCAPS_USE_DEV - compile time option in core git */
 
 	/* Set GIT_DIFFCAPS_TRUST_NANOSECS on a platform basis */
+#ifdef GIT_USE_NSEC
 	diff->diffcaps = diff->diffcaps | GIT_DIFFCAPS_TRUST_NANOSECS;
+#endif
+
+	/* Remember which index entries match the working directory, so that
+	 * the file system monitor can vouch for them in later scans */
+	if (repo->_fsmonitor != NULL &&
+		diff->old_src == GIT_ITERATOR_TYPE_INDEX &&
+		diff->new_src == GIT_ITERATOR_TYPE_WORKDIR)
+		diff->diffcaps = diff->diffcaps | GIT_DIFFCAPS_FSMONITOR;
 
 	/* If not given explicit `opts`, check `diff.xyz` configs */
 	if (!opts) {
@@ -634,6 +657,7 @@ typedef struct {
 	git_iterator *new_iter;
 	const git_index_entry *oitem;
 	const git_index_entry *nitem;
+	git_vector fsmonitor_valid; /* index entries seen to be unchanged */
 } diff_in_progress;
 
 #define MODE_BITS_MASK 0000777
@@ -698,7 +722,7 @@ static int maybe_modified(
 	unsigned int omode = oitem->mode;
 	unsigned int nmode = nitem->mode;
 	bool new_is_workdir = (info->new_iter->type == GIT_ITERATOR_TYPE_WORKDIR);
-	bool modified_uncertain = false;
+	bool modified_uncertain = false, workdir_checked = false;
 	const char *matched_pathspec;
 	int error = 0;
 
@@ -755,8 +779,7 @@ static int maybe_modified(
 		bool use_nanos = ((diff->diffcaps & GIT_DIFFCAPS_TRUST_NANOSECS) != 0);
 
 		status = GIT_DELTA_UNMODIFIED;
-
-		/* TODO: add check against index file st_mtime to avoid racy-git */
+		workdir_checked = !S_ISGITLINK(nmode);
 
 		if (S_ISGITLINK(nmode)) {
 			if ((error = maybe_modified_submodule(&status, &noid, diff, info)) < 0)
@@ -781,6 +804,16 @@ static int maybe_modified(
 			status = GIT_DELTA_MODIFIED;
 			modified_uncertain = true;
 		}
+
+		/* if the stat data matches but the file was modified no earlier
+		 * than the index was written, then it cannot be trusted (racy-git)
+		 */
+		else if (git_index__entry_is_racy(
+				git_iterator_get_index(info->old_iter), oitem))
+		{
+			status = GIT_DELTA_MODIFIED;
+			modified_uncertain = true;
+		}
 	}
 
 	/* if mode is GITLINK and submodules are ignored, then skip */
@@ -811,6 +844,15 @@ static int maybe_modified(
 			status = GIT_DELTA_UNMODIFIED;
 	}
 
+	/* the old item is the index's own entry, which can be marked as
+	 * unchanged since the token the scan was started with once the
+	 * scan is done and the index can be locked */
+	if (status == GIT_DELTA_UNMODIFIED && workdir_checked &&
+		(diff->diffcaps & GIT_DIFFCAPS_FSMONITOR) != 0 &&
+		GIT_IDXENTRY_STAGE(oitem) == 0 &&
+		git_vector_insert(&info->fsmonitor_valid, (void *)oitem) < 0)
+		return -1;
+
 	return diff_delta__from_two(
 		diff, status, oitem, omode, nitem, nmode,
 		git_oid_iszero(&noid) ? NULL : &noid, matched_pathspec);
@@ -1023,6 +1065,59 @@ static int handle_matched_item(
 	return error;
 }
 
+/* Tree iterators only return trees as items when the diff can skip the
+ * subtrees which are the same on both sides (see git_diff_tree_to_tree).
+ */
+static bool is_tree_item(git_iterator *iter, const git_index_entry *item)
+{
+	return (item != NULL && item->mode == GIT_FILEMODE_TREE &&
+		git_iterator_type(iter) == GIT_ITERATOR_TYPE_TREE);
+}
+
+static int handle_tree_items(
+	git_diff *diff, diff_in_progress *info, int cmp)
+{
+	bool old_is_tree = is_tree_item(info->old_iter, info->oitem);
+	bool new_is_tree = is_tree_item(info->new_iter, info->nitem);
+	int error = 0;
+
+	/* a tree with the same id on both sides holds no changes, so move
+	 * past it without reading it (unless unmodified items are wanted)
+	 */
+	if (cmp == 0 && old_is_tree && new_is_tree) {
+		if (git_oid_equal(&info->oitem->id, &info->nitem->id) &&
+			DIFF_FLAG_ISNT_SET(diff, GIT_DIFF_INCLUDE_UNMODIFIED)) {
+			if (!(error = git_iterator_advance(&info->oitem, info->old_iter)) ||
+				error == GIT_ITEROVER)
+				error = git_iterator_advance(&info->nitem, info->new_iter);
+		} else {
+			if (!(error = git_iterator_advance_into(
+					&info->oitem, info->old_iter)) || error == GIT_ITEROVER)
+				error = git_iterator_advance_into(
+					&info->nitem, info->new_iter);
+		}
+
+		return error;
+	}
+
+	/* otherwise expand a tree which comes first, or which the item on the
+	 * other side is a prefix of, so that the items compared (and checked
+	 * for type changes) are the same as if all the trees were expanded
+	 */
+	if (old_is_tree &&
+		(cmp < 0 || entry_is_prefixed(diff, info->oitem, info->nitem)))
+		return git_iterator_advance_into(&info->oitem, info->old_iter);
+
+	if (new_is_tree &&
+		(cmp > 0 || entry_is_prefixed(diff, info->nitem, info->oitem)))
+		return git_iterator_advance_into(&info->nitem, info->new_iter);
+
+	if (cmp < 0)
+		return handle_unmatched_old_item(diff, info);
+	else
+		return handle_unmatched_new_item(diff, info);
+}
+
 int git_diff__from_iterators(
 	git_diff **diff_ptr,
 	git_repository *repo,
@@ -1043,6 +1138,9 @@ int git_diff__from_iterators(
 	info.old_iter = old_iter;
 	info.new_iter = new_iter;
 
+	if ((error = git_vector_init(&info.fsmonitor_valid, 0, NULL)) < 0)
+		goto cleanup;
+
 	/* make iterators have matching icase behavior */
 	if (DIFF_FLAG_IS_SET(diff, GIT_DIFF_IGNORE_CASE)) {
 		if ((error = git_iterator_set_ignore_case(old_iter, true)) < 0 ||
@@ -1067,8 +1165,13 @@ int git_diff__from_iterators(
 		int cmp = info.oitem ?
 			(info.nitem ? diff->entrycomp(info.oitem, info.nitem) : -1) : 1;
 
+		/* skip or expand trees returned by tree iterators */
+		if (is_tree_item(old_iter, info.oitem) ||
+			is_tree_item(new_iter, info.nitem))
+			error = handle_tree_items(diff, &info, cmp);
+
 		/* create DELETED records for old items not matched in new */
-		if (cmp < 0)
+		else if (cmp < 0)
 			error = handle_unmatched_old_item(diff, &info);
 
 		/* create ADDED, TRACKED, or IGNORED records for new items not
@@ -1090,12 +1193,18 @@ int git_diff__from_iterators(
 
 	diff->perf.stat_calls += old_iter->stat_calls + new_iter->stat_calls;
 
+	if (!error && info.fsmonitor_valid.length > 0)
+		error = git_index__fsmonitor_mark_valid(
+			git_iterator_get_index(old_iter), &info.fsmonitor_valid);
+
 cleanup:
 	if (!error)
 		*diff_ptr = diff;
 	else
 		git_diff_free(diff);
 
+	git_vector_free(&info.fsmonitor_valid);
+
 	return error;
 }
 
@@ -1127,6 +1236,12 @@ int git_diff_tree_to_tree(
 	if (opts && (opts->flags & GIT_DIFF_IGNORE_CASE) != 0)
 		iflag = GIT_ITERATOR_IGNORE_CASE;
 
+	/* return trees as items instead of expanding them, so that subtrees
+	 * with the same id on both sides are skipped without being read
+	 */
+	else
+		iflag |= GIT_ITERATOR_DONT_AUTOEXPAND;
+
 	DIFF_FROM_ITERATORS(
 		git_iterator_for_tree(&a, old_tree, iflag, pfx, pfx),
 		git_iterator_for_tree(&b, new_tree, iflag, pfx, pfx)
@@ -29,6 +29,7 @@ enum {
 	GIT_DIFFCAPS_TRUST_CTIME      = (1 << 3), /* use st_ctime? */
 	GIT_DIFFCAPS_USE_DEV          = (1 << 4), /* use st_dev? */
 	GIT_DIFFCAPS_TRUST_NANOSECS   = (1 << 5), /* use stat time nanoseconds */
+	GIT_DIFFCAPS_FSMONITOR        = (1 << 6), /* mark entries for fsmonitor */
 };
 
 #define DIFF_FLAGS_KNOWN_BINARY (GIT_DIFF_FLAG_BINARY|GIT_DIFF_FLAG_NOT_BINARY)
@@ -96,6 +97,13 @@ extern int git_diff__oid_for_file(
 extern int git_diff__oid_for_entry(
 	git_oid *out, git_diff *, const git_index_entry *, const git_oid *update);
 
+/*
+ * Copy the caller's options over the defaults, only as far as the fields
+ * their version of the structure has.
+ */
+extern void git_diff__copy_options(
+	git_diff_options *out, const git_diff_options *opts);
+
 extern int git_diff__from_iterators(
 	git_diff **diff_ptr,
 	git_repository *repo,
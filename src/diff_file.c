@@ -15,6 +15,9 @@
 
 #define DIFF_MAX_FILESIZE 0x20000000
 
+/* blobs smaller than this are loaded whole to check if they are binary */
+#define DIFF_SNIFF_MIN_SIZE (64 * 1024)
+
 static bool diff_file_content_binary_by_size(git_diff_file_content *fc)
 {
 	/* if we have diff opts, check max_size vs file size */
@@ -138,6 +141,7 @@ int git_diff_file_content__init_from_src(
 	fc->repo = repo;
 	fc->file = as_file;
 	fc->blob = src->blob;
+	fc->prepared = src->prepared;
 
 	if (!src->blob && !src->buf) {
 		fc->flags |= GIT_DIFF_FLAG__NO_DATA;
@@ -217,6 +221,99 @@ static int diff_file_content_commit_to_str(
 	return 0;
 }
 
+static int diff_file_content_read_head(
+	char *buf, size_t *len, git_repository *repo, const git_oid *id)
+{
+	git_odb *odb;
+	git_odb_stream *stream;
+	int error, read = 0;
+
+	*len = 0;
+
+	if ((error = git_repository_odb__weakptr(&odb, repo)) < 0 ||
+		(error = git_odb_open_rstream(&stream, odb, id)) < 0)
+		return error;
+
+	while (*len < GIT_FILTER_BYTES_TO_CHECK_NUL &&
+		(read = git_odb_stream_read(stream,
+			buf + *len, GIT_FILTER_BYTES_TO_CHECK_NUL - *len)) > 0)
+		*len += read;
+
+	git_odb_stream_free(stream);
+
+	return (read < 0) ? read : 0;
+}
+
+/*
+ * Check whether a large blob is binary by reading only the bytes which
+ * `git_diff_driver_content_is_binary` looks at, so that binary blobs
+ * are never loaded whole.  This also finds the size of the blob if it
+ * isn't known yet, returning the object if it had to be read for that.
+ */
+static int diff_file_content_sniff_blob(
+	git_diff_file_content *fc, git_odb_object **odb_obj)
+{
+	git_binarycache *cache = fc->repo->binarycache;
+	char head[GIT_FILTER_BYTES_TO_CHECK_NUL];
+	size_t len;
+	int binary, error;
+
+	/* if we don't know size, try to peek at object header first */
+	if (!fc->file->size) {
+		if ((error = git_diff_file__resolve_zero_size(
+				fc->file, odb_obj, fc->repo)) < 0)
+			return error;
+	}
+
+	if (diff_file_content_binary_by_size(fc) ||
+		(fc->file->flags & DIFF_FLAGS_KNOWN_BINARY) != 0 ||
+		fc->file->size < DIFF_SNIFF_MIN_SIZE || *odb_obj != NULL)
+		return 0;
+
+	if (cache == NULL ||
+		(binary = git_binarycache_get(cache, &fc->file->id)) == GIT_ENOTFOUND) {
+		/* objects which can't be streamed are loaded whole instead */
+		if (diff_file_content_read_head(
+				head, &len, fc->repo, &fc->file->id) < 0 ||
+			len < sizeof(head)) {
+			giterr_clear();
+			return 0;
+		}
+
+		binary = git_diff_driver_content_is_binary(fc->driver, head, len);
+
+		if (cache != NULL && binary >= 0 &&
+			git_binarycache_put(cache, &fc->file->id, binary) < 0)
+			return -1;
+	}
+
+	switch (binary) {
+	case 0: fc->file->flags |= GIT_DIFF_FLAG_NOT_BINARY; break;
+	case 1: fc->file->flags |= GIT_DIFF_FLAG_BINARY; break;
+	default: break;
+	}
+
+	return (binary < 0) ? binary : 0;
+}
+
+int git_diff_file_content__sniff(git_diff_file_content *fc)
+{
+	git_odb_object *odb_obj = NULL;
+	int error;
+
+	if ((fc->flags & GIT_DIFF_FLAG__LOADED) != 0 ||
+		(fc->file->flags & GIT_DIFF_FLAG_BINARY) != 0 ||
+		fc->src == GIT_ITERATOR_TYPE_WORKDIR ||
+		fc->file->mode == GIT_FILEMODE_COMMIT ||
+		git_oid_iszero(&fc->file->id))
+		return 0;
+
+	error = diff_file_content_sniff_blob(fc, &odb_obj);
+
+	git_odb_object_free(odb_obj);
+	return error;
+}
+
 static int diff_file_content_load_blob(git_diff_file_content *fc)
 {
 	int error = 0;
@@ -228,16 +325,12 @@ static int diff_file_content_load_blob(git_diff_file_content *fc)
 	if (fc->file->mode == GIT_FILEMODE_COMMIT)
 		return diff_file_content_commit_to_str(fc, false);
 
-	/* if we don't know size, try to peek at object header first */
-	if (!fc->file->size) {
-		if ((error = git_diff_file__resolve_zero_size(
-				fc->file, &odb_obj, fc->repo)) < 0)
-			return error;
+	if ((error = diff_file_content_sniff_blob(fc, &odb_obj)) < 0 ||
+		(fc->file->flags & GIT_DIFF_FLAG_BINARY) != 0) {
+		git_odb_object_free(odb_obj);
+		return error;
 	}
 
-	if (diff_file_content_binary_by_size(fc))
-		return 0;
-
 	if (odb_obj != NULL) {
 		error = git_object__from_odb_object(
 			(git_object **)&fc->blob, fc->repo, odb_obj, GIT_OBJ_BLOB);
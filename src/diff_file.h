@@ -22,6 +22,7 @@ typedef struct {
 	git_off_t opts_max_size;
 	git_iterator_type_t src;
 	const git_blob *blob;
+	const git_diff_prepared_blob *prepared;
 	git_map map;
 } git_diff_file_content;
 
@@ -36,10 +37,13 @@ typedef struct {
 	const void *buf;
 	size_t buflen;
 	const char *as_path;
+	const git_diff_prepared_blob *prepared;
 } git_diff_file_content_src;
 
-#define GIT_DIFF_FILE_CONTENT_SRC__BLOB(BLOB,PATH) { (BLOB),NULL,0,(PATH) }
-#define GIT_DIFF_FILE_CONTENT_SRC__BUF(BUF,LEN,PATH) { NULL,(BUF),(LEN),(PATH) }
+#define GIT_DIFF_FILE_CONTENT_SRC__BLOB(BLOB,PATH) { (BLOB),NULL,0,(PATH),NULL }
+#define GIT_DIFF_FILE_CONTENT_SRC__BUF(BUF,LEN,PATH) { NULL,(BUF),(LEN),(PATH),NULL }
+#define GIT_DIFF_FILE_CONTENT_SRC__PREPARED(P) \
+	{ (P)->blob,NULL,0,(P)->path,(P) }
 
 extern int git_diff_file_content__init_from_src(
 	git_diff_file_content *fc,
@@ -48,6 +52,9 @@ extern int git_diff_file_content__init_from_src(
 	const git_diff_file_content_src *src,
 	git_diff_file *as_file);
 
+/* this checks if a large blob is binary without loading all of it */
+extern int git_diff_file_content__sniff(git_diff_file_content *fc);
+
 /* this loads the blob/file-on-disk as needed */
 extern int git_diff_file_content__load(git_diff_file_content *fc);
 
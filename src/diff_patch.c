@@ -152,6 +152,15 @@ static int diff_patch_load(git_patch *patch, git_diff_output *output)
 			goto cleanup;
 	}
 
+	/* neither blob is loaded if either one of them is binary, but the
+	 * size of both is known
+	 */
+	if ((error = git_diff_file_content__sniff(&patch->ofile)) < 0 ||
+		(error = git_diff_file_content__sniff(&patch->nfile)) < 0 ||
+		(patch->ofile.file->flags & GIT_DIFF_FLAG_BINARY) != 0 ||
+		(patch->nfile.file->flags & GIT_DIFF_FLAG_BINARY) != 0)
+		goto cleanup;
+
 	/* once workdir has been tried, load other data as needed */
 	if (patch->ofile.src != GIT_ITERATOR_TYPE_WORKDIR) {
 		if ((error = git_diff_file_content__load(&patch->ofile)) < 0 ||
@@ -258,6 +267,293 @@ static int diff_required(git_diff *diff, const char *action)
 	return -1;
 }
 
+/* Generate the patch of one delta, invoking the callbacks as it goes */
+static int diff_foreach_patch(
+	git_diff *diff, git_xdiff_output *xo, size_t idx)
+{
+	int error;
+	git_patch patch;
+
+	if ((error = diff_patch_init_from_diff(&patch, diff, idx)) < 0)
+		return error;
+
+	if (!(error = diff_patch_invoke_file_callback(&patch, &xo->output)))
+		error = diff_patch_generate(&patch, &xo->output);
+
+	git_patch_free(&patch);
+
+	return error;
+}
+
+#ifdef GIT_THREADS
+
+#define DIFF_FOREACH_MAX_THREADS 32
+#define DIFF_FOREACH_SLOTS_PER_THREAD 4
+#define DIFF_FOREACH_MAX_HELD (64 * 1024 * 1024)
+
+/*
+ * With threads, the patches of the next few deltas are generated ahead
+ * into slots, recording their hunks and lines, while the calling thread
+ * invokes the callbacks for the earliest slot from what was recorded.
+ * The calling thread sets up each patch, as that looks up attributes and
+ * diff drivers, and generates patches too when it has nothing to deliver.
+ *
+ * A patch is generated against a copy of its delta, which is copied back
+ * once the file callback was made, so that the callbacks see the delta as
+ * they would without threads.  A patch which could not be generated is
+ * generated again by the calling thread, which is the one reporting errors.
+ *
+ * A generated patch holds the content of its files and all of its lines
+ * until it is delivered, so no more deltas are set up ahead while the
+ * patches waiting to be delivered hold more than DIFF_FOREACH_MAX_HELD
+ * bytes.  Otherwise a diff of many large files could use a lot of memory,
+ * where the same diff without threads uses as much as its largest file.
+ */
+enum {
+	DIFF_FOREACH_QUEUED = 1,
+	DIFF_FOREACH_RUNNING,
+	DIFF_FOREACH_DONE,
+	DIFF_FOREACH_FAILED,
+};
+
+typedef struct {
+	git_patch patch;
+	git_diff_delta delta;
+	size_t delta_index;
+	size_t held; /* bytes held by the generated patch */
+	int state;
+} diff_foreach_slot;
+
+typedef struct {
+	git_diff *diff;
+	git_mutex lock;
+	git_cond changed;
+	diff_foreach_slot *slots;
+	size_t nslots;
+	size_t queued;  /* number of slots set up so far */
+	size_t claimed; /* number of slots taken to generate so far */
+	size_t held;    /* bytes held by the patches not yet delivered */
+	bool stopping;
+} diff_foreach_threads;
+
+/* Set up the patch for the next delta, if there is one left */
+static bool diff_foreach_setup(
+	diff_foreach_slot *slot, git_diff *diff, size_t *idx)
+{
+	git_diff_delta *delta;
+
+	for (; *idx < diff->deltas.length; ++(*idx)) {
+		delta = git_vector_get(&diff->deltas, *idx);
+
+		if (!git_diff_delta__should_skip(&diff->opts, delta))
+			break;
+	}
+
+	if (*idx >= diff->deltas.length)
+		return false;
+
+	/* stop here, the delta will be tried again without threads */
+	if (diff_patch_init_from_diff(&slot->patch, diff, *idx) < 0) {
+		giterr_clear();
+		return false;
+	}
+
+	memcpy(&slot->delta, slot->patch.delta, sizeof(slot->delta));
+	slot->patch.delta = &slot->delta;
+	slot->patch.ofile.file = &slot->delta.old_file;
+	slot->patch.nfile.file = &slot->delta.new_file;
+
+	slot->delta_index = (*idx)++;
+	slot->state = DIFF_FOREACH_QUEUED;
+
+	return true;
+}
+
+/* Take the next slot to generate; must be called with the lock held */
+static diff_foreach_slot *diff_foreach_claim(diff_foreach_threads *work)
+{
+	diff_foreach_slot *slot;
+
+	if (work->stopping || work->claimed >= work->queued)
+		return NULL;
+
+	slot = &work->slots[work->claimed++ % work->nslots];
+	slot->state = DIFF_FOREACH_RUNNING;
+
+	return slot;
+}
+
+/* Generate a claimed slot, with the lock released while doing it */
+static void diff_foreach_generate(
+	diff_foreach_threads *work, diff_foreach_slot *slot)
+{
+	git_xdiff_output xo;
+	int error;
+
+	git_mutex_unlock(&work->lock);
+
+	memset(&xo, 0, sizeof(xo));
+	diff_output_to_patch(&xo.output, &slot->patch);
+	git_xdiff_init(&xo, &work->diff->opts);
+
+	if ((error = diff_patch_generate(&slot->patch, &xo.output)) != 0)
+		giterr_clear();
+
+	slot->held = slot->patch.ofile.map.len + slot->patch.nfile.map.len +
+		git_array_size(slot->patch.hunks) * sizeof(diff_patch_hunk) +
+		git_array_size(slot->patch.lines) * sizeof(git_diff_line);
+
+	git_mutex_lock(&work->lock);
+
+	work->held += slot->held;
+	slot->state = error ? DIFF_FOREACH_FAILED : DIFF_FOREACH_DONE;
+	git_cond_broadcast(&work->changed);
+}
+
+static void *diff_foreach_thread(void *payload)
+{
+	diff_foreach_threads *work = payload;
+	diff_foreach_slot *slot;
+
+	git_mutex_lock(&work->lock);
+
+	while (!work->stopping) {
+		if ((slot = diff_foreach_claim(work)) != NULL)
+			diff_foreach_generate(work, slot);
+		else
+			git_cond_wait(&work->changed, &work->lock);
+	}
+
+	git_mutex_unlock(&work->lock);
+
+	return NULL;
+}
+
+/* Invoke the callbacks for a generated slot */
+static int diff_foreach_deliver(
+	git_diff *diff, git_xdiff_output *xo, diff_foreach_slot *slot)
+{
+	git_patch *patch = &slot->patch;
+	git_diff_delta *delta = git_vector_get(&diff->deltas, slot->delta_index);
+	git_diff_output *output = &xo->output;
+	int error;
+
+	if (slot->state == DIFF_FOREACH_FAILED) {
+		git_patch_free(patch);
+		return diff_foreach_patch(diff, xo, slot->delta_index);
+	}
+
+	patch->delta = delta;
+
+	if (!(error = diff_patch_invoke_file_callback(patch, output))) {
+		memcpy(delta, &slot->delta, sizeof(*delta));
+
+		error = git_patch__invoke_callbacks(
+			patch, NULL, output->hunk_cb, output->data_cb, output->payload);
+	}
+
+	git_patch_free(patch);
+
+	return error;
+}
+
+/* Generate patches on threads, leaving `idx` at the first delta left */
+static int diff_foreach_threaded(
+	size_t *idx, git_diff *diff, git_xdiff_output *xo)
+{
+	diff_foreach_threads work;
+	diff_foreach_slot *slot;
+	git_thread threads[DIFF_FOREACH_MAX_THREADS];
+	size_t nthreads = min(diff->opts.threads, DIFF_FOREACH_MAX_THREADS);
+	size_t started, delivered = 0, i;
+	bool more = true;
+	git_odb *odb;
+	int error;
+
+	/* set up the object database before the threads need it */
+	if ((error = git_repository_odb__weakptr(&odb, diff->repo)) < 0)
+		return error;
+
+	memset(&work, 0, sizeof(work));
+	work.diff = diff;
+	work.nslots = nthreads * DIFF_FOREACH_SLOTS_PER_THREAD;
+	work.slots = git__calloc(work.nslots, sizeof(diff_foreach_slot));
+	GITERR_CHECK_ALLOC(work.slots);
+
+	if (git_mutex_init(&work.lock) || git_cond_init(&work.changed)) {
+		giterr_set(GITERR_OS, "Failed to initialize lock");
+		git__free(work.slots);
+		return -1;
+	}
+
+	for (started = 0; started + 1 < nthreads; ++started)
+		if (git_thread_create(
+				&threads[started], NULL, diff_foreach_thread, &work) != 0)
+			break;
+
+	git_mutex_lock(&work.lock);
+
+	while (!error) {
+		/* set up the deltas ahead, as far as there are free slots */
+		while (more && work.queued < delivered + work.nslots &&
+			(work.held < DIFF_FOREACH_MAX_HELD || work.queued == delivered)) {
+			slot = &work.slots[work.queued % work.nslots];
+
+			git_mutex_unlock(&work.lock);
+			more = diff_foreach_setup(slot, diff, idx);
+			git_mutex_lock(&work.lock);
+
+			if (more) {
+				work.queued++;
+				git_cond_broadcast(&work.changed);
+			}
+		}
+
+		if (delivered == work.queued)
+			break;
+
+		/* wait for the earliest slot, generating some meanwhile */
+		slot = &work.slots[delivered % work.nslots];
+
+		if (slot->state == DIFF_FOREACH_QUEUED ||
+			slot->state == DIFF_FOREACH_RUNNING) {
+			diff_foreach_slot *next = diff_foreach_claim(&work);
+
+			if (next != NULL)
+				diff_foreach_generate(&work, next);
+			else
+				git_cond_wait(&work.changed, &work.lock);
+			continue;
+		}
+
+		git_mutex_unlock(&work.lock);
+		error = diff_foreach_deliver(diff, xo, slot);
+		git_mutex_lock(&work.lock);
+
+		work.held -= slot->held;
+		delivered++;
+	}
+
+	work.stopping = true;
+	git_cond_broadcast(&work.changed);
+	git_mutex_unlock(&work.lock);
+
+	for (i = 0; i < started; ++i)
+		git_thread_join(threads[i], NULL);
+
+	/* free the patches which were not delivered */
+	for (i = delivered; i < work.queued; ++i)
+		git_patch_free(&work.slots[i % work.nslots].patch);
+
+	git_cond_free(&work.changed);
+	git_mutex_free(&work.lock);
+	git__free(work.slots);
+
+	return error;
+}
+
+#endif
+
 int git_diff_foreach(
 	git_diff *diff,
 	git_diff_file_cb file_cb,
@@ -267,8 +563,8 @@ int git_diff_foreach(
 {
 	int error = 0;
 	git_xdiff_output xo;
-	size_t idx;
-	git_patch patch;
+	size_t idx = 0;
+	git_diff_delta *delta;
 
 	if ((error = diff_required(diff, "git_diff_foreach")) < 0)
 		return error;
@@ -278,22 +574,22 @@ int git_diff_foreach(
 		&xo.output, &diff->opts, file_cb, hunk_cb, data_cb, payload);
 	git_xdiff_init(&xo, &diff->opts);
 
-	git_vector_foreach(&diff->deltas, idx, patch.delta) {
+#ifdef GIT_THREADS
+	/* only the text of the files is worth generating on other threads */
+	if (diff->opts.threads > 1 && (hunk_cb || data_cb) &&
+		diff->old_src != GIT_ITERATOR_TYPE_WORKDIR &&
+		diff->new_src != GIT_ITERATOR_TYPE_WORKDIR)
+		error = diff_foreach_threaded(&idx, diff, &xo);
+#endif
+
+	for (; !error && idx < diff->deltas.length; ++idx) {
+		delta = git_vector_get(&diff->deltas, idx);
 
 		/* check flags against patch status */
-		if (git_diff_delta__should_skip(&diff->opts, patch.delta))
+		if (git_diff_delta__should_skip(&diff->opts, delta))
 			continue;
 
-		if ((error = diff_patch_init_from_diff(&patch, diff, idx)) < 0)
-			break;
-
-		if (!(error = diff_patch_invoke_file_callback(&patch, &xo.output)))
-			error = diff_patch_generate(&patch, &xo.output);
-
-		git_patch_free(&patch);
-
-		if (error)
-			break;
+		error = diff_foreach_patch(diff, &xo, idx);
 	}
 
 	return error;
@@ -349,8 +645,6 @@ static int diff_patch_from_sources(
 	git_diff_file *lfile = &pd->delta.old_file, *rfile = &pd->delta.new_file;
 	git_diff_file_content *ldata = &pd->patch.ofile, *rdata = &pd->patch.nfile;
 
-	GITERR_CHECK_VERSION(opts, GIT_DIFF_OPTIONS_VERSION, "git_diff_options");
-
 	if (opts && (opts->flags & GIT_DIFF_REVERSE) != 0) {
 		void *tmp = lfile; lfile = rfile; rfile = tmp;
 		tmp = ldata; ldata = rdata; rdata = tmp;
@@ -420,6 +714,14 @@ static int diff_from_sources(
 	int error = 0;
 	diff_patch_with_delta pd;
 	git_xdiff_output xo;
+	git_diff_options given;
+
+	GITERR_CHECK_VERSION(opts, GIT_DIFF_OPTIONS_VERSION, "git_diff_options");
+
+	if (opts) {
+		git_diff__copy_options(&given, opts);
+		opts = &given;
+	}
 
 	memset(&xo, 0, sizeof(xo));
 	diff_output_init(
@@ -444,10 +746,18 @@ static int patch_from_sources(
 	int error = 0;
 	diff_patch_with_delta *pd;
 	git_xdiff_output xo;
+	git_diff_options given;
 
 	assert(out);
 	*out = NULL;
 
+	GITERR_CHECK_VERSION(opts, GIT_DIFF_OPTIONS_VERSION, "git_diff_options");
+
+	if (opts) {
+		git_diff__copy_options(&given, opts);
+		opts = &given;
+	}
+
 	if ((error = diff_patch_with_delta_alloc(
 			&pd, &oldsrc->as_path, &newsrc->as_path)) < 0)
 		return error;
@@ -572,6 +882,36 @@ int git_patch_from_buffers(
 	return patch_from_sources(out, &osrc, &nsrc, opts);
 }
 
+int git_diff_prepared_blobs(
+	const git_diff_prepared_blob *old_blob,
+	const git_diff_prepared_blob *new_blob,
+	const git_diff_options *opts,
+	git_diff_file_cb file_cb,
+	git_diff_hunk_cb hunk_cb,
+	git_diff_line_cb data_cb,
+	void *payload)
+{
+	git_diff_file_content_src osrc =
+		GIT_DIFF_FILE_CONTENT_SRC__PREPARED(old_blob);
+	git_diff_file_content_src nsrc =
+		GIT_DIFF_FILE_CONTENT_SRC__PREPARED(new_blob);
+	return diff_from_sources(
+		&osrc, &nsrc, opts, file_cb, hunk_cb, data_cb, payload);
+}
+
+int git_patch_from_prepared_blobs(
+	git_patch **out,
+	const git_diff_prepared_blob *old_blob,
+	const git_diff_prepared_blob *new_blob,
+	const git_diff_options *opts)
+{
+	git_diff_file_content_src osrc =
+		GIT_DIFF_FILE_CONTENT_SRC__PREPARED(old_blob);
+	git_diff_file_content_src nsrc =
+		GIT_DIFF_FILE_CONTENT_SRC__PREPARED(new_blob);
+	return patch_from_sources(out, &osrc, &nsrc, opts);
+}
+
 int git_patch_from_diff(
 	git_patch **patch_ptr, git_diff *diff, size_t idx)
 {
@@ -803,6 +1143,16 @@ void git_patch__new_data(
 	*len = patch->nfile.map.len;
 }
 
+const git_diff_prepared_blob *git_patch__old_prepared(git_patch *patch)
+{
+	return patch->ofile.prepared;
+}
+
+const git_diff_prepared_blob *git_patch__new_prepared(git_patch *patch)
+{
+	return patch->nfile.prepared;
+}
+
 int git_patch__invoke_callbacks(
 	git_patch *patch,
 	git_diff_file_cb file_cb,
@@ -822,7 +1172,8 @@ int git_patch__invoke_callbacks(
 	for (i = 0; !error && i < git_array_size(patch->hunks); ++i) {
 		diff_patch_hunk *h = git_array_get(patch->hunks, i);
 
-		error = hunk_cb(patch->delta, &h->hunk, payload);
+		if (hunk_cb)
+			error = hunk_cb(patch->delta, &h->hunk, payload);
 
 		if (!line_cb)
 			continue;
@@ -20,6 +20,9 @@ extern git_diff_driver *git_patch__driver(git_patch *);
 extern void git_patch__old_data(char **, size_t *, git_patch *);
 extern void git_patch__new_data(char **, size_t *, git_patch *);
 
+extern const git_diff_prepared_blob *git_patch__old_prepared(git_patch *);
+extern const git_diff_prepared_blob *git_patch__new_prepared(git_patch *);
+
 extern int git_patch__invoke_callbacks(
 	git_patch *patch,
 	git_diff_file_cb file_cb,
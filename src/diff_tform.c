@@ -4,6 +4,8 @@
  * This file is part of libgit2, distributed under the GNU GPL v2 with
  * a Linking Exception. For full terms see the included COPYING file.
  */
+#include <stddef.h>
+
 #include "common.h"
 
 #include "git2/config.h"
@@ -280,8 +282,10 @@ static int normalize_find_opts(
 		git_repository_config__weakptr(&cfg, diff->repo) < 0)
 		return -1;
 
+	/* version 1 of the options ends before `threads` */
 	if (given)
-		memcpy(opts, given, sizeof(*opts));
+		memcpy(opts, given, given->version < 2 ?
+			offsetof(git_diff_find_options, threads) : sizeof(*opts));
 
 	if (!given ||
 		 (given->flags & GIT_DIFF_FIND_ALL) == GIT_DIFF_FIND_BY_CONFIG)
@@ -479,6 +483,54 @@ static int similarity_init(
 		info->file, &info->odb_obj, info->repo);
 }
 
+/* The signature cache of the repository, if it can hold this file's */
+static git_sigcache *similarity_sigcache(
+	git_repository *repo,
+	git_iterator_type_t src,
+	const git_diff_find_options *opts,
+	const git_diff_file *file)
+{
+	/* only the builtin metric is known to give the same signatures */
+	if (repo == NULL || repo->sigcache == NULL ||
+		src == GIT_ITERATOR_TYPE_WORKDIR ||
+		opts->metric->buffer_signature !=
+			git_diff_find_similar__hashsig_for_buf ||
+		(uintptr_t)opts->metric->payload >= GIT_SIGCACHE_OPTIONS ||
+		git_oid_iszero(&file->id))
+		return NULL;
+
+	return repo->sigcache;
+}
+
+/* Take the signature of a file from the repository's cache, if there */
+static int similarity_sig_from_cache(
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **cache,
+	size_t file_idx)
+{
+	git_diff_file *file = similarity_get_file(diff, file_idx);
+	git_sigcache *sigcache = similarity_sigcache(diff->repo,
+		(file_idx & 1) ? diff->new_src : diff->old_src, opts, file);
+	git_off_t size;
+	int error;
+
+	if (sigcache == NULL)
+		return 0;
+
+	error = git_sigcache_get((git_hashsig **)&cache[file_idx], &size,
+		sigcache, &file->id, (git_hashsig_option_t)(intptr_t)opts->metric->payload);
+
+	if (error == GIT_ENOTFOUND)
+		return 0;
+	if (error < 0)
+		return error;
+
+	/* as loading the blob would have */
+	file->size = size;
+	return 1;
+}
+
 static int similarity_sig(
 	similarity_info *info,
 	const git_diff_find_options *opts,
@@ -486,6 +538,7 @@ static int similarity_sig(
 {
 	int error = 0;
 	git_diff_file *file = info->file;
+	git_sigcache *sigcache;
 
 	if (info->src == GIT_ITERATOR_TYPE_WORKDIR) {
 		if ((error = git_buf_joinpath(
@@ -527,6 +580,13 @@ static int similarity_sig(
 			error = opts->metric->buffer_signature(
 				&cache[info->idx], info->file,
 				git_blob_rawcontent(info->blob), sz, opts->metric->payload);
+
+			if (!error && cache[info->idx] != NULL &&
+				(sigcache = similarity_sigcache(
+					info->repo, info->src, opts, file)) != NULL)
+				error = git_sigcache_put(sigcache, &file->id,
+					(git_hashsig_option_t)(intptr_t)opts->metric->payload,
+					file->size, cache[info->idx]);
 		}
 	}
 
@@ -544,6 +604,41 @@ static void similarity_unload(similarity_info *info)
 		git_buf_free(&info->data);
 }
 
+/* Load the signature of a file into the cache, if it can have one */
+static int similarity_load_sig(
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **cache,
+	size_t file_idx)
+{
+	similarity_info info;
+	int error;
+
+	if (cache[file_idx] != NULL)
+		return 0;
+
+	if ((error = similarity_sig_from_cache(diff, opts, cache, file_idx)) != 0)
+		return (error < 0) ? error : 0;
+
+	memset(&info, 0, sizeof(info));
+
+	if ((error = similarity_init(&info, diff, file_idx)) == 0)
+		error = similarity_sig(&info, opts, cache);
+
+	similarity_unload(&info);
+	return error;
+}
+
+/* check if file sizes are nowhere near each other */
+GIT_INLINE(bool) similarity_sizes_differ(
+	const git_diff_file *a_file, const git_diff_file *b_file)
+{
+	return (a_file->size > 127 &&
+		b_file->size > 127 &&
+		(a_file->size > (b_file->size << 3) ||
+		 b_file->size > (a_file->size << 3)));
+}
+
 #define FLAG_SET(opts,flag_name) (((opts)->flags & flag_name) != 0)
 
 /* - score < 0 means files cannot be compared
@@ -600,6 +695,14 @@ static int similarity_measure(
 	memset(&a_info, 0, sizeof(a_info));
 	memset(&b_info, 0, sizeof(b_info));
 
+	/* take what signatures the repository remembers */
+	if (!cache[a_idx] &&
+		(error = similarity_sig_from_cache(diff, opts, cache, a_idx)) < 0)
+		return error;
+	if (!cache[b_idx] &&
+		(error = similarity_sig_from_cache(diff, opts, cache, b_idx)) < 0)
+		return error;
+
 	/* set up similarity data (will try to update missing file sizes) */
 	if (!cache[a_idx] && (error = similarity_init(&a_info, diff, a_idx)) < 0)
 		return error;
@@ -607,10 +710,7 @@ static int similarity_measure(
 		goto cleanup;
 
 	/* check if file sizes are nowhere near each other */
-	if (a_file->size > 127 &&
-		b_file->size > 127 &&
-		(a_file->size > (b_file->size << 3) ||
-		 b_file->size > (a_file->size << 3)))
+	if (similarity_sizes_differ(a_file, b_file))
 		goto cleanup;
 
 	/* update signature cache if needed */
@@ -637,6 +737,48 @@ cleanup:
 	return error;
 }
 
+/*
+ * Measure the similarity of two files from the signatures already in the
+ * cache, as `similarity_measure` would.  Returns 0 if a file needs to be
+ * loaded for that (or the metric failed), 1 otherwise.  Nothing shared
+ * is modified, so this can run on several threads at once.
+ */
+static int similarity_measure_cached(
+	int *score,
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **cache,
+	size_t a_idx,
+	size_t b_idx)
+{
+	git_diff_file *a_file = similarity_get_file(diff, a_idx);
+	git_diff_file *b_file = similarity_get_file(diff, b_idx);
+
+	*score = -1;
+
+	if (GIT_MODE_TYPE(a_file->mode) != GIT_MODE_TYPE(b_file->mode))
+		return 1;
+
+	if (git_oid__cmp(&a_file->id, &b_file->id) == 0) {
+		*score = 100;
+		return 1;
+	}
+
+	if (!cache[a_idx] || !cache[b_idx])
+		return 0;
+
+	if (similarity_sizes_differ(a_file, b_file))
+		return 1;
+
+	if (opts->metric->similarity(
+			score, cache[a_idx], cache[b_idx], opts->metric->payload) < 0) {
+		*score = -1;
+		return 0;
+	}
+
+	return 1;
+}
+
 static int calc_self_similarity(
 	git_diff *diff,
 	const git_diff_find_options *opts,
@@ -804,19 +946,497 @@ typedef struct {
 	uint16_t similarity;
 } diff_find_match;
 
+static int exact_match_cmp(const void *a, const void *b, void *payload)
+{
+	git_diff *diff = payload;
+	size_t aidx = *(const size_t *)a, bidx = *(const size_t *)b;
+	git_diff_delta *adelta = GIT_VECTOR_GET(&diff->deltas, aidx);
+	git_diff_delta *bdelta = GIT_VECTOR_GET(&diff->deltas, bidx);
+	int cmp = git_oid__cmp(&adelta->old_file.id, &bdelta->old_file.id);
+
+	if (!cmp)
+		cmp = (aidx < bidx) ? -1 : (aidx > bidx) ? 1 : 0;
+	return cmp;
+}
+
+/*
+ * Pair the targets with the sources which have the same id before
+ * comparing any content; the pairs made here can't be beaten.  Once the
+ * sources are sorted by id, the ones with the same content as a target
+ * are next to each other.
+ */
+static int find_exact_matches(
+	git_diff *diff,
+	const git_hashsig_ids *srcs,
+	diff_find_match *tgt2src,
+	diff_find_match *src2tgt,
+	diff_find_match *tgt2src_copy)
+{
+	git_diff_delta *src, *tgt;
+	size_t t, lo, hi, mid, *s, *sorted;
+
+	sorted = git__malloc(srcs->size * sizeof(size_t));
+	GITERR_CHECK_ALLOC(sorted);
+
+	memcpy(sorted, srcs->ptr, srcs->size * sizeof(size_t));
+	git__qsort_r(sorted, srcs->size, sizeof(size_t), exact_match_cmp, diff);
+
+	git_vector_foreach(&diff->deltas, t, tgt) {
+		if ((tgt->flags & GIT_DIFF_FLAG__IS_RENAME_TARGET) == 0 ||
+			git_oid_iszero(&tgt->new_file.id))
+			continue;
+
+		/* find the first source with the id of the target */
+		for (lo = 0, hi = srcs->size; lo < hi; ) {
+			mid = lo + (hi - lo) / 2;
+			src = GIT_VECTOR_GET(&diff->deltas, sorted[mid]);
+
+			if (git_oid__cmp(&src->old_file.id, &tgt->new_file.id) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (s = &sorted[lo]; s < sorted + srcs->size; ++s) {
+			src = GIT_VECTOR_GET(&diff->deltas, *s);
+
+			if (git_oid__cmp(&src->old_file.id, &tgt->new_file.id) != 0)
+				break;
+
+			if (*s == t ||
+				GIT_MODE_TYPE(src->old_file.mode) != GIT_MODE_TYPE(tgt->new_file.mode))
+				continue;
+
+			if (tgt2src_copy != NULL && !tgt2src_copy[t].similarity) {
+				tgt2src_copy[t].idx = *s;
+				tgt2src_copy[t].similarity = 100;
+			}
+
+			if (!src2tgt[*s].similarity) {
+				tgt2src[t].idx = *s;
+				tgt2src[t].similarity = 100;
+				src2tgt[*s].idx = t;
+				src2tgt[*s].similarity = 100;
+				break;
+			}
+		}
+	}
+
+	git__free(sorted);
+	return 0;
+}
+
+/*
+ * With the internal metric, index the signatures of the sources so that
+ * each target is only compared with the sources it may be similar enough
+ * to.  Sources without a signature can't be indexed and are compared
+ * with every target.
+ */
+static int index_rename_sources(
+	git_hashsig_index **out,
+	git_hashsig_ids *unindexed,
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	const git_hashsig_ids *srcs,
+	void **sigcache)
+{
+	git_hashsig_index *index = NULL;
+	git_diff_delta *src;
+	size_t i, *s, *u;
+	int error = 0, threshold;
+
+	*out = NULL;
+
+	if (FLAG_SET(opts, GIT_DIFF_FIND_EXACT_MATCH_ONLY)) {
+		/* only sources whose id is yet to be computed need comparing */
+		for (i = 0; i < srcs->size; ++i) {
+			src = GIT_VECTOR_GET(&diff->deltas, srcs->ptr[i]);
+
+			if (git_oid_iszero(&src->old_file.id)) {
+				u = git_array_alloc(*unindexed);
+				GITERR_CHECK_ALLOC(u);
+				*u = srcs->ptr[i];
+			}
+		}
+
+		return 0;
+	}
+
+	if (opts->metric->similarity != git_diff_find_similar__calc_similarity)
+		return 0;
+
+	/* no match below the lowest threshold is ever used */
+	threshold = min(opts->rename_threshold, opts->rename_from_rewrite_threshold);
+	threshold = min(threshold, opts->copy_threshold);
+
+	if ((error = git_hashsig_index_new(&index, threshold)) < 0)
+		return error;
+
+	for (i = 0; !error && i < srcs->size; ++i) {
+		s = &srcs->ptr[i];
+
+		if ((error = similarity_load_sig(diff, opts, sigcache, 2 * *s)) < 0)
+			break;
+
+		if (sigcache[2 * *s] != NULL)
+			error = git_hashsig_index_add(index, sigcache[2 * *s], *s);
+		else if ((u = git_array_alloc(*unindexed)) == NULL)
+			error = -1;
+		else
+			*u = *s;
+	}
+
+	if (!error)
+		error = git_hashsig_index_build(index);
+
+	if (error < 0) {
+		git_hashsig_index_free(index);
+		return error;
+	}
+
+	*out = index;
+	return 0;
+}
+
+static int copy_ids(git_hashsig_ids *out, const git_hashsig_ids *ids)
+{
+	size_t i, *id;
+
+	for (i = 0; i < ids->size; ++i) {
+		id = git_array_alloc(*out);
+		GITERR_CHECK_ALLOC(id);
+		*id = ids->ptr[i];
+	}
+
+	return 0;
+}
+
+/*
+ * The sources left to compare once identical files are paired up: a
+ * source with the same contents as a target can't be beaten, so only
+ * when looking for copies (which may share a source) is it still used.
+ */
+static int unpaired_sources(
+	git_hashsig_ids *out,
+	const git_hashsig_ids *srcs,
+	const diff_find_match *src2tgt,
+	bool copies)
+{
+	size_t i, *id;
+
+	for (i = 0; i < srcs->size; ++i) {
+		if (!copies && src2tgt[srcs->ptr[i]].similarity >= 100)
+			continue;
+
+		id = git_array_alloc(*out);
+		GITERR_CHECK_ALLOC(id);
+		*id = srcs->ptr[i];
+	}
+
+	return 0;
+}
+
+static int size_t_cmp(const void *a, const void *b, void *payload)
+{
+	size_t aidx = *(const size_t *)a, bidx = *(const size_t *)b;
+	GIT_UNUSED(payload);
+	return (aidx < bidx) ? -1 : (aidx > bidx) ? 1 : 0;
+}
+
+static int candidates_for_sig(
+	git_hashsig_ids *out,
+	git_hashsig_index *index,
+	const git_hashsig_ids *srcs,
+	const git_hashsig_ids *unindexed,
+	const git_hashsig *sig)
+{
+	int error;
+
+	out->size = 0;
+
+	if (index == NULL || sig == NULL)
+		return copy_ids(out, srcs);
+
+	if ((error = git_hashsig_index_lookup(out, index, sig)) < 0 ||
+		(error = copy_ids(out, unindexed)) < 0)
+		return error;
+
+	if (unindexed->size > 0)
+		git__qsort_r(out->ptr, out->size, sizeof(size_t), size_t_cmp, NULL);
+
+	return 0;
+}
+
+/* The sources a target is to be compared with, in the order of the deltas */
+static int rename_candidates(
+	git_hashsig_ids *out,
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	git_hashsig_index *index,
+	const git_hashsig_ids *srcs,
+	const git_hashsig_ids *unindexed,
+	void **sigcache,
+	size_t t)
+{
+	git_diff_delta *tgt = GIT_VECTOR_GET(&diff->deltas, t);
+	int error;
+
+	if (FLAG_SET(opts, GIT_DIFF_FIND_EXACT_MATCH_ONLY)) {
+		out->size = 0;
+
+		if (git_oid_iszero(&tgt->new_file.id))
+			return copy_ids(out, srcs);
+		return copy_ids(out, unindexed);
+	}
+
+	if (index != NULL &&
+		(error = similarity_load_sig(diff, opts, sigcache, 2 * t + 1)) < 0)
+		return error;
+
+	return candidates_for_sig(
+		out, index, srcs, unindexed, sigcache[2 * t + 1]);
+}
+
+/* The scores of the first candidates of a target, computed ahead */
+typedef git_array_t(int) diff_find_scores;
+
+#define DIFF_FIND_NOT_SCORED INT_MIN
+
+#ifdef GIT_THREADS
+
+#define DIFF_FIND_MAX_THREADS 32
+
+/*
+ * With threads, the signatures of all the files are computed first, and
+ * then each target is scored against its candidates, every thread taking
+ * the next file or target in turn.  The matching itself stays on the
+ * calling thread, which takes the scores in the order it would have
+ * computed them, so the result is the same as without threads.  Whatever
+ * a thread could not do is done again by the calling thread, which is the
+ * one reporting errors.
+ */
+typedef struct {
+	git_diff *diff;
+	const git_diff_find_options *opts;
+	void **sigcache;
+	git_hashsig_index *index;
+	const git_hashsig_ids *srcs;
+	const git_hashsig_ids *unindexed;
+	const diff_find_match *src2tgt;
+	bool copies;
+	diff_find_scores *scores;
+
+	git_hashsig_ids items; /* the files to sign or targets to score */
+	git_atomic next;
+} diff_find_threads;
+
+static void *diff_find_sign_thread(void *payload)
+{
+	diff_find_threads *work = payload;
+	size_t count = work->items.size, i;
+
+	while ((i = (size_t)git_atomic_inc(&work->next) - 1) < count)
+		(void)similarity_load_sig(
+			work->diff, work->opts, work->sigcache, work->items.ptr[i]);
+
+	/* failures are found again when the signatures are needed */
+	giterr_clear();
+
+	return NULL;
+}
+
+static void diff_find_score_target(
+	diff_find_threads *work, git_hashsig_ids *candidates, size_t t)
+{
+	const git_hashsig *sig = work->sigcache[2 * t + 1];
+	diff_find_scores *scores = &work->scores[t];
+	size_t c, s, tried_srcs = 0;
+	int result, *score;
+
+	/* the candidates depend on the signature of the target */
+	if (work->index != NULL && sig == NULL)
+		return;
+
+	if (candidates_for_sig(candidates,
+			work->index, work->srcs, work->unindexed, sig) < 0)
+		return;
+
+	/* stop where the matching would (if no source is taken meanwhile) */
+	for (c = 0; c < candidates->size; ++c) {
+		s = candidates->ptr[c];
+
+		if ((score = git_array_alloc(*scores)) == NULL)
+			return;
+		*score = DIFF_FIND_NOT_SCORED;
+
+		if (s == t || (!work->copies && work->src2tgt[s].similarity >= 100))
+			continue;
+
+		if (similarity_measure_cached(&result, work->diff, work->opts,
+				work->sigcache, 2 * s, 2 * t + 1) > 0) {
+			*score = result;
+
+			if (result >= 0 && ++tried_srcs > work->opts->rename_limit)
+				break;
+		}
+	}
+}
+
+static void *diff_find_score_thread(void *payload)
+{
+	diff_find_threads *work = payload;
+	git_hashsig_ids candidates = GIT_ARRAY_INIT;
+	size_t count = work->items.size, i;
+
+	while ((i = (size_t)git_atomic_inc(&work->next) - 1) < count)
+		diff_find_score_target(work, &candidates, work->items.ptr[i]);
+
+	git_array_clear(candidates);
+	giterr_clear();
+
+	return NULL;
+}
+
+static void diff_find_threads_run(
+	diff_find_threads *work, void *(*thread_fn)(void *))
+{
+	git_thread threads[DIFF_FIND_MAX_THREADS];
+	size_t nthreads = min(work->opts->threads, DIFF_FIND_MAX_THREADS);
+	size_t started, i;
+
+	if (nthreads > work->items.size)
+		nthreads = work->items.size;
+
+	git_atomic_set(&work->next, 0);
+
+	for (started = 0; started + 1 < nthreads; ++started)
+		if (git_thread_create(&threads[started], NULL, thread_fn, work) != 0)
+			break;
+
+	/* this thread takes its share too */
+	thread_fn(work);
+
+	for (i = 0; i < started; ++i)
+		git_thread_join(threads[i], NULL);
+}
+
+static int diff_find_add_item(diff_find_threads *work, size_t item)
+{
+	size_t *i = git_array_alloc(work->items);
+	GITERR_CHECK_ALLOC(i);
+	*i = item;
+	return 0;
+}
+
+/* Compute the signatures of all the sources and targets */
+static int find_similar_sign_threaded(
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **sigcache,
+	const git_hashsig_ids *srcs,
+	const diff_find_match *tgt2src)
+{
+	diff_find_threads work;
+	git_diff_delta *tgt;
+	git_odb *odb;
+	size_t i, t;
+	int error = 0;
+
+	memset(&work, 0, sizeof(work));
+	work.diff = diff;
+	work.opts = opts;
+	work.sigcache = sigcache;
+
+	/* set up the object database before the threads need it */
+	if (diff->repo != NULL &&
+		(error = git_repository_odb__weakptr(&odb, diff->repo)) < 0)
+		return error;
+
+	for (i = 0; !error && i < srcs->size; ++i)
+		error = diff_find_add_item(&work, 2 * srcs->ptr[i]);
+
+	git_vector_foreach(&diff->deltas, t, tgt) {
+		if (error < 0)
+			break;
+
+		if ((tgt->flags & GIT_DIFF_FLAG__IS_RENAME_TARGET) != 0 &&
+			tgt2src[t].similarity < 100)
+			error = diff_find_add_item(&work, 2 * t + 1);
+	}
+
+	if (!error)
+		diff_find_threads_run(&work, diff_find_sign_thread);
+
+	git_array_clear(work.items);
+	return error;
+}
+
+/* Score each target against its first candidates */
+static int find_similar_score_threaded(
+	diff_find_scores **out,
+	git_diff *diff,
+	const git_diff_find_options *opts,
+	void **sigcache,
+	git_hashsig_index *index,
+	const git_hashsig_ids *srcs,
+	const git_hashsig_ids *unindexed,
+	const diff_find_match *tgt2src,
+	const diff_find_match *src2tgt,
+	bool copies)
+{
+	diff_find_threads work;
+	git_diff_delta *tgt;
+	size_t t;
+	int error = 0;
+
+	memset(&work, 0, sizeof(work));
+	work.diff = diff;
+	work.opts = opts;
+	work.sigcache = sigcache;
+	work.index = index;
+	work.srcs = srcs;
+	work.unindexed = unindexed;
+	work.src2tgt = src2tgt;
+	work.copies = copies;
+
+	work.scores = git__calloc(diff->deltas.length, sizeof(diff_find_scores));
+	GITERR_CHECK_ALLOC(work.scores);
+
+	git_vector_foreach(&diff->deltas, t, tgt) {
+		if ((tgt->flags & GIT_DIFF_FLAG__IS_RENAME_TARGET) != 0 &&
+			tgt2src[t].similarity < 100 &&
+			(error = diff_find_add_item(&work, t)) < 0)
+			break;
+	}
+
+	if (!error)
+		diff_find_threads_run(&work, diff_find_score_thread);
+
+	git_array_clear(work.items);
+	*out = work.scores;
+	return error;
+}
+
+#endif
+
 int git_diff_find_similar(
 	git_diff *diff,
 	const git_diff_find_options *given_opts)
 {
-	size_t s, t;
+	size_t s, t, c, *srcp;
 	int error = 0, result;
 	uint16_t similarity;
 	git_diff_delta *src, *tgt;
 	git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
-	size_t num_deltas, num_srcs = 0, num_tgts = 0;
+	size_t num_deltas, num_srcs = 0, num_tgts = 0, num_unpaired = 0;
 	size_t tried_srcs = 0, tried_tgts = 0;
 	size_t num_rewrites = 0, num_updates = 0, num_bumped = 0;
 	void **sigcache = NULL; /* cache of similarity metric file signatures */
+	git_hashsig_index *index = NULL;
+	git_hashsig_ids srcs = GIT_ARRAY_INIT, unindexed = GIT_ARRAY_INIT;
+	git_hashsig_ids unpaired = GIT_ARRAY_INIT; /* sources left to compare */
+	git_hashsig_ids candidates = GIT_ARRAY_INIT;
+	diff_find_scores *scores = NULL; /* computed ahead on other threads */
 	diff_find_match *tgt2src = NULL;
 	diff_find_match *src2tgt = NULL;
 	diff_find_match *tgt2src_copy = NULL;
@@ -828,7 +1448,6 @@ int git_diff_find_similar(
 
 	num_deltas = diff->deltas.length;
 
-	/* TODO: maybe abort if deltas.length > rename_limit ??? */
 	if (!git__is_uint32(num_deltas))
 		goto cleanup;
 
@@ -845,8 +1464,12 @@ int git_diff_find_similar(
 	 * mark them for splitting if break-rewrites is enabled
 	 */
 	git_vector_foreach(&diff->deltas, t, tgt) {
-		if (is_rename_source(diff, &opts, t, sigcache))
+		if (is_rename_source(diff, &opts, t, sigcache)) {
+			srcp = git_array_alloc(srcs);
+			GITERR_CHECK_ALLOC(srcp);
+			*srcp = t;
 			++num_srcs;
+		}
 
 		if (is_rename_target(diff, &opts, t, sigcache))
 			++num_tgts;
@@ -869,6 +1492,45 @@ int git_diff_find_similar(
 		GITERR_CHECK_ALLOC(tgt2src_copy);
 	}
 
+	/*
+	 * Pair up the files with identical contents; only the remaining ones
+	 * need their contents compared, and only to plausible candidates
+	 */
+
+	if ((error = find_exact_matches(
+			diff, &srcs, tgt2src, src2tgt, tgt2src_copy)) < 0 ||
+		(error = unpaired_sources(
+			&unpaired, &srcs, src2tgt, tgt2src_copy != NULL)) < 0)
+		goto cleanup;
+
+	git_vector_foreach(&diff->deltas, t, tgt) {
+		if ((tgt->flags & GIT_DIFF_FLAG__IS_RENAME_TARGET) != 0 &&
+			tgt2src[t].similarity < 100)
+			++num_unpaired;
+	}
+
+	/* with every target paired (a pure rename), no contents are loaded */
+	if (!num_unpaired || !unpaired.size)
+		goto find_best_matches;
+
+#ifdef GIT_THREADS
+	if (opts.threads > 1 && !FLAG_SET(&opts, GIT_DIFF_FIND_EXACT_MATCH_ONLY) &&
+		(error = find_similar_sign_threaded(
+			diff, &opts, sigcache, &unpaired, tgt2src)) < 0)
+		goto cleanup;
+#endif
+
+	if ((error = index_rename_sources(
+			&index, &unindexed, diff, &opts, &unpaired, sigcache)) < 0)
+		goto cleanup;
+
+#ifdef GIT_THREADS
+	if (opts.threads > 1 && !FLAG_SET(&opts, GIT_DIFF_FIND_EXACT_MATCH_ONLY) &&
+		(error = find_similar_score_threaded(&scores, diff, &opts, sigcache,
+			index, &unpaired, &unindexed, tgt2src, src2tgt, tgt2src_copy != NULL)) < 0)
+		goto cleanup;
+#endif
+
 	/*
 	 * Find best-fit matches for rename / copy candidates
 	 */
@@ -881,16 +1543,29 @@ find_best_matches:
 		if ((tgt->flags & GIT_DIFF_FLAG__IS_RENAME_TARGET) == 0)
 			continue;
 
+		/* nothing beats a source with the same contents */
+		if (tgt2src[t].similarity >= 100)
+			goto next_target;
+
+		if ((error = rename_candidates(&candidates, diff, &opts,
+				index, &unpaired, &unindexed, sigcache, t)) < 0)
+			goto cleanup;
+
 		tried_srcs = 0;
 
-		git_vector_foreach(&diff->deltas, s, src) {
-			/* skip things that are not rename sources */
-			if ((src->flags & GIT_DIFF_FLAG__IS_RENAME_SOURCE) == 0)
+		for (c = 0; c < candidates.size; ++c) {
+			s = candidates.ptr[c];
+
+			/* a source with the same contents as another target is taken */
+			if (!tgt2src_copy && src2tgt[s].similarity >= 100)
 				continue;
 
 			/* calculate similarity for this pair and find best match */
 			if (s == t)
 				result = -1; /* don't measure self-similarity here */
+			else if (scores != NULL && c < scores[t].size &&
+				scores[t].ptr[c] != DIFF_FIND_NOT_SCORED)
+				result = scores[t].ptr[c];
 			else if ((error = similarity_measure(
 				&result, diff, &opts, sigcache, 2 * s, 2 * t + 1)) < 0)
 				goto cleanup;
@@ -928,14 +1603,12 @@ find_best_matches:
 				tgt2src_copy[t].similarity = similarity;
 			}
 
-			if (++tried_srcs >= num_srcs)
-				break;
-
-			/* cap on maximum targets we'll examine (per "tgt" file) */
-			if (tried_srcs > opts.rename_limit)
+			/* cap on maximum sources we'll examine (per "tgt" file) */
+			if (++tried_srcs > opts.rename_limit)
 				break;
 		}
 
+next_target:
 		if (++tried_tgts >= num_tgts)
 			break;
 	}
@@ -1104,11 +1777,28 @@ find_best_matches:
 			FLAG_SET(&opts, GIT_DIFF_BREAK_REWRITES) &&
 			!FLAG_SET(&opts, GIT_DIFF_BREAK_REWRITES_FOR_RENAMES_ONLY));
 
+	/* saving the signatures for later diffs is only a best effort */
+	if (!error && diff->repo != NULL && diff->repo->sigcache != NULL &&
+		git_sigcache_save(diff->repo->sigcache) < 0)
+		giterr_clear();
+
 cleanup:
 	git__free(tgt2src);
 	git__free(src2tgt);
 	git__free(tgt2src_copy);
 
+	if (scores) {
+		for (t = 0; t < num_deltas; ++t)
+			git_array_clear(scores[t]);
+		git__free(scores);
+	}
+
+	git_hashsig_index_free(index);
+	git_array_clear(srcs);
+	git_array_clear(unpaired);
+	git_array_clear(unindexed);
+	git_array_clear(candidates);
+
 	if (sigcache) {
 		for (t = 0; t < num_deltas * 2; ++t) {
 			if (sigcache[t] != NULL)
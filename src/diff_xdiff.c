@@ -9,6 +9,7 @@
 #include "diff_driver.h"
 #include "diff_patch.h"
 #include "diff_xdiff.h"
+#include "git2/blob.h"
 
 static int git_xdiff_scan_int(const char **str, int *value)
 {
@@ -180,6 +181,11 @@ static int git_xdiff_cb(void *priv, mmbuffer_t *bufs, int len)
 	return output->error;
 }
 
+static const mmlines_t *prepared_lines(const git_diff_prepared_blob *prepared)
+{
+	return prepared ? &prepared->lines : NULL;
+}
+
 static int git_xdiff(git_diff_output *output, git_patch *patch)
 {
 	git_xdiff_output *xo = (git_xdiff_output *)output;
@@ -208,9 +214,14 @@ static int git_xdiff(git_diff_output *output, git_patch *patch)
 	git_patch__old_data(&info.xd_old_data.ptr, &info.xd_old_data.size, patch);
 	git_patch__new_data(&info.xd_new_data.ptr, &info.xd_new_data.size, patch);
 
+	xo->params.lines1 = prepared_lines(git_patch__old_prepared(patch));
+	xo->params.lines2 = prepared_lines(git_patch__new_prepared(patch));
+
 	xdl_diff(&info.xd_old_data, &info.xd_new_data,
 		&xo->params, &xo->config, &xo->callback);
 
+	xo->params.lines1 = xo->params.lines2 = NULL;
+
 	git_diff_find_context_clear(&findctxt);
 
 	return xo->output.error;
@@ -239,3 +250,65 @@ void git_xdiff_init(git_xdiff_output *xo, const git_diff_options *opts)
 
 	xo->callback.outf = git_xdiff_cb;
 }
+
+int git_diff_prepared_blob_new(
+	git_diff_prepared_blob **out,
+	const git_blob *blob,
+	const char *as_path,
+	const git_diff_options *opts)
+{
+	git_diff_prepared_blob *prepared;
+	git_xdiff_output xo;
+	git_diff_options given;
+	mmfile_t file;
+
+	assert(out);
+	*out = NULL;
+
+	GITERR_CHECK_VERSION(opts, GIT_DIFF_OPTIONS_VERSION, "git_diff_options");
+
+	if (opts) {
+		git_diff__copy_options(&given, opts);
+		opts = &given;
+	}
+
+	prepared = git__calloc(1, sizeof(git_diff_prepared_blob));
+	GITERR_CHECK_ALLOC(prepared);
+
+	if (as_path && (prepared->path = git__strdup(as_path)) == NULL)
+		goto on_error;
+
+	if (blob && git_object_dup(
+			(git_object **)&prepared->blob, (git_object *)blob) < 0)
+		goto on_error;
+
+	/* the lines are hashed with the flags the diffs will use */
+	memset(&xo, 0, sizeof(xo));
+	git_xdiff_init(&xo, opts);
+
+	file.ptr  = blob ? (char *)git_blob_rawcontent(blob) : NULL;
+	file.size = blob ? (size_t)git_blob_rawsize(blob) : 0;
+
+	if (xdl_prepare_lines(&file, xo.params.flags, &prepared->lines) < 0) {
+		giterr_set_oom();
+		goto on_error;
+	}
+
+	*out = prepared;
+	return 0;
+
+on_error:
+	git_diff_prepared_blob_free(prepared);
+	return -1;
+}
+
+void git_diff_prepared_blob_free(git_diff_prepared_blob *prepared)
+{
+	if (prepared == NULL)
+		return;
+
+	xdl_free_lines(&prepared->lines);
+	git_blob_free(prepared->blob);
+	git__free(prepared->path);
+	git__free(prepared);
+}
@@ -25,4 +25,13 @@ typedef struct {
 
 void git_xdiff_init(git_xdiff_output *xo, const git_diff_options *opts);
 
+/* A prepared blob keeps the lines of the blob as xdiff splits and hashes
+ * them, which git_xdiff() hands to xdiff for it not to do it again.
+ */
+struct git_diff_prepared_blob {
+	git_blob *blob;
+	char *path;
+	mmlines_t lines;
+};
+
 #endif
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "ewah.h"
+
+static uint32_t read_u32(const char *buffer)
+{
+	uint32_t val;
+	memcpy(&val, buffer, sizeof(val));
+	return ntohl(val);
+}
+
+static uint64_t read_u64(const char *buffer)
+{
+	return ((uint64_t)read_u32(buffer) << 32) | read_u32(buffer + 4);
+}
+
+static int write_u32(git_buf *out, uint32_t val)
+{
+	val = htonl(val);
+	return git_buf_put(out, (char *)&val, sizeof(val));
+}
+
+static int write_u64(git_buf *out, uint64_t val)
+{
+	if (write_u32(out, (uint32_t)(val >> 32)) < 0)
+		return -1;
+	return write_u32(out, (uint32_t)(val & 0xffffffff));
+}
+
+int git_ewah_read(
+	git_bitvec *bits, size_t nbits, const char **buffer, const char *end)
+{
+	const char *ptr = *buffer, *words;
+	size_t word_count, i = 0, bit = 0, j, k;
+
+	if (end - ptr < 8)
+		return -1;
+
+	/* the bit count is informational only */
+	word_count = read_u32(ptr + 4);
+	ptr += 8;
+
+	if ((size_t)(end - ptr) / 8 < word_count ||
+		(size_t)(end - ptr) - word_count * 8 < 4)
+		return -1;
+
+	words = ptr;
+	ptr += word_count * 8 + 4;
+
+	while (i < word_count) {
+		uint64_t rlw = read_u64(words + 8 * i++);
+		size_t run_len = (size_t)((rlw >> 1) & 0xffffffff);
+		size_t literals = (size_t)(rlw >> 33);
+
+		if (run_len > (SIZE_MAX - bit) / 64 || literals > word_count - i)
+			return -1;
+
+		if (rlw & 1) {
+			if (bit + run_len * 64 > nbits && run_len > 0)
+				return -1;
+
+			for (j = 0; j < run_len * 64; ++j)
+				git_bitvec_set(bits, bit + j, true);
+		}
+		bit += run_len * 64;
+
+		for (j = 0; j < literals; ++j, bit += 64) {
+			uint64_t word = read_u64(words + 8 * i++);
+
+			for (k = 0; word != 0; ++k, word >>= 1) {
+				if (!(word & 1))
+					continue;
+				if (bit + k >= nbits)
+					return -1;
+				git_bitvec_set(bits, bit + k, true);
+			}
+		}
+	}
+
+	*buffer = ptr;
+	return 0;
+}
+
+/* write a bitmap as a single run length word followed by literals */
+int git_ewah_write(git_buf *out, git_bitvec *bits, size_t nbits)
+{
+	size_t bit_size = 0, words, i, j;
+
+	for (i = nbits; i > 0; --i) {
+		if (git_bitvec_get(bits, i - 1)) {
+			bit_size = i;
+			break;
+		}
+	}
+
+	words = (bit_size + 63) / 64;
+
+	write_u32(out, (uint32_t)bit_size);
+	write_u32(out, (uint32_t)(words + 1));
+	write_u64(out, (uint64_t)words << 33);
+
+	for (i = 0; i < words; ++i) {
+		uint64_t word = 0;
+
+		for (j = 0; j < 64 && i * 64 + j < bit_size; ++j)
+			if (git_bitvec_get(bits, i * 64 + j))
+				word |= ((uint64_t)1 << j);
+
+		write_u64(out, word);
+	}
+
+	/* position of the last run length word */
+	write_u32(out, 0);
+
+	return git_buf_oom(out) ? -1 : 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_ewah_h__
+#define INCLUDE_ewah_h__
+
+#include "common.h"
+#include "buffer.h"
+#include "bitvec.h"
+
+/*
+ * EWAH compressed bitmaps, as used by core git in index extensions: a
+ * 32-bit bit count and 32-bit word count, followed by the 64-bit words
+ * and the 32-bit position of the last "run length word".  Each run length
+ * word holds a running bit (bit 0), the number of 64-bit words that are
+ * all equal to the running bit (bits 1-32) and the number of literal
+ * words that follow it (bits 33-63).
+ */
+
+/*
+ * Parse the bitmap at `*buffer` into `bits`, which must be able to hold
+ * `nbits` bits; a bitmap with bits set beyond that is rejected.  On
+ * success, `*buffer` is advanced past the bitmap.  Returns -1 without
+ * setting an error message if the data is invalid.
+ */
+extern int git_ewah_read(
+	git_bitvec *bits, size_t nbits, const char **buffer, const char *end);
+
+/* Append the first `nbits` bits of `bits` to `out` as an EWAH bitmap */
+extern int git_ewah_write(git_buf *out, git_bitvec *bits, size_t nbits);
+
+#endif
@@ -811,13 +811,14 @@ int git_futils_filestamp_check(
 		return GIT_ENOTFOUND;
 
 	if (stamp->mtime == (git_time_t)st.st_mtime &&
+#if defined(GIT_USE_NSEC)
+		stamp->mtime_nsec == (unsigned int)st.st_mtime_nsec &&
+#endif
 		stamp->size  == (git_off_t)st.st_size   &&
 		stamp->ino   == (unsigned int)st.st_ino)
 		return 0;
 
-	stamp->mtime = (git_time_t)st.st_mtime;
-	stamp->size  = (git_off_t)st.st_size;
-	stamp->ino   = (unsigned int)st.st_ino;
+	git_futils_filestamp_set_from_stat(stamp, &st);
 
 	return 1;
 }
@@ -839,6 +840,11 @@ void git_futils_filestamp_set_from_stat(
 {
 	if (st) {
 		stamp->mtime = (git_time_t)st->st_mtime;
+#if defined(GIT_USE_NSEC)
+		stamp->mtime_nsec = (unsigned int)st->st_mtime_nsec;
+#else
+		stamp->mtime_nsec = 0;
+#endif
 		stamp->size  = (git_off_t)st->st_size;
 		stamp->ino   = (unsigned int)st->st_ino;
 	} else {
@@ -286,6 +286,7 @@ extern int git_futils_fake_symlink(const char *new, const char *old);
  */
 typedef struct {
 	git_time_t mtime;
+	unsigned int mtime_nsec;
 	git_off_t  size;
 	unsigned int ino;
 } git_futils_filestamp;
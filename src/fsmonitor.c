@@ -0,0 +1,505 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "common.h"
+#include "buffer.h"
+#include "path.h"
+#include "posix.h"
+#include "vector.h"
+#include "strmap.h"
+#include "git2/sys/fsmonitor.h"
+
+int git_fsmonitor_init(git_fsmonitor *fsmonitor, unsigned int version)
+{
+	GIT_INIT_STRUCTURE_FROM_TEMPLATE(
+		fsmonitor, version, git_fsmonitor, GIT_FSMONITOR_INIT);
+	return 0;
+}
+
+#ifdef GIT_USE_INOTIFY
+
+#include <sys/inotify.h>
+
+GIT__USE_STRMAP;
+
+#define INOTIFY_TOKEN_PREFIX "libgit2-inotify:"
+
+#define INOTIFY_WATCH_MASK \
+	(IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | \
+	 IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | \
+	 IN_DONT_FOLLOW | IN_ONLYDIR)
+
+/* bound on the number of changed paths that are remembered; past it,
+ * they are forgotten and only newer tokens can be answered for */
+#define INOTIFY_MAX_CHANGES 65536
+
+typedef struct {
+	int wd;
+	char path[GIT_FLEX_ARRAY]; /* "" for the root, else with a trailing '/' */
+} inotify_watch;
+
+typedef struct {
+	uint64_t seq; /* the query that last saw the path change */
+	char path[GIT_FLEX_ARRAY];
+} inotify_change;
+
+typedef struct {
+	git_fsmonitor parent;
+	git_mutex lock;
+	int fd;
+	git_buf workdir;     /* with a trailing slash */
+	git_buf instance;    /* token prefix, unique to this monitor */
+	git_vector watches;  /* of inotify_watch, by watch descriptor */
+	git_strmap *changes; /* path to inotify_change */
+	uint64_t seq;        /* the last token handed out */
+	uint64_t oldest;     /* the oldest token we can still answer for */
+	bool broken;         /* a directory could not be watched */
+} inotify_monitor;
+
+static int inotify_watch_cmp(const void *a, const void *b)
+{
+	const inotify_watch *watch_a = a, *watch_b = b;
+	return (watch_a->wd < watch_b->wd) ? -1 : (watch_a->wd > watch_b->wd);
+}
+
+static int inotify_watch_srch(const void *key, const void *item)
+{
+	int wd = *(const int *)key;
+	const inotify_watch *watch = item;
+	return (wd < watch->wd) ? -1 : (wd > watch->wd);
+}
+
+static inotify_watch *inotify_watch_find(
+	size_t *pos, inotify_monitor *m, int wd)
+{
+	if (git_vector_bsearch2(pos, &m->watches, inotify_watch_srch, &wd) < 0)
+		return NULL;
+
+	return git_vector_get(&m->watches, *pos);
+}
+
+GIT_INLINE(bool) inotify_is_dotgit(const git_buf *path)
+{
+	size_t len = path->size;
+
+	if (len > 0 && path->ptr[len - 1] == '/')
+		len--;
+
+	return (len >= 4 && !strncmp(path->ptr + len - 4, ".git", 4) &&
+		(len == 4 || path->ptr[len - 5] == '/'));
+}
+
+/* start watching one directory, given by its full path */
+static int inotify_watch_one(inotify_monitor *m, git_buf *path)
+{
+	inotify_watch *watch, *existing;
+	const char *rel = path->ptr + m->workdir.size;
+	size_t rel_len = path->size - m->workdir.size, pos;
+	int wd;
+
+	if ((wd = inotify_add_watch(m->fd, path->ptr, INOTIFY_WATCH_MASK)) < 0) {
+		/* the directory is already gone again; we'll hear about that */
+		if (errno == ENOENT || errno == ENOTDIR)
+			return 0;
+
+		giterr_set(GITERR_OS, "Failed to watch directory '%s'", path->ptr);
+		return -1;
+	}
+
+	watch = git__calloc(1, sizeof(inotify_watch) + rel_len + 2);
+	GITERR_CHECK_ALLOC(watch);
+
+	watch->wd = wd;
+	memcpy(watch->path, rel, rel_len);
+	if (rel_len > 0 && rel[rel_len - 1] != '/')
+		watch->path[rel_len] = '/';
+
+	/* watching a directory twice yields the same descriptor */
+	if ((existing = inotify_watch_find(&pos, m, wd)) != NULL) {
+		git__free(existing);
+		m->watches.contents[pos] = watch;
+		return 0;
+	}
+
+	if (git_vector_insert_sorted(&m->watches, watch, NULL) < 0) {
+		git__free(watch);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int inotify_watch_tree(inotify_monitor *m, git_buf *path);
+
+static int inotify_watch_tree_cb(void *payload, git_buf *path)
+{
+	struct stat st;
+
+	if (p_lstat(path->ptr, &st) < 0 || !S_ISDIR(st.st_mode) ||
+		inotify_is_dotgit(path))
+		return 0;
+
+	return inotify_watch_tree((inotify_monitor *)payload, path);
+}
+
+/* watch a directory and everything beneath it */
+static int inotify_watch_tree(inotify_monitor *m, git_buf *path)
+{
+	int error;
+
+	if ((error = inotify_watch_one(m, path)) < 0)
+		return error;
+
+	/* the directory may vanish while we look into it */
+	if ((error = git_path_direach(path, 0, inotify_watch_tree_cb, m)) < 0 &&
+		!git_path_isdir(path->ptr)) {
+		giterr_clear();
+		error = 0;
+	}
+
+	return error;
+}
+
+typedef struct {
+	inotify_monitor *m;
+	const char *prefix;
+} inotify_unwatch_data;
+
+static int inotify_unwatch_match(
+	const git_vector *watches, size_t idx, void *payload)
+{
+	inotify_unwatch_data *data = payload;
+	inotify_watch *watch = git_vector_get(watches, idx);
+
+	if (git__prefixcmp(watch->path, data->prefix) != 0)
+		return 0;
+
+	inotify_rm_watch(data->m->fd, watch->wd);
+	git__free(watch);
+	return 1;
+}
+
+/* stop watching a directory (relative, with a trailing slash) and
+ * everything beneath it */
+static void inotify_unwatch_tree(inotify_monitor *m, const char *dir)
+{
+	inotify_unwatch_data data;
+
+	data.m = m;
+	data.prefix = dir;
+
+	git_vector_remove_matching(&m->watches, inotify_unwatch_match, &data);
+}
+
+static void inotify_forget_changes(inotify_monitor *m)
+{
+	inotify_change *change;
+
+	git_strmap_foreach_value(m->changes, change, {
+		git__free(change);
+	});
+	git_strmap_clear(m->changes);
+
+	m->oldest = m->seq;
+}
+
+static int inotify_record(inotify_monitor *m, const char *path)
+{
+	inotify_change *change;
+	khiter_t pos;
+	size_t path_len = strlen(path);
+	int error;
+
+	pos = git_strmap_lookup_index(m->changes, path);
+
+	if (git_strmap_valid_index(m->changes, pos)) {
+		change = git_strmap_value_at(m->changes, pos);
+		change->seq = m->seq;
+		return 0;
+	}
+
+	if (git_strmap_num_entries(m->changes) >= INOTIFY_MAX_CHANGES)
+		inotify_forget_changes(m);
+
+	change = git__calloc(1, sizeof(inotify_change) + path_len + 1);
+	GITERR_CHECK_ALLOC(change);
+
+	change->seq = m->seq;
+	memcpy(change->path, path, path_len);
+
+	git_strmap_insert(m->changes, change->path, change, error);
+
+	if (error < 0) {
+		git__free(change);
+		giterr_set_oom();
+		return -1;
+	}
+
+	return 0;
+}
+
+/* events were lost, so anything may have changed (and new directories
+ * may not be watched yet) */
+static int inotify_rewatch(inotify_monitor *m)
+{
+	git_buf path = GIT_BUF_INIT;
+	int error;
+
+	inotify_forget_changes(m);
+
+	if (!(error = git_buf_set(&path, m->workdir.ptr, m->workdir.size)))
+		error = inotify_watch_tree(m, &path);
+
+	git_buf_free(&path);
+	return error;
+}
+
+static int inotify_process(inotify_monitor *m, const struct inotify_event *ev)
+{
+	inotify_watch *watch;
+	git_buf path = GIT_BUF_INIT, full = GIT_BUF_INIT;
+	size_t pos;
+	int error = 0;
+
+	if ((ev->mask & IN_Q_OVERFLOW) != 0)
+		return inotify_rewatch(m);
+
+	if ((watch = inotify_watch_find(&pos, m, ev->wd)) == NULL)
+		return 0;
+
+	if ((ev->mask & IN_IGNORED) != 0) {
+		git_vector_remove(&m->watches, pos);
+		git__free(watch);
+		return 0;
+	}
+
+	if (git_buf_puts(&path, watch->path) < 0 ||
+		(ev->len > 0 && git_buf_puts(&path, ev->name) < 0))
+		goto fail;
+
+	/* a directory coming or going affects everything beneath it */
+	if (ev->len > 0 && (ev->mask & IN_ISDIR) != 0) {
+		if (git_buf_putc(&path, '/') < 0)
+			goto fail;
+
+		if ((ev->mask & IN_MOVED_FROM) != 0)
+			inotify_unwatch_tree(m, path.ptr);
+
+		else if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) != 0 &&
+			!inotify_is_dotgit(&path)) {
+			if (git_buf_joinpath(&full, m->workdir.ptr, path.ptr) < 0)
+				goto fail;
+			error = inotify_watch_tree(m, &full);
+		}
+	}
+
+	if (!error)
+		error = inotify_record(m, path.ptr);
+
+	git_buf_free(&path);
+	git_buf_free(&full);
+	return error;
+
+fail:
+	git_buf_free(&path);
+	git_buf_free(&full);
+	return -1;
+}
+
+static int inotify_drain(inotify_monitor *m)
+{
+	union {
+		struct inotify_event event;
+		char data[4096];
+	} buf;
+	const struct inotify_event *ev;
+	ssize_t len, offset;
+	int error = 0;
+
+	while (!error) {
+		if ((len = read(m->fd, buf.data, sizeof(buf.data))) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+
+			giterr_set(GITERR_OS, "Failed to read file system events");
+			return -1;
+		}
+
+		for (offset = 0; !error && offset < len;
+			offset += sizeof(struct inotify_event) + ev->len) {
+			ev = (const struct inotify_event *)(buf.data + offset);
+			error = inotify_process(m, ev);
+		}
+	}
+
+	return error;
+}
+
+static bool inotify_parse_token(
+	uint64_t *out, inotify_monitor *m, const char *token)
+{
+	int64_t seq;
+	const char *end;
+
+	if (!token || git__prefixcmp(token, m->instance.ptr) != 0)
+		return false;
+
+	token += m->instance.size;
+
+	if (git__strtol64(&seq, token, &end, 10) < 0 || *end || seq < 0) {
+		giterr_clear();
+		return false;
+	}
+
+	*out = (uint64_t)seq;
+	return true;
+}
+
+static int inotify_query(
+	git_buf *token_out,
+	git_fsmonitor *fsmonitor,
+	const char *token,
+	git_fsmonitor_changed_cb changed_cb,
+	void *payload)
+{
+	inotify_monitor *m = (inotify_monitor *)fsmonitor;
+	inotify_change *change;
+	uint64_t since = 0;
+	bool known;
+	int error = 0;
+
+	if (git_mutex_lock(&m->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to lock file system monitor");
+		return -1;
+	}
+
+	/* changes seen from now on are newer than the token handed out by
+	 * any earlier query */
+	m->seq++;
+
+	/* once a directory could not be watched, we can't vouch for anything
+	 * until the whole tree is being watched again; rewatching forgets
+	 * every change, so no earlier token is trusted */
+	if (m->broken) {
+		if (inotify_rewatch(m) < 0)
+			giterr_clear();
+		else
+			m->broken = false;
+	}
+
+	if (!m->broken && (error = inotify_drain(m)) < 0)
+		m->broken = true;
+
+	known = !m->broken && inotify_parse_token(&since, m, token) &&
+		since >= m->oldest && since < m->seq;
+
+	if (known) {
+		git_strmap_foreach_value(m->changes, change, {
+			if (change->seq > since &&
+				(error = changed_cb(change->path, payload)) != 0)
+				break;
+		});
+	}
+
+	git_buf_clear(token_out);
+	git_buf_printf(token_out, "%s%" PRIu64, m->instance.ptr, m->seq);
+
+	if (git_buf_oom(token_out))
+		error = -1;
+	else if (!error && !known)
+		error = GIT_ENOTFOUND;
+
+	git_mutex_unlock(&m->lock);
+	return error;
+}
+
+static void inotify_free(git_fsmonitor *fsmonitor)
+{
+	inotify_monitor *m = (inotify_monitor *)fsmonitor;
+	inotify_watch *watch;
+	size_t i;
+
+	if (m->fd >= 0)
+		p_close(m->fd);
+
+	git_vector_foreach(&m->watches, i, watch)
+		git__free(watch);
+	git_vector_free(&m->watches);
+
+	if (m->changes) {
+		inotify_forget_changes(m);
+		git_strmap_free(m->changes);
+	}
+
+	git_buf_free(&m->workdir);
+	git_buf_free(&m->instance);
+	git_mutex_free(&m->lock);
+	git__free(m);
+}
+
+int git_fsmonitor_inotify_new(git_fsmonitor **out, const char *workdir)
+{
+	inotify_monitor *m;
+	git_buf path = GIT_BUF_INIT;
+	int error;
+
+	assert(out && workdir);
+
+	*out = NULL;
+
+	m = git__calloc(1, sizeof(inotify_monitor));
+	GITERR_CHECK_ALLOC(m);
+
+	m->parent.version = GIT_FSMONITOR_VERSION;
+	m->parent.query = inotify_query;
+	m->parent.free = inotify_free;
+
+	git_mutex_init(&m->lock);
+
+	if ((m->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+		giterr_set(GITERR_OS, "Failed to initialize inotify");
+		error = -1;
+		goto done;
+	}
+
+	if ((error = git_path_prettify_dir(&m->workdir, workdir, NULL)) < 0 ||
+		(error = git_vector_init(&m->watches, 0, inotify_watch_cmp)) < 0 ||
+		(error = git_strmap_alloc(&m->changes)) < 0 ||
+		(error = git_buf_printf(&m->instance, INOTIFY_TOKEN_PREFIX "%d.%ld.%p:",
+			(int)getpid(), (long)time(NULL), (void *)m)) < 0 ||
+		(error = git_buf_set(&path, m->workdir.ptr, m->workdir.size)) < 0)
+		goto done;
+
+	error = inotify_watch_tree(m, &path);
+
+done:
+	git_buf_free(&path);
+
+	if (error < 0)
+		inotify_free(&m->parent);
+	else
+		*out = &m->parent;
+
+	return error;
+}
+
+#else
+
+int git_fsmonitor_inotify_new(git_fsmonitor **out, const char *workdir)
+{
+	GIT_UNUSED(workdir);
+
+	*out = NULL;
+
+	giterr_set(GITERR_INVALID,
+		"The inotify file system monitor is not available on this platform");
+	return -1;
+}
+
+#endif
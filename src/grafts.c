@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "grafts.h"
+#include "repository.h"
+#include "filebuf.h"
+#include "vector.h"
+#include "oid.h"
+
+GIT__USE_OIDMAP;
+
+/* grafts are allocated in units of this size to keep them aligned */
+#define GRAFTS_UNIT 8
+
+#define GRAFTS_FILE "info/grafts"
+#define SHALLOW_FILE "shallow"
+#define SHALLOW_FILE_MODE 0644
+
+static int grafts_add(
+	git_grafts *grafts,
+	const git_oid *commit_id,
+	const git_oid *parents,
+	size_t parent_count)
+{
+	git_commit_graft *graft;
+	size_t size;
+	khiter_t pos;
+	int ret;
+
+	size = sizeof(git_commit_graft) + parent_count * sizeof(git_oid);
+
+	graft = git_pool_malloc(&grafts->pool,
+		(uint32_t)((size + GRAFTS_UNIT - 1) / GRAFTS_UNIT));
+	GITERR_CHECK_ALLOC(graft);
+
+	git_oid_cpy(&graft->oid, commit_id);
+	graft->parent_count = parent_count;
+	if (parent_count)
+		memcpy(graft->parents, parents, parent_count * sizeof(git_oid));
+
+	/* a later graft of the same commit replaces the earlier one */
+	pos = kh_put(oid, grafts->commits, &graft->oid, &ret);
+	if (ret < 0) {
+		giterr_set_oom();
+		return -1;
+	}
+	kh_key(grafts->commits, pos) = &graft->oid;
+	kh_value(grafts->commits, pos) = graft;
+
+	return 0;
+}
+
+static int grafts_error(const char *path, int line)
+{
+	giterr_set(GITERR_REPOSITORY, "Invalid graft in '%s' at line %d", path, line);
+	return -1;
+}
+
+/*
+ * Each line holds the id of a commit, followed by the ids of the parents
+ * it is grafted onto; lines of the `shallow` file hold only the commit.
+ */
+static int grafts_parse(
+	git_grafts *grafts,
+	const char *path,
+	git_futils_filestamp *stamp,
+	bool shallow)
+{
+	git_buf contents = GIT_BUF_INIT;
+	git_array_oid_t parents = GIT_ARRAY_INIT;
+	git_oid commit_id, *parent_id;
+	const char *line, *end;
+	int error, lineno = 0;
+
+	if ((error = git_futils_filestamp_check(stamp, path)) == GIT_ENOTFOUND)
+		return 0;
+
+	if ((error = git_futils_readbuffer(&contents, path)) < 0) {
+		if (error == GIT_ENOTFOUND) {
+			giterr_clear();
+			error = 0;
+		}
+		return error;
+	}
+
+	for (line = contents.ptr; !error && *line; line = end) {
+		lineno++;
+		end = line + strcspn(line, "\n");
+
+		if (*end)
+			end++;
+
+		if (*line == '#' || *line == '\n')
+			continue;
+
+		if (git_oid_fromstrn(&commit_id, line, GIT_OID_HEXSZ) < 0) {
+			error = grafts_error(path, lineno);
+			break;
+		}
+
+		line += GIT_OID_HEXSZ;
+		git_array_clear(parents);
+
+		while (!shallow && *line == ' ') {
+			if ((parent_id = git_array_alloc(parents)) == NULL) {
+				error = -1;
+				break;
+			}
+
+			if (git_oid_fromstrn(parent_id, line + 1, GIT_OID_HEXSZ) < 0) {
+				error = grafts_error(path, lineno);
+				break;
+			}
+
+			line += GIT_OID_HEXSZ + 1;
+		}
+
+		if (!error && line != end && (*line != '\n' || line + 1 != end))
+			error = grafts_error(path, lineno);
+
+		if (!error && shallow) {
+			if ((parent_id = git_array_alloc(grafts->shallow)) == NULL)
+				error = -1;
+			else
+				git_oid_cpy(parent_id, &commit_id);
+		}
+
+		if (!error)
+			error = grafts_add(grafts, &commit_id,
+				parents.ptr, git_array_size(parents));
+	}
+
+	git_array_clear(parents);
+	git_buf_free(&contents);
+	return error;
+}
+
+int git_grafts_load(git_grafts **out, git_repository *repo)
+{
+	git_grafts *grafts;
+	git_buf path = GIT_BUF_INIT;
+	int error;
+
+	assert(out && repo);
+
+	grafts = git__calloc(1, sizeof(git_grafts));
+	GITERR_CHECK_ALLOC(grafts);
+
+	GIT_REFCOUNT_INC(grafts);
+
+	if (git_pool_init(&grafts->pool, GRAFTS_UNIT, 0) < 0 ||
+		(grafts->commits = git_oidmap_alloc()) == NULL) {
+		git_grafts_free(grafts);
+		giterr_set_oom();
+		return -1;
+	}
+
+	*out = grafts;
+
+	if (repo->path_repository == NULL)
+		return 0;
+
+	/* the boundary of a shallow clone wins over any graft of it */
+	if ((error = git_buf_joinpath(
+			&path, repo->path_repository, GRAFTS_FILE)) < 0 ||
+		(error = grafts_parse(
+			grafts, path.ptr, &grafts->grafts_stamp, false)) < 0 ||
+		(error = git_buf_joinpath(
+			&path, repo->path_repository, SHALLOW_FILE)) < 0 ||
+		(error = grafts_parse(
+			grafts, path.ptr, &grafts->shallow_stamp, true)) < 0) {
+		git_grafts_free(grafts);
+		*out = NULL;
+	}
+
+	git_buf_free(&path);
+	return error;
+}
+
+static bool stamp_changed(const git_futils_filestamp *stamp, const char *path)
+{
+	git_futils_filestamp current;
+	int error;
+
+	git_futils_filestamp_set(&current, stamp);
+	error = git_futils_filestamp_check(&current, path);
+
+	/* an empty stamp is that of a file which didn't exist */
+	if (error == GIT_ENOTFOUND)
+		return stamp->mtime != 0 || stamp->ino != 0;
+
+	return error != 0;
+}
+
+int git_grafts_changed(git_grafts *grafts, git_repository *repo)
+{
+	git_buf path = GIT_BUF_INIT;
+	int changed = 0;
+
+	assert(grafts && repo);
+
+	if (repo->path_repository == NULL)
+		return 0;
+
+	if (git_buf_joinpath(&path, repo->path_repository, GRAFTS_FILE) < 0 ||
+		stamp_changed(&grafts->grafts_stamp, path.ptr) ||
+		git_buf_joinpath(&path, repo->path_repository, SHALLOW_FILE) < 0 ||
+		stamp_changed(&grafts->shallow_stamp, path.ptr))
+		changed = 1;
+
+	git_buf_free(&path);
+	return changed;
+}
+
+const git_commit_graft *git_grafts_get(
+	git_grafts *grafts, const git_oid *commit_id)
+{
+	khiter_t pos;
+
+	assert(grafts && commit_id);
+
+	pos = kh_get(oid, grafts->commits, commit_id);
+	if (pos == kh_end(grafts->commits))
+		return NULL;
+
+	return kh_value(grafts->commits, pos);
+}
+
+size_t git_grafts_size(git_grafts *grafts)
+{
+	assert(grafts);
+	return (size_t)kh_size(grafts->commits);
+}
+
+static void grafts_free(git_grafts *grafts)
+{
+	git_oidmap_free(grafts->commits);
+	git_pool_clear(&grafts->pool);
+	git_array_clear(grafts->shallow);
+	git__free(grafts);
+}
+
+void git_grafts_free(git_grafts *grafts)
+{
+	if (grafts == NULL)
+		return;
+
+	GIT_REFCOUNT_DEC(grafts, grafts_free);
+}
+
+static int oid_cmp(const void *a, const void *b)
+{
+	return git_oid__cmp(a, b);
+}
+
+int git_grafts_update_shallow(
+	git_repository *repo,
+	const git_oid *shallow, size_t shallow_count,
+	const git_oid *unshallow, size_t unshallow_count)
+{
+	git_grafts *grafts;
+	git_vector roots = GIT_VECTOR_INIT;
+	git_filebuf file = GIT_FILEBUF_INIT;
+	git_buf path = GIT_BUF_INIT;
+	char hex[GIT_OID_HEXSZ + 1];
+	const git_oid *root;
+	size_t i, pos;
+	int error;
+
+	assert(repo && (shallow || !shallow_count) && (unshallow || !unshallow_count));
+
+	if ((error = git_grafts_load(&grafts, repo)) < 0)
+		return error;
+
+	if ((error = git_vector_init(&roots,
+			git_array_size(grafts->shallow) + shallow_count, oid_cmp)) < 0)
+		goto done;
+
+	for (i = 0; !error && i < git_array_size(grafts->shallow); ++i)
+		error = git_vector_insert(&roots, git_array_get(grafts->shallow, i));
+
+	for (i = 0; !error && i < shallow_count; ++i)
+		error = git_vector_insert(&roots, (void *)&shallow[i]);
+
+	if (error < 0)
+		goto done;
+
+	git_vector_sort(&roots);
+	git_vector_uniq(&roots, NULL);
+
+	for (i = 0; i < unshallow_count; ++i) {
+		if (!git_vector_bsearch(&pos, &roots, &unshallow[i]))
+			git_vector_remove(&roots, pos);
+	}
+
+	if ((error = git_buf_joinpath(
+			&path, repo->path_repository, SHALLOW_FILE)) < 0)
+		goto done;
+
+	if (!roots.length) {
+		if (git_path_isfile(path.ptr) && (error = p_unlink(path.ptr)) < 0)
+			giterr_set(GITERR_OS, "Failed to remove '%s'", path.ptr);
+		goto done;
+	}
+
+	if ((error = git_filebuf_open(
+			&file, path.ptr, GIT_FILEBUF_FORCE, SHALLOW_FILE_MODE)) < 0)
+		goto done;
+
+	hex[GIT_OID_HEXSZ] = '\n';
+
+	git_vector_foreach(&roots, i, root) {
+		git_oid_fmt(hex, root);
+
+		if ((error = git_filebuf_write(&file, hex, sizeof(hex))) < 0)
+			break;
+	}
+
+	if (!error)
+		error = git_filebuf_commit(&file);
+	else
+		git_filebuf_cleanup(&file);
+
+done:
+	if (!error)
+		git_repository__clear_grafts(repo);
+
+	git_buf_free(&path);
+	git_vector_free(&roots);
+	git_grafts_free(grafts);
+	return error;
+}
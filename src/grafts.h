@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_grafts_h__
+#define INCLUDE_grafts_h__
+
+#include "common.h"
+#include "git2/oid.h"
+#include "oidarray.h"
+#include "fileops.h"
+#include "oidmap.h"
+#include "pool.h"
+
+/*
+ * Commit grafts
+ *
+ * A graft replaces the parents of a commit for the purposes of history
+ * traversal.  They come from two files in the repository: `info/grafts`
+ * lists a commit followed by the parents it should have, and `shallow`
+ * lists the commits at the boundary of a shallow clone, whose parents
+ * were never fetched; those are grafted to have no parents at all.
+ *
+ * The grafts of a repository are loaded once and shared by reference
+ * between the walks using them.  They are reloaded when either file
+ * changes on disk.
+ */
+
+typedef struct {
+	git_oid oid;
+	size_t parent_count;
+	git_oid parents[GIT_FLEX_ARRAY];
+} git_commit_graft;
+
+typedef struct {
+	git_refcount rc;
+	git_oidmap *commits;
+	git_pool pool;
+	git_array_oid_t shallow;
+	git_futils_filestamp shallow_stamp;
+	git_futils_filestamp grafts_stamp;
+} git_grafts;
+
+/* Read the grafts and shallow roots of a repository from disk */
+extern int git_grafts_load(git_grafts **out, git_repository *repo);
+
+/* Whether the files the grafts were loaded from have changed since */
+extern int git_grafts_changed(git_grafts *grafts, git_repository *repo);
+
+/* The graft of a commit, or NULL if its parents are the recorded ones */
+extern const git_commit_graft *git_grafts_get(
+	git_grafts *grafts, const git_oid *commit_id);
+
+extern size_t git_grafts_size(git_grafts *grafts);
+
+/* Drop a reference to the grafts */
+extern void git_grafts_free(git_grafts *grafts);
+
+/*
+ * Record the result of a shallow fetch: the commits in `shallow` become
+ * shallow roots, and the ones in `unshallow` had their history fetched
+ * and stop being roots.  The `shallow` file is removed when no roots
+ * are left.
+ */
+extern int git_grafts_update_shallow(
+	git_repository *repo,
+	const git_oid *shallow, size_t shallow_count,
+	const git_oid *unshallow, size_t unshallow_count);
+
+#endif
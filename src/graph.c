@@ -7,6 +7,8 @@
 
 #include "revwalk.h"
 #include "merge.h"
+#include "pool.h"
+#include "array.h"
 #include "git2/graph.h"
 
 static int interesting(git_pqueue *list, git_commit_list *roots)
@@ -172,6 +174,387 @@ on_error:
 	return -1;
 }
 
+/*
+ * Ahead/behind for many tips at once
+ *
+ * A single walk over the histories of the base and of all of the tips
+ * gives every commit a set of the tips (and a bit for the base) that
+ * reach it, and a set of the tips for which it is below a commit that
+ * the tip shares with the base.  The commits in the first set only are
+ * counted, and the shared commits that aren't below another shared one
+ * are the merge bases.  Once a commit is shared by everything and below
+ * shared commits for every tip, none of its ancestors matter anymore.
+ */
+
+#define GRAPH_TIPS_PER_THREAD 64
+#define GRAPH_MAX_THREADS 16
+
+typedef uint64_t graph_word;
+#define GRAPH_WORD_BITS 64
+
+typedef struct {
+	git_repository *repo;
+	const git_oid *base;
+	const git_oid *tips;
+	size_t count;
+	size_t *ahead;
+	size_t *behind;
+	git_oid *merge_bases;
+	int error;
+} graph_batch;
+
+typedef struct {
+	git_commit_list_node *commit;
+	unsigned int queued;
+	bool settled;
+	graph_word *reach; /* the tips, and then the base, reaching the commit */
+	graph_word *below; /* the tips having a shared commit above it */
+} graph_node;
+
+typedef struct {
+	graph_batch *batch;
+	git_revwalk *walk;
+	git_oidmap *nodes;
+	git_pool pool;
+	git_vector visited;
+	git_pqueue queue;
+	size_t words;
+	size_t unsettled; /* queue entries of commits which aren't settled */
+	graph_word *all; /* every tip and the base */
+} graph_walk;
+
+#define GRAPH_NODE_WORDS \
+	((sizeof(graph_node) + sizeof(graph_word) - 1) / sizeof(graph_word))
+
+#define GRAPH_TEST(set, n) \
+	(((set)[(n) / GRAPH_WORD_BITS] >> ((n) % GRAPH_WORD_BITS)) & 1)
+#define GRAPH_SET(set, n) \
+	((set)[(n) / GRAPH_WORD_BITS] |= ((graph_word)1 << ((n) % GRAPH_WORD_BITS)))
+
+static graph_node *graph_node_get(graph_walk *gw, git_commit_list_node *commit)
+{
+	graph_node *node;
+	khiter_t pos;
+	int ret;
+
+	pos = kh_get(oid, gw->nodes, &commit->oid);
+	if (pos != kh_end(gw->nodes))
+		return kh_value(gw->nodes, pos);
+
+	if (git_commit_list_parse(gw->walk, commit) < 0)
+		return NULL;
+
+	/* the sets follow the node, in the same allocation */
+	node = git_pool_mallocz(&gw->pool,
+		(uint32_t)(GRAPH_NODE_WORDS + 2 * gw->words));
+	if (node == NULL)
+		return NULL;
+
+	node->commit = commit;
+	node->reach = (graph_word *)node + GRAPH_NODE_WORDS;
+	node->below = node->reach + gw->words;
+
+	pos = kh_put(oid, gw->nodes, &commit->oid, &ret);
+	if (ret < 0 || git_vector_insert(&gw->visited, node) < 0) {
+		giterr_set_oom();
+		return NULL;
+	}
+	kh_value(gw->nodes, pos) = node;
+
+	return node;
+}
+
+static int graph_enqueue(graph_walk *gw, graph_node *node)
+{
+	node->queued++;
+	if (!node->settled)
+		gw->unsettled++;
+
+	return git_pqueue_insert(&gw->queue, node->commit);
+}
+
+static graph_node *graph_dequeue(graph_walk *gw)
+{
+	git_commit_list_node *commit = git_pqueue_pop(&gw->queue);
+	graph_node *node = kh_value(gw->nodes, kh_get(oid, gw->nodes, &commit->oid));
+
+	node->queued--;
+	if (!node->settled)
+		gw->unsettled--;
+
+	return node;
+}
+
+/*
+ * A commit is settled once it is shared by everything and below shared
+ * commits for every tip; nothing can be learned from its ancestors then.
+ */
+static void graph_update_settled(graph_walk *gw, graph_node *node)
+{
+	size_t bytes = gw->words * sizeof(graph_word);
+
+	if (node->settled ||
+		memcmp(node->reach, gw->all, bytes) != 0 ||
+		memcmp(node->below, gw->all + gw->words, bytes) != 0)
+		return;
+
+	node->settled = true;
+	gw->unsettled -= node->queued;
+}
+
+static int graph_push(graph_walk *gw, const git_oid *id, size_t bit)
+{
+	git_commit_list_node *commit;
+	graph_node *node;
+
+	if ((commit = git_revwalk__commit_lookup(gw->walk, id)) == NULL ||
+		(node = graph_node_get(gw, commit)) == NULL)
+		return -1;
+
+	GRAPH_SET(node->reach, bit);
+	graph_update_settled(gw, node);
+
+	return graph_enqueue(gw, node);
+}
+
+/* Hand the sets of a commit down to its parents, requeueing the ones
+ * that learn something new */
+static int graph_mark_parents(graph_walk *gw, graph_node *node)
+{
+	git_commit_list_node *commit = node->commit;
+	size_t words = gw->words, i;
+	bool shared = GRAPH_TEST(node->reach, gw->batch->count), changed;
+	graph_node *parent;
+	graph_word below;
+	unsigned short p;
+	int error;
+
+	for (p = 0; p < commit->out_degree; ++p) {
+		if ((parent = graph_node_get(gw, commit->parents[p])) == NULL)
+			return -1;
+
+		changed = false;
+
+		for (i = 0; i < words; ++i) {
+			below = node->below[i];
+
+			/* the tips sharing this commit have a shared one above the
+			 * parent; the base's bit is masked off by `all` */
+			if (shared)
+				below |= node->reach[i] & gw->all[words + i];
+
+			if ((parent->reach[i] | node->reach[i]) != parent->reach[i] ||
+				(parent->below[i] | below) != parent->below[i]) {
+				parent->reach[i] |= node->reach[i];
+				parent->below[i] |= below;
+				changed = true;
+			}
+		}
+
+		if (!changed)
+			continue;
+
+		graph_update_settled(gw, parent);
+
+		if ((error = graph_enqueue(gw, parent)) < 0)
+			return error;
+	}
+
+	return 0;
+}
+
+static int graph_count(graph_walk *gw)
+{
+	graph_batch *batch = gw->batch;
+	graph_node *node, **best = NULL;
+	size_t i, t;
+	bool shared;
+
+	if (batch->merge_bases) {
+		best = git__calloc(batch->count, sizeof(graph_node *));
+		GITERR_CHECK_ALLOC(best);
+	}
+
+	memset(batch->ahead, 0, batch->count * sizeof(size_t));
+	memset(batch->behind, 0, batch->count * sizeof(size_t));
+
+	git_vector_foreach(&gw->visited, i, node) {
+		shared = GRAPH_TEST(node->reach, batch->count);
+
+		for (t = 0; t < batch->count; ++t) {
+			if (!GRAPH_TEST(node->reach, t)) {
+				if (shared)
+					batch->behind[t]++;
+			} else if (!shared) {
+				batch->ahead[t]++;
+			} else if (best && !GRAPH_TEST(node->below, t) &&
+				(!best[t] || best[t]->commit->time < node->commit->time)) {
+				best[t] = node;
+			}
+		}
+	}
+
+	for (t = 0; best && t < batch->count; ++t) {
+		if (best[t])
+			git_oid_cpy(&batch->merge_bases[t], &best[t]->commit->oid);
+		else
+			memset(&batch->merge_bases[t], 0, sizeof(git_oid));
+	}
+
+	git__free(best);
+	return 0;
+}
+
+static int graph_batch_run(graph_batch *batch)
+{
+	graph_walk gw;
+	size_t i;
+	int error;
+
+	memset(&gw, 0, sizeof(gw));
+	gw.batch = batch;
+	gw.words = (batch->count + 1 + GRAPH_WORD_BITS - 1) / GRAPH_WORD_BITS;
+
+	if ((error = git_revwalk_new(&gw.walk, batch->repo)) < 0)
+		return error;
+
+	if ((error = git_pool_init(&gw.pool, sizeof(graph_word), 0)) < 0 ||
+		(error = git_vector_init(&gw.visited, 64, NULL)) < 0 ||
+		(error = git_pqueue_init(
+			&gw.queue, 0, 64, git_commit_list_time_cmp)) < 0)
+		goto done;
+
+	/* all of the bits, followed by only the tips' */
+	gw.nodes = git_oidmap_alloc();
+	gw.all = git__calloc(2 * gw.words, sizeof(graph_word));
+	if (!gw.nodes || !gw.all) {
+		giterr_set_oom();
+		error = -1;
+		goto done;
+	}
+
+	for (i = 0; i < batch->count; ++i) {
+		GRAPH_SET(gw.all, i);
+		GRAPH_SET(gw.all + gw.words, i);
+	}
+	GRAPH_SET(gw.all, batch->count);
+
+	if ((error = graph_push(&gw, batch->base, batch->count)) < 0)
+		goto done;
+
+	for (i = 0; i < batch->count; ++i)
+		if ((error = graph_push(&gw, &batch->tips[i], i)) < 0)
+			goto done;
+
+	while (gw.unsettled > 0) {
+		if ((error = graph_mark_parents(&gw, graph_dequeue(&gw))) < 0)
+			goto done;
+	}
+
+	error = graph_count(&gw);
+
+done:
+	git__free(gw.all);
+	git_pqueue_free(&gw.queue);
+	git_vector_free(&gw.visited);
+	git_pool_clear(&gw.pool);
+	git_oidmap_free(gw.nodes);
+	git_revwalk_free(gw.walk);
+	return error;
+}
+
+#ifdef GIT_THREADS
+
+static void *graph_batch_thread(void *payload)
+{
+	graph_batch *batch = payload;
+
+	batch->error = graph_batch_run(batch);
+
+	/* failed batches are run again on the calling thread */
+	giterr_clear();
+
+	return NULL;
+}
+
+#endif
+
+int git_graph_ahead_behind_many(
+	size_t *ahead,
+	size_t *behind,
+	git_oid *merge_bases,
+	git_repository *repo,
+	const git_oid *base,
+	const git_oid *tips,
+	size_t count,
+	unsigned int threads)
+{
+#ifdef GIT_THREADS
+	git_thread handles[GRAPH_MAX_THREADS];
+	graph_batch batches[GRAPH_MAX_THREADS];
+	size_t nthreads, per_thread, started, i;
+	int error = 0;
+#endif
+	graph_batch batch;
+
+	assert(ahead && behind && repo && base && (tips || !count));
+
+	if (!count)
+		return 0;
+
+	batch.repo = repo;
+	batch.base = base;
+	batch.tips = tips;
+	batch.count = count;
+	batch.ahead = ahead;
+	batch.behind = behind;
+	batch.merge_bases = merge_bases;
+
+#ifdef GIT_THREADS
+	nthreads = threads ? threads : (size_t)git_online_cpus();
+	if (nthreads > count / GRAPH_TIPS_PER_THREAD)
+		nthreads = count / GRAPH_TIPS_PER_THREAD;
+	if (nthreads > GRAPH_MAX_THREADS)
+		nthreads = GRAPH_MAX_THREADS;
+
+	if (nthreads < 2)
+		return graph_batch_run(&batch);
+
+	/* each thread has a walk of its own over a part of the tips */
+	per_thread = (count + nthreads - 1) / nthreads;
+
+	for (i = 0; i < nthreads; ++i) {
+		batches[i] = batch;
+		batches[i].tips = tips + i * per_thread;
+		batches[i].count = min(per_thread, count - i * per_thread);
+		batches[i].ahead = ahead + i * per_thread;
+		batches[i].behind = behind + i * per_thread;
+		batches[i].merge_bases =
+			merge_bases ? merge_bases + i * per_thread : NULL;
+		batches[i].error = -1;
+	}
+
+	for (started = 0; started < nthreads; ++started)
+		if (git_thread_create(&handles[started], NULL,
+				graph_batch_thread, &batches[started]) != 0)
+			break;
+
+	for (i = 0; i < started; ++i)
+		git_thread_join(handles[i], NULL);
+
+	/* errors are only reported on this thread */
+	for (i = 0; i < nthreads && !error; ++i) {
+		if (batches[i].error < 0)
+			error = graph_batch_run(&batches[i]);
+	}
+
+	return error;
+#else
+	GIT_UNUSED(threads);
+	return graph_batch_run(&batch);
+#endif
+}
+
 int git_graph_descendant_of(git_repository *repo, const git_oid *commit, const git_oid *ancestor)
 {
 	git_oid merge_base;
@@ -190,3 +573,302 @@ int git_graph_descendant_of(git_repository *repo, const git_oid *commit, const g
 
 	return git_oid_equal(&merge_base, ancestor);
 }
+
+/*
+ * Reachability index
+ *
+ * A depth-first walk from the tips numbers every commit after all of its
+ * parents (post-order), so everything a commit can reach is numbered
+ * below it.  Two intervals are kept per commit: the numbers of the
+ * commits below it in the walk's spanning tree, which it certainly
+ * reaches, and the lowest number of anything it reaches, which bounds
+ * the commits it can reach at all.  Most queries are answered by one of
+ * them or by the generation numbers; the rest walk the history while
+ * skipping every commit that the labels rule out.
+ */
+
+typedef struct graph_reach_node {
+	git_oid oid;
+	git_commit_list_node *commit; /* only while the index is built */
+	struct graph_reach_node **parents;
+	unsigned short parent_count;
+	unsigned short next_parent;
+	bool done;
+	uint32_t start; /* the first number in the node's spanning subtree */
+	uint32_t post;
+	uint32_t low; /* the lowest number the node reaches */
+	uint32_t generation;
+	uint32_t stamp; /* the last query which visited the node */
+} graph_reach_node;
+
+struct git_graph_reachability {
+	git_repository *repo;
+	git_oidmap *nodes;
+	git_pool pool;
+	git_pool parents_pool;
+	git_array_t(graph_reach_node *) stack;
+	uint32_t stamp;
+};
+
+static graph_reach_node *reach_node_get(
+	git_graph_reachability *index, git_revwalk *walk, const git_oid *id)
+{
+	graph_reach_node *node;
+	khiter_t pos;
+	int ret;
+
+	pos = kh_get(oid, index->nodes, id);
+	if (pos != kh_end(index->nodes))
+		return kh_value(index->nodes, pos);
+
+	if ((node = git_pool_mallocz(&index->pool, 1)) == NULL)
+		return NULL;
+
+	git_oid_cpy(&node->oid, id);
+	if ((node->commit = git_revwalk__commit_lookup(walk, id)) == NULL)
+		return NULL;
+
+	pos = kh_put(oid, index->nodes, &node->oid, &ret);
+	if (ret < 0) {
+		giterr_set_oom();
+		return NULL;
+	}
+	kh_value(index->nodes, pos) = node;
+
+	return node;
+}
+
+static int reach_enter(
+	git_graph_reachability *index, git_revwalk *walk,
+	graph_reach_node *node, uint32_t counter)
+{
+	graph_reach_node **top;
+	unsigned short p;
+	int error;
+
+	if ((error = git_commit_list_parse(walk, node->commit)) < 0)
+		return error;
+
+	node->start = counter;
+	node->parent_count = node->commit->out_degree;
+
+	if (node->parent_count) {
+		node->parents = git_pool_malloc(
+			&index->parents_pool, node->parent_count);
+		GITERR_CHECK_ALLOC(node->parents);
+	}
+
+	for (p = 0; p < node->parent_count; ++p) {
+		node->parents[p] = reach_node_get(
+			index, walk, &node->commit->parents[p]->oid);
+		if (node->parents[p] == NULL)
+			return -1;
+	}
+
+	top = git_array_alloc(index->stack);
+	GITERR_CHECK_ALLOC(top);
+	*top = node;
+
+	return 0;
+}
+
+static int reach_label(
+	git_graph_reachability *index, git_revwalk *walk,
+	graph_reach_node *tip, uint32_t *counter)
+{
+	graph_reach_node **top, *node, *parent;
+	unsigned short p;
+	int error;
+
+	if (tip->done)
+		return 0;
+
+	if ((error = reach_enter(index, walk, tip, *counter)) < 0)
+		return error;
+
+	while ((top = git_array_last(index->stack)) != NULL) {
+		node = *top;
+
+		if (node->next_parent < node->parent_count) {
+			parent = node->parents[node->next_parent++];
+
+			/* a parent can't be on the stack already, that would
+			 * be a cycle */
+			if (!parent->done &&
+				(error = reach_enter(index, walk, parent, *counter)) < 0)
+				return error;
+			continue;
+		}
+
+		node->post = (*counter)++;
+		node->low = node->post;
+		node->generation = 1;
+
+		for (p = 0; p < node->parent_count; ++p) {
+			parent = node->parents[p];
+
+			if (parent->low < node->low)
+				node->low = parent->low;
+			if (parent->generation >= node->generation)
+				node->generation = parent->generation + 1;
+		}
+
+		node->done = true;
+		node->commit = NULL;
+		git_array_pop(index->stack);
+	}
+
+	return 0;
+}
+
+int git_graph_reachability_new(
+	git_graph_reachability **out,
+	git_repository *repo,
+	const git_oid *tips,
+	size_t count)
+{
+	git_graph_reachability *index;
+	git_revwalk *walk = NULL;
+	graph_reach_node *tip;
+	uint32_t counter = 0;
+	size_t i;
+	int error;
+
+	assert(out && repo && (tips || !count));
+
+	index = git__calloc(1, sizeof(git_graph_reachability));
+	GITERR_CHECK_ALLOC(index);
+
+	index->repo = repo;
+	git_array_init(index->stack);
+
+	if ((error = git_pool_init(&index->pool, sizeof(graph_reach_node), 0)) < 0 ||
+		(error = git_pool_init(&index->parents_pool,
+			sizeof(graph_reach_node *), 0)) < 0 ||
+		(error = git_revwalk_new(&walk, repo)) < 0)
+		goto on_error;
+
+	if ((index->nodes = git_oidmap_alloc()) == NULL) {
+		giterr_set_oom();
+		error = -1;
+		goto on_error;
+	}
+
+	for (i = 0; i < count; ++i) {
+		if ((tip = reach_node_get(index, walk, &tips[i])) == NULL) {
+			error = -1;
+			goto on_error;
+		}
+
+		if ((error = reach_label(index, walk, tip, &counter)) < 0)
+			goto on_error;
+	}
+
+	git_revwalk_free(walk);
+
+	*out = index;
+	return 0;
+
+on_error:
+	git_revwalk_free(walk);
+	git_graph_reachability_free(index);
+	return error;
+}
+
+#define REACH_BELOW(node, number) \
+	((number) >= (node)->start && (number) <= (node)->post)
+#define REACH_OUTSIDE(node, number) \
+	((number) < (node)->low || (number) > (node)->post)
+
+static int reach_search(
+	git_graph_reachability *index,
+	graph_reach_node *from,
+	graph_reach_node *to)
+{
+	graph_reach_node **top, *node, *parent;
+	unsigned short p;
+
+	if (to->generation >= from->generation || REACH_OUTSIDE(from, to->post))
+		return 0;
+	if (REACH_BELOW(from, to->post))
+		return 1;
+
+	/* the stamps of a new query can't be mistaken for old ones */
+	if (++index->stamp == 0) {
+		graph_reach_node *n;
+
+		kh_foreach_value(index->nodes, n, n->stamp = 0);
+		index->stamp = 1;
+	}
+
+	index->stack.size = 0;
+
+	top = git_array_alloc(index->stack);
+	GITERR_CHECK_ALLOC(top);
+	*top = from;
+
+	while ((top = git_array_pop(index->stack)) != NULL) {
+		node = *top;
+
+		for (p = 0; p < node->parent_count; ++p) {
+			parent = node->parents[p];
+
+			if (parent == to || REACH_BELOW(parent, to->post))
+				return 1;
+
+			if (parent->stamp == index->stamp ||
+				parent->generation <= to->generation ||
+				REACH_OUTSIDE(parent, to->post))
+				continue;
+
+			parent->stamp = index->stamp;
+
+			top = git_array_alloc(index->stack);
+			GITERR_CHECK_ALLOC(top);
+			*top = parent;
+		}
+	}
+
+	return 0;
+}
+
+int git_graph_reachability_descendant_of(
+	git_graph_reachability *index,
+	const git_oid *commit,
+	const git_oid *ancestor)
+{
+	khiter_t from, to;
+
+	assert(index && commit && ancestor);
+
+	if (git_oid_equal(commit, ancestor))
+		return 0;
+
+	from = kh_get(oid, index->nodes, commit);
+	to = kh_get(oid, index->nodes, ancestor);
+
+	/* commits which weren't indexed need a walk of their own */
+	if (from == kh_end(index->nodes) || to == kh_end(index->nodes))
+		return git_graph_descendant_of(index->repo, commit, ancestor);
+
+	return reach_search(index,
+		kh_value(index->nodes, from), kh_value(index->nodes, to));
+}
+
+size_t git_graph_reachability_size(git_graph_reachability *index)
+{
+	assert(index);
+	return (size_t)kh_size(index->nodes);
+}
+
+void git_graph_reachability_free(git_graph_reachability *index)
+{
+	if (index == NULL)
+		return;
+
+	git_array_clear(index->stack);
+	git_oidmap_free(index->nodes);
+	git_pool_clear(&index->pool);
+	git_pool_clear(&index->parents_pool);
+	git__free(index);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "graphcache.h"
+
+GIT__USE_OIDMAP;
+
+/* entries are allocated in units of this size to keep them aligned */
+#define GRAPHCACHE_UNIT 8
+
+int git_graphcache_new(git_graphcache **out, size_t max_entries)
+{
+	git_graphcache *cache;
+
+	assert(out && max_entries > 0);
+
+	cache = git__calloc(1, sizeof(git_graphcache));
+	GITERR_CHECK_ALLOC(cache);
+
+	if (git_rwlock_init(&cache->lock)) {
+		giterr_set(GITERR_OS, "Failed to initialize lock");
+		git__free(cache);
+		return -1;
+	}
+
+	if (git_pool_init(&cache->pool, GRAPHCACHE_UNIT, 0) < 0 ||
+		(cache->map = git_oidmap_alloc()) == NULL) {
+		git_graphcache_free(cache);
+		giterr_set_oom();
+		return -1;
+	}
+
+	cache->max_entries = max_entries;
+
+	*out = cache;
+	return 0;
+}
+
+static void graphcache_clear_locked(git_graphcache *cache)
+{
+	kh_clear(oid, cache->map);
+	git_pool_clear(&cache->pool);
+}
+
+int git_graphcache_put(
+	git_graphcache *cache,
+	const git_oid *commit_id,
+	uint32_t time,
+	uint32_t generation,
+	const git_oid *parents,
+	size_t parent_count)
+{
+	git_graphcache_entry *entry;
+	size_t size;
+	khiter_t pos;
+	int ret, error = 0;
+
+	assert(cache && commit_id && (parents || !parent_count));
+
+	/* an octopus this large isn't worth keeping */
+	if (parent_count > USHRT_MAX)
+		return 0;
+
+	size = sizeof(git_graphcache_entry) + parent_count * sizeof(git_oid);
+
+	if (git_rwlock_wrlock(&cache->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to lock commit graph cache");
+		return -1;
+	}
+
+	if (kh_get(oid, cache->map, commit_id) != kh_end(cache->map))
+		goto done;
+
+	/* nothing can be referring to entries, so a full cache is emptied */
+	if (kh_size(cache->map) >= cache->max_entries)
+		graphcache_clear_locked(cache);
+
+	entry = git_pool_malloc(&cache->pool,
+		(uint32_t)((size + GRAPHCACHE_UNIT - 1) / GRAPHCACHE_UNIT));
+	if (entry == NULL) {
+		giterr_set_oom();
+		error = -1;
+		goto done;
+	}
+
+	git_oid_cpy(&entry->oid, commit_id);
+	entry->time = time;
+	entry->generation = generation;
+	entry->parent_count = (uint16_t)parent_count;
+	if (parent_count)
+		memcpy(entry->parents, parents, parent_count * sizeof(git_oid));
+
+	pos = kh_put(oid, cache->map, &entry->oid, &ret);
+	if (ret < 0) {
+		giterr_set_oom();
+		error = -1;
+		goto done;
+	}
+	kh_value(cache->map, pos) = entry;
+
+done:
+	git_rwlock_wrunlock(&cache->lock);
+	return error;
+}
+
+int git_graphcache_with(
+	git_graphcache *cache,
+	const git_oid *commit_id,
+	int (*cb)(const git_graphcache_entry *entry, void *payload),
+	void *payload)
+{
+	khiter_t pos;
+	int error = GIT_ENOTFOUND;
+
+	assert(cache && commit_id && cb);
+
+	if (git_rwlock_rdlock(&cache->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to lock commit graph cache");
+		return -1;
+	}
+
+	pos = kh_get(oid, cache->map, commit_id);
+	if (pos != kh_end(cache->map))
+		error = cb(kh_value(cache->map, pos), payload);
+
+	git_rwlock_rdunlock(&cache->lock);
+	return error;
+}
+
+size_t git_graphcache_size(git_graphcache *cache)
+{
+	size_t size;
+
+	if (git_rwlock_rdlock(&cache->lock) < 0)
+		return 0;
+
+	size = (size_t)kh_size(cache->map);
+
+	git_rwlock_rdunlock(&cache->lock);
+	return size;
+}
+
+void git_graphcache_clear(git_graphcache *cache)
+{
+	if (git_rwlock_wrlock(&cache->lock) < 0)
+		return;
+
+	graphcache_clear_locked(cache);
+
+	git_rwlock_wrunlock(&cache->lock);
+}
+
+void git_graphcache_free(git_graphcache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	git_oidmap_free(cache->map);
+	git_pool_clear(&cache->pool);
+	git_rwlock_free(&cache->lock);
+	git__free(cache);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_graphcache_h__
+#define INCLUDE_graphcache_h__
+
+#include "common.h"
+#include "git2/oid.h"
+#include "thread-utils.h"
+#include "oidmap.h"
+#include "pool.h"
+
+/*
+ * Commit graph cache
+ *
+ * Revision walks only need the parents and the time of a commit (and
+ * its generation number, when one is known), but every walk reads and
+ * parses the commits it visits again.  A repository can keep the parsed
+ * form of commits across walks, so that revwalks, merge-base queries
+ * and descendant checks start from what earlier ones have learnt.
+ *
+ * The cache is shared between threads: entries are copied out while a
+ * read lock is held, and the whole cache is dropped when it is full.
+ */
+
+typedef struct {
+	git_oid oid;
+	uint32_t time;
+	uint32_t generation;
+	uint16_t parent_count;
+	git_oid parents[GIT_FLEX_ARRAY];
+} git_graphcache_entry;
+
+typedef struct {
+	git_rwlock lock;
+	git_oidmap *map;
+	git_pool pool;
+	size_t max_entries;
+} git_graphcache;
+
+extern int git_graphcache_new(git_graphcache **out, size_t max_entries);
+
+/* Remember the parents, time and generation of a commit */
+extern int git_graphcache_put(
+	git_graphcache *cache,
+	const git_oid *commit_id,
+	uint32_t time,
+	uint32_t generation,
+	const git_oid *parents,
+	size_t parent_count);
+
+/*
+ * Call `cb` with the entry of a commit while the cache is locked for
+ * reading; the entry must not be used after `cb` returns.  Returns
+ * GIT_ENOTFOUND when the commit isn't cached, or the value of `cb`.
+ */
+extern int git_graphcache_with(
+	git_graphcache *cache,
+	const git_oid *commit_id,
+	int (*cb)(const git_graphcache_entry *entry, void *payload),
+	void *payload);
+
+extern size_t git_graphcache_size(git_graphcache *cache);
+
+extern void git_graphcache_clear(git_graphcache *cache);
+
+extern void git_graphcache_free(git_graphcache *cache);
+
+#endif
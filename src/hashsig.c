@@ -7,6 +7,10 @@
 #include "hashsig.h"
 #include "fileops.h"
 #include "util.h"
+#include "offmap.h"
+#include "pool.h"
+
+GIT__USE_OFFMAP;
 
 typedef uint32_t hashsig_t;
 typedef uint64_t hashsig_state;
@@ -20,6 +24,17 @@ typedef uint64_t hashsig_state;
 #define HASHSIG_HASH_MIX(S,CH) \
 	(S) = ((S) << HASHSIG_HASH_SHIFT) - (S) + (hashsig_state)(CH)
 
+/* mixing in four characters at once: the powers of 31 */
+#define HASHSIG_HASH_MUL1 31ULL
+#define HASHSIG_HASH_MUL2 961ULL
+#define HASHSIG_HASH_MUL3 29791ULL
+#define HASHSIG_HASH_MUL4 923521ULL
+
+/* a word with each of its bytes set to `b`, and byte tests on words */
+#define HASHSIG_BYTES(b) (0x0101010101010101ULL * (uint8_t)(b))
+#define HASHSIG_HAS_ZERO_BYTE(w) \
+	(((w) - HASHSIG_BYTES(0x01)) & ~(w) & HASHSIG_BYTES(0x80))
+
 #define HASHSIG_HEAP_SIZE ((1 << 7) - 1)
 #define HASHSIG_HEAP_MIN_SIZE 4
 
@@ -63,11 +78,19 @@ static int hashsig_cmp_min(const void *a, const void *b, void *payload)
 	return (av > bv) ? -1 : (av < bv) ? 1 : 0;
 }
 
-static void hashsig_heap_up(hashsig_heap *h, int el)
+/*
+ * Whether `a` orders before `b` in a heap, that is whether its comparison
+ * function would return less than zero; the heap operations below are
+ * always given a constant `is_min`, so each is compiled for both heaps.
+ */
+#define HASHSIG_HEAP_BEFORE(is_min, a, b) ((is_min) ? ((a) > (b)) : ((a) < (b)))
+
+GIT_INLINE(void) hashsig_heap_up(hashsig_heap *h, int el, bool is_min)
 {
 	int parent_el = HEAP_PARENT_OF(el);
 
-	while (el > 0 && h->cmp(&h->values[parent_el], &h->values[el], NULL) > 0) {
+	while (el > 0 && HASHSIG_HEAP_BEFORE(
+			is_min, h->values[el], h->values[parent_el])) {
 		hashsig_t t = h->values[el];
 		h->values[el] = h->values[parent_el];
 		h->values[parent_el] = t;
@@ -77,7 +100,7 @@ static void hashsig_heap_up(hashsig_heap *h, int el)
 	}
 }
 
-static void hashsig_heap_down(hashsig_heap *h, int el)
+GIT_INLINE(void) hashsig_heap_down(hashsig_heap *h, int el, bool is_min)
 {
 	hashsig_t v, lv, rv;
 
@@ -90,10 +113,11 @@ static void hashsig_heap_down(hashsig_heap *h, int el)
 		lv = h->values[lel];
 		rv = h->values[rel];
 
-		if (h->cmp(&v, &lv, NULL) < 0 && h->cmp(&v, &rv, NULL) < 0)
+		if (HASHSIG_HEAP_BEFORE(is_min, v, lv) &&
+			HASHSIG_HEAP_BEFORE(is_min, v, rv))
 			break;
 
-		swapel = (h->cmp(&lv, &rv, NULL) < 0) ? lel : rel;
+		swapel = HASHSIG_HEAP_BEFORE(is_min, lv, rv) ? lel : rel;
 
 		h->values[el] = h->values[swapel];
 		h->values[swapel] = v;
@@ -108,21 +132,66 @@ static void hashsig_heap_sort(hashsig_heap *h)
 	git__qsort_r(h->values, h->size, sizeof(hashsig_t), h->cmp, NULL);
 }
 
-static void hashsig_heap_insert(hashsig_heap *h, hashsig_t val)
+GIT_INLINE(void) hashsig_heap_insert(
+	hashsig_heap *h, hashsig_t val, bool is_min)
 {
 	/* if heap is not full, insert new element */
 	if (h->size < h->asize) {
 		h->values[h->size++] = val;
-		hashsig_heap_up(h, h->size - 1);
+		hashsig_heap_up(h, h->size - 1, is_min);
 	}
 
 	/* if heap is full, pop top if new element should replace it */
-	else if (h->cmp(&val, &h->values[0], NULL) > 0) {
+	else if (HASHSIG_HEAP_BEFORE(is_min, h->values[0], val)) {
 		h->size--;
 		h->values[0] = h->values[h->size];
-		hashsig_heap_down(h, 0);
+		hashsig_heap_down(h, 0, is_min);
+	}
+
+}
+
+static void hashsig_insert(git_hashsig *sig, hashsig_t val)
+{
+	hashsig_heap_insert(&sig->mins, val, true);
+	hashsig_heap_insert(&sig->maxs, val, false);
+
+	sig->considered++;
+}
+
+/* Length of the run at `scan`, up to the first newline or NUL byte */
+static size_t hashsig_run_length(const uint8_t *scan, size_t avail)
+{
+	uint64_t word;
+	size_t len = 0;
+
+	/* skip words without either byte in them, then find it in the last */
+	for (; len + sizeof(word) <= avail; len += sizeof(word)) {
+		memcpy(&word, scan + len, sizeof(word));
+
+		if (HASHSIG_HAS_ZERO_BYTE(word) ||
+			HASHSIG_HAS_ZERO_BYTE(word ^ HASHSIG_BYTES('\n')))
+			break;
 	}
 
+	while (len < avail && scan[len] != '\n' && scan[len] != '\0')
+		++len;
+
+	return len;
+}
+
+/* Mix a run of characters into the hash state, four at a time */
+static hashsig_state hashsig_hash_run(
+	hashsig_state state, const uint8_t *run, size_t len)
+{
+	for (; len >= 4; len -= 4, run += 4)
+		state = state * HASHSIG_HASH_MUL4 +
+			run[0] * HASHSIG_HASH_MUL3 + run[1] * HASHSIG_HASH_MUL2 +
+			run[2] * HASHSIG_HASH_MUL1 + run[3];
+
+	for (; len > 0; --len, ++run)
+		HASHSIG_HASH_MIX(state, *run);
+
+	return state;
 }
 
 typedef struct {
@@ -137,13 +206,9 @@ static void hashsig_in_progress_init(
 
 	switch (sig->opt) {
 	case GIT_HASHSIG_IGNORE_WHITESPACE:
-		for (i = 0; i < 256; ++i)
-			prog->ignore_ch[i] = git__isspace_nonlf(i);
-		prog->use_ignores = 1;
-		break;
 	case GIT_HASHSIG_SMART_WHITESPACE:
 		for (i = 0; i < 256; ++i)
-			prog->ignore_ch[i] = git__isspace(i);
+			prog->ignore_ch[i] = git__isspace_nonlf(i);
 		prog->use_ignores = 1;
 		break;
 	default:
@@ -154,6 +219,33 @@ static void hashsig_in_progress_init(
 
 #define HASHSIG_IN_PROGRESS_INIT { 1 }
 
+/* Without any whitespace to skip, runs are hashed a word at a time */
+static void hashsig_add_hashes_normal(
+	git_hashsig *sig, const uint8_t *data, size_t size)
+{
+	const uint8_t *scan = data, *end = data + size;
+	size_t len, avail;
+
+	while (scan < end) {
+		avail = min((size_t)(end - scan), HASHSIG_MAX_RUN);
+		len = hashsig_run_length(scan, avail);
+
+		if (len > 0)
+			hashsig_insert(sig, (hashsig_t)
+				hashsig_hash_run(HASHSIG_HASH_START, scan, len));
+
+		/* a run cut at the maximum length has no terminator */
+		scan += len;
+		if (len < avail)
+			++scan;
+
+		if (len > 0) {
+			while (scan < end && (*scan == '\n' || !*scan))
+				++scan;
+		}
+	}
+}
+
 static int hashsig_add_hashes(
 	git_hashsig *sig,
 	const uint8_t *data,
@@ -161,25 +253,32 @@ static int hashsig_add_hashes(
 	hashsig_in_progress *prog)
 {
 	const uint8_t *scan = data, *end = data + size;
+	const uint8_t *ignore_ch = prog->ignore_ch;
+	bool smart = (sig->opt == GIT_HASHSIG_SMART_WHITESPACE);
 	hashsig_state state = HASHSIG_HASH_START;
 	int use_ignores = prog->use_ignores, len;
 	uint8_t ch;
 
+	if (sig->opt == GIT_HASHSIG_NORMAL) {
+		hashsig_add_hashes_normal(sig, data, size);
+		return 0;
+	}
+
 	while (scan < end) {
 		state = HASHSIG_HASH_START;
 
 		for (len = 0; scan < end && len < HASHSIG_MAX_RUN; ) {
-			ch = *scan;
-
 			if (use_ignores)
-				for (; scan < end && git__isspace_nonlf(ch); ch = *scan)
+				while (scan < end && ignore_ch[*scan])
 					++scan;
-			else if (sig->opt != GIT_HASHSIG_NORMAL)
-				for (; scan < end && ch == '\r'; ch = *scan)
+			else
+				while (scan < end && *scan == '\r')
 					++scan;
 
+			ch = (scan < end) ? *scan : '\0';
+
 			/* peek at next character to decide what to do next */
-			if (sig->opt == GIT_HASHSIG_SMART_WHITESPACE)
+			if (smart)
 				use_ignores = (ch == '\n');
 
 			if (scan >= end)
@@ -195,10 +294,7 @@ static int hashsig_add_hashes(
 		}
 
 		if (len > 0) {
-			hashsig_heap_insert(&sig->mins, (hashsig_t)state);
-			hashsig_heap_insert(&sig->maxs, (hashsig_t)state);
-
-			sig->considered++;
+			hashsig_insert(sig, (hashsig_t)state);
 
 			while (scan < end && (*scan == '\n' || !*scan))
 				++scan;
@@ -311,26 +407,160 @@ void git_hashsig_free(git_hashsig *sig)
 	git__free(sig);
 }
 
-static int hashsig_heap_compare(const hashsig_heap *a, const hashsig_heap *b)
+int git_hashsig_dup(git_hashsig **out, const git_hashsig *sig)
 {
-	int matches = 0, i, j, cmp;
+	git_hashsig *dup = git__malloc(sizeof(git_hashsig));
+	GITERR_CHECK_ALLOC(dup);
 
-	assert(a->cmp == b->cmp);
+	memcpy(dup, sig, sizeof(git_hashsig));
 
-	/* hash heaps are sorted - just look for overlap vs total */
+	*out = dup;
+	return 0;
+}
+
+/*
+ * A signature is written as the number of hashes considered, then the
+ * sizes of the heaps and the option, followed by the sorted hashes of
+ * each heap, all of them in network byte order.
+ */
+#define HASHSIG_HEADER_SIZE (2 * sizeof(uint32_t))
+
+static void hashsig_heap_write(char *out, const hashsig_heap *h)
+{
+	uint32_t value;
+	int i;
+
+	for (i = 0; i < h->size; ++i) {
+		value = htonl(h->values[i]);
+		memcpy(out + i * sizeof(value), &value, sizeof(value));
+	}
+}
+
+int git_hashsig_write(git_buf *out, const git_hashsig *sig)
+{
+	uint32_t header[2];
+	size_t len = HASHSIG_HEADER_SIZE +
+		(sig->mins.size + sig->maxs.size) * sizeof(hashsig_t);
+	char *data;
+
+	if (git_buf_grow(out, out->size + len + 1) < 0)
+		return -1;
+
+	data = out->ptr + out->size;
+
+	header[0] = htonl((uint32_t)sig->considered);
+	header[1] = htonl(((uint32_t)sig->mins.size << 16) |
+		((uint32_t)sig->maxs.size << 8) | (uint32_t)sig->opt);
+	memcpy(data, header, sizeof(header));
+
+	data += HASHSIG_HEADER_SIZE;
+	hashsig_heap_write(data, &sig->mins);
+
+	data += sig->mins.size * sizeof(hashsig_t);
+	hashsig_heap_write(data, &sig->maxs);
+
+	out->size += len;
+	out->ptr[out->size] = '\0';
+
+	return 0;
+}
+
+static void hashsig_heap_read(hashsig_heap *h, const char *data)
+{
+	uint32_t value;
+	int i;
+
+	for (i = 0; i < h->size; ++i) {
+		memcpy(&value, data + i * sizeof(value), sizeof(value));
+		h->values[i] = ntohl(value);
+	}
+}
+
+int git_hashsig_read(
+	git_hashsig **out, const char *data, size_t len, size_t *consumed)
+{
+	git_hashsig *sig;
+	uint32_t header[2];
+	int mins, maxs, opt;
+	size_t sig_len;
+
+	if (len < HASHSIG_HEADER_SIZE)
+		goto invalid;
+
+	memcpy(header, data, sizeof(header));
+	mins = (int)((ntohl(header[1]) >> 16) & 0xff);
+	maxs = (int)((ntohl(header[1]) >> 8) & 0xff);
+	opt  = (int)(ntohl(header[1]) & 0xff);
+
+	sig_len = HASHSIG_HEADER_SIZE + (mins + maxs) * sizeof(hashsig_t);
+
+	if (mins < HASHSIG_HEAP_MIN_SIZE || mins > HASHSIG_HEAP_SIZE ||
+		maxs > HASHSIG_HEAP_SIZE || opt > GIT_HASHSIG_SMART_WHITESPACE ||
+		sig_len > len)
+		goto invalid;
+
+	sig = hashsig_alloc((git_hashsig_option_t)opt);
+	GITERR_CHECK_ALLOC(sig);
+
+	sig->considered = (int)ntohl(header[0]);
+	sig->mins.size = mins;
+	sig->maxs.size = maxs;
 
-	for (i = 0, j = 0; i < a->size && j < b->size; ) {
-		cmp = a->cmp(&a->values[i], &b->values[j], NULL);
+	data += HASHSIG_HEADER_SIZE;
+	hashsig_heap_read(&sig->mins, data);
+	hashsig_heap_read(&sig->maxs, data + mins * sizeof(hashsig_t));
 
-		if (cmp < 0)
-			++i;
-		else if (cmp > 0)
-			++j;
-		else {
-			++i; ++j; ++matches;
+	*out = sig;
+	*consumed = sig_len;
+	return 0;
+
+invalid:
+	giterr_set(GITERR_INVALID, "Invalid similarity signature");
+	return -1;
+}
+
+/*
+ * Count the values two sorted arrays have in common, stepping through
+ * both with the results of comparisons rather than with branches, which
+ * are not predictable here.
+ */
+GIT_INLINE(int) hashsig_intersect(
+	const hashsig_t *a, int a_size,
+	const hashsig_t *b, int b_size,
+	bool descending)
+{
+	hashsig_t av, bv;
+	int matches = 0, i = 0, j = 0;
+
+	if (descending) {
+		while (i < a_size && j < b_size) {
+			av = a[i]; bv = b[j];
+			matches += (av == bv);
+			i += (av >= bv);
+			j += (bv >= av);
+		}
+	} else {
+		while (i < a_size && j < b_size) {
+			av = a[i]; bv = b[j];
+			matches += (av == bv);
+			i += (av <= bv);
+			j += (bv <= av);
 		}
 	}
 
+	return matches;
+}
+
+static int hashsig_heap_compare(const hashsig_heap *a, const hashsig_heap *b)
+{
+	int matches;
+
+	assert(a->cmp == b->cmp);
+
+	/* hash heaps are sorted - just look for overlap vs total */
+	matches = hashsig_intersect(a->values, a->size, b->values, b->size,
+		a->cmp == hashsig_cmp_min);
+
 	return HASHSIG_SCALE * (matches * 2) / (a->size + b->size);
 }
 
@@ -345,3 +575,267 @@ int git_hashsig_compare(const git_hashsig *a, const git_hashsig *b)
 		return (hashsig_heap_compare(&a->mins, &b->mins) +
 				hashsig_heap_compare(&a->maxs, &b->maxs)) / 2;
 }
+
+/*
+ * A signature with a similarity of at least T to another one shares at
+ * least `o` of the hashes in its mins or its maxs with it, where
+ * `o = T * n / (200 - T)` for its `n` hashes.  Ordering the hashes of
+ * every signature the same way, two signatures sharing `o` hashes share
+ * one of their first `n - o + 1` hashes; ordering them from the rarest
+ * keeps the lists of signatures under each hash short.
+ */
+
+#define HASHSIG_INDEX_KEY(heap, val) \
+	((git_off_t)(((uint64_t)(heap) << 32) | (uint64_t)(val)))
+
+typedef struct {
+	uint32_t count; /* number of indexed signatures with this hash */
+	git_array_t(uint32_t) entries; /* signatures with it in their prefix */
+} hashsig_index_key;
+
+typedef struct {
+	git_off_t key;
+	hashsig_index_key *info;
+} hashsig_prefix_key;
+
+typedef struct {
+	const git_hashsig *sig;
+	size_t id;
+} hashsig_index_entry;
+
+struct git_hashsig_index {
+	int threshold;
+	git_offmap *keys;
+	git_pool pool;
+	git_array_t(hashsig_index_entry) entries;
+	bool built;
+};
+
+int git_hashsig_index_new(git_hashsig_index **out, int threshold)
+{
+	git_hashsig_index *index;
+
+	assert(out);
+
+	index = git__calloc(1, sizeof(git_hashsig_index));
+	GITERR_CHECK_ALLOC(index);
+
+	index->threshold = (threshold < 1) ? 1 :
+		(threshold > HASHSIG_SCALE) ? HASHSIG_SCALE : threshold;
+
+	if (git_pool_init(&index->pool, sizeof(hashsig_index_key), 0) < 0 ||
+		(index->keys = git_offmap_alloc()) == NULL) {
+		git_hashsig_index_free(index);
+		giterr_set_oom();
+		return -1;
+	}
+
+	*out = index;
+	return 0;
+}
+
+static int hashsig_index_count(
+	git_hashsig_index *index, const hashsig_heap *h, int heap)
+{
+	hashsig_index_key *info;
+	git_off_t key;
+	khiter_t pos;
+	int i, ret;
+
+	for (i = 0; i < h->size; ++i) {
+		key = HASHSIG_INDEX_KEY(heap, h->values[i]);
+		pos = kh_put(off, index->keys, key, &ret);
+
+		if (ret < 0) {
+			giterr_set_oom();
+			return -1;
+		}
+
+		if (ret > 0) {
+			info = git_pool_mallocz(&index->pool, 1);
+			GITERR_CHECK_ALLOC(info);
+			kh_val(index->keys, pos) = info;
+		}
+
+		info = kh_val(index->keys, pos);
+		info->count++;
+	}
+
+	return 0;
+}
+
+int git_hashsig_index_add(
+	git_hashsig_index *index, const git_hashsig *sig, size_t id)
+{
+	hashsig_index_entry *entry;
+
+	assert(index && sig && !index->built);
+
+	entry = git_array_alloc(index->entries);
+	GITERR_CHECK_ALLOC(entry);
+
+	entry->sig = sig;
+	entry->id = id;
+
+	if (hashsig_index_count(index, &sig->mins, 0) < 0 ||
+		hashsig_index_count(index, &sig->maxs, 1) < 0)
+		return -1;
+
+	return 0;
+}
+
+static int hashsig_prefix_cmp(const void *a, const void *b, void *payload)
+{
+	const hashsig_prefix_key *ak = a, *bk = b;
+	uint32_t acount = ak->info ? ak->info->count : 0;
+	uint32_t bcount = bk->info ? bk->info->count : 0;
+
+	GIT_UNUSED(payload);
+
+	if (acount != bcount)
+		return (acount < bcount) ? -1 : 1;
+
+	return (ak->key < bk->key) ? -1 : (ak->key > bk->key) ? 1 : 0;
+}
+
+/* Fill `keys` with the hashes of the heap a similar signature must share */
+static int hashsig_prefix(
+	hashsig_prefix_key *keys,
+	git_hashsig_index *index,
+	const hashsig_heap *h,
+	int heap)
+{
+	int i, overlap, threshold = index->threshold;
+	khiter_t pos;
+
+	for (i = 0; i < h->size; ++i) {
+		keys[i].key = HASHSIG_INDEX_KEY(heap, h->values[i]);
+		pos = kh_get(off, index->keys, keys[i].key);
+		keys[i].info = (pos != kh_end(index->keys)) ?
+			kh_val(index->keys, pos) : NULL;
+	}
+
+	git__qsort_r(keys, h->size, sizeof(hashsig_prefix_key),
+		hashsig_prefix_cmp, NULL);
+
+	overlap = (threshold * h->size + (2 * HASHSIG_SCALE - threshold) - 1) /
+		(2 * HASHSIG_SCALE - threshold);
+	if (overlap < 1)
+		overlap = 1;
+
+	return h->size - overlap + 1;
+}
+
+int git_hashsig_index_build(git_hashsig_index *index)
+{
+	hashsig_prefix_key keys[HASHSIG_HEAP_SIZE];
+	hashsig_index_entry *entry;
+	uint32_t i, *e;
+	int heap, k, len;
+
+	assert(index);
+
+	if (index->built)
+		return 0;
+
+	for (i = 0; i < git_array_size(index->entries); ++i) {
+		entry = git_array_get(index->entries, i);
+
+		for (heap = 0; heap < 2; ++heap) {
+			len = hashsig_prefix(keys, index,
+				heap ? &entry->sig->maxs : &entry->sig->mins, heap);
+
+			for (k = 0; k < len; ++k) {
+				/* a hash may be in the heap more than once */
+				e = git_array_last(keys[k].info->entries);
+				if (e != NULL && *e == i)
+					continue;
+
+				e = git_array_alloc(keys[k].info->entries);
+				GITERR_CHECK_ALLOC(e);
+				*e = i;
+			}
+		}
+	}
+
+	index->built = true;
+	return 0;
+}
+
+static int id_cmp(const void *a, const void *b, void *payload)
+{
+	size_t aid = *(const size_t *)a, bid = *(const size_t *)b;
+	GIT_UNUSED(payload);
+	return (aid < bid) ? -1 : (aid > bid) ? 1 : 0;
+}
+
+int git_hashsig_index_lookup(
+	git_hashsig_ids *out, git_hashsig_index *index, const git_hashsig *sig)
+{
+	hashsig_prefix_key keys[HASHSIG_HEAP_SIZE];
+	hashsig_index_entry *entry;
+	uint32_t start, i, j, *e;
+	size_t *id;
+	int heap, k, len, smaller;
+
+	assert(out && index && sig);
+
+	if (git_hashsig_index_build(index) < 0)
+		return -1;
+
+	start = out->size;
+
+	for (heap = 0; heap < 2; ++heap) {
+		len = hashsig_prefix(keys, index, heap ? &sig->maxs : &sig->mins, heap);
+
+		for (k = 0; k < len; ++k) {
+			if (keys[k].info == NULL)
+				continue;
+
+			for (i = 0; i < git_array_size(keys[k].info->entries); ++i) {
+				e = git_array_get(keys[k].info->entries, i);
+				entry = git_array_get(index->entries, *e);
+
+				/* signatures of very different sizes can't be similar */
+				smaller = min(entry->sig->mins.size, sig->mins.size);
+				if (HASHSIG_SCALE * 2 * smaller <
+					index->threshold * (entry->sig->mins.size + sig->mins.size))
+					continue;
+
+				id = git_array_alloc(*out);
+				GITERR_CHECK_ALLOC(id);
+				*id = entry->id;
+			}
+		}
+	}
+
+	/* a signature may share several hashes with the one looked up */
+	git__qsort_r(out->ptr + start, out->size - start, sizeof(size_t), id_cmp, NULL);
+
+	for (i = start, j = start; i < out->size; ++i) {
+		if (j == start || out->ptr[j - 1] != out->ptr[i])
+			out->ptr[j++] = out->ptr[i];
+	}
+	out->size = j;
+
+	return 0;
+}
+
+void git_hashsig_index_free(git_hashsig_index *index)
+{
+	hashsig_index_key *info;
+
+	if (index == NULL)
+		return;
+
+	if (index->keys) {
+		git_offmap_foreach_value(index->keys, info, {
+			git_array_clear(info->entries);
+		});
+		git_offmap_free(index->keys);
+	}
+
+	git_pool_clear(&index->pool);
+	git_array_clear(index->entries);
+	git__free(index);
+}
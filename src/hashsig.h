@@ -8,6 +8,8 @@
 #define INCLUDE_hashsig_h__
 
 #include "common.h"
+#include "array.h"
+#include "buffer.h"
 
 /**
  * Similarity signature of line hashes for a buffer
@@ -60,6 +62,23 @@ extern int git_hashsig_create_fromfile(
  */
 extern void git_hashsig_free(git_hashsig *sig);
 
+/**
+ * Make a copy of a similarity signature
+ */
+extern int git_hashsig_dup(git_hashsig **out, const git_hashsig *sig);
+
+/**
+ * Append the serialized form of a signature to a buffer
+ */
+extern int git_hashsig_write(git_buf *out, const git_hashsig *sig);
+
+/**
+ * Read back a signature written by `git_hashsig_write` from the start
+ * of `data`, storing the number of bytes it took in `consumed`.
+ */
+extern int git_hashsig_read(
+	git_hashsig **out, const char *data, size_t len, size_t *consumed);
+
 /**
  * Measure similarity between two files
  *
@@ -69,4 +88,48 @@ extern int git_hashsig_compare(
 	const git_hashsig *a,
 	const git_hashsig *b);
 
+/**
+ * Index of signatures for finding similar ones
+ *
+ * Comparing each of a set of signatures with each of another is
+ * quadratic.  The index only returns the signatures which could possibly
+ * reach a given similarity with the one being looked up: two signatures
+ * which are that similar must share some of their hashes, and looking at
+ * the rarest hashes of each is enough to find them.  No match which
+ * reaches the threshold is ever left out.
+ */
+typedef struct git_hashsig_index git_hashsig_index;
+
+typedef git_array_t(size_t) git_hashsig_ids;
+
+/**
+ * Create an index for finding signatures with a similarity of at least
+ * `threshold` (between 1 and 100) to the ones looked up.
+ */
+extern int git_hashsig_index_new(git_hashsig_index **out, int threshold);
+
+/**
+ * Add a signature to the index, under the given id.  The signature must
+ * stay alive as long as the index is used.  Signatures cannot be added
+ * once lookups have started.
+ */
+extern int git_hashsig_index_add(
+	git_hashsig_index *index, const git_hashsig *sig, size_t id);
+
+/**
+ * Prepare the index for lookups once all signatures are added.  This is
+ * done by the first lookup otherwise; once built, the index isn't
+ * modified by lookups, which can be made from several threads.
+ */
+extern int git_hashsig_index_build(git_hashsig_index *index);
+
+/**
+ * Find the ids of the signatures which may be similar enough to `sig`.
+ * They are appended to `out` in increasing order.
+ */
+extern int git_hashsig_index_lookup(
+	git_hashsig_ids *out, git_hashsig_index *index, const git_hashsig *sig);
+
+extern void git_hashsig_index_free(git_hashsig_index *index);
+
 #endif
@@ -17,6 +17,12 @@
 #include "pathspec.h"
 #include "ignore.h"
 #include "blob.h"
+#include "bitvec.h"
+#include "ewah.h"
+#include "array.h"
+#include "filter.h"
+#include "odb.h"
+#include "diff.h"
 
 #include "git2/odb.h"
 #include "git2/oid.h"
@@ -40,6 +46,8 @@ static const unsigned int INDEX_HEADER_SIG = 0x44495243;
 static const char INDEX_EXT_TREECACHE_SIG[] = {'T', 'R', 'E', 'E'};
 static const char INDEX_EXT_UNMERGED_SIG[] = {'R', 'E', 'U', 'C'};
 static const char INDEX_EXT_CONFLICT_NAME_SIG[] = {'N', 'A', 'M', 'E'};
+static const char INDEX_EXT_UNTRACKED_SIG[] = {'U', 'N', 'T', 'R'};
+static const char INDEX_EXT_FSMONITOR_SIG[] = {'F', 'S', 'M', 'N'};
 
 #define INDEX_OWNER(idx) ((git_repository *)(GIT_REFCOUNT_OWNER(idx)))
 
@@ -495,8 +503,10 @@ static int index_remove_entry(git_index *index, size_t pos)
 	int error = 0;
 	git_index_entry *entry = git_vector_get(&index->entries, pos);
 
-	if (entry != NULL)
+	if (entry != NULL) {
 		git_tree_cache_invalidate_path(index->tree, entry->path);
+		git_untracked_cache_invalidate_path(index->untracked, entry->path);
+	}
 
 	error = git_vector_remove(&index->entries, pos);
 
@@ -525,6 +535,12 @@ int git_index_clear(git_index *index)
 		return -1;
 	}
 
+	git_untracked_cache_free(index->untracked);
+	index->untracked = NULL;
+
+	git__free(index->fsmonitor_token);
+	index->fsmonitor_token = NULL;
+
 	while (!error && index->entries.length > 0)
 		error = index_remove_entry(index, index->entries.length - 1);
 	index_free_deleted(index);
@@ -641,10 +657,63 @@ int git_index__changed_relative_to(
 		giterr_clear();
 
 	return (index->stamp.mtime != fs->mtime ||
+			index->stamp.mtime_nsec != fs->mtime_nsec ||
 			index->stamp.size != fs->size ||
 			index->stamp.ino != fs->ino);
 }
 
+/* Entries that were modified no earlier than the index file are racily
+ * clean: once the index is rewritten (and so becomes newer than them),
+ * a change made to them within the same timestamp would go unnoticed.
+ * Check them against the working directory now and smudge the size of
+ * the modified ones, so that they are never mistaken for unmodified.
+ */
+static int truncate_racily_clean(git_index *index)
+{
+	git_repository *repo = INDEX_OWNER(index);
+	git_diff_options diff_opts = GIT_DIFF_OPTIONS_INIT;
+	git_diff *diff = NULL;
+	git_vector paths = GIT_VECTOR_INIT;
+	git_diff_delta *delta;
+	git_index_entry *entry;
+	size_t i;
+	int error = 0;
+
+	if (!repo || git_repository_is_bare(repo))
+		return 0;
+
+	git_vector_foreach(&index->entries, i, entry) {
+		if (GIT_IDXENTRY_STAGE(entry) == 0 &&
+			git_index__entry_is_racy(index, entry) &&
+			(error = git_vector_insert(&paths, (char *)entry->path)) < 0)
+			goto done;
+	}
+
+	if (!paths.length)
+		goto done;
+
+	diff_opts.flags |= GIT_DIFF_INCLUDE_TYPECHANGE |
+		GIT_DIFF_IGNORE_SUBMODULES | GIT_DIFF_DISABLE_PATHSPEC_MATCH;
+	diff_opts.pathspec.count = paths.length;
+	diff_opts.pathspec.strings = (char **)paths.contents;
+
+	if ((error = git_diff_index_to_workdir(&diff, repo, index, &diff_opts)) < 0)
+		goto done;
+
+	git_vector_foreach(&diff->deltas, i, delta) {
+		entry = (git_index_entry *)git_index_get_bypath(
+			index, delta->old_file.path, 0);
+
+		if (entry != NULL)
+			entry->file_size = 0;
+	}
+
+done:
+	git_diff_free(diff);
+	git_vector_free(&paths);
+	return error;
+}
+
 int git_index_write(git_index *index)
 {
 	git_filebuf file = GIT_FILEBUF_INIT;
@@ -658,6 +727,9 @@ int git_index_write(git_index *index)
 		return -1;
 	git_vector_sort(&index->reuc);
 
+	if ((error = truncate_racily_clean(index)) < 0)
+		return error;
+
 	if ((error = git_filebuf_open(
 		&file, index->index_file_path, GIT_FILEBUF_HASH_CONTENTS, GIT_INDEX_FILE_MODE)) < 0) {
 		if (error == GIT_ELOCKED)
@@ -745,8 +817,10 @@ void git_index_entry__init_from_stat(
 {
 	entry->ctime.seconds = (git_time_t)st->st_ctime;
 	entry->mtime.seconds = (git_time_t)st->st_mtime;
-	/* entry->mtime.nanoseconds = st->st_mtimensec; */
-	/* entry->ctime.nanoseconds = st->st_ctimensec; */
+#if defined(GIT_USE_NSEC)
+	entry->mtime.nanoseconds = (unsigned int)st->st_mtime_nsec;
+	entry->ctime.nanoseconds = (unsigned int)st->st_ctime_nsec;
+#endif
 	entry->dev  = st->st_rdev;
 	entry->ino  = st->st_ino;
 	entry->mode = (!trust_mode && S_ISREG(st->st_mode)) ?
@@ -987,6 +1061,9 @@ static int index_insert(
 
 	entry = *entry_ptr;
 
+	/* nothing is known about how the new entry relates to the monitor */
+	entry->flags_extended &= ~GIT_IDXENTRY_FSMONITOR_VALID;
+
 	/* make sure that the path length flag is correct */
 	path_length = ((struct entry_internal *)entry)->pathlen;
 
@@ -1032,6 +1109,9 @@ static int index_insert(
 		 * check for dups, this is actually cheaper in the long run.)
 		 */
 		error = git_vector_insert_sorted(&index->entries, entry, index_no_dups);
+
+		if (!error)
+			git_untracked_cache_invalidate_path(index->untracked, entry->path);
 	}
 
 	if (error < 0) {
@@ -1794,6 +1874,7 @@ static size_t read_entry(
 
 		flags_raw = ntohs(source_l->flags_extended);
 		memcpy(&entry.flags_extended, &flags_raw, 2);
+		entry.flags_extended &= ~GIT_IDXENTRY_FSMONITOR_VALID;
 	} else
 		path_ptr = source->path;
 
@@ -1844,6 +1925,79 @@ static int read_header(struct index_header *dest, const void *buffer)
 	return 0;
 }
 
+/*
+ * The file system monitor extension, as written by core git: a version,
+ * the token (a nanosecond timestamp in version 1, a string in version 2)
+ * and an EWAH bitmap of the entries that are *not* known to be unchanged
+ * since the token was handed out.
+ */
+static int read_fsmonitor(git_index *index, const char *buffer, size_t size)
+{
+	const char *end = buffer + size, *token_end;
+	uint32_t version, dirty_size;
+	git_bitvec dirty;
+	git_index_entry *entry;
+	git_buf token = GIT_BUF_INIT;
+	size_t i;
+
+	if (size < 4)
+		return index_error_invalid("truncated fsmonitor extension");
+
+	memcpy(&version, buffer, 4);
+	version = ntohl(version);
+	buffer += 4;
+
+	if (version == 1 && end - buffer >= 8) {
+		uint32_t hi, lo;
+		memcpy(&hi, buffer, 4);
+		memcpy(&lo, buffer + 4, 4);
+		git_buf_printf(&token, "%" PRIu64,
+			((uint64_t)ntohl(hi) << 32) | ntohl(lo));
+		buffer += 8;
+	} else if (version == 2 &&
+		(token_end = memchr(buffer, '\0', end - buffer)) != NULL) {
+		git_buf_put(&token, buffer, token_end - buffer);
+		buffer = token_end + 1;
+	} else
+		return index_error_invalid("unsupported fsmonitor extension");
+
+	if (git_buf_oom(&token))
+		return -1;
+
+	if (end - buffer < 4) {
+		git_buf_free(&token);
+		return index_error_invalid("truncated fsmonitor extension");
+	}
+
+	memcpy(&dirty_size, buffer, 4);
+	dirty_size = ntohl(dirty_size);
+	buffer += 4;
+
+	if (dirty_size > (size_t)(end - buffer) ||
+		git_bitvec_init(&dirty, index->entries.length) < 0) {
+		git_buf_free(&token);
+		return index_error_invalid("truncated fsmonitor extension");
+	}
+
+	if (git_ewah_read(
+			&dirty, index->entries.length, &buffer, buffer + dirty_size) < 0) {
+		git_bitvec_free(&dirty);
+		git_buf_free(&token);
+		return index_error_invalid("invalid fsmonitor bitmap");
+	}
+
+	git_vector_foreach(&index->entries, i, entry) {
+		if (!git_bitvec_get(&dirty, i))
+			entry->flags_extended |= GIT_IDXENTRY_FSMONITOR_VALID;
+	}
+
+	git__free(index->fsmonitor_token);
+	index->fsmonitor_token = git_buf_detach(&token);
+
+	git_bitvec_free(&dirty);
+	return 0;
+}
+
 static size_t read_extension(git_index *index, const char *buffer, size_t buffer_size)
 {
 	const struct index_extension *source;
@@ -1874,6 +2028,17 @@ static size_t read_extension(git_index *index, const char *buffer, size_t buffer
 		} else if (memcmp(dest.signature, INDEX_EXT_CONFLICT_NAME_SIG, 4) == 0) {
 			if (read_conflict_names(index, buffer + 8, dest.extension_size) < 0)
 				return 0;
+		} else if (memcmp(dest.signature, INDEX_EXT_UNTRACKED_SIG, 4) == 0) {
+			/* the untracked cache is only an optimization, so (like core
+			 * git) we silently drop it if it can't be parsed */
+			git_untracked_cache_free(index->untracked);
+			if (git_untracked_cache_read(
+					&index->untracked, buffer + 8, dest.extension_size) < 0)
+				giterr_clear();
+		} else if (memcmp(dest.signature, INDEX_EXT_FSMONITOR_SIG, 4) == 0) {
+			/* likewise for the file system monitor data */
+			if (read_fsmonitor(index, buffer + 8, dest.extension_size) < 0)
+				giterr_clear();
 		}
 		/* else, unsupported extension. We cannot parse this, but we can skip
 		 * it by returning `total_size */
@@ -2055,7 +2220,8 @@ static int write_disk_entry(git_filebuf *file, git_index_entry *entry)
 	if (entry->flags & GIT_IDXENTRY_EXTENDED) {
 		struct entry_long *ondisk_ext;
 		ondisk_ext = (struct entry_long *)ondisk;
-		ondisk_ext->flags_extended = htons(entry->flags_extended);
+		ondisk_ext->flags_extended =
+			htons(entry->flags_extended & GIT_IDXENTRY_EXTENDED_FLAGS);
 		path = ondisk_ext->path;
 	}
 	else
@@ -2218,6 +2384,92 @@ done:
 	return error;
 }
 
+static int write_untracked_extension(git_index *index, git_filebuf *file)
+{
+	git_buf untracked_buf = GIT_BUF_INIT;
+	struct index_extension extension;
+	int error;
+
+	if ((error = git_untracked_cache_write(&untracked_buf, index->untracked)) < 0)
+		goto done;
+
+	memset(&extension, 0x0, sizeof(struct index_extension));
+	memcpy(&extension.signature, INDEX_EXT_UNTRACKED_SIG, 4);
+	extension.extension_size = (uint32_t)untracked_buf.size;
+
+	error = write_extension(file, &extension, &untracked_buf);
+
+done:
+	git_buf_free(&untracked_buf);
+	return error;
+}
+
+static int write_fsmonitor_extension(git_index *index, git_filebuf *file)
+{
+	struct index_extension extension;
+	git_buf fsmonitor_buf = GIT_BUF_INIT, dirty_buf = GIT_BUF_INIT;
+	git_vector case_sorted, *entries;
+	git_index_entry *entry;
+	git_bitvec dirty;
+	uint32_t version = htonl(2), dirty_size;
+	size_t i;
+	int error;
+
+	if (git_mutex_lock(&index->lock) < 0) {
+		giterr_set(GITERR_OS, "Failed to lock index");
+		return -1;
+	}
+
+	/* the bitmap follows the order of the entries on disk */
+	if (index->ignore_case) {
+		git_vector_dup(&case_sorted, &index->entries, git_index_entry_cmp);
+		git_vector_sort(&case_sorted);
+		entries = &case_sorted;
+	} else {
+		entries = &index->entries;
+	}
+
+	if (!(error = git_bitvec_init(&dirty, entries->length))) {
+		git_vector_foreach(entries, i, entry) {
+			if (!(entry->flags_extended & GIT_IDXENTRY_FSMONITOR_VALID))
+				git_bitvec_set(&dirty, i, true);
+		}
+
+		error = git_ewah_write(&dirty_buf, &dirty, entries->length);
+		git_bitvec_free(&dirty);
+	}
+
+	git_mutex_unlock(&index->lock);
+
+	if (index->ignore_case)
+		git_vector_free(&case_sorted);
+
+	if (error < 0)
+		goto done;
+
+	dirty_size = htonl((uint32_t)dirty_buf.size);
+
+	git_buf_put(&fsmonitor_buf, (char *)&version, sizeof(version));
+	git_buf_put(&fsmonitor_buf,
+		index->fsmonitor_token, strlen(index->fsmonitor_token) + 1);
+	git_buf_put(&fsmonitor_buf, (char *)&dirty_size, sizeof(dirty_size));
+	git_buf_put(&fsmonitor_buf, dirty_buf.ptr, dirty_buf.size);
+
+	if ((error = git_buf_oom(&fsmonitor_buf) ? -1 : 0) < 0)
+		goto done;
+
+	memset(&extension, 0x0, sizeof(struct index_extension));
+	memcpy(&extension.signature, INDEX_EXT_FSMONITOR_SIG, 4);
+	extension.extension_size = (uint32_t)fsmonitor_buf.size;
+
+	error = write_extension(file, &extension, &fsmonitor_buf);
+
+done:
+	git_buf_free(&fsmonitor_buf);
+	git_buf_free(&dirty_buf);
+	return error;
+}
+
 static int write_index(git_index *index, git_filebuf *file)
 {
 	git_oid hash_final;
@@ -2250,6 +2502,14 @@ static int write_index(git_index *index, git_filebuf *file)
 	if (index->reuc.length > 0 && write_reuc_extension(index, file) < 0)
 		return -1;
 
+	/* write the untracked cache extension */
+	if (index->untracked && write_untracked_extension(index, file) < 0)
+		return -1;
+
+	/* write the file system monitor extension */
+	if (index->fsmonitor_token && write_fsmonitor_extension(index, file) < 0)
+		return -1;
+
 	/* get out the hash for all the contents we've appended to the file */
 	git_filebuf_hash(&hash_final, file);
 
@@ -2356,181 +2616,895 @@ git_repository *git_index_owner(const git_index *index)
 	return INDEX_OWNER(index);
 }
 
-int git_index_add_all(
-	git_index *index,
-	const git_strarray *paths,
-	unsigned int flags,
-	git_index_matched_path_cb cb,
-	void *payload)
-{
-	int error;
-	git_repository *repo;
-	git_iterator *wditer = NULL;
-	const git_index_entry *wd = NULL;
+typedef struct {
 	git_index_entry *entry;
-	git_pathspec ps;
-	const char *match;
-	size_t existing;
-	bool no_fnmatch = (flags & GIT_INDEX_ADD_DISABLE_PATHSPEC_MATCH) != 0;
-	int ignorecase;
-	git_oid blobid;
+	size_t seq;
+	unsigned int remove:1,
+		resolve:1,
+		kept:1;
+} index_batch_op;
 
-	assert(index);
+struct git_index_batch {
+	git_index *index;
+	git_array_t(index_batch_op) ops;
+};
 
-	if (INDEX_OWNER(index) == NULL)
-		return create_index_error(-1,
-			"Could not add paths to index. "
-			"Index is not backed up by an existing repository.");
+/* the state of one entry while a batch is merged into the index */
+typedef struct {
+	git_index_entry *entry;
+	git_index_entry *existing; /* entry in the index replaced by `entry` */
+	index_batch_op *op;
+	unsigned int dropped:1;
+} index_batch_slot;
 
-	repo = INDEX_OWNER(index);
-	if ((error = git_repository__ensure_not_bare(repo, "index add all")) < 0)
-		return error;
+typedef git_array_t(index_batch_slot) index_batch_slots;
 
-	if (git_repository__cvar(&ignorecase, repo, GIT_CVAR_IGNORECASE) < 0)
-		return -1;
+static int index_batch_op_cmp(const void *a, const void *b)
+{
+	const index_batch_op *op_a = a, *op_b = b;
+	int diff = git_index_entry_cmp(op_a->entry, op_b->entry);
 
-	if ((error = git_pathspec__init(&ps, paths)) < 0)
-		return error;
+	if (!diff)
+		diff = (op_a->seq < op_b->seq) ? -1 : (op_a->seq > op_b->seq);
 
-	/* optionally check that pathspec doesn't mention any ignored files */
-	if ((flags & GIT_INDEX_ADD_CHECK_PATHSPEC) != 0 &&
-		(flags & GIT_INDEX_ADD_FORCE) == 0 &&
-		(error = git_ignore__check_pathspec_for_exact_ignores(
-			repo, &ps.pathspec, no_fnmatch)) < 0)
-		goto cleanup;
+	return diff;
+}
 
-	if ((error = git_iterator_for_workdir(
-			&wditer, repo, 0, ps.prefix, ps.prefix)) < 0)
-		goto cleanup;
+static int index_batch_op_icmp(const void *a, const void *b)
+{
+	const index_batch_op *op_a = a, *op_b = b;
+	int diff = git_index_entry_icmp(op_a->entry, op_b->entry);
 
-	while (!(error = git_iterator_advance(&wd, wditer))) {
+	if (!diff)
+		diff = (op_a->seq < op_b->seq) ? -1 : (op_a->seq > op_b->seq);
 
-		/* check if path actually matches */
-		if (!git_pathspec__match(
-				&ps.pathspec, wd->path, no_fnmatch, (bool)ignorecase, &match, NULL))
-			continue;
+	return diff;
+}
 
-		/* skip ignored items that are not already in the index */
-		if ((flags & GIT_INDEX_ADD_FORCE) == 0 &&
-			git_iterator_current_is_ignored(wditer) &&
-			index_find(&existing, index, wd->path, 0, 0, true) < 0)
-			continue;
+int git_index_batch_new(git_index_batch **out, git_index *index)
+{
+	git_index_batch *batch;
 
-		/* issue notification callback if requested */
-		if (cb && (error = cb(wd->path, match, payload)) != 0) {
-			if (error > 0) /* return > 0 means skip this one */
-				continue;
-			if (error < 0) { /* return < 0 means abort */
-				giterr_set_after_callback(error);
-				break;
-			}
-		}
+	assert(out && index);
 
-		/* TODO: Should we check if the file on disk is already an exact
-		 * match to the file in the index and skip this work if it is?
-		 */
+	batch = git__calloc(1, sizeof(git_index_batch));
+	GITERR_CHECK_ALLOC(batch);
 
-		/* write the blob to disk and get the oid */
-		if ((error = git_blob_create_fromworkdir(&blobid, repo, wd->path)) < 0)
-			break;
+	batch->index = index;
+	git_array_init(batch->ops);
 
-		/* make the new entry to insert */
-		if ((error = index_entry_dup(&entry, wd)) < 0)
-			break;
+	*out = batch;
+	return 0;
+}
 
-		entry->id = blobid;
+/* index_batch_push takes ownership of the entry, freeing it on failure */
+static int index_batch_push(
+	git_index_batch *batch, git_index_entry *entry, bool remove, bool resolve)
+{
+	index_batch_op *op;
+	size_t path_length = ((struct entry_internal *)entry)->pathlen;
 
-		/* add working directory item to index */
-		if ((error = index_insert(index, &entry, 1)) < 0)
-			break;
+	entry->flags_extended &= ~GIT_IDXENTRY_FSMONITOR_VALID;
 
-		git_tree_cache_invalidate_path(index->tree, wd->path);
+	entry->flags &= ~GIT_IDXENTRY_NAMEMASK;
 
-		/* add implies conflict resolved, move conflict entries to REUC */
-		if ((error = index_conflict_to_reuc(index, wd->path)) < 0) {
-			if (error != GIT_ENOTFOUND)
-				break;
-			giterr_clear();
-		}
-	}
+	if (path_length < GIT_IDXENTRY_NAMEMASK)
+		entry->flags |= path_length & GIT_IDXENTRY_NAMEMASK;
+	else
+		entry->flags |= GIT_IDXENTRY_NAMEMASK;
 
-	if (error == GIT_ITEROVER)
-		error = 0;
+	if ((op = git_array_alloc(batch->ops)) == NULL) {
+		index_entry_free(entry);
+		giterr_set_oom();
+		return -1;
+	}
 
-cleanup:
-	git_iterator_free(wditer);
-	git_pathspec__clear(&ps);
+	op->entry = entry;
+	op->seq = git_array_size(batch->ops);
+	op->remove = remove;
+	op->resolve = resolve;
+	op->kept = 0;
 
-	return error;
+	return 0;
 }
 
-enum {
-	INDEX_ACTION_NONE = 0,
-	INDEX_ACTION_UPDATE = 1,
-	INDEX_ACTION_REMOVE = 2,
-};
-
-static int index_apply_to_all(
-	git_index *index,
-	int action,
-	const git_strarray *paths,
-	git_index_matched_path_cb cb,
-	void *payload)
+int git_index_batch_add(
+	git_index_batch *batch, const git_index_entry *source_entry)
 {
-	int error = 0;
-	size_t i;
-	git_pathspec ps;
-	const char *match;
-	git_buf path = GIT_BUF_INIT;
+	git_index_entry *entry = NULL;
+	int error;
 
-	assert(index);
+	assert(batch && source_entry && source_entry->path);
+
+	if (!valid_filemode(source_entry->mode)) {
+		giterr_set(GITERR_INDEX, "invalid filemode");
+		return -1;
+	}
 
-	if ((error = git_pathspec__init(&ps, paths)) < 0)
+	if ((error = index_entry_dup(&entry, source_entry)) < 0)
 		return error;
 
-	git_vector_sort(&index->entries);
+	return index_batch_push(batch, entry, false, false);
+}
 
-	for (i = 0; !error && i < index->entries.length; ++i) {
-		git_index_entry *entry = git_vector_get(&index->entries, i);
+int git_index_batch_add_bypath(git_index_batch *batch, const char *path)
+{
+	git_index_entry *entry = NULL;
+	int error;
 
-		/* check if path actually matches */
-		if (!git_pathspec__match(
-				&ps.pathspec, entry->path, false, (bool)index->ignore_case,
-				&match, NULL))
-			continue;
+	assert(batch && path);
 
-		/* issue notification callback if requested */
-		if (cb && (error = cb(entry->path, match, payload)) != 0) {
-			if (error > 0) { /* return > 0 means skip this one */
-				error = 0;
-				continue;
-			}
-			if (error < 0)   /* return < 0 means abort */
-				break;
-		}
+	if ((error = index_entry_init(&entry, batch->index, path)) < 0)
+		return error;
 
-		/* index manipulation may alter entry, so don't depend on it */
-		if ((error = git_buf_sets(&path, entry->path)) < 0)
+	return index_batch_push(batch, entry, false, true);
+}
+
+static int index_batch_remove(
+	git_index_batch *batch, const char *path, int stage, bool resolve)
+{
+	git_index_entry *entry = index_entry_alloc(path);
+	GITERR_CHECK_ALLOC(entry);
+
+	GIT_IDXENTRY_STAGE_SET(entry, stage);
+
+	return index_batch_push(batch, entry, true, resolve);
+}
+
+int git_index_batch_remove(
+	git_index_batch *batch, const char *path, int stage)
+{
+	assert(batch && path);
+	return index_batch_remove(batch, path, stage, false);
+}
+
+int git_index_batch_remove_bypath(git_index_batch *batch, const char *path)
+{
+	assert(batch && path);
+	return index_batch_remove(batch, path, 0, true);
+}
+
+static void index_batch_clear(git_index_batch *batch)
+{
+	size_t i;
+
+	for (i = 0; i < git_array_size(batch->ops); ++i) {
+		index_batch_op *op = git_array_get(batch->ops, i);
+
+		if (!op->kept)
+			index_entry_free(op->entry);
+	}
+
+	git_array_clear(batch->ops);
+}
+
+void git_index_batch_free(git_index_batch *batch)
+{
+	if (batch == NULL)
+		return;
+
+	index_batch_clear(batch);
+	git__free(batch);
+}
+
+/* call with locked index; free an entry that was removed from the index
+ * or keep it alive until the last reader is done */
+static int index_batch_release(git_index *index, git_index_entry *entry)
+{
+	git_tree_cache_invalidate_path(index->tree, entry->path);
+	git_untracked_cache_invalidate_path(index->untracked, entry->path);
+
+	if (git_atomic_get(&index->readers) > 0)
+		return git_vector_insert(&index->deleted, entry);
+
+	index_entry_free(entry);
+	return 0;
+}
+
+/* call with locked index; merge the (sorted) operations with the sorted
+ * entries of the index into `slots`, without changing anything yet.
+ * Entries removed by the batch end up in `removed` and the conflicts
+ * resolved by it in `resolved` (grouped by path).
+ */
+static int index_batch_merge(
+	index_batch_slots *slots,
+	git_vector *removed,
+	git_vector *resolved,
+	git_index *index,
+	git_vector *ops)
+{
+	size_t i = 0, j = 0;
+	const char *resolve_path = NULL;
+	index_batch_slot *slot;
+	int (*strcomp)(const char *, const char *) =
+		index->ignore_case ? git__strcasecmp : git__strcmp;
+
+	while (i < index->entries.length || j < ops->length) {
+		git_index_entry *existing = git_vector_get(&index->entries, i);
+		index_batch_op *op = git_vector_get(ops, j);
+		int cmp;
+
+		/* only the last change to each path and stage counts, but
+		 * conflicts resolved by earlier ones stay resolved */
+		if (op && j + 1 < ops->length) {
+			index_batch_op *next = ops->contents[j + 1];
+
+			if (!index->entries._cmp(op->entry, next->entry)) {
+				next->resolve |= op->resolve;
+				j++;
+				continue;
+			}
+		}
+
+		if (!existing)
+			cmp = 1;
+		else if (!op)
+			cmp = -1;
+		else
+			cmp = index->entries._cmp(existing, op->entry);
+
+		if (cmp < 0) {
+			i++;
+
+			if (GIT_IDXENTRY_STAGE(existing) > 0 && resolve_path &&
+				!strcomp(existing->path, resolve_path)) {
+				if (git_vector_insert(resolved, existing) < 0)
+					return -1;
+				continue;
+			}
+
+			if ((slot = git_array_alloc(*slots)) == NULL)
+				goto on_oom;
+
+			slot->entry = existing;
+			slot->existing = NULL;
+			slot->op = NULL;
+			slot->dropped = 0;
+			continue;
+		}
+
+		j++;
+
+		if (op->resolve)
+			resolve_path = op->entry->path;
+
+		if (cmp == 0)
+			i++;
+
+		if (op->remove) {
+			if (cmp == 0 && git_vector_insert(removed, existing) < 0)
+				return -1;
+			continue;
+		}
+
+		if ((slot = git_array_alloc(*slots)) == NULL)
+			goto on_oom;
+
+		slot->entry = op->entry;
+		slot->existing = (cmp == 0) ? existing : NULL;
+		slot->op = op;
+		slot->dropped = 0;
+	}
+
+	return 0;
+
+on_oom:
+	giterr_set_oom();
+	return -1;
+}
+
+/* Look for files that collide with directories in a single pass over the
+ * merged entries: all paths that start with a given path directly follow
+ * it, so a stack of the preceding paths that are prefixes of the current
+ * one holds every file that could be one of its parent directories.
+ * Collisions between an entry from the batch and one that was already in
+ * the index are resolved in favor of the batch.
+ */
+static int index_batch_check_collisions(
+	git_index *index, index_batch_slots *slots)
+{
+	size_t *stack, depth = 0, i, j, count = git_array_size(*slots);
+	int (*strncomp)(const char *, const char *, size_t) =
+		index->ignore_case ? git__strncasecmp : git__strncmp;
+	int error = 0;
+
+	stack = git__calloc(count ? count : 1, sizeof(size_t));
+	GITERR_CHECK_ALLOC(stack);
+
+	for (i = 0; i < count && !error; ++i) {
+		index_batch_slot *cur = git_array_get(*slots, i);
+		size_t cur_len = ((struct entry_internal *)cur->entry)->pathlen;
+
+		while (depth > 0) {
+			index_batch_slot *top = git_array_get(*slots, stack[depth - 1]);
+			size_t top_len = ((struct entry_internal *)top->entry)->pathlen;
+
+			if (top_len <= cur_len &&
+				!strncomp(top->entry->path, cur->entry->path, top_len))
+				break;
+
+			depth--;
+		}
+
+		for (j = 0; j < depth; ++j) {
+			index_batch_slot *file = git_array_get(*slots, stack[j]);
+			size_t file_len = ((struct entry_internal *)file->entry)->pathlen;
+
+			if (file->dropped ||
+				cur->entry->path[file_len] != '/' ||
+				GIT_IDXENTRY_STAGE(file->entry) !=
+					GIT_IDXENTRY_STAGE(cur->entry))
+				continue;
+
+			if (file->op && cur->op) {
+				giterr_set(GITERR_INDEX,
+					"'%s' appears as both a file and a directory",
+					file->entry->path);
+				error = -1;
+				break;
+			} else if (cur->op) {
+				file->dropped = 1;
+			} else if (file->op) {
+				cur->dropped = 1;
+				break;
+			}
+
+			/* entries that were both in the index already are left be */
+		}
+
+		if (!cur->dropped)
+			stack[depth++] = i;
+	}
+
+	git__free(stack);
+	return error;
+}
+
+/* call with locked index; move the conflicts for each path in `resolved`
+ * to the REUC section */
+static int index_batch_resolve(git_index *index, git_vector *resolved)
+{
+	size_t i = 0, j;
+	int error = 0;
+	int (*strcomp)(const char *, const char *) =
+		index->ignore_case ? git__strcasecmp : git__strcmp;
+
+	while (!error && i < resolved->length) {
+		git_index_entry *conflict[3] = { NULL, NULL, NULL }, *entry;
+		const char *path = ((git_index_entry *)resolved->contents[i])->path;
+
+		for (j = i; j < resolved->length; ++j) {
+			entry = resolved->contents[j];
+
+			if (strcomp(entry->path, path) != 0)
+				break;
+
+			conflict[GIT_IDXENTRY_STAGE(entry) - 1] = entry;
+		}
+
+		error = git_index_reuc_add(index, path,
+			conflict[0] ? conflict[0]->mode : 0,
+			conflict[0] ? &conflict[0]->id : NULL,
+			conflict[1] ? conflict[1]->mode : 0,
+			conflict[1] ? &conflict[1]->id : NULL,
+			conflict[2] ? conflict[2]->mode : 0,
+			conflict[2] ? &conflict[2]->id : NULL);
+
+		for (; i < j; ++i)
+			if (index_batch_release(index, resolved->contents[i]) < 0)
+				error = -1;
+	}
+
+	return error;
+}
+
+int git_index_batch_commit(git_index_batch *batch)
+{
+	git_index *index;
+	git_vector ops = GIT_VECTOR_INIT, entries = GIT_VECTOR_INIT;
+	git_vector removed = GIT_VECTOR_INIT, resolved = GIT_VECTOR_INIT;
+	index_batch_slots slots = GIT_ARRAY_INIT;
+	size_t i;
+	int error;
+
+	assert(batch);
+
+	index = batch->index;
+
+	if (!git_array_size(batch->ops))
+		return 0;
+
+	if ((error = git_vector_init(&ops, git_array_size(batch->ops),
+			index->ignore_case ? index_batch_op_icmp : index_batch_op_cmp)) < 0)
+		return error;
+
+	for (i = 0; i < git_array_size(batch->ops); ++i)
+		git_vector_insert(&ops, git_array_get(batch->ops, i));
+
+	git_vector_sort(&ops);
+
+	if (git_mutex_lock(&index->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to acquire index lock");
+		git_vector_free(&ops);
+		return -1;
+	}
+
+	git_vector_sort(&index->entries);
+
+	if ((error = index_batch_merge(
+			&slots, &removed, &resolved, index, &ops)) < 0 ||
+		(error = index_batch_check_collisions(index, &slots)) < 0 ||
+		(error = git_vector_init(
+			&entries, git_array_size(slots), index->entries._cmp)) < 0)
+		goto done;
+
+	/* nothing has been changed up to here; apply the merged entries */
+	for (i = 0; i < git_array_size(slots); ++i) {
+		index_batch_slot *slot = git_array_get(slots, i);
+		git_index_entry *entry = slot->entry;
+
+		if (slot->dropped) {
+			if (index_batch_release(index, entry) < 0)
+				error = -1;
+			continue;
+		}
+
+		if (slot->op) {
+			git_tree_cache_invalidate_path(index->tree, entry->path);
+
+			if (slot->existing) {
+				/* update filemode to existing values if stat is not trusted */
+				entry->mode = index_merge_mode(index, slot->existing, entry->mode);
+				index_entry_cpy(slot->existing, entry);
+				entry = slot->existing;
+			} else {
+				git_untracked_cache_invalidate_path(index->untracked, entry->path);
+				slot->op->kept = 1;
+			}
+		}
+
+		git_vector_insert(&entries, entry);
+	}
+
+	git_vector_set_sorted(&entries, 1);
+	git_vector_swap(&entries, &index->entries);
+
+	for (i = 0; i < removed.length; ++i)
+		if (index_batch_release(index, removed.contents[i]) < 0)
+			error = -1;
+
+	if (index_batch_resolve(index, &resolved) < 0)
+		error = -1;
+
+	index_batch_clear(batch);
+
+done:
+	git_mutex_unlock(&index->lock);
+
+	git_array_clear(slots);
+	git_vector_free(&entries);
+	git_vector_free(&removed);
+	git_vector_free(&resolved);
+	git_vector_free(&ops);
+
+	return error;
+}
+
+/* Refreshing many entries writes the blobs of their files ahead of time
+ * on a pool of threads (see core.preloadindex) when there are at least
+ * this many entries for each thread. */
+size_t git_index__preload_per_thread = 500;
+
+#define INDEX_PRELOAD_MAX_THREADS 20
+
+typedef struct {
+	const char *path;
+	git_filter_list *fl;
+	struct stat st;
+	git_oid id;
+	int error;
+} index_preload_entry;
+
+typedef struct {
+	git_repository *repo;
+	git_odb *odb;
+	git_array_t(index_preload_entry) entries;
+	git_atomic next;
+	bool enabled;
+} index_preload;
+
+static int index_preload_init(index_preload *preload, git_index *index)
+{
+	int enabled = 0;
+
+	memset(preload, 0, sizeof(*preload));
+	preload->repo = INDEX_OWNER(index);
+	git_array_init(preload->entries);
+
+#ifdef GIT_THREADS
+	if (preload->repo != NULL && git_repository__cvar(
+			&enabled, preload->repo, GIT_CVAR_PRELOADINDEX) < 0)
+		return -1;
+#endif
+
+	preload->enabled = (enabled != 0);
+	return 0;
+}
+
+/* `path` must stay valid until the preload is freed */
+static int index_preload_add(index_preload *preload, const char *path)
+{
+	index_preload_entry *entry;
+
+	if (!preload->enabled)
+		return 0;
+
+	entry = git_array_alloc(preload->entries);
+	GITERR_CHECK_ALLOC(entry);
+
+	memset(entry, 0, sizeof(*entry));
+	entry->path = path;
+	entry->error = GIT_ENOTFOUND;
+
+	return 0;
+}
+
+#ifdef GIT_THREADS
+
+static void index_preload_write(
+	index_preload_entry *entry, git_odb *odb, git_buf *path,
+	const char *workdir)
+{
+	if (git_buf_joinpath(path, workdir, entry->path) < 0 ||
+		p_lstat(path->ptr, &entry->st) < 0 ||
+		!git__is_sizet(entry->st.st_size))
+		return;
+
+	if (S_ISLNK(entry->st.st_mode) || S_ISREG(entry->st.st_mode))
+		entry->error = git_blob__create_from_file(&entry->id, odb,
+			path->ptr, entry->st.st_mode, entry->st.st_size, entry->fl);
+}
+
+static void *index_preload_thread(void *payload)
+{
+	index_preload *preload = payload;
+	const char *workdir = git_repository_workdir(preload->repo);
+	git_buf path = GIT_BUF_INIT;
+	size_t count = git_array_size(preload->entries), i;
+
+	while ((i = (size_t)git_atomic_inc(&preload->next) - 1) < count)
+		index_preload_write(
+			git_array_get(preload->entries, i), preload->odb, &path, workdir);
+
+	git_buf_free(&path);
+
+	/* errors are found again when the entries are used */
+	giterr_clear();
+
+	return NULL;
+}
+
+#endif
+
+/* Write the added files to the ODB (and stat them) on multiple threads.
+ * Nothing here is an error; entries that could not be written are handled
+ * one by one by index_preload_blob.
+ */
+static void index_preload_run(index_preload *preload)
+{
+#ifdef GIT_THREADS
+	git_thread threads[INDEX_PRELOAD_MAX_THREADS];
+	size_t count = git_array_size(preload->entries), i, nthreads, started;
+
+	nthreads = git_index__preload_per_thread ?
+		count / git_index__preload_per_thread : count;
+	if (nthreads > (size_t)git_online_cpus())
+		nthreads = (size_t)git_online_cpus();
+	if (nthreads > INDEX_PRELOAD_MAX_THREADS)
+		nthreads = INDEX_PRELOAD_MAX_THREADS;
+
+	if (!preload->enabled || nthreads < 2)
+		return;
+
+	if (git_repository_odb__weakptr(&preload->odb, preload->repo) < 0) {
+		giterr_clear();
+		return;
+	}
+
+	/* attributes (and so the filters) are loaded on this thread, as
+	 * the attribute cache is not thread safe */
+	for (i = 0; i < count; ++i) {
+		index_preload_entry *entry = git_array_get(preload->entries, i);
+
+		if (git_filter_list_load(&entry->fl, preload->repo, NULL,
+				entry->path, GIT_FILTER_TO_ODB, GIT_FILTER_OPT_DEFAULT) < 0)
+			entry->fl = NULL;
+	}
+
+	for (started = 0; started < nthreads; ++started)
+		if (git_thread_create(&threads[started], NULL,
+				index_preload_thread, preload) != 0)
+			break;
+
+	/* whatever the threads could not get to is done here */
+	index_preload_thread(preload);
+
+	for (i = 0; i < started; ++i)
+		git_thread_join(threads[i], NULL);
+
+	for (i = 0; i < count; ++i)
+		git_filter_list_free(git_array_get(preload->entries, i)->fl);
+
+	giterr_clear();
+#else
+	GIT_UNUSED(preload);
+#endif
+}
+
+/* Create the blob for the `pos`th file added to the preload (with `path`),
+ * unless it was already written ahead of time.
+ */
+static int index_preload_blob(
+	git_oid *id,
+	struct stat *st,
+	index_preload *preload,
+	size_t pos,
+	const char *path)
+{
+	index_preload_entry *entry = git_array_get(preload->entries, pos);
+
+	if (entry && !entry->error) {
+		git_oid_cpy(id, &entry->id);
+		if (st)
+			memcpy(st, &entry->st, sizeof(*st));
+		return 0;
+	}
+
+	return git_blob__create_from_paths(
+		id, st, preload->repo, NULL, path, 0, true);
+}
+
+static void index_preload_free(index_preload *preload)
+{
+	git_array_clear(preload->entries);
+}
+
+/* update the entry for the `pos`th preloaded file, or remove it from the
+ * index if the file is gone */
+static int index_batch_update_preloaded(
+	git_index_batch *batch, index_preload *preload, size_t pos, const char *path)
+{
+	git_index_entry *entry;
+	struct stat st;
+	git_oid id;
+	int error;
+
+	if (preload->repo == NULL)
+		return create_index_error(-1,
+			"Could not initialize index entry. "
+			"Index is not backed up by an existing repository.");
+
+	error = index_preload_blob(&id, &st, preload, pos, path);
+
+	if (error == GIT_ENOTFOUND) {
+		giterr_clear();
+		return git_index_batch_remove_bypath(batch, path);
+	}
+	if (error < 0)
+		return error;
+
+	entry = index_entry_alloc(path);
+	GITERR_CHECK_ALLOC(entry);
+
+	entry->id = id;
+	git_index_entry__init_from_stat(
+		entry, &st, !batch->index->distrust_filemode);
+
+	return index_batch_push(batch, entry, false, true);
+}
+
+int git_index_add_all(
+	git_index *index,
+	const git_strarray *paths,
+	unsigned int flags,
+	git_index_matched_path_cb cb,
+	void *payload)
+{
+	int error;
+	git_repository *repo;
+	git_iterator *wditer = NULL;
+	git_index_batch *batch = NULL;
+	const git_index_entry *wd = NULL;
+	git_index_entry *entry;
+	git_vector added = GIT_VECTOR_INIT;
+	index_preload preload;
+	git_pathspec ps;
+	const char *match;
+	size_t existing, i;
+	bool no_fnmatch = (flags & GIT_INDEX_ADD_DISABLE_PATHSPEC_MATCH) != 0;
+	int ignorecase, blob_error = 0;
+
+	assert(index);
+
+	if (INDEX_OWNER(index) == NULL)
+		return create_index_error(-1,
+			"Could not add paths to index. "
+			"Index is not backed up by an existing repository.");
+
+	repo = INDEX_OWNER(index);
+	if ((error = git_repository__ensure_not_bare(repo, "index add all")) < 0)
+		return error;
+
+	if (git_repository__cvar(&ignorecase, repo, GIT_CVAR_IGNORECASE) < 0)
+		return -1;
+
+	if ((error = index_preload_init(&preload, index)) < 0 ||
+		(error = git_pathspec__init(&ps, paths)) < 0)
+		return error;
+
+	/* optionally check that pathspec doesn't mention any ignored files */
+	if ((flags & GIT_INDEX_ADD_CHECK_PATHSPEC) != 0 &&
+		(flags & GIT_INDEX_ADD_FORCE) == 0 &&
+		(error = git_ignore__check_pathspec_for_exact_ignores(
+			repo, &ps.pathspec, no_fnmatch)) < 0)
+		goto cleanup;
+
+	if ((error = git_iterator_for_workdir(
+			&wditer, repo, 0, ps.prefix, ps.prefix)) < 0 ||
+		(error = git_index_batch_new(&batch, index)) < 0)
+		goto cleanup;
+
+	while (!(error = git_iterator_advance(&wd, wditer))) {
+
+		/* check if path actually matches */
+		if (!git_pathspec__match(
+				&ps.pathspec, wd->path, no_fnmatch, (bool)ignorecase, &match, NULL))
+			continue;
+
+		/* skip ignored items that are not already in the index */
+		if ((flags & GIT_INDEX_ADD_FORCE) == 0 &&
+			git_iterator_current_is_ignored(wditer) &&
+			index_find(&existing, index, wd->path, 0, 0, true) < 0)
+			continue;
+
+		/* issue notification callback if requested */
+		if (cb && (error = cb(wd->path, match, payload)) != 0) {
+			if (error > 0) /* return > 0 means skip this one */
+				continue;
+			if (error < 0) { /* return < 0 means abort */
+				giterr_set_after_callback(error);
+				break;
+			}
+		}
+
+		/* TODO: Should we check if the file on disk is already an exact
+		 * match to the file in the index and skip this work if it is?
+		 */
+
+		/* make the new entry to insert; the oid is filled in below */
+		if ((error = index_entry_dup(&entry, wd)) < 0)
+			break;
+
+		if ((error = git_vector_insert(&added, entry)) < 0) {
+			index_entry_free(entry);
+			break;
+		}
+
+		if ((error = index_preload_add(&preload, entry->path)) < 0)
+			break;
+	}
+
+	if (error == GIT_ITEROVER)
+		error = 0;
+
+	index_preload_run(&preload);
+
+	/* write the blobs to disk and add the working directory items to the
+	 * index; add implies conflict resolved, so conflict entries are moved
+	 * to REUC */
+	for (i = 0; !blob_error && i < added.length; ++i) {
+		entry = git__swap(added.contents[i], NULL);
+
+		if ((blob_error = index_preload_blob(
+				&entry->id, NULL, &preload, i, entry->path)) < 0)
+			index_entry_free(entry);
+		else
+			blob_error = index_batch_push(batch, entry, false, true);
+	}
+
+	if (!error)
+		error = blob_error;
+
+	/* whatever was added before an error or abort is kept */
+	if (!error)
+		error = git_index_batch_commit(batch);
+	else
+		(void)git_index_batch_commit(batch);
+
+cleanup:
+	git_vector_foreach(&added, i, entry)
+		if (entry)
+			index_entry_free(entry);
+	git_vector_free(&added);
+	index_preload_free(&preload);
+	git_index_batch_free(batch);
+	git_iterator_free(wditer);
+	git_pathspec__clear(&ps);
+
+	return error;
+}
+
+enum {
+	INDEX_ACTION_NONE = 0,
+	INDEX_ACTION_UPDATE = 1,
+	INDEX_ACTION_REMOVE = 2,
+};
+
+static int index_apply_to_all(
+	git_index *index,
+	int action,
+	const git_strarray *paths,
+	git_index_matched_path_cb cb,
+	void *payload)
+{
+	int error = 0, update_error = 0;
+	size_t i;
+	git_pathspec ps;
+	git_index_batch *batch = NULL;
+	git_vector updated = GIT_VECTOR_INIT;
+	index_preload preload;
+	const char *match;
+	git_buf path = GIT_BUF_INIT;
+
+	assert(index);
+
+	if ((error = index_preload_init(&preload, index)) < 0 ||
+		(error = git_pathspec__init(&ps, paths)) < 0)
+		return error;
+
+	if ((error = git_index_batch_new(&batch, index)) < 0)
+		goto cleanup;
+
+	git_vector_sort(&index->entries);
+
+	for (i = 0; !error && i < index->entries.length; ++i) {
+		git_index_entry *entry = git_vector_get(&index->entries, i);
+
+		/* the other stages of a path that was just handled */
+		if (path.size > 0 && !index->entries_cmp_path(path.ptr, entry))
+			continue;
+
+		/* check if path actually matches */
+		if (!git_pathspec__match(
+				&ps.pathspec, entry->path, false, (bool)index->ignore_case,
+				&match, NULL))
+			continue;
+
+		/* issue notification callback if requested */
+		if (cb && (error = cb(entry->path, match, payload)) != 0) {
+			if (error > 0) { /* return > 0 means skip this one */
+				error = 0;
+				continue;
+			}
+			if (error < 0)   /* return < 0 means abort */
+				break;
+		}
+
+		if ((error = git_buf_sets(&path, entry->path)) < 0)
 			break;
 
+		/* the index is only changed once the batch is committed, so it
+		 * is safe to keep iterating over its entries */
 		switch (action) {
 		case INDEX_ACTION_NONE:
 			break;
 		case INDEX_ACTION_UPDATE:
-			error = git_index_add_bypath(index, path.ptr);
-
-			if (error == GIT_ENOTFOUND) {
-				giterr_clear();
-
-				error = git_index_remove_bypath(index, path.ptr);
-
-				if (!error) /* back up foreach if we removed this */
-					i--;
-			}
+			/* files are hashed below, all at once */
+			if ((error = git_vector_insert(&updated, entry)) == 0)
+				error = index_preload_add(&preload, entry->path);
 			break;
 		case INDEX_ACTION_REMOVE:
-			if (!(error = git_index_remove_bypath(index, path.ptr)))
-				i--; /* back up foreach if we removed this */
+			error = git_index_batch_remove_bypath(batch, path.ptr);
 			break;
 		default:
 			giterr_set(GITERR_INVALID, "Unknown index action %d", action);
@@ -2539,6 +3513,25 @@ static int index_apply_to_all(
 		}
 	}
 
+	index_preload_run(&preload);
+
+	for (i = 0; !update_error && i < updated.length; ++i)
+		update_error = index_batch_update_preloaded(batch, &preload, i,
+			((git_index_entry *)updated.contents[i])->path);
+
+	if (!error)
+		error = update_error;
+
+	/* whatever was changed before an error or abort is kept */
+	if (!error)
+		error = git_index_batch_commit(batch);
+	else
+		(void)git_index_batch_commit(batch);
+
+cleanup:
+	git_index_batch_free(batch);
+	git_vector_free(&updated);
+	index_preload_free(&preload);
 	git_buf_free(&path);
 	git_pathspec__clear(&ps);
 
@@ -2575,6 +3568,372 @@ int git_index_update_all(
 	return error;
 }
 
+/* call with locked index; collect the (unique, sorted) names of the files
+ * and directories directly inside `dir` that have entries in the index */
+static int index_tracked_children(
+	git_vector *out, git_index *index, const char *dir, size_t dir_len)
+{
+	size_t pos, i = 0;
+	char *name, *last = NULL;
+
+	git_vector_sort(&index->entries);
+
+	index_find_in_entries(&pos, &index->entries,
+		index->entries_search, dir, dir_len, GIT_INDEX_STAGE_ANY);
+
+	for (; pos < index->entries.length; ++pos) {
+		struct entry_internal *entry = index->entries.contents[pos];
+		const char *slash;
+		size_t name_len;
+
+		if (entry->pathlen <= dir_len || memcmp(entry->path, dir, dir_len))
+			break;
+
+		slash = strchr(entry->path + dir_len, '/');
+		name_len = slash ?
+			(size_t)(slash - entry->path) - dir_len : entry->pathlen - dir_len;
+
+		/* entries in the same subdirectory (or stages of the same
+		 * file) are adjacent, so this catches most duplicates */
+		if (last && !strncmp(last, entry->path + dir_len, name_len) &&
+			!last[name_len])
+			continue;
+
+		last = git__strndup(entry->path + dir_len, name_len);
+		GITERR_CHECK_ALLOC(last);
+
+		if (git_vector_insert(out, last) < 0) {
+			git__free(last);
+			return -1;
+		}
+	}
+
+	git_vector_sort(out);
+
+	/* remove whatever duplicates remain after sorting */
+	git_vector_foreach(out, pos, name) {
+		if (i > 0 && !strcmp(name, out->contents[i - 1]))
+			git__free(name);
+		else
+			out->contents[i++] = name;
+	}
+	out->length = i;
+
+	return 0;
+}
+
+int git_index__untracked_cache_load(
+	git_vector *contents, git_index *index, const char *dir,
+	const struct stat *st)
+{
+	git_repository *repo = INDEX_OWNER(index);
+	git_untracked_cache_dir *ucdir;
+	git_vector names = GIT_VECTOR_INIT;
+	size_t dir_len = strlen(dir), i;
+	const char *name;
+	int error = 0;
+
+	if (!repo || !git_repository_workdir(repo) || index->ignore_case)
+		return GIT_ENOTFOUND;
+
+	if (git_mutex_lock(&index->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to acquire index lock");
+		return -1;
+	}
+
+	if (!git_untracked_cache_is_usable(
+			index->untracked, git_repository_workdir(repo)) ||
+		!(ucdir = git_untracked_cache_lookup(index->untracked, dir, false)) ||
+		!git_untracked_cache_dir_is_fresh(ucdir, st)) {
+		error = GIT_ENOTFOUND;
+		goto done;
+	}
+
+	git_vector_set_cmp(&names, git__strcmp_cb);
+
+	if ((error = index_tracked_children(&names, index, dir, dir_len)) < 0)
+		goto done;
+
+	/* tracked entries are only removed from the index after the cache
+	 * has been invalidated, so anything untracked is not in `names` */
+	git_vector_foreach(&ucdir->untracked, i, name) {
+		size_t name_len = strlen(name);
+		git_path_with_stat *ps;
+
+		if (name_len > 0 && name[name_len - 1] == '/')
+			name_len--;
+
+		if ((ps = git_path_with_stat__alloc(dir, dir_len, name, name_len)) == NULL ||
+			git_vector_insert(contents, ps) < 0) {
+			git__free(ps);
+			error = -1;
+			goto done;
+		}
+	}
+
+	git_vector_foreach(&names, i, name) {
+		git_path_with_stat *ps =
+			git_path_with_stat__alloc(dir, dir_len, name, strlen(name));
+
+		if (!ps || git_vector_insert(contents, ps) < 0) {
+			git__free(ps);
+			error = -1;
+			goto done;
+		}
+	}
+
+done:
+	git_mutex_unlock(&index->lock);
+	git_vector_free_deep(&names);
+
+	return error;
+}
+
+int git_index__untracked_cache_store(
+	git_index *index, const char *dir, const struct stat *st,
+	const git_vector *contents, bool valid, bool create)
+{
+	git_repository *repo = INDEX_OWNER(index);
+	const char *workdir = repo ? git_repository_workdir(repo) : NULL;
+	git_untracked_cache_dir *ucdir;
+	git_vector tracked = GIT_VECTOR_INIT, untracked = GIT_VECTOR_INIT;
+	git_buf name = GIT_BUF_INIT;
+	git_path_with_stat *ps;
+	size_t dir_len = strlen(dir), i;
+	int error = 0;
+
+	if (!workdir || index->ignore_case || !valid)
+		return 0;
+
+	if (git_mutex_lock(&index->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to acquire index lock");
+		return -1;
+	}
+
+	if (!git_untracked_cache_is_usable(index->untracked, workdir)) {
+		if (!create)
+			goto done;
+
+		git_untracked_cache_free(index->untracked);
+		index->untracked = NULL;
+
+		if ((error = git_untracked_cache_new(&index->untracked, workdir)) < 0)
+			goto done;
+	}
+
+	if ((ucdir = git_untracked_cache_lookup(index->untracked, dir, true)) == NULL) {
+		error = -1;
+		goto done;
+	}
+
+	git_vector_set_cmp(&tracked, git__strcmp_cb);
+	git_vector_set_cmp(&untracked, git__strcmp_cb);
+
+	if ((error = index_tracked_children(&tracked, index, dir, dir_len)) < 0)
+		goto done;
+
+	git_vector_foreach(contents, i, ps) {
+		size_t name_len = ps->path_len - dir_len;
+		char *untracked_name;
+
+		if (ps->path_len <= dir_len)
+			continue;
+
+		/* look up the name without the trailing slash of directories */
+		if (ps->path[ps->path_len - 1] == '/')
+			name_len--;
+
+		if ((error = git_buf_set(&name, ps->path + dir_len, name_len)) < 0)
+			goto done;
+
+		if (!git_vector_bsearch(NULL, &tracked, name.ptr))
+			continue;
+
+		/* core git lists untracked directories with a trailing slash */
+		if ((untracked_name = git__strdup(ps->path + dir_len)) == NULL ||
+			git_vector_insert(&untracked, untracked_name) < 0) {
+			git__free(untracked_name);
+			error = -1;
+			goto done;
+		}
+	}
+
+	error = git_untracked_cache_dir_set(ucdir, st, &untracked);
+
+done:
+	git_mutex_unlock(&index->lock);
+	git_vector_free_deep(&tracked);
+	git_vector_free_deep(&untracked);
+	git_buf_free(&name);
+
+	return error;
+}
+
+static int index_fsmonitor_collect(const char *path, void *payload)
+{
+	git_vector *changed = payload;
+	char *copy = git__strdup(path);
+
+	GITERR_CHECK_ALLOC(copy);
+
+	if (git_vector_insert(changed, copy) < 0) {
+		git__free(copy);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* call with locked index */
+static void index_fsmonitor_invalidate(git_index *index, const char *path)
+{
+	size_t path_len = strlen(path), pos;
+	git_index_entry *entry;
+	int (*strncomp)(const char *a, const char *b, size_t sz) =
+		index->ignore_case ? git__strncasecmp : git__strncmp;
+
+	git_untracked_cache_invalidate_path(index->untracked, path);
+
+	while (path_len > 0 && path[path_len - 1] == '/')
+		path_len--;
+
+	if (!path_len) {
+		git_vector_foreach(&index->entries, pos, entry)
+			entry->flags_extended &= ~GIT_IDXENTRY_FSMONITOR_VALID;
+		return;
+	}
+
+	/* the path itself and everything beneath it; entries like "path.c"
+	 * may sort between those, so keep going while the prefix matches */
+	index_find(&pos, index, path, path_len, 0, false);
+
+	for (; pos < index->entries.length; ++pos) {
+		entry = index->entries.contents[pos];
+
+		if (strncomp(entry->path, path, path_len) != 0)
+			break;
+
+		if (entry->path[path_len] == '\0' || entry->path[path_len] == '/')
+			entry->flags_extended &= ~GIT_IDXENTRY_FSMONITOR_VALID;
+	}
+}
+
+int git_index__fsmonitor_refresh(git_index *index, git_fsmonitor *fsmonitor)
+{
+	git_buf token = GIT_BUF_INIT;
+	git_vector changed = GIT_VECTOR_INIT;
+	git_index_entry *entry;
+	char *path;
+	size_t i;
+	int error;
+
+	error = fsmonitor->query(&token, fsmonitor,
+		index->fsmonitor_token, index_fsmonitor_collect, &changed);
+
+	/* the monitor is only an optimization, so if it fails just stop
+	 * trusting it until it recovers */
+	if (error < 0 && error != GIT_ENOTFOUND) {
+		giterr_clear();
+		git_buf_clear(&token);
+	}
+
+	if (git_mutex_lock(&index->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to acquire index lock");
+		git_vector_free_deep(&changed);
+		git_buf_free(&token);
+		return -1;
+	}
+
+	if (error < 0) {
+		git_vector_foreach(&index->entries, i, entry)
+			entry->flags_extended &= ~GIT_IDXENTRY_FSMONITOR_VALID;
+	} else {
+		git_vector_foreach(&changed, i, path)
+			index_fsmonitor_invalidate(index, path);
+	}
+
+	git__free(index->fsmonitor_token);
+	index->fsmonitor_token = token.size ? git_buf_detach(&token) : NULL;
+
+	git_mutex_unlock(&index->lock);
+
+	git_vector_free_deep(&changed);
+	git_buf_free(&token);
+	return 0;
+}
+
+int git_index__fsmonitor_mark_valid(
+	git_index *index, const git_vector *entries)
+{
+	git_index_entry *seen, *entry;
+	size_t i, pos;
+
+	if (git_mutex_lock(&index->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to acquire index lock");
+		return -1;
+	}
+
+	git_vector_foreach(entries, i, seen) {
+		if (index_find(&pos, index, seen->path, 0, 0, false) < 0)
+			continue;
+
+		/* the diff's snapshot keeps replaced entries alive, so only
+		 * the very entry that was looked at is marked */
+		entry = index->entries.contents[pos];
+		if (entry == seen)
+			entry->flags_extended |= GIT_IDXENTRY_FSMONITOR_VALID;
+	}
+
+	git_mutex_unlock(&index->lock);
+	return 0;
+}
+
+int git_index__fsmonitor_load_stat(
+	size_t *loaded, git_index *index, git_vector *contents)
+{
+	git_path_with_stat *ps;
+	git_index_entry *entry;
+	size_t i, pos;
+
+	*loaded = 0;
+
+	if (git_mutex_lock(&index->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to acquire index lock");
+		return -1;
+	}
+
+	git_vector_foreach(contents, i, ps) {
+		if (index_find(&pos, index, ps->path, ps->path_len, 0, false) < 0)
+			continue;
+
+		entry = index->entries.contents[pos];
+
+		if (!(entry->flags_extended & GIT_IDXENTRY_FSMONITOR_VALID) ||
+			!(S_ISREG(entry->mode) || S_ISLNK(entry->mode)))
+			continue;
+
+		/* the inverse of git_index_entry__init_from_stat */
+		memset(&ps->st, 0, sizeof(ps->st));
+		ps->st.st_ctime = (time_t)entry->ctime.seconds;
+		ps->st.st_mtime = (time_t)entry->mtime.seconds;
+#if defined(GIT_USE_NSEC)
+		ps->st.st_ctime_nsec = entry->ctime.nanoseconds;
+		ps->st.st_mtime_nsec = entry->mtime.nanoseconds;
+#endif
+		ps->st.st_rdev = entry->dev;
+		ps->st.st_ino = entry->ino;
+		ps->st.st_mode = entry->mode;
+		ps->st.st_uid = entry->uid;
+		ps->st.st_gid = entry->gid;
+		ps->st.st_size = entry->file_size;
+
+		(*loaded)++;
+	}
+
+	git_mutex_unlock(&index->lock);
+	return 0;
+}
+
 int git_index_snapshot_new(git_vector *snap, git_index *index)
 {
 	int error;
@@ -11,8 +11,10 @@
 #include "filebuf.h"
 #include "vector.h"
 #include "tree-cache.h"
+#include "untracked_cache.h"
 #include "git2/odb.h"
 #include "git2/index.h"
+#include "git2/sys/fsmonitor.h"
 
 #define GIT_INDEX_FILE "index"
 #define GIT_INDEX_FILE_MODE 0666
@@ -35,6 +37,8 @@ struct git_index {
 	unsigned int no_symlinks:1;
 
 	git_tree_cache *tree;
+	git_untracked_cache *untracked;
+	char *fsmonitor_token; /* see GIT_IDXENTRY_FSMONITOR_VALID */
 
 	git_vector names;
 	git_vector reuc;
@@ -72,6 +76,10 @@ extern int git_index__find_pos(
 
 extern void git_index__set_ignore_case(git_index *index, bool ignore_case);
 
+/* Minimum number of files per thread for git_index_add_all and
+ * git_index_update_all to hash files on multiple threads */
+extern size_t git_index__preload_per_thread;
+
 extern unsigned int git_index__create_mode(unsigned int mode);
 
 GIT_INLINE(const git_futils_filestamp *) git_index__filestamp(git_index *index)
@@ -81,6 +89,64 @@ GIT_INLINE(const git_futils_filestamp *) git_index__filestamp(git_index *index)
 
 extern int git_index__changed_relative_to(git_index *index, const git_futils_filestamp *fs);
 
+/* An entry is "racily clean" when its file was last modified no earlier
+ * than the index file itself: the file may have changed again within the
+ * same timestamp without that showing in its stat data, so its contents
+ * must be checked.
+ */
+GIT_INLINE(bool) git_index__entry_is_racy(
+	const git_index *index, const git_index_entry *entry)
+{
+	if (!index || !index->stamp.mtime)
+		return false;
+
+	if (entry->mtime.seconds != index->stamp.mtime)
+		return (entry->mtime.seconds > index->stamp.mtime);
+
+	return (entry->mtime.nanoseconds >= index->stamp.mtime_nsec);
+}
+
+/* Fill `contents` with `git_path_with_stat` entries (not yet stat'ed) for
+ * everything in the working directory `dir` (relative, with a trailing
+ * slash, or "" for the root) if the untracked cache knows the directory
+ * to be unchanged since `st` was recorded.  Returns GIT_ENOTFOUND if the
+ * directory must be read from disk.
+ */
+extern int git_index__untracked_cache_load(
+	git_vector *contents, git_index *index, const char *dir,
+	const struct stat *st);
+
+/* Remember the untracked entries of `dir`, given the `git_path_with_stat`
+ * listing `contents` read from disk.  If `create` is set, replaces the
+ * untracked cache with a new one when the index does not have a usable
+ * cache.  Nothing is recorded unless `valid` is set (i.e. the stat data
+ * of the directory is not racy).
+ */
+extern int git_index__untracked_cache_store(
+	git_index *index, const char *dir, const struct stat *st,
+	const git_vector *contents, bool valid, bool create);
+
+/* Ask the file system monitor what changed since the token recorded in
+ * the index, and forget that any of those entries were unchanged.  The
+ * monitor failing is not an error; nothing is trusted until it recovers.
+ */
+extern int git_index__fsmonitor_refresh(
+	git_index *index, git_fsmonitor *fsmonitor);
+
+/* Mark the given entries, which a diff found unchanged in the working
+ * directory, as vouched for by the file system monitor.  Entries that
+ * were replaced in the meantime are left alone.
+ */
+extern int git_index__fsmonitor_mark_valid(
+	git_index *index, const git_vector *entries);
+
+/* Fill in the stat data of the (not yet stat'ed) `git_path_with_stat`
+ * entries of `contents` for which the index has the stat data vouched
+ * for by the file system monitor, counting them in `loaded`.
+ */
+extern int git_index__fsmonitor_load_stat(
+	size_t *loaded, git_index *index, git_vector *contents);
+
 /* Copy the current entries vector *and* increment the index refcount.
  * Call `git_index__release_snapshot` when done.
  */
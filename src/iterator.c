@@ -294,7 +294,6 @@ static bool tree_iterator__move_to_next(
 
 static int tree_iterator__set_next(tree_iterator *ti, tree_iterator_frame *tf)
 {
-	int error = 0;
 	const git_tree_entry *te, *last = NULL;
 
 	tf->next = tf->current;
@@ -304,32 +303,52 @@ static int tree_iterator__set_next(tree_iterator *ti, tree_iterator_frame *tf)
 
 		if (last && tree_iterator__te_cmp(last, te, ti->strncomp))
 			break;
-
-		/* try to load trees for items in [current,next) range */
-		if (!error && git_tree_entry__is_tree(te))
-			error = git_tree_lookup(
-				&tf->entries[tf->next]->tree, ti->base.repo, &te->oid);
 	}
 
 	if (tf->next > tf->current + 1)
 		ti->path_ambiguities++;
 
-	/* if a tree lookup failed, advance over this span and return failure */
-	if (error < 0) {
-		tree_iterator__move_to_next(ti, tf);
-		return error;
-	}
-
 	if (last && !tree_iterator__current_filename(ti, last))
 		return -1; /* must have been allocation failure */
 
 	return 0;
 }
 
+/* load the trees for items in [current,next) range, which is only done
+ * when expanding them, so that trees which are skipped over are not read
+ */
+static int tree_iterator__load_trees(tree_iterator *ti, tree_iterator_frame *tf)
+{
+	int error = 0;
+	size_t i;
+	tree_iterator_entry *entry;
+
+	for (i = tf->current; !error && i < tf->next; ++i) {
+		entry = tf->entries[i];
+
+		if (!entry->tree && entry->te && git_tree_entry__is_tree(entry->te))
+			error = git_tree_lookup(
+				&entry->tree, ti->base.repo, &entry->te->oid);
+	}
+
+	/* if a tree lookup failed, advance over this span and return failure */
+	if (error < 0)
+		tree_iterator__move_to_next(ti, tf);
+
+	return error;
+}
+
 GIT_INLINE(bool) tree_iterator__at_tree(tree_iterator *ti)
 {
-	return (ti->head->current < ti->head->n_entries &&
-			ti->head->entries[ti->head->current]->tree != NULL);
+	tree_iterator_entry *entry;
+
+	if (ti->head->current >= ti->head->n_entries)
+		return false;
+
+	entry = ti->head->entries[ti->head->current];
+
+	return (entry->tree != NULL ||
+			(entry->te != NULL && git_tree_entry__is_tree(entry->te)));
 }
 
 static int tree_iterator__push_frame(tree_iterator *ti)
@@ -338,9 +357,12 @@ static int tree_iterator__push_frame(tree_iterator *ti)
 	tree_iterator_frame *head = ti->head, *tf = NULL;
 	size_t i, n_entries = 0;
 
-	if (head->current >= head->n_entries || !head->entries[head->current]->tree)
+	if (!tree_iterator__at_tree(ti))
 		return GIT_ITEROVER;
 
+	if ((error = tree_iterator__load_trees(ti, head)) < 0)
+		return error;
+
 	for (i = head->current; i < head->next; ++i)
 		n_entries += git_tree_entrycount(head->entries[i]->tree);
 
@@ -534,7 +556,7 @@ static int tree_iterator__advance(
 		   tree_iterator__pop_frame(ti, false))
 		tf = ti->head;
 
-	/* find next and load trees */
+	/* find next item (trees are loaded when expanded) */
 	if ((error = tree_iterator__set_next(ti, tf)) < 0)
 		return error;
 
@@ -911,6 +933,7 @@ struct fs_iterator {
 	uint32_t dirload_flags;
 	int depth;
 
+	int (*dirload_cb)(fs_iterator *self, git_vector *contents);
 	int (*enter_dir_cb)(fs_iterator *self);
 	int (*leave_dir_cb)(fs_iterator *self);
 	int (*update_entry_cb)(fs_iterator *self);
@@ -996,9 +1019,13 @@ static int fs_iterator__expand_dir(fs_iterator *fi)
 	ff = fs_iterator__alloc_frame(fi);
 	GITERR_CHECK_ALLOC(ff);
 
-	error = git_path_dirload_with_stat(
-		fi->path.ptr, fi->root_len, fi->dirload_flags,
-		fi->base.start, fi->base.end, &ff->entries);
+	/* a custom loader keeps count of its own stat calls */
+	if (fi->dirload_cb)
+		error = fi->dirload_cb(fi, &ff->entries);
+	else if (!(error = git_path_dirload_with_stat(
+			fi->path.ptr, fi->root_len, fi->dirload_flags,
+			fi->base.start, fi->base.end, &ff->entries)))
+		fi->base.stat_calls += ff->entries.length;
 
 	if (error < 0) {
 		git_error_state last_error = { 0 };
@@ -1017,7 +1044,6 @@ static int fs_iterator__expand_dir(fs_iterator *fi)
 		fs_iterator__free_frame(ff);
 		return GIT_ENOTFOUND;
 	}
-	fi->base.stat_calls += ff->entries.length;
 
 	fs_iterator__seek_frame_start(fi, ff);
 
@@ -1268,6 +1294,13 @@ typedef struct {
 	fs_iterator fi;
 	git_ignores ignores;
 	int is_ignored;
+
+	/* the index holding the untracked cache and the file system monitor
+	 * data, if either is in use */
+	git_index *index;
+	int untracked_cache;
+	time_t scan_start;
+	bool fsmonitor;
 } workdir_iterator;
 
 GIT_INLINE(bool) workdir_path_is_dotgit(const git_buf *path)
@@ -1289,6 +1322,63 @@ GIT_INLINE(bool) workdir_path_is_dotgit(const git_buf *path)
 	return (len == 4 || path->ptr[len - 5] == '/');
 }
 
+static int workdir_iterator__dirload(fs_iterator *fi, git_vector *contents)
+{
+	workdir_iterator *wi = (workdir_iterator *)fi;
+	const char *dir = fi->path.ptr + fi->root_len;
+	git_path_with_stat *ps = NULL;
+	struct stat st;
+	size_t loaded = 0;
+	bool use_cache = false, store = false;
+	int error = 0;
+
+	/* listings limited to a range of paths are not worth remembering */
+	if (wi->untracked_cache != GIT_UNTRACKEDCACHE_FALSE &&
+		!fi->base.start && !fi->base.end) {
+		/* the stat data of a subdirectory comes from its parent's listing */
+		if (fi->stack)
+			ps = git_vector_get(&fi->stack->entries, fi->stack->index);
+
+		if (ps) {
+			memcpy(&st, &ps->st, sizeof(st));
+			use_cache = true;
+		} else
+			use_cache = (p_stat(fi->path.ptr, &st) == 0);
+	}
+
+	if (use_cache)
+		error = git_index__untracked_cache_load(contents, wi->index, dir, &st);
+
+	/* read the directory unless the cache could reconstruct it */
+	if (!use_cache || error == GIT_ENOTFOUND) {
+		error = git_path_dirload_without_stat(
+			fi->path.ptr, fi->root_len, fi->dirload_flags, contents);
+		store = use_cache;
+	}
+
+	if (error < 0)
+		return error;
+
+	/* take the stat data the file system monitor vouches for as it is */
+	if (wi->fsmonitor &&
+		(error = git_index__fsmonitor_load_stat(
+			&loaded, wi->index, contents)) < 0)
+		return error;
+
+	fi->base.stat_calls += contents->length - loaded;
+
+	if ((error = git_path_stat_contents(
+			fi->path.ptr, fi->root_len, fi->dirload_flags,
+			fi->base.start, fi->base.end, contents)) < 0 || !store)
+		return error;
+
+	/* a directory modified since the scan began may change again
+	 * without its (one second resolution) mtime changing */
+	return git_index__untracked_cache_store(
+		wi->index, dir, &st, contents, st.st_mtime < wi->scan_start,
+		wi->untracked_cache == GIT_UNTRACKEDCACHE_TRUE);
+}
+
 static int workdir_iterator__enter_dir(fs_iterator *fi)
 {
 	workdir_iterator *wi = (workdir_iterator *)fi;
@@ -1365,6 +1455,7 @@ static void workdir_iterator__free(git_iterator *self)
 	workdir_iterator *wi = (workdir_iterator *)self;
 	fs_iterator__free(self);
 	git_ignore__free(&wi->ignores);
+	git_index_free(wi->index);
 }
 
 int git_iterator_for_workdir_ext(
@@ -1408,6 +1499,38 @@ int git_iterator_for_workdir_ext(
 	else if (precompose)
 		wi->fi.base.flags |= GIT_ITERATOR_PRECOMPOSE_UNICODE;
 
+	/* use the untracked cache and the file system monitor for the
+	 * repository's own working directory, except where directory entry
+	 * names may be rewritten or folded */
+	if (git_repository__cvar(
+			&wi->untracked_cache, repo, GIT_CVAR_UNTRACKEDCACHE) < 0) {
+		giterr_clear();
+		wi->untracked_cache = GIT_UNTRACKEDCACHE_FALSE;
+	}
+
+	if ((wi->untracked_cache != GIT_UNTRACKEDCACHE_FALSE ||
+		 repo->_fsmonitor != NULL) &&
+		!iterator__ignore_case(wi) && !precompose &&
+		git_repository_workdir(repo) != NULL &&
+		!strcmp(repo_workdir, git_repository_workdir(repo)))
+	{
+		if (git_repository_index(&wi->index, repo) < 0)
+			giterr_clear();
+		else {
+			wi->fi.dirload_cb = workdir_iterator__dirload;
+			wi->scan_start = time(NULL);
+		}
+
+		if (wi->index && repo->_fsmonitor != NULL) {
+			if ((error = git_index__fsmonitor_refresh(
+					wi->index, repo->_fsmonitor)) < 0) {
+				git_iterator_free((git_iterator *)wi);
+				return error;
+			}
+			wi->fsmonitor = true;
+		}
+	}
+
 	return fs_iterator__initialize(out, &wi->fi, repo_workdir);
 }
 
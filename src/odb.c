@@ -1030,6 +1030,7 @@ void git_odb_stream_free(git_odb_stream *stream)
 int git_odb_open_rstream(git_odb_stream **stream, git_odb *db, const git_oid *oid)
 {
 	size_t i, reads = 0;
+	bool passthrough = false;
 	int error = GIT_ERROR;
 
 	assert(stream && db);
@@ -1041,12 +1042,14 @@ int git_odb_open_rstream(git_odb_stream **stream, git_odb *db, const git_oid *oi
 		if (b->readstream != NULL) {
 			++reads;
 			error = b->readstream(stream, b, oid);
+
+			/* the backend has the object, but can't stream it */
+			if (error == GIT_PASSTHROUGH)
+				passthrough = true;
 		}
 	}
 
-	if (error == GIT_PASSTHROUGH)
-		error = 0;
-	if (error < 0 && !reads)
+	if (error < 0 && (!reads || passthrough))
 		error = git_odb__error_unsupported_in_backend("read object streamed");
 
 	return error;
@@ -28,6 +28,17 @@ typedef struct {
 	git_filebuf fbuf;
 } loose_writestream;
 
+typedef struct {
+	git_odb_stream stream;
+	git_file fd;
+	z_stream zs;
+	unsigned char in[4096];
+	unsigned char head[65]; /* header and first bytes, NUL terminated */
+	size_t head_pos, head_len;
+	size_t remaining;
+	int done;
+} loose_readstream;
+
 typedef struct loose_backend {
 	git_odb_backend parent;
 
@@ -866,6 +877,167 @@ static int loose_backend__stream(git_odb_stream **stream_out, git_odb_backend *_
 	return !stream ? -1 : 0;
 }
 
+static int loose_readstream_inflate(
+	loose_readstream *stream, unsigned char *out, size_t len, size_t *written)
+{
+	int status, read_bytes;
+
+	set_stream_output(&stream->zs, out, len);
+
+	while (stream->zs.avail_out > 0 && !stream->done) {
+		if (stream->zs.avail_in == 0) {
+			read_bytes = p_read(stream->fd, stream->in, sizeof(stream->in));
+			if (read_bytes < 0) {
+				giterr_set(GITERR_OS, "Failed to read loose object");
+				return -1;
+			}
+
+			/* a truncated object ends early; the caller notices */
+			if (read_bytes == 0) {
+				stream->done = 1;
+				break;
+			}
+
+			set_stream_input(&stream->zs, stream->in, read_bytes);
+		}
+
+		status = inflate(&stream->zs, 0);
+
+		if (status == Z_STREAM_END)
+			stream->done = 1;
+		else if (status != Z_OK) {
+			giterr_set(GITERR_ZLIB, "Failed to inflate loose object");
+			return -1;
+		}
+	}
+
+	*written = len - stream->zs.avail_out;
+	return 0;
+}
+
+static int loose_backend__readstream_read(
+	git_odb_stream *_stream, char *buffer, size_t len)
+{
+	loose_readstream *stream = (loose_readstream *)_stream;
+	size_t written, inflated;
+
+	if (len > stream->remaining)
+		len = stream->remaining;
+	if (len > INT_MAX)
+		len = INT_MAX;
+
+	/* the start of the contents was inflated along with the header */
+	written = min(len, stream->head_len - stream->head_pos);
+	memcpy(buffer, stream->head + stream->head_pos, written);
+	stream->head_pos += written;
+
+	if (written < len) {
+		if (loose_readstream_inflate(stream,
+				(unsigned char *)buffer + written, len - written, &inflated) < 0)
+			return -1;
+
+		written += inflated;
+	}
+
+	if (!written && len) {
+		giterr_set(GITERR_ZLIB, "Loose object is truncated");
+		return -1;
+	}
+
+	stream->remaining -= written;
+	return (int)written;
+}
+
+static void loose_backend__readstream_free(git_odb_stream *_stream)
+{
+	loose_readstream *stream = (loose_readstream *)_stream;
+
+	inflateEnd(&stream->zs);
+	if (stream->fd >= 0)
+		p_close(stream->fd);
+	git__free(stream);
+}
+
+static int loose_readstream_open(loose_readstream *stream, git_buf *loc)
+{
+	obj_hdr hdr;
+	size_t used;
+	int read_bytes;
+
+	if ((stream->fd = git_futils_open_ro(loc->ptr)) < 0)
+		return stream->fd;
+
+	if ((read_bytes = p_read(stream->fd, stream->in, sizeof(stream->in))) < 0) {
+		giterr_set(GITERR_OS, "Failed to read loose object");
+		return -1;
+	}
+
+	/* the old pack-like loose format isn't worth streaming */
+	if (read_bytes < 2 || !is_zlib_compressed_data(stream->in))
+		return GIT_PASSTHROUGH;
+
+	init_stream(&stream->zs, NULL, 0);
+	set_stream_input(&stream->zs, stream->in, read_bytes);
+
+	if (inflateInit(&stream->zs) < Z_OK) {
+		giterr_set(GITERR_ZLIB, "Failed to inflate loose object");
+		return -1;
+	}
+
+	if (loose_readstream_inflate(stream,
+			stream->head, sizeof(stream->head) - 1, &stream->head_len) < 0)
+		return -1;
+
+	if ((used = get_object_header(&hdr, stream->head)) == 0 ||
+		used > stream->head_len ||
+		!git_object_typeisloose(hdr.type)) {
+		giterr_set(GITERR_ODB, "Failed to read loose object header");
+		return -1;
+	}
+
+	stream->head_pos = used;
+	stream->remaining = hdr.size;
+	stream->stream.declared_size = hdr.size;
+
+	return 0;
+}
+
+static int loose_backend__readstream(
+	git_odb_stream **stream_out, git_odb_backend *backend, const git_oid *oid)
+{
+	git_buf object_path = GIT_BUF_INIT;
+	loose_readstream *stream;
+	int error;
+
+	assert(backend && oid);
+
+	if (locate_object(&object_path, (loose_backend *)backend, oid) < 0) {
+		error = git_odb__error_notfound("no matching loose object", oid);
+		goto done;
+	}
+
+	stream = git__calloc(1, sizeof(loose_readstream));
+	if (stream == NULL) {
+		error = -1;
+		goto done;
+	}
+
+	stream->fd = -1;
+	stream->stream.backend = backend;
+	stream->stream.mode = GIT_STREAM_RDONLY;
+	stream->stream.read = &loose_backend__readstream_read;
+	stream->stream.free = &loose_backend__readstream_free;
+
+	if ((error = loose_readstream_open(stream, &object_path)) < 0)
+		loose_backend__readstream_free((git_odb_stream *)stream);
+	else
+		*stream_out = (git_odb_stream *)stream;
+
+done:
+	git_buf_free(&object_path);
+	return error;
+}
+
 static int loose_backend__write(git_odb_backend *_backend, const git_oid *oid, const void *data, size_t len, git_otype type)
 {
 	int error = 0, header_len;
@@ -956,6 +1128,7 @@ int git_odb_backend_loose(
 	backend->parent.read_prefix = &loose_backend__read_prefix;
 	backend->parent.read_header = &loose_backend__read_header;
 	backend->parent.writestream = &loose_backend__stream;
+	backend->parent.readstream = &loose_backend__readstream;
 	backend->parent.exists = &loose_backend__exists;
 	backend->parent.exists_prefix = &loose_backend__exists_prefix;
 	backend->parent.foreach = &loose_backend__foreach;
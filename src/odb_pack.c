@@ -32,6 +32,11 @@ struct pack_writepack {
 	git_indexer *indexer;
 };
 
+struct pack_readstream {
+	git_odb_stream parent;
+	git_packfile_stream zstream;
+};
+
 /**
  * The wonderful tale of a Packed Object lookup query
  * ===================================================
@@ -475,6 +480,96 @@ static int pack_backend__read_prefix(
 		out_oid, buffer_p, len_p, type_p, backend, short_oid, len);
 }
 
+static int pack_backend__readstream_read(
+	git_odb_stream *_stream, char *buffer, size_t len)
+{
+	struct pack_readstream *stream = (struct pack_readstream *)_stream;
+	git_off_t curpos;
+	ssize_t read;
+
+	if (len > INT_MAX)
+		len = INT_MAX;
+
+	/* the compressed data may continue in the next window */
+	do {
+		curpos = stream->zstream.curpos;
+		read = git_packfile_stream_read(&stream->zstream, buffer, len);
+	} while (read == GIT_EBUFS && stream->zstream.curpos != curpos);
+
+	if (read == GIT_EBUFS) {
+		giterr_set(GITERR_ODB, "Object in packfile is truncated");
+		return -1;
+	}
+
+	return (int)read;
+}
+
+static void pack_backend__readstream_free(git_odb_stream *_stream)
+{
+	struct pack_readstream *stream = (struct pack_readstream *)_stream;
+
+	git_packfile_stream_free(&stream->zstream);
+	git__free(stream);
+}
+
+static int pack_backend__readstream_internal(
+	git_odb_stream **stream_out, git_odb_backend *backend, const git_oid *oid)
+{
+	struct git_pack_entry e;
+	struct pack_readstream *stream;
+	git_mwindow *w_curs = NULL;
+	git_off_t curpos;
+	git_otype type;
+	size_t size;
+	int error;
+
+	if ((error = pack_entry_find(&e, (struct pack_backend *)backend, oid)) < 0)
+		return error;
+
+	curpos = e.offset;
+	error = git_packfile_unpack_header(&size, &type, &e.p->mwf, &w_curs, &curpos);
+	git_mwindow_close(&w_curs);
+	if (error < 0)
+		return error;
+
+	/* a delta has to be applied to its base as a whole */
+	if (type == GIT_OBJ_OFS_DELTA || type == GIT_OBJ_REF_DELTA)
+		return GIT_PASSTHROUGH;
+
+	stream = git__calloc(1, sizeof(struct pack_readstream));
+	GITERR_CHECK_ALLOC(stream);
+
+	if (git_packfile_stream_open(&stream->zstream, e.p, curpos) < 0) {
+		git__free(stream);
+		return -1;
+	}
+
+	stream->parent.backend = backend;
+	stream->parent.mode = GIT_STREAM_RDONLY;
+	stream->parent.declared_size = size;
+	stream->parent.read = &pack_backend__readstream_read;
+	stream->parent.free = &pack_backend__readstream_free;
+
+	*stream_out = (git_odb_stream *)stream;
+	return 0;
+}
+
+static int pack_backend__readstream(
+	git_odb_stream **stream_out, git_odb_backend *backend, const git_oid *oid)
+{
+	int error;
+
+	error = pack_backend__readstream_internal(stream_out, backend, oid);
+
+	if (error != GIT_ENOTFOUND)
+		return error;
+
+	if ((error = pack_backend__refresh(backend)) < 0)
+		return error;
+
+	return pack_backend__readstream_internal(stream_out, backend, oid);
+}
+
 static int pack_backend__exists(git_odb_backend *backend, const git_oid *oid)
 {
 	struct git_pack_entry e;
@@ -628,6 +723,7 @@ static int pack_backend__alloc(struct pack_backend **out, size_t initial_size)
 	backend->parent.read = &pack_backend__read;
 	backend->parent.read_prefix = &pack_backend__read_prefix;
 	backend->parent.read_header = &pack_backend__read_header;
+	backend->parent.readstream = &pack_backend__readstream;
 	backend->parent.exists = &pack_backend__exists;
 	backend->parent.exists_prefix = &pack_backend__exists_prefix;
 	backend->parent.refresh = &pack_backend__refresh;
@@ -19,6 +19,38 @@ static int oid_error_invalid(const char *msg)
 	return -1;
 }
 
+int git_oid__fromhex(git_oid *out, const char *str)
+{
+	const unsigned char *hex = (const unsigned char *)str;
+	unsigned char *raw = out->id, *end = out->id + GIT_OID_RAWSZ;
+	unsigned int invalid = 0, h0, l0, h1, l1;
+
+	/*
+	 * Invalid digits translate to 0xff, so the high bits of `invalid`
+	 * are only set when the id can't be used; checking once at the end
+	 * keeps the loop free of branches.
+	 */
+	while (raw < end) {
+		h0 = (unsigned char)from_hex[hex[0]];
+		l0 = (unsigned char)from_hex[hex[1]];
+		h1 = (unsigned char)from_hex[hex[2]];
+		l1 = (unsigned char)from_hex[hex[3]];
+
+		invalid |= h0 | l0 | h1 | l1;
+
+		raw[0] = (unsigned char)((h0 << 4) | l0);
+		raw[1] = (unsigned char)((h1 << 4) | l1);
+
+		raw += 2;
+		hex += 4;
+	}
+
+	if (invalid & 0xf0)
+		return oid_error_invalid("contains invalid characters");
+
+	return 0;
+}
+
 int git_oid_fromstrn(git_oid *out, const char *str, size_t length)
 {
 	size_t p;
@@ -140,7 +172,7 @@ int git_oid__parse(
 	if (buffer[header_len + sha_len] != '\n')
 		return -1;
 
-	if (git_oid_fromstr(oid, buffer + header_len) < 0)
+	if (git_oid__fromhex(oid, buffer + header_len) < 0)
 		return -1;
 
 	*buffer_out = buffer + (header_len + sha_len + 1);
@@ -9,6 +9,12 @@
 
 #include "git2/oid.h"
 
+/*
+ * Decode the GIT_OID_HEXSZ hexadecimal digits of an object id, which
+ * must all be readable.
+ */
+extern int git_oid__fromhex(git_oid *out, const char *str);
+
 GIT_INLINE(int) git_oid__hashcmp(const unsigned char *sha1, const unsigned char *sha2)
 {
 	int i;
@@ -1055,6 +1055,32 @@ int git_path_with_stat_cmp_icase(const void *a, const void *b)
 	return strcasecmp(psa->path, psb->path);
 }
 
+int git_path_dirload_without_stat(
+	const char *path,
+	size_t prefix_len,
+	unsigned int flags,
+	git_vector *contents)
+{
+	int error;
+	unsigned int i;
+	git_path_with_stat *ps;
+
+	error = git_path_dirload(
+		path, prefix_len, sizeof(git_path_with_stat) + 1, flags, contents);
+	if (error < 0)
+		return error;
+
+	/* stat struct at start of git_path_with_stat, so shift path text */
+	git_vector_foreach(contents, i, ps) {
+		size_t path_len = strlen((char *)ps);
+		memmove(ps->path, ps, path_len + 1);
+		ps->path_len = path_len;
+		memset(&ps->st, 0, sizeof(ps->st));
+	}
+
+	return 0;
+}
+
 int git_path_dirload_with_stat(
 	const char *path,
 	size_t prefix_len,
@@ -1063,7 +1089,41 @@ int git_path_dirload_with_stat(
 	const char *end_stat,
 	git_vector *contents)
 {
-	int error;
+	int error = git_path_dirload_without_stat(
+		path, prefix_len, flags, contents);
+
+	if (error < 0)
+		return error;
+
+	return git_path_stat_contents(
+		path, prefix_len, flags, start_stat, end_stat, contents);
+}
+
+git_path_with_stat *git_path_with_stat__alloc(
+	const char *dir, size_t dir_len, const char *name, size_t name_len)
+{
+	/* leave room for the trailing slash added to directories */
+	git_path_with_stat *ps =
+		git__calloc(sizeof(git_path_with_stat) + dir_len + name_len + 2, 1);
+
+	if (ps) {
+		memcpy(ps->path, dir, dir_len);
+		memcpy(&ps->path[dir_len], name, name_len);
+		ps->path_len = dir_len + name_len;
+	}
+
+	return ps;
+}
+
+int git_path_stat_contents(
+	const char *path,
+	size_t prefix_len,
+	unsigned int flags,
+	const char *start_stat,
+	const char *end_stat,
+	git_vector *contents)
+{
+	int error = 0;
 	unsigned int i;
 	git_path_with_stat *ps;
 	git_buf full = GIT_BUF_INIT;
@@ -1074,23 +1134,9 @@ int git_path_dirload_with_stat(
 	if (git_buf_set(&full, path, prefix_len) < 0)
 		return -1;
 
-	error = git_path_dirload(
-		path, prefix_len, sizeof(git_path_with_stat) + 1, flags, contents);
-	if (error < 0) {
-		git_buf_free(&full);
-		return error;
-	}
-
 	strncomp = (flags & GIT_PATH_DIR_IGNORE_CASE) != 0 ?
 		git__strncasecmp : git__strncmp;
 
-	/* stat struct at start of git_path_with_stat, so shift path text */
-	git_vector_foreach(contents, i, ps) {
-		size_t path_len = strlen((char *)ps);
-		memmove(ps->path, ps, path_len + 1);
-		ps->path_len = path_len;
-	}
-
 	git_vector_foreach(contents, i, ps) {
 		/* skip if before start_stat or after end_stat */
 		cmp_len = min(start_len, ps->path_len);
@@ -1100,6 +1146,10 @@ int git_path_dirload_with_stat(
 		if (cmp_len && strncomp(ps->path, end_stat, cmp_len) > 0)
 			continue;
 
+		/* stat data may be known already */
+		if (ps->st.st_mode != 0)
+			continue;
+
 		git_buf_truncate(&full, prefix_len);
 
 		if ((error = git_buf_joinpath(&full, full.ptr, ps->path)) < 0 ||
@@ -367,6 +367,44 @@ extern int git_path_dirload_with_stat(
 	const char *end_stat,
 	git_vector *contents);
 
+/**
+ * Load all directory entries into a vector of `git_path_with_stat`
+ * entries without stat data.
+ *
+ * This is the first half of `git_path_dirload_with_stat`; the entries
+ * are not sorted yet.  Parameters are as for `git_path_dirload_with_stat`.
+ */
+extern int git_path_dirload_without_stat(
+	const char *path,
+	size_t prefix_len,
+	uint32_t flags,
+	git_vector *contents);
+
+/**
+ * Stat a vector of `git_path_with_stat` entries whose paths are already
+ * filled in (for example, from a cached directory listing).
+ *
+ * This is the second half of `git_path_dirload_with_stat`: entries that
+ * no longer exist are dropped, directories get a '/' suffix and the
+ * vector is sorted.  Entries whose stat data is already filled in (with
+ * a non-zero mode) are taken as they are.  Parameters are as for
+ * `git_path_dirload_with_stat`.
+ */
+extern int git_path_stat_contents(
+	const char *path,
+	size_t prefix_len,
+	uint32_t flags,
+	const char *start_stat,
+	const char *end_stat,
+	git_vector *contents);
+
+/**
+ * Allocate a `git_path_with_stat` for `dir` joined with `name` (`dir`
+ * must be empty or end in a '/') with room for a directory suffix.
+ */
+extern git_path_with_stat *git_path_with_stat__alloc(
+	const char *dir, size_t dir_len, const char *name, size_t name_len);
+
 enum { GIT_PATH_NOTEQUAL = 0, GIT_PATH_EQUAL = 1, GIT_PATH_PREFIX = 2 };
 
 /*
@@ -9,6 +9,7 @@
 #include "git2/object.h"
 #include "git2/refdb.h"
 #include "git2/sys/repository.h"
+#include "git2/sys/fsmonitor.h"
 
 #include "common.h"
 #include "repository.h"
@@ -48,6 +49,10 @@ static void set_odb(git_repository *repo, git_odb *odb)
 		GIT_REFCOUNT_OWN(odb, NULL);
 		git_odb_free(odb);
 	}
+
+	/* the history may not be the same in the new object database */
+	if (repo->graphcache)
+		git_graphcache_clear(repo->graphcache);
 }
 
 static void set_refdb(git_repository *repo, git_refdb *refdb)
@@ -117,6 +122,13 @@ void git_repository_free(git_repository *repo)
 	git_diff_driver_registry_free(repo->diff_drivers);
 	repo->diff_drivers = NULL;
 
+	git_repository_set_fsmonitor(repo, NULL);
+	git_graphcache_free(repo->graphcache);
+	git_sigcache_free(repo->sigcache);
+	git_binarycache_free(repo->binarycache);
+	git_grafts_free(repo->grafts);
+	git_mutex_free(&repo->grafts_lock);
+
 	git__free(repo->path_repository);
 	git__free(repo->workdir);
 	git__free(repo->namespace);
@@ -157,6 +169,12 @@ static git_repository *repository_alloc(void)
 		return NULL;
 	}
 
+	if (git_mutex_init(&repo->grafts_lock)) {
+		git_cache_free(&repo->objects);
+		git__free(repo);
+		return NULL;
+	}
+
 	/* set all the entries in the cvar cache to `unset` */
 	git_repository__cvar_cache_clear(repo);
 
@@ -774,6 +792,106 @@ void git_repository_set_index(git_repository *repo, git_index *index)
 	set_index(repo, index);
 }
 
+int git_repository_set_fsmonitor(git_repository *repo, git_fsmonitor *fsmonitor)
+{
+	assert(repo);
+
+	if (fsmonitor)
+		GITERR_CHECK_VERSION(
+			fsmonitor, GIT_FSMONITOR_VERSION, "git_fsmonitor");
+
+	if ((fsmonitor = git__swap(repo->_fsmonitor, fsmonitor)) != NULL)
+		fsmonitor->free(fsmonitor);
+
+	return 0;
+}
+
+int git_repository_set_graph_cache(git_repository *repo, size_t max_commits)
+{
+	git_graphcache *cache = NULL;
+
+	assert(repo);
+
+	if (max_commits && git_graphcache_new(&cache, max_commits) < 0)
+		return -1;
+
+	git_graphcache_free(git__swap(repo->graphcache, cache));
+	return 0;
+}
+
+int git_repository_set_signature_cache(
+	git_repository *repo, size_t max_signatures, const char *path)
+{
+	git_sigcache *cache = NULL;
+
+	assert(repo);
+
+	if (max_signatures && git_sigcache_new(&cache, max_signatures, path) < 0)
+		return -1;
+
+	git_sigcache_free(git__swap(repo->sigcache, cache));
+	return 0;
+}
+
+int git_repository_set_binary_cache(git_repository *repo, size_t max_blobs)
+{
+	git_binarycache *cache = NULL;
+
+	assert(repo);
+
+	if (max_blobs && git_binarycache_new(&cache, max_blobs) < 0)
+		return -1;
+
+	git_binarycache_free(git__swap(repo->binarycache, cache));
+	return 0;
+}
+
+int git_repository__grafts(git_grafts **out, git_repository *repo)
+{
+	int error = 0;
+
+	assert(out && repo);
+
+	if (git_mutex_lock(&repo->grafts_lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to lock repository grafts");
+		return -1;
+	}
+
+	if (repo->grafts && git_grafts_changed(repo->grafts, repo)) {
+		git_grafts_free(repo->grafts);
+		repo->grafts = NULL;
+
+		/* the cached parents may be the ones of the old grafts */
+		if (repo->graphcache)
+			git_graphcache_clear(repo->graphcache);
+	}
+
+	if (repo->grafts == NULL)
+		error = git_grafts_load(&repo->grafts, repo);
+
+	if (!error) {
+		GIT_REFCOUNT_INC(repo->grafts);
+		*out = repo->grafts;
+	}
+
+	git_mutex_unlock(&repo->grafts_lock);
+	return error;
+}
+
+void git_repository__clear_grafts(git_repository *repo)
+{
+	if (git_mutex_lock(&repo->grafts_lock) < 0)
+		return;
+
+	git_grafts_free(repo->grafts);
+	repo->grafts = NULL;
+
+	if (repo->graphcache)
+		git_graphcache_clear(repo->graphcache);
+
+	git_mutex_unlock(&repo->grafts_lock);
+}
+
 int git_repository_set_namespace(git_repository *repo, const char *namespace)
 {
 	git__free(repo->namespace);
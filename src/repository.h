@@ -19,6 +19,10 @@
 #include "buffer.h"
 #include "object.h"
 #include "attrcache.h"
+#include "graphcache.h"
+#include "sigcache.h"
+#include "binarycache.h"
+#include "grafts.h"
 #include "submodule.h"
 #include "diff_driver.h"
 
@@ -40,6 +44,8 @@ typedef enum {
 	GIT_CVAR_PRECOMPOSE,    /* core.precomposeunicode */
 	GIT_CVAR_SAFE_CRLF,		/* core.safecrlf */
 	GIT_CVAR_LOGALLREFUPDATES, /* core.logallrefupdates */
+	GIT_CVAR_UNTRACKEDCACHE, /* core.untrackedcache */
+	GIT_CVAR_PRELOADINDEX,  /* core.preloadindex */
 	GIT_CVAR_CACHE_MAX
 } git_cvar_cached;
 
@@ -96,6 +102,13 @@ typedef enum {
 	/* core.logallrefupdates */
 	GIT_LOGALLREFUPDATES_UNSET = 2,
 	GIT_LOGALLREFUPDATES_DEFAULT = GIT_LOGALLREFUPDATES_UNSET,
+	/* core.untrackedcache: false, true, 'keep' */
+	GIT_UNTRACKEDCACHE_FALSE = 0,
+	GIT_UNTRACKEDCACHE_TRUE = 1,
+	GIT_UNTRACKEDCACHE_KEEP = 2,
+	GIT_UNTRACKEDCACHE_DEFAULT = GIT_UNTRACKEDCACHE_FALSE,
+	/* core.preloadindex: bool */
+	GIT_PRELOADINDEX_DEFAULT = GIT_CVAR_TRUE,
 } git_cvar_value;
 
 /* internal repository init flags */
@@ -112,11 +125,18 @@ struct git_repository {
 	git_config *_config;
 	git_index *_index;
 	git_submodule_cache *_submodules;
+	git_fsmonitor *_fsmonitor;
 
 	git_cache objects;
 	git_attr_cache *attrcache;
+	git_graphcache *graphcache;
+	git_sigcache *sigcache;
+	git_binarycache *binarycache;
 	git_diff_driver_registry *diff_drivers;
 
+	git_mutex grafts_lock;
+	git_grafts *grafts;
+
 	char *path_repository;
 	char *workdir;
 	char *namespace;
@@ -146,6 +166,15 @@ int git_repository_odb__weakptr(git_odb **out, git_repository *repo);
 int git_repository_refdb__weakptr(git_refdb **out, git_repository *repo);
 int git_repository_index__weakptr(git_index **out, git_repository *repo);
 
+/*
+ * The grafts and shallow roots of the repository, reloaded when their
+ * files changed.  The caller owns a reference and must free it.
+ */
+int git_repository__grafts(git_grafts **out, git_repository *repo);
+
+/* Forget the grafts, after the files they come from were rewritten */
+void git_repository__clear_grafts(git_repository *repo);
+
 /*
  * CVAR cache
  *
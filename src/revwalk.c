@@ -11,6 +11,7 @@
 #include "pool.h"
 
 #include "revwalk.h"
+#include "tree.h"
 #include "git2/revparse.h"
 #include "merge.h"
 
@@ -39,6 +40,409 @@ git_commit_list_node *git_revwalk__commit_lookup(
 	return commit;
 }
 
+/* The parents of a commit which the walk follows */
+static unsigned short commit_parents(
+	git_commit_list_node ***parents_out,
+	git_revwalk *walk,
+	git_commit_list_node *commit)
+{
+	if (commit->simplified) {
+		*parents_out = &commit->parents[commit->follow_parent];
+		return 1;
+	}
+
+	*parents_out = commit->parents;
+
+	if (walk->first_parent && commit->out_degree)
+		return 1;
+
+	return commit->out_degree;
+}
+
+/*
+ * Path limiting
+ *
+ * Each commit is reduced to the tree entries found at the limiting paths,
+ * so that it can be compared to its parents without diffing their trees.
+ * The entry found underneath every tree on the way to a path is cached,
+ * so a subtree which many commits share is only read once during a walk.
+ */
+
+typedef struct {
+	git_oid id;
+	uint16_t mode;
+} limit_entry;
+
+typedef struct {
+	git_oid tree_id;
+	limit_entry entry;
+} limit_tree_entry;
+
+typedef struct {
+	char *buf;
+	git_bloom_key key;
+	size_t depth;
+	char **components;
+	git_oidmap **trees; /* one map of tree id to limit_tree_entry per depth */
+} limit_path;
+
+static void limit_path_free(limit_path *path)
+{
+	size_t i;
+
+	if (path == NULL)
+		return;
+
+	for (i = 0; path->trees && i < path->depth; ++i)
+		git_oidmap_free(path->trees[i]);
+
+	git__free(path->trees);
+	git__free(path->components);
+	git__free(path->buf);
+	git__free(path);
+}
+
+static int limit_path_new(limit_path **out, const char *str)
+{
+	limit_path *path;
+	size_t len, i;
+	char *scan;
+
+	path = git__calloc(1, sizeof(limit_path));
+	GITERR_CHECK_ALLOC(path);
+
+	if ((path->buf = git__strdup(str)) == NULL)
+		goto on_error;
+
+	len = strlen(path->buf);
+	while (len > 0 && path->buf[len - 1] == '/')
+		path->buf[--len] = '\0';
+
+	if (!len || path->buf[0] == '/' || strstr(path->buf, "//") != NULL) {
+		giterr_set(GITERR_INVALID, "Invalid path '%s' to limit the walk to", str);
+		goto on_error;
+	}
+
+	git_bloom_key_init(&path->key, path->buf, len);
+
+	path->depth = 1;
+	for (scan = path->buf; *scan; ++scan)
+		if (*scan == '/')
+			path->depth++;
+
+	path->components = git__calloc(path->depth, sizeof(char *));
+	path->trees = git__calloc(path->depth, sizeof(git_oidmap *));
+	if (!path->components || !path->trees)
+		goto on_error;
+
+	for (i = 0, scan = path->buf; i < path->depth; ++i) {
+		path->components[i] = scan;
+
+		if ((scan = strchr(scan, '/')) != NULL)
+			*scan++ = '\0';
+
+		if ((path->trees[i] = git_oidmap_alloc()) == NULL) {
+			giterr_set_oom();
+			goto on_error;
+		}
+	}
+
+	*out = path;
+	return 0;
+
+on_error:
+	limit_path_free(path);
+	return -1;
+}
+
+static void limit_clear(git_revwalk *walk)
+{
+	limit_path *path;
+	size_t i;
+
+	git_vector_foreach(&walk->limit_paths, i, path)
+		limit_path_free(path);
+
+	git_vector_free(&walk->limit_paths);
+	git_oidmap_free(walk->limit_commits);
+	git_pool_clear(&walk->limit_pool);
+}
+
+/* Load the changed-path filters of the repository, if it has any */
+static int load_bloom(git_revwalk *walk)
+{
+	int error;
+
+	/* the generations and filters were computed with the real parents */
+	if (walk->bloom != NULL || walk->grafts != NULL)
+		return 0;
+
+	if ((error = git_bloom_file_open(&walk->bloom, walk->repo)) == GIT_ENOTFOUND) {
+		giterr_clear();
+		error = 0;
+	}
+
+	return error;
+}
+
+/* Find the entry at `path` (from the component at `depth` on) in a tree */
+static int limit_resolve(
+	limit_entry *out,
+	git_revwalk *walk,
+	limit_path *path,
+	size_t depth,
+	const git_oid *tree_id)
+{
+	git_oidmap *trees = path->trees[depth];
+	git_tree *tree;
+	const git_tree_entry *te;
+	limit_tree_entry *cached;
+	git_oid subtree_id;
+	bool descend = false;
+	khiter_t pos;
+	int error, ret;
+
+	pos = kh_get(oid, trees, tree_id);
+	if (pos != kh_end(trees)) {
+		*out = ((limit_tree_entry *)kh_value(trees, pos))->entry;
+		return 0;
+	}
+
+	if ((error = git_tree_lookup(&tree, walk->repo, tree_id)) < 0)
+		return error;
+
+	memset(out, 0, sizeof(*out));
+
+	if ((te = git_tree_entry_byname(tree, path->components[depth])) == NULL)
+		/* not found */;
+	else if (depth + 1 == path->depth) {
+		git_oid_cpy(&out->id, &te->oid);
+		out->mode = te->attr;
+	} else if (git_tree_entry__is_tree(te)) {
+		git_oid_cpy(&subtree_id, &te->oid);
+		descend = true;
+	}
+
+	git_tree_free(tree);
+
+	if (descend &&
+		(error = limit_resolve(out, walk, path, depth + 1, &subtree_id)) < 0)
+		return error;
+
+	cached = git_pool_malloc(&walk->limit_pool, sizeof(limit_tree_entry));
+	GITERR_CHECK_ALLOC(cached);
+
+	git_oid_cpy(&cached->tree_id, tree_id);
+	cached->entry = *out;
+
+	pos = kh_put(oid, trees, &cached->tree_id, &ret);
+	if (ret < 0) {
+		giterr_set_oom();
+		return -1;
+	}
+	kh_value(trees, pos) = cached;
+
+	return 0;
+}
+
+static int limit_commit_tree(
+	git_oid *out, git_revwalk *walk, git_commit_list_node *commit)
+{
+	git_odb_object *obj;
+	const char *data;
+	int error;
+
+	if ((error = git_odb_read(&obj, walk->odb, &commit->oid)) < 0)
+		return error;
+
+	data = git_odb_object_data(obj);
+
+	if (obj->cached.type != GIT_OBJ_COMMIT ||
+		git_odb_object_size(obj) < strlen("tree ") + GIT_OID_HEXSZ ||
+		git__prefixcmp(data, "tree ") != 0) {
+		giterr_set(GITERR_INVALID, "Failed to parse commit - missing tree");
+		error = -1;
+	} else
+		error = git_oid__fromhex(out, data + strlen("tree "));
+
+	git_odb_object_free(obj);
+	return error;
+}
+
+/* Look up the entries of a commit at all of the limiting paths */
+static int limit_commit_entries(
+	limit_entry **out, git_revwalk *walk, git_commit_list_node *commit)
+{
+	limit_entry *entries;
+	limit_path *path;
+	git_oid tree_id;
+	khiter_t pos;
+	size_t i;
+	int error, ret;
+
+	pos = kh_get(oid, walk->limit_commits, &commit->oid);
+	if (pos != kh_end(walk->limit_commits)) {
+		*out = kh_value(walk->limit_commits, pos);
+		return 0;
+	}
+
+	if ((error = limit_commit_tree(&tree_id, walk, commit)) < 0)
+		return error;
+
+	entries = git_pool_malloc(&walk->limit_pool,
+		(uint32_t)(walk->limit_paths.length * sizeof(limit_entry)));
+	GITERR_CHECK_ALLOC(entries);
+
+	git_vector_foreach(&walk->limit_paths, i, path) {
+		if ((error = limit_resolve(&entries[i], walk, path, 0, &tree_id)) < 0)
+			return error;
+	}
+
+	pos = kh_put(oid, walk->limit_commits, &commit->oid, &ret);
+	if (ret < 0) {
+		giterr_set_oom();
+		return -1;
+	}
+	kh_value(walk->limit_commits, pos) = entries;
+
+	*out = entries;
+	return 0;
+}
+
+/* compare the entries of two commits, or against nothing at all */
+static bool limit_entries_equal(
+	const limit_entry *a, const limit_entry *b, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; ++i) {
+		if (b == NULL) {
+			if (a[i].mode != 0)
+				return false;
+		} else if (a[i].mode != b[i].mode || !git_oid_equal(&a[i].id, &b[i].id))
+			return false;
+	}
+
+	return true;
+}
+
+/* Whether the changed-path filter of a commit rules out any change to
+ * the limiting paths relative to its first parent */
+static bool limit_filtered_out(git_revwalk *walk, git_commit_list_node *commit)
+{
+	git_bloom_filter filter;
+	limit_path *path;
+	size_t i;
+
+	if (!walk->bloom ||
+		git_bloom_file_lookup(&filter, walk->bloom, &commit->oid) < 0)
+		return false;
+
+	git_vector_foreach(&walk->limit_paths, i, path) {
+		if (git_bloom_filter_contains(&filter, &path->key))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Decide whether a commit modifies any of the limiting paths, and
+ * simplify its history: when a commit matches one of its parents at
+ * all of the paths, it is not shown and only that parent is followed.
+ */
+static int limit_commit(git_revwalk *walk, git_commit_list_node *commit)
+{
+	limit_entry *entries, *parent_entries;
+	size_t count = walk->limit_paths.length;
+	unsigned short i, max;
+	int error;
+
+	commit->treesame = 0;
+	commit->simplified = 0;
+
+	max = (walk->first_parent && commit->out_degree) ? 1 : commit->out_degree;
+
+	/* the first parent is the first one a commit is compared to */
+	if (limit_filtered_out(walk, commit)) {
+		commit->treesame = 1;
+
+		if (max > 1) {
+			commit->simplified = 1;
+			commit->follow_parent = 0;
+		}
+		return 0;
+	}
+
+	if ((error = limit_commit_entries(&entries, walk, commit)) < 0)
+		return error;
+
+	if (!commit->out_degree) {
+		commit->treesame = limit_entries_equal(entries, NULL, count);
+		return 0;
+	}
+
+	for (i = 0; i < max; ++i) {
+		if ((error = limit_commit_entries(
+				&parent_entries, walk, commit->parents[i])) < 0)
+			return error;
+
+		if (limit_entries_equal(entries, parent_entries, count)) {
+			commit->treesame = 1;
+
+			if (max > 1) {
+				commit->simplified = 1;
+				commit->follow_parent = i;
+			}
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int git_revwalk_limit_paths(git_revwalk *walk, const git_strarray *paths)
+{
+	limit_path *path;
+	size_t i;
+	int error = -1;
+
+	assert(walk);
+
+	if (walk->walking)
+		git_revwalk_reset(walk);
+
+	limit_clear(walk);
+
+	if (paths == NULL || !paths->count)
+		return 0;
+
+	if (git_vector_init(&walk->limit_paths, paths->count, NULL) < 0)
+		return -1;
+
+	if ((walk->limit_commits = git_oidmap_alloc()) == NULL) {
+		giterr_set_oom();
+		goto on_error;
+	}
+
+	for (i = 0; i < paths->count; ++i) {
+		if ((error = limit_path_new(&path, paths->strings[i])) < 0)
+			goto on_error;
+
+		if ((error = git_vector_insert(&walk->limit_paths, path)) < 0) {
+			limit_path_free(path);
+			goto on_error;
+		}
+	}
+
+	if (!(error = load_bloom(walk)))
+		return 0;
+
+on_error:
+	limit_clear(walk);
+	return error;
+}
+
 static int mark_uninteresting(git_revwalk *walk, git_commit_list_node *commit)
 {
 	int error;
@@ -100,15 +504,18 @@ static int process_commit(git_revwalk *walk, git_commit_list_node *commit, int h
 
 static int process_commit_parents(git_revwalk *walk, git_commit_list_node *commit)
 {
+	git_commit_list_node **parents;
 	unsigned short i, max;
 	int error = 0;
 
-	max = commit->out_degree;
-	if (walk->first_parent && commit->out_degree)
-		max = 1;
+	if (walk->limit_paths.length > 0 && !commit->uninteresting &&
+		(error = limit_commit(walk, commit)) < 0)
+		return error;
+
+	max = commit_parents(&parents, walk, commit);
 
 	for (i = 0; i < max && !error; ++i)
-		error = process_commit(walk, commit->parents[i], commit->uninteresting);
+		error = process_commit(walk, parents[i], commit->uninteresting);
 
 	return error;
 }
@@ -290,6 +697,20 @@ static int revwalk_enqueue_unsorted(git_revwalk *walk, git_commit_list_node *com
 	return git_commit_list_insert(commit, &walk->iterator_rand) ? 0 : -1;
 }
 
+static int revwalk_enqueue_explore(git_revwalk *walk, git_commit_list_node *commit)
+{
+	if (!commit->generation) {
+		commit->generation = git_bloom_file_generation(walk->bloom, &commit->oid);
+
+		/* without a generation, a commit has to be treated as if it
+		 * could be a descendant of anything else */
+		if (commit->generation == GIT_BLOOM_GENERATION_UNKNOWN)
+			commit->generation = GIT_BLOOM_GENERATION_MAX;
+	}
+
+	return git_pqueue_insert(&walk->explore_queue, commit);
+}
+
 static int revwalk_next_timesort(git_commit_list_node **object_out, git_revwalk *walk)
 {
 	int error;
@@ -328,7 +749,7 @@ static int revwalk_next_unsorted(git_commit_list_node **object_out, git_revwalk
 
 static int revwalk_next_toposort(git_commit_list_node **object_out, git_revwalk *walk)
 {
-	git_commit_list_node *next;
+	git_commit_list_node *next, **parents;
 	unsigned short i, max;
 
 	for (;;) {
@@ -343,13 +764,10 @@ static int revwalk_next_toposort(git_commit_list_node **object_out, git_revwalk
 			continue;
 		}
 
-
-		max = next->out_degree;
-		if (walk->first_parent && next->out_degree)
-			max = 1;
+		max = commit_parents(&parents, walk, next);
 
 		for (i = 0; i < max; ++i) {
-			git_commit_list_node *parent = next->parents[i];
+			git_commit_list_node *parent = parents[i];
 
 			if (--parent->in_degree == 0 && parent->topo_delay) {
 				parent->topo_delay = 0;
@@ -363,6 +781,162 @@ static int revwalk_next_toposort(git_commit_list_node **object_out, git_revwalk
 	}
 }
 
+/*
+ * Incremental topological sorting
+ *
+ * Commits are explored in order of decreasing generation.  Every child
+ * of a commit has a larger generation than it, so once the walk has
+ * counted the in-degrees of all the commits down to the generation of a
+ * commit, the commit's in-degree is final and it can be returned as soon
+ * as it drops to zero.  In-degrees are stored one too high, so that zero
+ * still means "not counted yet".
+ */
+
+static int topo_explore_to_depth(git_revwalk *walk, uint32_t generation)
+{
+	git_commit_list_node *next;
+	int error;
+
+	while ((next = git_pqueue_get(&walk->explore_queue, 0)) != NULL &&
+		next->generation >= generation) {
+		git_pqueue_pop(&walk->explore_queue);
+
+		if (!next->uninteresting &&
+			(error = process_commit_parents(walk, next)) < 0)
+			return error;
+	}
+
+	return 0;
+}
+
+static int topo_indegrees_to_depth(git_revwalk *walk, uint32_t generation)
+{
+	git_commit_list_node *next, **parents;
+	unsigned short i, max;
+	int error;
+
+	while ((next = git_pqueue_get(&walk->indegree_queue, 0)) != NULL &&
+		next->generation >= generation) {
+		git_pqueue_pop(&walk->indegree_queue);
+
+		if ((error = topo_explore_to_depth(walk, next->generation)) < 0)
+			return error;
+
+		max = commit_parents(&parents, walk, next);
+
+		for (i = 0; i < max; ++i) {
+			git_commit_list_node *parent = parents[i];
+
+			if (parent->uninteresting)
+				continue;
+
+			if (parent->in_degree) {
+				parent->in_degree++;
+				continue;
+			}
+
+			parent->in_degree = 2;
+			if ((error = git_pqueue_insert(&walk->indegree_queue, parent)) < 0)
+				return error;
+		}
+	}
+
+	return 0;
+}
+
+static int topo_output(git_revwalk *walk, git_commit_list_node *commit)
+{
+	if (walk->sorting & GIT_SORT_TIME)
+		return git_pqueue_insert(&walk->iterator_time, commit);
+
+	return git_commit_list_insert(commit, &walk->iterator_topo) ? 0 : -1;
+}
+
+static int revwalk_next_toposort_incremental(
+	git_commit_list_node **object_out, git_revwalk *walk)
+{
+	git_commit_list_node *next, **parents;
+	unsigned short i, max;
+	int error;
+
+	do {
+		if (walk->sorting & GIT_SORT_TIME)
+			next = git_pqueue_pop(&walk->iterator_time);
+		else
+			next = git_commit_list_pop(&walk->iterator_topo);
+
+		if (next == NULL) {
+			giterr_clear();
+			return GIT_ITEROVER;
+		}
+	} while (next->uninteresting);
+
+	max = commit_parents(&parents, walk, next);
+
+	for (i = 0; i < max; ++i) {
+		git_commit_list_node *parent = parents[i];
+
+		if (parent->uninteresting)
+			continue;
+
+		if ((error = topo_indegrees_to_depth(walk, parent->generation)) < 0)
+			return error;
+
+		if (--parent->in_degree == 1 && (error = topo_output(walk, parent)) < 0)
+			return error;
+	}
+
+	*object_out = next;
+	return 0;
+}
+
+static int prepare_toposort_incremental(git_revwalk *walk)
+{
+	git_commit_list_node *start;
+	uint32_t min_generation = GIT_BLOOM_GENERATION_MAX;
+	unsigned int i;
+	int error;
+
+	walk->enqueue = &revwalk_enqueue_explore;
+	walk->get_next = &revwalk_next_toposort_incremental;
+
+	for (i = 0, start = walk->one; start != NULL;
+		 start = git_vector_get(&walk->twos, i++)) {
+		if ((error = process_commit(walk, start, start->uninteresting)) < 0)
+			return error;
+	}
+
+	for (i = 0, start = walk->one; start != NULL;
+		 start = git_vector_get(&walk->twos, i++)) {
+		if (start->uninteresting || start->in_degree)
+			continue;
+
+		start->in_degree = 1;
+		if ((error = git_pqueue_insert(&walk->indegree_queue, start)) < 0)
+			return error;
+
+		if (start->generation < min_generation)
+			min_generation = start->generation;
+	}
+
+	if ((error = topo_indegrees_to_depth(walk, min_generation)) < 0)
+		return error;
+
+	/* the starting points which no other one reaches can go first */
+	for (i = 0, start = walk->one; start != NULL;
+		 start = git_vector_get(&walk->twos, i++)) {
+		if (start->uninteresting || start->in_degree != 1 || start->topo_delay)
+			continue;
+
+		start->topo_delay = 1;
+		if ((error = topo_output(walk, start)) < 0)
+			return error;
+	}
+
+	walk->walking = 1;
+	return 0;
+}
+
 static int revwalk_next_reverse(git_commit_list_node **object_out, git_revwalk *walk)
 {
 	*object_out = git_commit_list_pop(&walk->iterator_reverse);
@@ -385,6 +959,16 @@ static int prepare_walk(git_revwalk *walk)
 		return GIT_ITEROVER;
 	}
 
+	/* with generation numbers, a topological walk can be streamed */
+	if ((walk->sorting & GIT_SORT_TOPOLOGICAL) &&
+		!(walk->sorting & GIT_SORT_REVERSE)) {
+		if ((error = load_bloom(walk)) < 0)
+			return error;
+
+		if (walk->bloom != NULL)
+			return prepare_toposort_incremental(walk);
+	}
+
 	if (process_commit(walk, walk->one, walk->one->uninteresting) < 0)
 		return -1;
 
@@ -394,13 +978,14 @@ static int prepare_walk(git_revwalk *walk)
 	}
 
 	if (walk->sorting & GIT_SORT_TOPOLOGICAL) {
-		unsigned short i;
+		git_commit_list_node **parents;
+		unsigned short i, max;
 
 		while ((error = walk->get_next(&next, walk)) == 0) {
-			for (i = 0; i < next->out_degree; ++i) {
-				git_commit_list_node *parent = next->parents[i];
-				parent->in_degree++;
-			}
+			max = commit_parents(&parents, walk, next);
+
+			for (i = 0; i < max; ++i)
+				parents[i]->in_degree++;
 
 			if (git_commit_list_insert(next, &walk->iterator_topo) == NULL)
 				return -1;
@@ -443,9 +1028,14 @@ int git_revwalk_new(git_revwalk **revwalk_out, git_repository *repo)
 
 	if (git_pqueue_init(
 			&walk->iterator_time, 0, 8, git_commit_list_time_cmp) < 0 ||
+		git_pqueue_init(&walk->explore_queue,
+			0, 8, git_commit_list_generation_cmp) < 0 ||
+		git_pqueue_init(&walk->indegree_queue,
+			0, 8, git_commit_list_generation_cmp) < 0 ||
 		git_vector_init(&walk->twos, 4, NULL) < 0 ||
 		git_pool_init(&walk->commit_pool, 1,
-			git_pool__suggest_items_per_page(COMMIT_ALLOC) * COMMIT_ALLOC) < 0)
+			git_pool__suggest_items_per_page(COMMIT_ALLOC) * COMMIT_ALLOC) < 0 ||
+		git_pool_init(&walk->limit_pool, 1, 0) < 0)
 		return -1;
 
 	walk->get_next = &revwalk_next_unsorted;
@@ -453,11 +1043,17 @@ int git_revwalk_new(git_revwalk **revwalk_out, git_repository *repo)
 
 	walk->repo = repo;
 
-	if (git_repository_odb(&walk->odb, repo) < 0) {
+	if (git_repository_odb(&walk->odb, repo) < 0 ||
+		git_repository__grafts(&walk->grafts, repo) < 0) {
 		git_revwalk_free(walk);
 		return -1;
 	}
 
+	if (!git_grafts_size(walk->grafts)) {
+		git_grafts_free(walk->grafts);
+		walk->grafts = NULL;
+	}
+
 	*revwalk_out = walk;
 	return 0;
 }
@@ -469,10 +1065,15 @@ void git_revwalk_free(git_revwalk *walk)
 
 	git_revwalk_reset(walk);
 	git_odb_free(walk->odb);
+	git_grafts_free(walk->grafts);
+	limit_clear(walk);
+	git_bloom_file_free(walk->bloom);
 
 	git_oidmap_free(walk->commits);
 	git_pool_clear(&walk->commit_pool);
 	git_pqueue_free(&walk->iterator_time);
+	git_pqueue_free(&walk->explore_queue);
+	git_pqueue_free(&walk->indegree_queue);
 	git_vector_free(&walk->twos);
 	git__free(walk);
 }
@@ -483,15 +1084,9 @@ git_repository *git_revwalk_repository(git_revwalk *walk)
 	return walk->repo;
 }
 
-void git_revwalk_sorting(git_revwalk *walk, unsigned int sort_mode)
+/* Set up the queue a walk starts from, which prepare_walk may replace */
+static void set_sort_functions(git_revwalk *walk)
 {
-	assert(walk);
-
-	if (walk->walking)
-		git_revwalk_reset(walk);
-
-	walk->sorting = sort_mode;
-
 	if (walk->sorting & GIT_SORT_TIME) {
 		walk->get_next = &revwalk_next_timesort;
 		walk->enqueue = &revwalk_enqueue_timesort;
@@ -501,6 +1096,17 @@ void git_revwalk_sorting(git_revwalk *walk, unsigned int sort_mode)
 	}
 }
 
+void git_revwalk_sorting(git_revwalk *walk, unsigned int sort_mode)
+{
+	assert(walk);
+
+	if (walk->walking)
+		git_revwalk_reset(walk);
+
+	walk->sorting = sort_mode;
+	set_sort_functions(walk);
+}
+
 void git_revwalk_simplify_first_parent(git_revwalk *walk)
 {
 	walk->first_parent = 1;
@@ -518,7 +1124,10 @@ int git_revwalk_next(git_oid *oid, git_revwalk *walk)
 			return error;
 	}
 
-	error = walk->get_next(&next, walk);
+	/* commits which don't modify the limiting paths only shape the walk */
+	do {
+		error = walk->get_next(&next, walk);
+	} while (!error && next->treesame);
 
 	if (error == GIT_ITEROVER) {
 		git_revwalk_reset(walk);
@@ -543,13 +1152,18 @@ void git_revwalk_reset(git_revwalk *walk)
 		commit->in_degree = 0;
 		commit->topo_delay = 0;
 		commit->uninteresting = 0;
+		commit->treesame = 0;
+		commit->simplified = 0;
 		});
 
 	git_pqueue_clear(&walk->iterator_time);
+	git_pqueue_clear(&walk->explore_queue);
+	git_pqueue_clear(&walk->indegree_queue);
 	git_commit_list_free(&walk->iterator_topo);
 	git_commit_list_free(&walk->iterator_rand);
 	git_commit_list_free(&walk->iterator_reverse);
 	walk->walking = 0;
+	set_sort_functions(walk);
 
 	walk->one = NULL;
 	git_vector_clear(&walk->twos);
@@ -13,6 +13,8 @@
 #include "pqueue.h"
 #include "pool.h"
 #include "vector.h"
+#include "bloom.h"
+#include "grafts.h"
 
 GIT__USE_OIDMAP;
 
@@ -20,6 +22,9 @@ struct git_revwalk {
 	git_repository *repo;
 	git_odb *odb;
 
+	/* parents replaced by grafts or cut at the shallow boundary */
+	git_grafts *grafts;
+
 	git_oidmap *commits;
 	git_pool commit_pool;
 
@@ -42,6 +47,18 @@ struct git_revwalk {
 	/* hide callback */
 	git_revwalk_hide_cb hide_cb;
 	void *hide_cb_payload;
+
+	/* path limiting */
+	git_vector limit_paths;
+	git_oidmap *limit_commits;
+	git_pool limit_pool;
+
+	/* changed-path filters and generation numbers */
+	git_bloom_file *bloom;
+
+	/* incremental topological sorting */
+	git_pqueue explore_queue;
+	git_pqueue indegree_queue;
 };
 
 git_commit_list_node *git_revwalk__commit_lookup(git_revwalk *walk, const git_oid *oid);
@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "sigcache.h"
+#include "fileops.h"
+#include "filebuf.h"
+
+GIT__USE_OIDMAP;
+
+/*
+ * The cache file starts with a signature and a version, followed by one
+ * record per blob: its raw id, the whitespace option and the size of the
+ * blob, and the signature as written by `git_hashsig_write`.  Records
+ * are only ever appended; a file which ends in the middle of a record,
+ * or which would hold more records than the cache, is rewritten (under
+ * its lock file) on the next save.
+ */
+#define SIGCACHE_FILE_SIGNATURE "SIGC"
+#define SIGCACHE_FILE_VERSION 1
+#define SIGCACHE_FILE_MODE 0644
+
+#define SIGCACHE_HEADER_SIZE 8
+#define SIGCACHE_RECORD_SIZE (GIT_OID_RAWSZ + 3 * sizeof(uint32_t))
+
+static void sigcache_unlink(git_sigcache *cache, git_sigcache_entry *entry)
+{
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	else
+		cache->newest = entry->older;
+
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	else
+		cache->oldest = entry->newer;
+
+	entry->newer = entry->older = NULL;
+}
+
+static void sigcache_link_newest(git_sigcache *cache, git_sigcache_entry *entry)
+{
+	entry->older = cache->newest;
+	entry->newer = NULL;
+
+	if (cache->newest)
+		cache->newest->newer = entry;
+	else
+		cache->oldest = entry;
+
+	cache->newest = entry;
+}
+
+static void sigcache_evict_oldest(git_sigcache *cache)
+{
+	git_sigcache_entry *entry = cache->oldest;
+	git_oidmap *map = cache->map[entry->opt];
+	khiter_t pos;
+
+	pos = kh_get(oid, map, &entry->oid);
+	if (pos != kh_end(map))
+		kh_del(oid, map, pos);
+
+	if (!entry->saved) {
+		cache->unsaved.contents[entry->unsaved_pos] = NULL;
+		cache->unsaved_count--;
+	}
+
+	sigcache_unlink(cache, entry);
+	cache->count--;
+
+	git_hashsig_free(entry->sig);
+	git__free(entry);
+}
+
+/* Add an entry, taking ownership of the signature */
+static int sigcache_insert(
+	git_sigcache *cache,
+	const git_oid *blob_id,
+	git_hashsig_option_t opt,
+	git_off_t size,
+	git_hashsig *sig,
+	bool saved)
+{
+	git_oidmap *map = cache->map[opt];
+	git_sigcache_entry *entry;
+	khiter_t pos;
+	int ret;
+
+	if (kh_get(oid, map, blob_id) != kh_end(map)) {
+		git_hashsig_free(sig);
+		return 0;
+	}
+
+	if (cache->count >= cache->max_entries)
+		sigcache_evict_oldest(cache);
+
+	entry = git__calloc(1, sizeof(git_sigcache_entry));
+	if (entry == NULL) {
+		git_hashsig_free(sig);
+		return -1;
+	}
+
+	git_oid_cpy(&entry->oid, blob_id);
+	entry->size = size;
+	entry->sig = sig;
+	entry->opt = opt;
+	entry->saved = saved;
+	entry->unsaved_pos = cache->unsaved.length;
+
+	if (!saved && git_vector_insert(&cache->unsaved, entry) < 0) {
+		git_hashsig_free(sig);
+		git__free(entry);
+		return -1;
+	}
+
+	pos = kh_put(oid, map, &entry->oid, &ret);
+	if (ret < 0) {
+		if (!saved)
+			git_vector_pop(&cache->unsaved);
+		git_hashsig_free(sig);
+		git__free(entry);
+		giterr_set_oom();
+		return -1;
+	}
+	kh_value(map, pos) = entry;
+
+	sigcache_link_newest(cache, entry);
+	cache->count++;
+
+	if (!saved)
+		cache->unsaved_count++;
+
+	return 0;
+}
+
+static int sigcache_read_record(
+	git_sigcache *cache, const char **data, const char *end)
+{
+	git_hashsig *sig;
+	git_oid blob_id;
+	uint32_t fields[3];
+	git_off_t size;
+	size_t sig_len;
+
+	if ((size_t)(end - *data) < SIGCACHE_RECORD_SIZE)
+		return -1;
+
+	git_oid_fromraw(&blob_id, (const unsigned char *)*data);
+	memcpy(fields, *data + GIT_OID_RAWSZ, sizeof(fields));
+	*data += SIGCACHE_RECORD_SIZE;
+
+	if (ntohl(fields[0]) >= GIT_SIGCACHE_OPTIONS)
+		return -1;
+
+	size = (git_off_t)(((uint64_t)ntohl(fields[1]) << 32) | ntohl(fields[2]));
+
+	if (git_hashsig_read(&sig, *data, (size_t)(end - *data), &sig_len) < 0)
+		return -1;
+
+	*data += sig_len;
+
+	return sigcache_insert(cache, &blob_id,
+		(git_hashsig_option_t)ntohl(fields[0]), size, sig, true);
+}
+
+static int sigcache_load(git_sigcache *cache)
+{
+	git_buf contents = GIT_BUF_INIT;
+	const char *data, *end;
+	uint32_t version;
+	size_t records = 0;
+	int error;
+
+	if ((error = git_futils_readbuffer(&contents, cache->path)) < 0) {
+		if (error == GIT_ENOTFOUND) {
+			giterr_clear();
+			error = 0;
+		}
+
+		cache->rewrite = 1;
+		return error;
+	}
+
+	data = contents.ptr;
+	end = contents.ptr + contents.size;
+
+	if (contents.size < SIGCACHE_HEADER_SIZE ||
+		memcmp(data, SIGCACHE_FILE_SIGNATURE, 4) != 0) {
+		cache->rewrite = 1;
+		goto done;
+	}
+
+	memcpy(&version, data + 4, sizeof(version));
+	data += SIGCACHE_HEADER_SIZE;
+
+	/* signatures from another version may not be computed the same way */
+	if (ntohl(version) != SIGCACHE_FILE_VERSION) {
+		cache->rewrite = 1;
+		goto done;
+	}
+
+	while (data < end) {
+		if (sigcache_read_record(cache, &data, end) < 0) {
+			/* keep what could be read, the rest is overwritten */
+			giterr_clear();
+			cache->rewrite = 1;
+			break;
+		}
+
+		records++;
+	}
+
+	cache->file_records = records;
+
+	/* compact a file holding duplicates or more than the cache can */
+	if (records > cache->count)
+		cache->rewrite = 1;
+
+done:
+	git_buf_free(&contents);
+	return 0;
+}
+
+int git_sigcache_new(git_sigcache **out, size_t max_entries, const char *path)
+{
+	git_sigcache *cache;
+	size_t i;
+
+	assert(out && max_entries > 0);
+
+	cache = git__calloc(1, sizeof(git_sigcache));
+	GITERR_CHECK_ALLOC(cache);
+
+	if (git_mutex_init(&cache->lock)) {
+		giterr_set(GITERR_OS, "Failed to initialize lock");
+		git__free(cache);
+		return -1;
+	}
+
+	cache->max_entries = max_entries;
+
+	if (git_vector_init(&cache->unsaved, 0, NULL) < 0) {
+		git_sigcache_free(cache);
+		return -1;
+	}
+
+	for (i = 0; i < GIT_SIGCACHE_OPTIONS; ++i) {
+		if ((cache->map[i] = git_oidmap_alloc()) == NULL) {
+			git_sigcache_free(cache);
+			giterr_set_oom();
+			return -1;
+		}
+	}
+
+	if (path != NULL &&
+		((cache->path = git__strdup(path)) == NULL ||
+		 sigcache_load(cache) < 0)) {
+		git_sigcache_free(cache);
+		return -1;
+	}
+
+	*out = cache;
+	return 0;
+}
+
+int git_sigcache_get(
+	git_hashsig **out,
+	git_off_t *size,
+	git_sigcache *cache,
+	const git_oid *blob_id,
+	git_hashsig_option_t opt)
+{
+	git_oidmap *map;
+	git_sigcache_entry *entry;
+	khiter_t pos;
+	int error = GIT_ENOTFOUND;
+
+	assert(out && size && cache && blob_id && opt < GIT_SIGCACHE_OPTIONS);
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to lock signature cache");
+		return -1;
+	}
+
+	map = cache->map[opt];
+	pos = kh_get(oid, map, blob_id);
+
+	if (pos != kh_end(map)) {
+		entry = kh_value(map, pos);
+
+		if ((error = git_hashsig_dup(out, entry->sig)) == 0) {
+			*size = entry->size;
+
+			sigcache_unlink(cache, entry);
+			sigcache_link_newest(cache, entry);
+		}
+	}
+
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+int git_sigcache_put(
+	git_sigcache *cache,
+	const git_oid *blob_id,
+	git_hashsig_option_t opt,
+	git_off_t size,
+	const git_hashsig *sig)
+{
+	git_hashsig *dup;
+	int error;
+
+	assert(cache && blob_id && sig && opt < GIT_SIGCACHE_OPTIONS);
+
+	if (git_hashsig_dup(&dup, sig) < 0)
+		return -1;
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		git_hashsig_free(dup);
+		giterr_set(GITERR_OS, "Unable to lock signature cache");
+		return -1;
+	}
+
+	/* without a file, there is nothing to save */
+	error = sigcache_insert(cache, blob_id, opt, size, dup, !cache->path);
+
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+static int sigcache_write_record(git_buf *out, git_sigcache_entry *entry)
+{
+	uint32_t fields[3];
+	uint64_t size = (uint64_t)entry->size;
+
+	fields[0] = htonl((uint32_t)entry->opt);
+	fields[1] = htonl((uint32_t)(size >> 32));
+	fields[2] = htonl((uint32_t)(size & 0xffffffff));
+
+	if (git_buf_put(out, (const char *)entry->oid.id, GIT_OID_RAWSZ) < 0 ||
+		git_buf_put(out, (const char *)fields, sizeof(fields)) < 0)
+		return -1;
+
+	return git_hashsig_write(out, entry->sig);
+}
+
+static int sigcache_write(git_sigcache *cache)
+{
+	git_sigcache_entry *entry;
+	git_filebuf file = GIT_FILEBUF_INIT;
+	git_buf records = GIT_BUF_INIT;
+	uint32_t version = htonl(SIGCACHE_FILE_VERSION);
+	size_t i;
+	int error = 0;
+
+	/* rather than growing the file past what the cache can hold (with
+	 * records of dropped and re-added signatures), compact it */
+	if (cache->file_records + cache->unsaved_count > cache->max_entries)
+		cache->rewrite = 1;
+
+	if (cache->rewrite) {
+		error = git_buf_put(&records, SIGCACHE_FILE_SIGNATURE, 4);
+		if (!error)
+			error = git_buf_put(&records, (const char *)&version, sizeof(version));
+
+		/* oldest first, so that the newest are the ones kept on load */
+		for (entry = cache->oldest; !error && entry; entry = entry->newer)
+			error = sigcache_write_record(&records, entry);
+	} else {
+		git_vector_foreach(&cache->unsaved, i, entry) {
+			if (entry != NULL &&
+				(error = sigcache_write_record(&records, entry)) < 0)
+				break;
+		}
+	}
+
+	if (error < 0)
+		goto done;
+
+	if (cache->rewrite) {
+		if ((error = git_filebuf_open(&file, cache->path,
+				GIT_FILEBUF_FORCE, SIGCACHE_FILE_MODE)) < 0 ||
+			(error = git_filebuf_write(&file, records.ptr, records.size)) < 0) {
+			git_filebuf_cleanup(&file);
+			goto done;
+		}
+
+		error = git_filebuf_commit(&file);
+	} else {
+		error = git_futils_writebuffer(
+			&records, cache->path, O_WRONLY | O_APPEND, SIGCACHE_FILE_MODE);
+	}
+
+	if (error < 0)
+		goto done;
+
+	git_vector_foreach(&cache->unsaved, i, entry) {
+		if (entry != NULL)
+			entry->saved = 1;
+	}
+
+	cache->file_records = cache->rewrite ?
+		cache->count : cache->file_records + cache->unsaved_count;
+
+	git_vector_clear(&cache->unsaved);
+	cache->unsaved_count = 0;
+	cache->rewrite = 0;
+
+done:
+	git_buf_free(&records);
+	return error;
+}
+
+int git_sigcache_save(git_sigcache *cache)
+{
+	int error = 0;
+
+	assert(cache);
+
+	if (cache->path == NULL)
+		return 0;
+
+	if (git_mutex_lock(&cache->lock) < 0) {
+		giterr_set(GITERR_OS, "Unable to lock signature cache");
+		return -1;
+	}
+
+	if (cache->unsaved_count || cache->rewrite)
+		error = sigcache_write(cache);
+
+	git_mutex_unlock(&cache->lock);
+	return error;
+}
+
+size_t git_sigcache_size(git_sigcache *cache)
+{
+	size_t size;
+
+	if (git_mutex_lock(&cache->lock) < 0)
+		return 0;
+
+	size = cache->count;
+
+	git_mutex_unlock(&cache->lock);
+	return size;
+}
+
+void git_sigcache_free(git_sigcache *cache)
+{
+	git_sigcache_entry *entry, *older;
+	size_t i;
+
+	if (cache == NULL)
+		return;
+
+	for (entry = cache->newest; entry; entry = older) {
+		older = entry->older;
+		git_hashsig_free(entry->sig);
+		git__free(entry);
+	}
+
+	for (i = 0; i < GIT_SIGCACHE_OPTIONS; ++i)
+		git_oidmap_free(cache->map[i]);
+
+	git_vector_free(&cache->unsaved);
+	git__free(cache->path);
+	git_mutex_free(&cache->lock);
+	git__free(cache);
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_sigcache_h__
+#define INCLUDE_sigcache_h__
+
+#include "common.h"
+#include "git2/oid.h"
+#include "thread-utils.h"
+#include "oidmap.h"
+#include "hashsig.h"
+#include "vector.h"
+
+/*
+ * Similarity signature cache
+ *
+ * Rename detection computes the similarity signature of every blob it
+ * compares, which means reading and hashing the whole of its contents,
+ * and does it again on each diff.  A repository can keep the signatures
+ * of blobs across diffs; as blobs never change, a signature is keyed by
+ * the id of the blob and the whitespace option it was computed with.
+ *
+ * The least recently used signatures are dropped when the cache is full.
+ * The cache can also be saved to a file, from which it is loaded when it
+ * is created; new signatures are appended to it by `git_sigcache_save`,
+ * and the file is rewritten once it would hold more than the cache.
+ */
+
+typedef struct git_sigcache_entry git_sigcache_entry;
+
+struct git_sigcache_entry {
+	git_oid oid;
+	git_off_t size;
+	git_hashsig *sig;
+	git_sigcache_entry *newer, *older;
+	size_t unsaved_pos; /* position in the cache's `unsaved` vector */
+	unsigned int opt:2,
+		saved:1;
+};
+
+#define GIT_SIGCACHE_OPTIONS (GIT_HASHSIG_SMART_WHITESPACE + 1)
+
+typedef struct {
+	git_mutex lock;
+	git_oidmap *map[GIT_SIGCACHE_OPTIONS];
+	git_sigcache_entry *newest, *oldest;
+	size_t count, max_entries;
+	char *path;
+	git_vector unsaved;   /* entries added since the last save (or NULL
+	                       * where they were dropped again) */
+	size_t unsaved_count; /* the entries in `unsaved` still cached */
+	size_t file_records;  /* the records in the file */
+	unsigned int rewrite:1;
+} git_sigcache;
+
+/*
+ * Create a cache of at most `max_entries` signatures, loading the ones
+ * saved in the file at `path` if it is given and exists.
+ */
+extern int git_sigcache_new(
+	git_sigcache **out, size_t max_entries, const char *path);
+
+/*
+ * Look up the signature of a blob, returning a copy of it and the size
+ * of the blob.  Returns GIT_ENOTFOUND if the blob is not in the cache.
+ */
+extern int git_sigcache_get(
+	git_hashsig **out,
+	git_off_t *size,
+	git_sigcache *cache,
+	const git_oid *blob_id,
+	git_hashsig_option_t opt);
+
+/* Remember a copy of the signature of a blob of the given size */
+extern int git_sigcache_put(
+	git_sigcache *cache,
+	const git_oid *blob_id,
+	git_hashsig_option_t opt,
+	git_off_t size,
+	const git_hashsig *sig);
+
+/* Write the signatures added since the last save to the cache file */
+extern int git_sigcache_save(git_sigcache *cache);
+
+extern size_t git_sigcache_size(git_sigcache *cache);
+
+extern void git_sigcache_free(git_sigcache *cache);
+
+#endif
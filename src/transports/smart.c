@@ -360,6 +360,9 @@ static void git_smart__free(git_transport *transport)
 
 	git_vector_free(refs);
 
+	git_array_clear(t->shallow);
+	git_array_clear(t->unshallow);
+
 	git__free(t);
 }
 
@@ -9,6 +9,7 @@
 #include "netops.h"
 #include "buffer.h"
 #include "push.h"
+#include "oidarray.h"
 
 #define GIT_SIDE_BAND_DATA     1
 #define GIT_SIDE_BAND_PROGRESS 2
@@ -24,6 +25,7 @@
 #define GIT_CAP_REPORT_STATUS "report-status"
 #define GIT_CAP_THIN_PACK "thin-pack"
 #define GIT_CAP_SYMREF "symref"
+#define GIT_CAP_SHALLOW "shallow"
 
 enum git_pkt_type {
 	GIT_PKT_CMD,
@@ -40,6 +42,8 @@ enum git_pkt_type {
 	GIT_PKT_OK,
 	GIT_PKT_NG,
 	GIT_PKT_UNPACK,
+	GIT_PKT_SHALLOW,
+	GIT_PKT_UNSHALLOW,
 };
 
 /* Used for multi_ack and mutli_ack_detailed */
@@ -111,6 +115,12 @@ typedef struct {
 	int unpack_ok;
 } git_pkt_unpack;
 
+/* The shallow boundary of a fetch moved to or from a commit */
+typedef struct {
+	enum git_pkt_type type;
+	git_oid oid;
+} git_pkt_shallow;
+
 typedef struct transport_smart_caps {
 	int common:1,
 		ofs_delta:1,
@@ -121,7 +131,8 @@ typedef struct transport_smart_caps {
 		include_tag:1,
 		delete_refs:1,
 		report_status:1,
-		thin_pack:1;
+		thin_pack:1,
+		shallow:1;
 } transport_smart_caps;
 
 typedef int (*packetsize_cb)(size_t received, void *payload);
@@ -146,6 +157,8 @@ typedef struct {
 	git_atomic cancelled;
 	packetsize_cb packetsize_cb;
 	void *packetsize_payload;
+	git_array_oid_t shallow;
+	git_array_oid_t unshallow;
 	unsigned rpc : 1,
 		have_refs : 1,
 		connected : 1;
@@ -183,5 +196,6 @@ int git_pkt_buffer_flush(git_buf *buf);
 int git_pkt_send_flush(GIT_SOCKET s);
 int git_pkt_buffer_done(git_buf *buf);
 int git_pkt_buffer_wants(const git_remote_head * const *refs, size_t count, transport_smart_caps *caps, git_buf *buf);
+int git_pkt_buffer_shallow(const git_oid *roots, size_t count, unsigned int depth, git_buf *buf);
 int git_pkt_buffer_have(git_oid *oid, git_buf *buf);
 void git_pkt_free(git_pkt *pkt);
@@ -315,6 +315,34 @@ static int unpack_pkt(git_pkt **out, const char *line, size_t len)
 	return 0;
 }
 
+static int shallow_pkt(
+	git_pkt **out, enum git_pkt_type type, const char *line, size_t len)
+{
+	git_pkt_shallow *pkt;
+	size_t prefix_len;
+
+	prefix_len = (type == GIT_PKT_SHALLOW) ?
+		strlen("shallow ") : strlen("unshallow ");
+
+	if (len < prefix_len + GIT_OID_HEXSZ) {
+		giterr_set(GITERR_NET, "Invalid shallow line");
+		return -1;
+	}
+
+	pkt = git__malloc(sizeof(*pkt));
+	GITERR_CHECK_ALLOC(pkt);
+
+	pkt->type = type;
+	if (git_oid_fromstrn(&pkt->oid, line + prefix_len, GIT_OID_HEXSZ) < 0) {
+		giterr_set(GITERR_NET, "Invalid shallow line");
+		git__free(pkt);
+		return -1;
+	}
+
+	*out = (git_pkt *)pkt;
+	return 0;
+}
+
 static int32_t parse_len(const char *line)
 {
 	char num[PKT_LEN_SIZE + 1];
@@ -420,6 +448,10 @@ int git_pkt_parse_line(
 		ret = ng_pkt(head, line, len);
 	else if (!git__prefixcmp(line, "unpack"))
 		ret = unpack_pkt(head, line, len);
+	else if (!git__prefixcmp(line, "shallow "))
+		ret = shallow_pkt(head, GIT_PKT_SHALLOW, line, len);
+	else if (!git__prefixcmp(line, "unshallow "))
+		ret = shallow_pkt(head, GIT_PKT_UNSHALLOW, line, len);
 	else
 		ret = ref_pkt(head, line, len);
 
@@ -482,6 +514,9 @@ static int buffer_want_with_caps(const git_remote_head *head, transport_smart_ca
 	if (caps->ofs_delta)
 		git_buf_puts(&str, GIT_CAP_OFS_DELTA " ");
 
+	if (caps->shallow)
+		git_buf_puts(&str, GIT_CAP_SHALLOW " ");
+
 	if (git_buf_oom(&str))
 		return -1;
 
@@ -538,7 +573,39 @@ int git_pkt_buffer_wants(
 			return -1;
 	}
 
-	return git_pkt_buffer_flush(buf);
+	return 0;
+}
+
+/*
+ * Tell the server about our shallow roots and how deep the history it
+ * sends should be; these follow the wants in the same request.
+ */
+int git_pkt_buffer_shallow(
+	const git_oid *roots,
+	size_t count,
+	unsigned int depth,
+	git_buf *buf)
+{
+	char oid[GIT_OID_HEXSZ + 1];
+	size_t i;
+
+	oid[GIT_OID_HEXSZ] = '\0';
+
+	for (i = 0; i < count; ++i) {
+		git_oid_fmt(oid, &roots[i]);
+		git_buf_printf(buf, "%04xshallow %s\n",
+			(unsigned int)(strlen("XXXXshallow \n") + GIT_OID_HEXSZ), oid);
+	}
+
+	if (depth > 0) {
+		char line[32];
+
+		p_snprintf(line, sizeof(line), "deepen %u\n", depth);
+		git_buf_printf(buf, "%04x%s",
+			(unsigned int)(PKT_LEN_SIZE + strlen(line)), line);
+	}
+
+	return git_buf_oom(buf) ? -1 : 0;
 }
 
 int git_pkt_buffer_have(git_oid *oid, git_buf *buf)
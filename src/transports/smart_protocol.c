@@ -12,6 +12,7 @@
 #include "repository.h"
 #include "push.h"
 #include "pack-objects.h"
+#include "grafts.h"
 #include "remote.h"
 #include "util.h"
 
@@ -185,6 +186,12 @@ int git_smart__detect_caps(git_pkt_ref *pkt, transport_smart_caps *caps, git_vec
 			continue;
 		}
 
+		if (!git__prefixcmp(ptr, GIT_CAP_SHALLOW)) {
+			caps->common = caps->shallow = 1;
+			ptr += strlen(GIT_CAP_SHALLOW);
+			continue;
+		}
+
 		if (!git__prefixcmp(ptr, GIT_CAP_SYMREF)) {
 			int error;
 
@@ -325,19 +332,128 @@ static int wait_while_ack(gitno_buffer *buf)
 	return 0;
 }
 
+/* Read the shallow boundary which the server computed for our depth */
+static int recv_shallow(transport_smart *t)
+{
+	git_pkt_shallow *pkt = NULL;
+	git_oid *id;
+	int error;
+
+	git_array_clear(t->shallow);
+	git_array_clear(t->unshallow);
+
+	while ((error = recv_pkt((git_pkt **)&pkt, &t->buffer)) >= 0) {
+		if (pkt->type == GIT_PKT_FLUSH)
+			break;
+
+		if (pkt->type == GIT_PKT_SHALLOW)
+			id = git_array_alloc(t->shallow);
+		else if (pkt->type == GIT_PKT_UNSHALLOW)
+			id = git_array_alloc(t->unshallow);
+		else if (pkt->type == GIT_PKT_ERR) {
+			giterr_set(GITERR_NET, "Remote error: %s", ((git_pkt_err *)pkt)->error);
+			error = -1;
+			break;
+		} else {
+			giterr_set(GITERR_NET, "Unexpected pkt type");
+			error = -1;
+			break;
+		}
+
+		if (id == NULL) {
+			error = -1;
+			break;
+		}
+
+		git_oid_cpy(id, &pkt->oid);
+		git__free(pkt);
+		pkt = NULL;
+	}
+
+	git__free(pkt);
+	return error < 0 ? error : 0;
+}
+
+/* The wants, followed by our shallow boundary and the depth we want */
+static int buffer_request(
+	transport_smart *t,
+	const git_remote_head * const *wants,
+	size_t count,
+	git_grafts *grafts,
+	unsigned int depth,
+	git_buf *buf)
+{
+	int error;
+
+	if ((error = git_pkt_buffer_wants(wants, count, &t->caps, buf)) < 0)
+		return error;
+
+	if (t->caps.shallow && (error = git_pkt_buffer_shallow(grafts->shallow.ptr,
+			git_array_size(grafts->shallow), depth, buf)) < 0)
+		return error;
+
+	return git_pkt_buffer_flush(buf);
+}
+
 int git_smart__negotiate_fetch(git_transport *transport, git_repository *repo, const git_remote_head * const *wants, size_t count)
 {
 	transport_smart *t = (transport_smart *)transport;
 	gitno_buffer *buf = &t->buffer;
 	git_buf data = GIT_BUF_INIT;
 	git_revwalk *walk = NULL;
+	git_grafts *grafts = NULL;
+	unsigned int depth;
 	int error = -1, pkt_type;
 	unsigned int i;
 	git_oid oid;
 
-	if ((error = git_pkt_buffer_wants(wants, count, &t->caps, &data)) < 0)
+	git_array_clear(t->shallow);
+	git_array_clear(t->unshallow);
+
+	depth = t->owner ? git_remote_fetch_depth(t->owner) : 0;
+
+	if ((error = git_repository__grafts(&grafts, repo)) < 0)
 		return error;
 
+	if (!t->caps.shallow && (depth > 0 || git_array_size(grafts->shallow))) {
+		giterr_set(GITERR_NET, depth > 0 ?
+			"The remote does not support shallow fetches" :
+			"The remote does not support fetching into a shallow repository");
+		error = -1;
+		goto on_error;
+	}
+
+	/* only ask for the capability when we need it */
+	t->caps.shallow = (depth > 0 || git_array_size(grafts->shallow) > 0);
+
+	if ((error = buffer_request(t, wants, count, grafts, depth, &data)) < 0)
+		goto on_error;
+
+	/*
+	 * When deepening, the server sends the new shallow boundary before
+	 * it looks at any have; the stateless protocol repeats it in the
+	 * answer to every request.
+	 */
+	if (depth > 0) {
+		if (t->rpc)
+			git_pkt_buffer_flush(&data);
+
+		if (git_buf_oom(&data)) {
+			error = -1;
+			goto on_error;
+		}
+
+		if ((error = git_smart__negotiation_step(&t->parent, data.ptr, data.size)) < 0 ||
+			(error = recv_shallow(t)) < 0)
+			goto on_error;
+
+		git_buf_clear(&data);
+
+		if (t->rpc &&
+			(error = buffer_request(t, wants, count, grafts, depth, &data)) < 0)
+			goto on_error;
+	}
+
 	if ((error = fetch_setup_walk(&walk, repo)) < 0)
 		goto on_error;
 
@@ -376,6 +492,9 @@ int git_smart__negotiate_fetch(git_transport *transport, git_repository *repo, c
 			if ((error = git_smart__negotiation_step(&t->parent, data.ptr, data.size)) < 0)
 				goto on_error;
 
+			if (t->rpc && depth > 0 && (error = recv_shallow(t)) < 0)
+				goto on_error;
+
 			git_buf_clear(&data);
 			if (t->caps.multi_ack || t->caps.multi_ack_detailed) {
 				if ((error = store_common(t)) < 0)
@@ -406,7 +525,7 @@ int git_smart__negotiate_fetch(git_transport *transport, git_repository *repo, c
 			git_pkt_ack *pkt;
 			unsigned int i;
 
-			if ((error = git_pkt_buffer_wants(wants, count, &t->caps, &data)) < 0)
+			if ((error = buffer_request(t, wants, count, grafts, depth, &data)) < 0)
 				goto on_error;
 
 			git_vector_foreach(&t->common, i, pkt) {
@@ -426,7 +545,7 @@ int git_smart__negotiate_fetch(git_transport *transport, git_repository *repo, c
 		git_pkt_ack *pkt;
 		unsigned int i;
 
-		if ((error = git_pkt_buffer_wants(wants, count, &t->caps, &data)) < 0)
+		if ((error = buffer_request(t, wants, count, grafts, depth, &data)) < 0)
 			goto on_error;
 
 		git_vector_foreach(&t->common, i, pkt) {
@@ -451,8 +570,12 @@ int git_smart__negotiate_fetch(git_transport *transport, git_repository *repo, c
 	if ((error = git_smart__negotiation_step(&t->parent, data.ptr, data.size)) < 0)
 		goto on_error;
 
+	if (t->rpc && depth > 0 && (error = recv_shallow(t)) < 0)
+		goto on_error;
+
 	git_buf_free(&data);
 	git_revwalk_free(walk);
+	git_grafts_free(grafts);
 
 	/* Now let's eat up whatever the server gives us */
 	if (!t->caps.multi_ack && !t->caps.multi_ack_detailed) {
@@ -472,6 +595,7 @@ int git_smart__negotiate_fetch(git_transport *transport, git_repository *repo, c
 
 on_error:
 	git_revwalk_free(walk);
+	git_grafts_free(grafts);
 	git_buf_free(&data);
 	return error;
 }
@@ -631,6 +755,16 @@ done:
 		t->packetsize_payload = NULL;
 	}
 
+	/* the new boundary is only recorded once we have the objects */
+	if (!error &&
+		(git_array_size(t->shallow) > 0 || git_array_size(t->unshallow) > 0))
+		error = git_grafts_update_shallow(repo,
+			t->shallow.ptr, git_array_size(t->shallow),
+			t->unshallow.ptr, git_array_size(t->unshallow));
+
+	git_array_clear(t->shallow);
+	git_array_clear(t->unshallow);
+
 	return error;
 }
 
@@ -33,4 +33,15 @@ char *p_realpath(const char *, char *);
 /* see win32/posix.h for explanation about why this exists */
 #define p_lstat_posixly(p,b) lstat(p,b)
 
+/* nanoseconds of the stat times, where the platform has them */
+#if defined(GIT_USE_STAT_MTIM)
+# define st_mtime_nsec st_mtim.tv_nsec
+# define st_ctime_nsec st_ctim.tv_nsec
+# define GIT_USE_NSEC
+#elif defined(GIT_USE_STAT_MTIMESPEC)
+# define st_mtime_nsec st_mtimespec.tv_nsec
+# define st_ctime_nsec st_ctimespec.tv_nsec
+# define GIT_USE_NSEC
+#endif
+
 #endif
@@ -0,0 +1,755 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+
+#include "untracked_cache.h"
+#include "bitvec.h"
+#include "ewah.h"
+#include "posix.h"
+
+#ifndef GIT_WIN32
+#include <sys/utsname.h>
+#endif
+
+/*
+ * Core git's DIR_SHOW_OTHER_DIRECTORIES, which makes an invalidation
+ * propagate to all parent directories.
+ */
+#define UNTRACKED_DIR_SHOW_OTHER_DIRECTORIES (1u << 1)
+
+/*
+ * The directory flags written by libgit2.  Our listings contain ignored
+ * entries and every untracked directory, which is not what core git
+ * expects for any of its flag combinations; the private bit makes sure
+ * that git will never mistake our cache for one of its own.
+ */
+#define UNTRACKED_DIR_FLAGS_LIBGIT2 \
+	((1u << 31) | UNTRACKED_DIR_SHOW_OTHER_DIRECTORIES)
+
+#define UNTRACKED_EXCLUDE_PER_DIR ".gitignore"
+
+/* bound on directory nesting while parsing, to protect the stack */
+#define UNTRACKED_MAX_DEPTH 1024
+
+#define UNTRACKED_STAT_SIZE (9 * sizeof(uint32_t))
+
+static int untracked_error_invalid(const char *message)
+{
+	giterr_set(GITERR_INDEX, "Invalid untracked cache - %s", message);
+	return -1;
+}
+
+static int untracked_dir_cmp(const void *a, const void *b)
+{
+	const git_untracked_cache_dir *dir_a = a, *dir_b = b;
+	return strcmp(dir_a->name, dir_b->name);
+}
+
+static git_untracked_cache_dir *untracked_dir_alloc(
+	const char *name, size_t name_len)
+{
+	git_untracked_cache_dir *dir =
+		git__calloc(sizeof(git_untracked_cache_dir) + name_len + 1, 1);
+
+	if (!dir)
+		return NULL;
+
+	if (git_vector_init(&dir->untracked, 0, git__strcmp_cb) < 0 ||
+		git_vector_init(&dir->dirs, 0, untracked_dir_cmp) < 0) {
+		git_vector_free(&dir->untracked);
+		git__free(dir);
+		return NULL;
+	}
+
+	memcpy(dir->name, name, name_len);
+	return dir;
+}
+
+static void untracked_dir_clear(git_untracked_cache_dir *dir)
+{
+	size_t i;
+	char *name;
+
+	git_vector_foreach(&dir->untracked, i, name)
+		git__free(name);
+	git_vector_clear(&dir->untracked);
+}
+
+/* free a single node, leaving its children alone */
+static void untracked_dir_free_one(git_untracked_cache_dir *dir)
+{
+	if (!dir)
+		return;
+
+	untracked_dir_clear(dir);
+	git_vector_free(&dir->untracked);
+	git_vector_free(&dir->dirs);
+	git__free(dir);
+}
+
+static void untracked_dir_free(git_untracked_cache_dir *dir)
+{
+	size_t i;
+	git_untracked_cache_dir *child;
+
+	if (!dir)
+		return;
+
+	git_vector_foreach(&dir->dirs, i, child)
+		untracked_dir_free(child);
+
+	untracked_dir_free_one(dir);
+}
+
+static int untracked_ident(git_buf *out, const char *workdir)
+{
+	size_t len = strlen(workdir);
+#ifdef GIT_WIN32
+	const char *sysname = "Windows";
+#else
+	struct utsname uts;
+	const char *sysname = (uname(&uts) < 0) ? "unknown" : uts.sysname;
+#endif
+
+	/* core git describes the work tree without a trailing slash */
+	if (len > 1 && workdir[len - 1] == '/')
+		len--;
+
+	git_buf_clear(out);
+	git_buf_puts(out, "Location ");
+	git_buf_put(out, workdir, len);
+	git_buf_printf(out, ", system %s", sysname);
+	git_buf_putc(out, '\0');
+
+	return git_buf_oom(out) ? -1 : 0;
+}
+
+int git_untracked_cache_new(git_untracked_cache **out, const char *workdir)
+{
+	git_untracked_cache *uc;
+
+	assert(out && workdir);
+
+	uc = git__calloc(1, sizeof(git_untracked_cache));
+	GITERR_CHECK_ALLOC(uc);
+
+	uc->dir_flags = UNTRACKED_DIR_FLAGS_LIBGIT2;
+
+	if (untracked_ident(&uc->ident, workdir) < 0 ||
+		(uc->workdir = git__strdup(workdir)) == NULL ||
+		(uc->exclude_per_dir = git__strdup(UNTRACKED_EXCLUDE_PER_DIR)) == NULL ||
+		(uc->root = untracked_dir_alloc("", 0)) == NULL) {
+		git_untracked_cache_free(uc);
+		return -1;
+	}
+
+	*out = uc;
+	return 0;
+}
+
+bool git_untracked_cache_is_usable(
+	git_untracked_cache *uc, const char *workdir)
+{
+	git_buf ident = GIT_BUF_INIT;
+	bool usable;
+
+	if (!uc || !workdir || uc->dir_flags != UNTRACKED_DIR_FLAGS_LIBGIT2)
+		return false;
+
+	if (uc->workdir && !strcmp(uc->workdir, workdir))
+		return true;
+
+	if (untracked_ident(&ident, workdir) < 0)
+		return false;
+
+	usable = (ident.size == uc->ident.size &&
+		memcmp(ident.ptr, uc->ident.ptr, ident.size) == 0);
+
+	git_buf_free(&ident);
+
+	/* remember the result so we don't rebuild the ident every time */
+	if (usable) {
+		git__free(uc->workdir);
+		uc->workdir = git__strdup(workdir);
+	}
+
+	return usable;
+}
+
+void git_untracked_cache_free(git_untracked_cache *uc)
+{
+	if (!uc)
+		return;
+
+	untracked_dir_free(uc->root);
+	git_buf_free(&uc->ident);
+	git__free(uc->exclude_per_dir);
+	git__free(uc->workdir);
+	git__free(uc);
+}
+
+/*
+ * Variable width integers, as used by core git: seven bits per byte,
+ * most significant group first, with an offset of one added to each
+ * continuation group so that every value has exactly one encoding.
+ */
+static int read_varint(size_t *out, const char **buffer, const char *end)
+{
+	const unsigned char *ptr = (const unsigned char *)*buffer;
+	const unsigned char *ptr_end = (const unsigned char *)end;
+	uint64_t val;
+	unsigned char c;
+
+	if (ptr >= ptr_end)
+		return -1;
+
+	c = *ptr++;
+	val = c & 127;
+
+	while (c & 128) {
+		val += 1;
+		if (!val || (val >> 57) != 0 || ptr >= ptr_end)
+			return -1;
+
+		c = *ptr++;
+		val = (val << 7) + (c & 127);
+	}
+
+	if (val > (uint64_t)SIZE_MAX)
+		return -1;
+
+	*out = (size_t)val;
+	*buffer = (const char *)ptr;
+	return 0;
+}
+
+static int write_varint(git_buf *out, size_t value)
+{
+	unsigned char varint[16];
+	size_t pos = sizeof(varint) - 1;
+
+	varint[pos] = value & 127;
+
+	while (value >>= 7)
+		varint[--pos] = 128 | (--value & 127);
+
+	return git_buf_put(out, (char *)&varint[pos], sizeof(varint) - pos);
+}
+
+static uint32_t read_u32(const char *buffer)
+{
+	uint32_t val;
+	memcpy(&val, buffer, sizeof(val));
+	return ntohl(val);
+}
+
+static int write_u32(git_buf *out, uint32_t val)
+{
+	val = htonl(val);
+	return git_buf_put(out, (char *)&val, sizeof(val));
+}
+
+static void read_stat(git_untracked_cache_stat *st, const char *buffer)
+{
+	st->ctime_seconds     = read_u32(buffer);
+	st->ctime_nanoseconds = read_u32(buffer + 4);
+	st->mtime_seconds     = read_u32(buffer + 8);
+	st->mtime_nanoseconds = read_u32(buffer + 12);
+	st->dev               = read_u32(buffer + 16);
+	st->ino               = read_u32(buffer + 20);
+	st->uid               = read_u32(buffer + 24);
+	st->gid               = read_u32(buffer + 28);
+	st->size              = read_u32(buffer + 32);
+}
+
+static int write_stat(git_buf *out, const git_untracked_cache_stat *st)
+{
+	write_u32(out, st->ctime_seconds);
+	write_u32(out, st->ctime_nanoseconds);
+	write_u32(out, st->mtime_seconds);
+	write_u32(out, st->mtime_nanoseconds);
+	write_u32(out, st->dev);
+	write_u32(out, st->ino);
+	write_u32(out, st->uid);
+	write_u32(out, st->gid);
+	write_u32(out, st->size);
+
+	return git_buf_oom(out) ? -1 : 0;
+}
+
+static void stat_from_stat(git_untracked_cache_stat *out, const struct stat *st)
+{
+	memset(out, 0, sizeof(*out));
+
+	out->ctime_seconds = (uint32_t)st->st_ctime;
+	out->mtime_seconds = (uint32_t)st->st_mtime;
+	out->dev  = (uint32_t)st->st_dev;
+	out->ino  = (uint32_t)st->st_ino;
+	out->uid  = (uint32_t)st->st_uid;
+	out->gid  = (uint32_t)st->st_gid;
+	out->size = (uint32_t)st->st_size;
+}
+
+typedef struct {
+	const char *data;
+	const char *end;
+	git_untracked_cache_dir **dirs;
+	size_t dirs_len;
+	size_t index;
+} untracked_reader;
+
+static int read_dir(untracked_reader *rd, git_untracked_cache_dir **out, int depth)
+{
+	git_untracked_cache_dir *dir;
+	size_t untracked_count, dirs_count, i;
+	const char *eos;
+
+	if (depth > UNTRACKED_MAX_DEPTH || rd->index >= rd->dirs_len)
+		return untracked_error_invalid("too many directories");
+
+	if (read_varint(&untracked_count, &rd->data, rd->end) < 0 ||
+		read_varint(&dirs_count, &rd->data, rd->end) < 0 ||
+		(eos = memchr(rd->data, '\0', rd->end - rd->data)) == NULL)
+		return untracked_error_invalid("truncated directory");
+
+	if (untracked_count > (size_t)(rd->end - rd->data) ||
+		dirs_count > rd->dirs_len - rd->index)
+		return untracked_error_invalid("bad directory counts");
+
+	dir = untracked_dir_alloc(rd->data, eos - rd->data);
+	GITERR_CHECK_ALLOC(dir);
+	rd->dirs[rd->index++] = dir;
+	rd->data = eos + 1;
+
+	for (i = 0; i < untracked_count; ++i) {
+		char *name;
+
+		if ((eos = memchr(rd->data, '\0', rd->end - rd->data)) == NULL)
+			return untracked_error_invalid("truncated entry name");
+
+		name = git__strndup(rd->data, eos - rd->data);
+		GITERR_CHECK_ALLOC(name);
+
+		if (git_vector_insert(&dir->untracked, name) < 0) {
+			git__free(name);
+			return -1;
+		}
+
+		rd->data = eos + 1;
+	}
+
+	for (i = 0; i < dirs_count; ++i) {
+		git_untracked_cache_dir *child;
+
+		if (read_dir(rd, &child, depth + 1) < 0 ||
+			git_vector_insert(&dir->dirs, child) < 0)
+			return -1;
+	}
+
+	git_vector_sort(&dir->dirs);
+
+	*out = dir;
+	return 0;
+}
+
+int git_untracked_cache_read(
+	git_untracked_cache **out, const char *buffer, size_t buffer_size)
+{
+	git_untracked_cache *uc;
+	untracked_reader rd = { 0 };
+	git_bitvec valid, check_only, exclude_valid;
+	const char *end, *eos;
+	size_t len, i;
+	int error = -1;
+
+	*out = NULL;
+
+	/* the extension always ends with a NUL byte */
+	if (buffer_size <= 1 || buffer[buffer_size - 1] != '\0')
+		return untracked_error_invalid("missing terminator");
+	end = buffer + buffer_size - 1;
+
+	uc = git__calloc(1, sizeof(git_untracked_cache));
+	GITERR_CHECK_ALLOC(uc);
+
+	memset(&valid, 0, sizeof(valid));
+	memset(&check_only, 0, sizeof(check_only));
+	memset(&exclude_valid, 0, sizeof(exclude_valid));
+
+	if (read_varint(&len, &buffer, end) < 0 ||
+		len > (size_t)(end - buffer)) {
+		untracked_error_invalid("truncated ident");
+		goto done;
+	}
+
+	if (git_buf_put(&uc->ident, buffer, len) < 0)
+		goto done;
+	buffer += len;
+
+	if ((size_t)(end - buffer) < 2 * UNTRACKED_STAT_SIZE + 4 + 2 * GIT_OID_RAWSZ) {
+		untracked_error_invalid("truncated header");
+		goto done;
+	}
+
+	read_stat(&uc->info_exclude_stat, buffer);
+	read_stat(&uc->excludes_file_stat, buffer + UNTRACKED_STAT_SIZE);
+	buffer += 2 * UNTRACKED_STAT_SIZE;
+
+	uc->dir_flags = read_u32(buffer);
+	buffer += 4;
+
+	git_oid_fromraw(&uc->info_exclude_id, (const unsigned char *)buffer);
+	git_oid_fromraw(&uc->excludes_file_id,
+		(const unsigned char *)buffer + GIT_OID_RAWSZ);
+	buffer += 2 * GIT_OID_RAWSZ;
+
+	if ((eos = memchr(buffer, '\0', end - buffer)) == NULL) {
+		untracked_error_invalid("truncated exclude file name");
+		goto done;
+	}
+
+	uc->exclude_per_dir = git__strndup(buffer, eos - buffer);
+	GITERR_CHECK_ALLOC(uc->exclude_per_dir);
+	buffer = eos + 1;
+
+	if (read_varint(&rd.dirs_len, &buffer, end) < 0) {
+		untracked_error_invalid("truncated directory count");
+		goto done;
+	}
+
+	/* a cache without any directories */
+	if (!rd.dirs_len) {
+		error = 0;
+		goto done;
+	}
+
+	if (rd.dirs_len > (size_t)(end - buffer)) {
+		untracked_error_invalid("bad directory count");
+		goto done;
+	}
+
+	rd.dirs = git__calloc(rd.dirs_len, sizeof(git_untracked_cache_dir *));
+	GITERR_CHECK_ALLOC(rd.dirs);
+	rd.data = buffer;
+	rd.end = end;
+
+	if (read_dir(&rd, &uc->root, 0) < 0)
+		goto done;
+
+	if (rd.index != rd.dirs_len) {
+		untracked_error_invalid("directory count mismatch");
+		goto done;
+	}
+
+	buffer = rd.data;
+
+	if (git_bitvec_init(&valid, rd.dirs_len) < 0 ||
+		git_bitvec_init(&check_only, rd.dirs_len) < 0 ||
+		git_bitvec_init(&exclude_valid, rd.dirs_len) < 0)
+		goto done;
+
+	if (git_ewah_read(&valid, rd.dirs_len, &buffer, end) < 0 ||
+		git_ewah_read(&check_only, rd.dirs_len, &buffer, end) < 0 ||
+		git_ewah_read(&exclude_valid, rd.dirs_len, &buffer, end) < 0) {
+		untracked_error_invalid("bad directory bitmap");
+		goto done;
+	}
+
+	for (i = 0; i < rd.dirs_len; ++i) {
+		rd.dirs[i]->check_only = git_bitvec_get(&check_only, i);
+
+		if (!git_bitvec_get(&valid, i))
+			continue;
+
+		if ((size_t)(end - buffer) < UNTRACKED_STAT_SIZE) {
+			untracked_error_invalid("truncated directory stat data");
+			goto done;
+		}
+
+		rd.dirs[i]->valid = 1;
+		read_stat(&rd.dirs[i]->stat, buffer);
+		buffer += UNTRACKED_STAT_SIZE;
+	}
+
+	for (i = 0; i < rd.dirs_len; ++i) {
+		if (!git_bitvec_get(&exclude_valid, i))
+			continue;
+
+		if ((size_t)(end - buffer) < GIT_OID_RAWSZ) {
+			untracked_error_invalid("truncated exclude file id");
+			goto done;
+		}
+
+		git_oid_fromraw(&rd.dirs[i]->exclude_id, (const unsigned char *)buffer);
+		buffer += GIT_OID_RAWSZ;
+	}
+
+	error = 0;
+
+done:
+	if (error < 0 && rd.dirs) {
+		/* the tree may be partially linked, so free node by node */
+		for (i = 0; i < rd.index; ++i)
+			untracked_dir_free_one(rd.dirs[i]);
+		uc->root = NULL;
+	}
+
+	git__free(rd.dirs);
+	git_bitvec_free(&valid);
+	git_bitvec_free(&check_only);
+	git_bitvec_free(&exclude_valid);
+
+	if (error < 0)
+		git_untracked_cache_free(uc);
+	else
+		*out = uc;
+
+	return error;
+}
+
+typedef struct {
+	git_buf *out;
+	git_vector dirs;
+} untracked_writer;
+
+static int write_dir(untracked_writer *wr, git_untracked_cache_dir *dir)
+{
+	size_t i;
+	const char *name;
+	git_untracked_cache_dir *child;
+
+	/* an invalid directory has no untracked entries worth keeping */
+	if (!dir->valid) {
+		untracked_dir_clear(dir);
+		dir->check_only = 0;
+	}
+
+	if (git_vector_insert(&wr->dirs, dir) < 0)
+		return -1;
+
+	write_varint(wr->out, dir->untracked.length);
+	write_varint(wr->out, dir->dirs.length);
+	git_buf_put(wr->out, dir->name, strlen(dir->name) + 1);
+
+	git_vector_foreach(&dir->untracked, i, name)
+		git_buf_put(wr->out, name, strlen(name) + 1);
+
+	if (git_buf_oom(wr->out))
+		return -1;
+
+	git_vector_foreach(&dir->dirs, i, child) {
+		if (write_dir(wr, child) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+int git_untracked_cache_write(git_buf *out, git_untracked_cache *uc)
+{
+	untracked_writer wr;
+	git_buf blocks = GIT_BUF_INIT;
+	git_bitvec valid, check_only, exclude_valid;
+	git_untracked_cache_dir *dir;
+	size_t i;
+	int error = -1;
+
+	assert(out && uc);
+
+	write_varint(out, uc->ident.size);
+	git_buf_put(out, uc->ident.ptr, uc->ident.size);
+	write_stat(out, &uc->info_exclude_stat);
+	write_stat(out, &uc->excludes_file_stat);
+	write_u32(out, uc->dir_flags);
+	git_buf_put(out, (char *)uc->info_exclude_id.id, GIT_OID_RAWSZ);
+	git_buf_put(out, (char *)uc->excludes_file_id.id, GIT_OID_RAWSZ);
+	git_buf_put(out, uc->exclude_per_dir, strlen(uc->exclude_per_dir) + 1);
+
+	if (!uc->root)
+		return write_varint(out, 0);
+
+	memset(&valid, 0, sizeof(valid));
+	memset(&check_only, 0, sizeof(check_only));
+	memset(&exclude_valid, 0, sizeof(exclude_valid));
+
+	/* the directory blocks go to a side buffer since they must be
+	 * preceded by the total number of directories */
+	wr.out = &blocks;
+	if (git_vector_init(&wr.dirs, 16, NULL) < 0 ||
+		write_dir(&wr, uc->root) < 0)
+		goto done;
+
+	write_varint(out, wr.dirs.length);
+	git_buf_put(out, blocks.ptr, blocks.size);
+
+	if (git_bitvec_init(&valid, wr.dirs.length) < 0 ||
+		git_bitvec_init(&check_only, wr.dirs.length) < 0 ||
+		git_bitvec_init(&exclude_valid, wr.dirs.length) < 0)
+		goto done;
+
+	git_vector_foreach(&wr.dirs, i, dir) {
+		git_bitvec_set(&valid, i, dir->valid);
+		git_bitvec_set(&check_only, i, dir->check_only);
+		git_bitvec_set(&exclude_valid, i, !git_oid_iszero(&dir->exclude_id));
+	}
+
+	if (git_ewah_write(out, &valid, wr.dirs.length) < 0 ||
+		git_ewah_write(out, &check_only, wr.dirs.length) < 0 ||
+		git_ewah_write(out, &exclude_valid, wr.dirs.length) < 0)
+		goto done;
+
+	git_vector_foreach(&wr.dirs, i, dir) {
+		if (dir->valid && write_stat(out, &dir->stat) < 0)
+			goto done;
+	}
+
+	git_vector_foreach(&wr.dirs, i, dir) {
+		if (!git_oid_iszero(&dir->exclude_id))
+			git_buf_put(out, (char *)dir->exclude_id.id, GIT_OID_RAWSZ);
+	}
+
+	/* safety terminator for the string lists */
+	git_buf_putc(out, '\0');
+
+	error = git_buf_oom(out) ? -1 : 0;
+
+done:
+	git_buf_free(&blocks);
+	git_vector_free(&wr.dirs);
+	git_bitvec_free(&valid);
+	git_bitvec_free(&check_only);
+	git_bitvec_free(&exclude_valid);
+	return error;
+}
+
+static git_untracked_cache_dir *find_child(
+	git_untracked_cache_dir *dir, const char *name, size_t name_len,
+	size_t *at_pos)
+{
+	size_t lo = 0, hi = dir->dirs.length;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		git_untracked_cache_dir *child = git_vector_get(&dir->dirs, mid);
+		int cmp = strncmp(name, child->name, name_len);
+
+		if (!cmp)
+			cmp = child->name[name_len] ? -1 : 0;
+
+		if (!cmp) {
+			*at_pos = mid;
+			return child;
+		}
+
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	*at_pos = lo;
+	return NULL;
+}
+
+git_untracked_cache_dir *git_untracked_cache_lookup(
+	git_untracked_cache *uc, const char *path, bool create)
+{
+	git_untracked_cache_dir *dir, *child;
+	const char *slash;
+	size_t pos;
+
+	if (!uc)
+		return NULL;
+
+	if (!uc->root && (!create || (uc->root = untracked_dir_alloc("", 0)) == NULL))
+		return NULL;
+
+	dir = uc->root;
+
+	while (dir && *path) {
+		if ((slash = strchr(path, '/')) == NULL)
+			slash = path + strlen(path);
+
+		if ((child = find_child(dir, path, slash - path, &pos)) == NULL && create) {
+			if ((child = untracked_dir_alloc(path, slash - path)) == NULL)
+				return NULL;
+
+			if (git_vector_insert_sorted(&dir->dirs, child, NULL) < 0) {
+				untracked_dir_free_one(child);
+				return NULL;
+			}
+		}
+
+		dir = child;
+		path = *slash ? slash + 1 : slash;
+	}
+
+	return dir;
+}
+
+static void invalidate_dir(git_untracked_cache_dir *dir)
+{
+	dir->valid = 0;
+	dir->check_only = 0;
+	untracked_dir_clear(dir);
+}
+
+void git_untracked_cache_invalidate_path(
+	git_untracked_cache *uc, const char *path)
+{
+	git_untracked_cache_dir *dir;
+	const char *slash;
+	size_t pos;
+	bool parents = false;
+
+	if (!uc || !(dir = uc->root))
+		return;
+
+	parents = (uc->dir_flags & UNTRACKED_DIR_SHOW_OTHER_DIRECTORIES) != 0;
+
+	while ((slash = strchr(path, '/')) != NULL) {
+		if (parents)
+			invalidate_dir(dir);
+
+		if ((dir = find_child(dir, path, slash - path, &pos)) == NULL)
+			return;
+
+		path = slash + 1;
+	}
+
+	invalidate_dir(dir);
+}
+
+int git_untracked_cache_dir_set(
+	git_untracked_cache_dir *dir, const struct stat *st, git_vector *names)
+{
+	untracked_dir_clear(dir);
+	git_vector_swap(&dir->untracked, names);
+	git_vector_set_cmp(&dir->untracked, git__strcmp_cb);
+	git_vector_sort(&dir->untracked);
+
+	stat_from_stat(&dir->stat, st);
+	dir->valid = 1;
+	dir->check_only = 0;
+
+	return 0;
+}
+
+bool git_untracked_cache_dir_is_fresh(
+	const git_untracked_cache_dir *dir, const struct stat *st)
+{
+	git_untracked_cache_stat cur;
+
+	if (!dir || !dir->valid)
+		return false;
+
+	stat_from_stat(&cur, st);
+
+	return (cur.mtime_seconds == dir->stat.mtime_seconds &&
+		cur.ctime_seconds == dir->stat.ctime_seconds &&
+		cur.ino == dir->stat.ino &&
+		cur.size == dir->stat.size);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) the libgit2 contributors. All rights reserved.
+ *
+ * This file is part of libgit2, distributed under the GNU GPL v2 with
+ * a Linking Exception. For full terms see the included COPYING file.
+ */
+#ifndef INCLUDE_untracked_cache_h__
+#define INCLUDE_untracked_cache_h__
+
+#include "common.h"
+#include "buffer.h"
+#include "vector.h"
+#include "git2/oid.h"
+
+/*
+ * The untracked cache ("UNTR" index extension) remembers, for each
+ * directory of the working directory, the stat data of the directory
+ * and the names of the entries in it that are not tracked by the index.
+ * As long as the stat data of a directory has not changed, its contents
+ * can be reconstructed from the index and the cached names without
+ * reading the directory again.
+ *
+ * The on-disk format is the one used by core git.  Caches written by
+ * other implementations (or for another working directory) are read and
+ * written back, but only invalidated - never used - by libgit2; see
+ * `git_untracked_cache_is_usable`.
+ */
+
+typedef struct {
+	uint32_t ctime_seconds;
+	uint32_t ctime_nanoseconds;
+	uint32_t mtime_seconds;
+	uint32_t mtime_nanoseconds;
+	uint32_t dev;
+	uint32_t ino;
+	uint32_t uid;
+	uint32_t gid;
+	uint32_t size;
+} git_untracked_cache_stat;
+
+typedef struct git_untracked_cache_dir git_untracked_cache_dir;
+
+struct git_untracked_cache_dir {
+	git_vector untracked; /* untracked entry names, "name/" for dirs */
+	git_vector dirs;      /* child git_untracked_cache_dir, by name */
+	git_untracked_cache_stat stat;
+	git_oid exclude_id;   /* zero if there is no per-directory exclude */
+	unsigned int valid:1;
+	unsigned int check_only:1;
+	char name[GIT_FLEX_ARRAY];
+};
+
+typedef struct {
+	git_buf ident;
+	git_untracked_cache_stat info_exclude_stat;
+	git_untracked_cache_stat excludes_file_stat;
+	git_oid info_exclude_id;
+	git_oid excludes_file_id;
+	uint32_t dir_flags;
+	char *exclude_per_dir;
+	git_untracked_cache_dir *root;
+
+	char *workdir; /* working directory that the ident was checked for */
+} git_untracked_cache;
+
+/* Create an empty untracked cache for the given working directory */
+extern int git_untracked_cache_new(
+	git_untracked_cache **out, const char *workdir);
+
+/* Parse the body of an "UNTR" index extension */
+extern int git_untracked_cache_read(
+	git_untracked_cache **out, const char *buffer, size_t buffer_size);
+
+/* Serialize the cache as the body of an "UNTR" index extension */
+extern int git_untracked_cache_write(
+	git_buf *out, git_untracked_cache *uc);
+
+/*
+ * Is this a cache that libgit2 wrote for `workdir`?  Only such caches
+ * record every non-tracked entry (including ignored ones) and may be
+ * used in place of reading a directory.
+ */
+extern bool git_untracked_cache_is_usable(
+	git_untracked_cache *uc, const char *workdir);
+
+/*
+ * Find the node for `path` (a directory relative to the working
+ * directory, with or without a trailing slash; "" for the root),
+ * optionally creating any missing nodes on the way.
+ */
+extern git_untracked_cache_dir *git_untracked_cache_lookup(
+	git_untracked_cache *uc, const char *path, bool create);
+
+/*
+ * Forget what is known about the directory containing `path` (which was
+ * added to or removed from the index) and about all of its parents.
+ */
+extern void git_untracked_cache_invalidate_path(
+	git_untracked_cache *uc, const char *path);
+
+/* Replace the untracked entries of a directory */
+extern int git_untracked_cache_dir_set(
+	git_untracked_cache_dir *dir, const struct stat *st, git_vector *names);
+
+/* Does `st` still match the stat data recorded for a valid directory? */
+extern bool git_untracked_cache_dir_is_fresh(
+	const git_untracked_cache_dir *dir, const struct stat *st);
+
+extern void git_untracked_cache_free(git_untracked_cache *uc);
+
+#endif
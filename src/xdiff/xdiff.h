@@ -77,8 +77,23 @@ typedef struct s_mmbuffer {
 	size_t size;
 } mmbuffer_t;
 
+/*
+ * The lines of a file and their hashes, computed once by
+ * xdl_prepare_lines() and used by every diff of the same file made
+ * with the same whitespace flags.
+ */
+typedef struct s_mmlines {
+	char const *ptr;
+	long size;
+	unsigned long flags;
+	long nrec;
+	long *offs;
+	unsigned long *ha;
+} mmlines_t;
+
 typedef struct s_xpparam {
 	unsigned long flags;
+	mmlines_t const *lines1, *lines2;
 } xpparam_t;
 
 typedef struct s_xdemitcb {
@@ -112,6 +127,9 @@ long xdl_mmfile_size(mmfile_t *mmf);
 int xdl_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	     xdemitconf_t const *xecfg, xdemitcb_t *ecb);
 
+int xdl_prepare_lines(mmfile_t *mf, unsigned long flags, mmlines_t *lines);
+void xdl_free_lines(mmlines_t *lines);
+
 typedef struct s_xmparam {
 	xpparam_t xpp;
 	int marker_size;
@@ -259,6 +259,7 @@ static int fall_back_to_classic_diff(struct histindex *index,
 {
 	xpparam_t xpp;
 	xpp.flags = index->xpp->flags & ~XDF_HISTOGRAM_DIFF;
+	xpp.lines1 = xpp.lines2 = NULL;
 
 	return xdl_fall_back_diff(index->env, &xpp,
 				  line1, count1, line2, count2);
@@ -289,6 +289,7 @@ static int fall_back_to_classic_diff(struct hashmap *map,
 {
 	xpparam_t xpp;
 	xpp.flags = map->xpp->flags & ~XDF_PATIENCE_DIFF;
+	xpp.lines1 = xpp.lines2 = NULL;
 
 	return xdl_fall_back_diff(map->env, &xpp,
 				  line1, count1, line2, count2);
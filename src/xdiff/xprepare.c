@@ -58,6 +58,7 @@ static void xdl_free_classifier(xdlclassifier_t *cf);
 static int xdl_classify_record(unsigned int pass, xdlclassifier_t *cf, xrecord_t **rhash,
 			       unsigned int hbits, xrecord_t *rec);
 static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_t const *xpp,
+			   mmlines_t const *lines,
 			   xdlclassifier_t *cf, xdfile_t *xdf);
 static void xdl_free_ctx(xdfile_t *xdf);
 static int xdl_clean_mmatch(char const *dis, long i, long s, long e);
@@ -158,6 +159,7 @@ static int xdl_classify_record(unsigned int pass, xdlclassifier_t *cf, xrecord_t
 
 
 static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_t const *xpp,
+			   mmlines_t const *lines,
 			   xdlclassifier_t *cf, xdfile_t *xdf) {
 	unsigned int hbits;
 	long nrec, hsize, bsize;
@@ -176,7 +178,7 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 	rhash = NULL;
 	recs = NULL;
 
-	if (xdl_cha_init(&xdf->rcha, sizeof(xrecord_t), narec / 4 + 1) < 0)
+	if (xdl_cha_init(&xdf->rcha, sizeof(xrecord_t), narec + 1) < 0)
 		goto abort;
 	if (!(recs = (xrecord_t **) xdl_malloc(narec * sizeof(xrecord_t *))))
 		goto abort;
@@ -195,7 +197,11 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 	if ((cur = blk = xdl_mmfile_first(mf, &bsize)) != NULL) {
 		for (top = blk + bsize; cur < top; ) {
 			prev = cur;
-			hav = xdl_hash_record(&cur, top, xpp->flags);
+			if (lines) {
+				cur = blk + lines->offs[nrec + 1];
+				hav = lines->ha[nrec];
+			} else
+				hav = xdl_hash_record(&cur, top, xpp->flags);
 			if (nrec >= narec) {
 				narec *= 2;
 				if (!(rrecs = (xrecord_t **) xdl_realloc(recs, narec * sizeof(xrecord_t *))))
@@ -259,10 +265,89 @@ static void xdl_free_ctx(xdfile_t *xdf) {
 }
 
 
+/*
+ * Split a file into records and hash them as xdl_prepare_ctx() would,
+ * for the file to be diffed more than once.
+ */
+int xdl_prepare_lines(mmfile_t *mf, unsigned long flags, mmlines_t *lines) {
+	long narec, nrec;
+	long *offs;
+	unsigned long *ha;
+	char const *blk, *cur, *top;
+
+	memset(lines, 0, sizeof(*lines));
+
+	narec = xdl_guess_lines(mf, XDL_GUESS_NLINES1) + 1;
+	if (!(lines->offs = (long *) xdl_malloc((narec + 1) * sizeof(long))) ||
+		!(lines->ha = (unsigned long *) xdl_malloc(narec * sizeof(unsigned long)))) {
+
+		xdl_free_lines(lines);
+		return -1;
+	}
+
+	nrec = 0;
+	lines->offs[0] = 0;
+	if ((cur = blk = xdl_mmfile_first(mf, &lines->size)) != NULL) {
+		for (top = blk + lines->size; cur < top; ) {
+			if (nrec >= narec) {
+				narec *= 2;
+				if (!(offs = (long *) xdl_realloc(lines->offs, (narec + 1) * sizeof(long)))) {
+
+					xdl_free_lines(lines);
+					return -1;
+				}
+				lines->offs = offs;
+				if (!(ha = (unsigned long *) xdl_realloc(lines->ha, narec * sizeof(unsigned long)))) {
+
+					xdl_free_lines(lines);
+					return -1;
+				}
+				lines->ha = ha;
+			}
+			lines->ha[nrec] = xdl_hash_record(&cur, top, flags);
+			lines->offs[++nrec] = (long) (cur - blk);
+		}
+	}
+
+	lines->ptr = blk;
+	lines->flags = flags & XDF_WHITESPACE_FLAGS;
+	lines->nrec = nrec;
+
+	return 0;
+}
+
+
+void xdl_free_lines(mmlines_t *lines) {
+
+	xdl_free(lines->offs);
+	xdl_free(lines->ha);
+	memset(lines, 0, sizeof(*lines));
+}
+
+
+/*
+ * Prepared lines are only used for the very file they were made from,
+ * and not, say, for the part of it a fall back diff is made of.
+ */
+static mmlines_t const *xdl_usable_lines(mmlines_t const *lines, mmfile_t *mf,
+					 xpparam_t const *xpp) {
+	long size;
+	char const *blk = xdl_mmfile_first(mf, &size);
+
+	if (lines && lines->ptr == blk && lines->size == size &&
+		lines->flags == (xpp->flags & XDF_WHITESPACE_FLAGS))
+		return lines;
+
+	return NULL;
+}
+
+
 int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 		    xdfenv_t *xe) {
 	long enl1, enl2, sample;
 	xdlclassifier_t cf;
+	mmlines_t const *lines1 = xdl_usable_lines(xpp->lines1, mf1, xpp);
+	mmlines_t const *lines2 = xdl_usable_lines(xpp->lines2, mf2, xpp);
 
 	memset(&cf, 0, sizeof(cf));
 
@@ -275,8 +360,8 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	 */
 	sample = xpp->flags & XDF_HISTOGRAM_DIFF ? XDL_GUESS_NLINES2 : XDL_GUESS_NLINES1;
 
-	enl1 = xdl_guess_lines(mf1, sample) + 1;
-	enl2 = xdl_guess_lines(mf2, sample) + 1;
+	enl1 = lines1 ? lines1->nrec + 1 : xdl_guess_lines(mf1, sample) + 1;
+	enl2 = lines2 ? lines2->nrec + 1 : xdl_guess_lines(mf2, sample) + 1;
 
 	if (!(xpp->flags & XDF_HISTOGRAM_DIFF) &&
 		xdl_init_classifier(&cf, enl1 + enl2 + 1, xpp->flags) < 0) {
@@ -284,12 +369,12 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 		return -1;
 	}
 
-	if (xdl_prepare_ctx(1, mf1, enl1, xpp, &cf, &xe->xdf1) < 0) {
+	if (xdl_prepare_ctx(1, mf1, enl1, xpp, lines1, &cf, &xe->xdf1) < 0) {
 
 		xdl_free_classifier(&cf);
 		return -1;
 	}
-	if (xdl_prepare_ctx(2, mf2, enl2, xpp, &cf, &xe->xdf2) < 0) {
+	if (xdl_prepare_ctx(2, mf2, enl2, xpp, lines2, &cf, &xe->xdf2) < 0) {
 
 		xdl_free_ctx(&xe->xdf1);
 		xdl_free_classifier(&cf);
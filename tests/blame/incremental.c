@@ -0,0 +1,206 @@
+#include <stddef.h>
+
+#include "blame_helpers.h"
+
+static git_repository *g_repo;
+static git_blame *g_blame;
+
+void test_blame_incremental__initialize(void)
+{
+	cl_git_pass(git_repository_open(&g_repo, cl_fixture("blametest.git")));
+	g_blame = NULL;
+}
+
+void test_blame_incremental__cleanup(void)
+{
+	git_blame_free(g_blame);
+	git_repository_free(g_repo);
+}
+
+/* Check every line blamed by the hunks against a full blame of the file */
+static void assert_same_as_full_blame(
+	const git_blame_hunk **hunks, size_t count,
+	git_blame_options *opts, uint32_t expected_lines)
+{
+	git_blame *full;
+	const git_blame_hunk *expected;
+	uint32_t line, blamed = 0;
+	size_t i;
+
+	cl_git_pass(git_blame_file(&full, g_repo, "b.txt", opts));
+
+	for (i = 0; i < count; i++) {
+		for (line = hunks[i]->final_start_line_number;
+			line < hunks[i]->final_start_line_number + hunks[i]->lines_in_hunk;
+			line++) {
+			cl_assert((expected = git_blame_get_hunk_byline(full, line)) != NULL);
+			cl_assert(git_oid_equal(
+				&expected->final_commit_id, &hunks[i]->final_commit_id));
+			cl_assert_equal_i(expected->boundary, hunks[i]->boundary);
+			blamed++;
+		}
+	}
+
+	cl_assert_equal_i(expected_lines, blamed);
+
+	git_blame_free(full);
+}
+
+void test_blame_incremental__hunks_match_full_blame(void)
+{
+	const git_blame_hunk *hunks[16], *hunk;
+	size_t count = 0;
+	int error;
+
+	cl_git_pass(git_blame_file_start(&g_blame, g_repo, "b.txt", NULL));
+
+	while ((error = git_blame_next(&hunk, g_blame)) == 0) {
+		cl_assert(count < ARRAY_SIZE(hunks));
+		hunks[count++] = hunk;
+	}
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert(hunk == NULL);
+
+	assert_same_as_full_blame(hunks, count, NULL, 15);
+
+	/* once over, the blame can be queried like a complete one */
+	cl_assert_equal_i(GIT_ITEROVER, git_blame_next(&hunk, g_blame));
+	cl_assert_equal_i(4, git_blame_get_hunk_count(g_blame));
+	check_blame_hunk_index(g_repo, g_blame, 0,  1, 4, 0, "da237394", "b.txt");
+	check_blame_hunk_index(g_repo, g_blame, 1,  5, 1, 1, "b99f7ac0", "b.txt");
+	check_blame_hunk_index(g_repo, g_blame, 2,  6, 5, 0, "63d671eb", "b.txt");
+	check_blame_hunk_index(g_repo, g_blame, 3, 11, 5, 0, "aa06ecca", "b.txt");
+}
+
+void test_blame_incremental__line_range(void)
+{
+	git_blame_options opts = GIT_BLAME_OPTIONS_INIT;
+	const git_blame_hunk *hunks[16], *hunk;
+	size_t count = 0;
+	int error;
+
+	opts.min_line = 2;
+	opts.max_line = 7;
+
+	cl_git_pass(git_blame_file_start(&g_blame, g_repo, "b.txt", &opts));
+
+	while ((error = git_blame_next(&hunk, g_blame)) == 0) {
+		cl_assert(count < ARRAY_SIZE(hunks));
+		cl_assert(hunk->final_start_line_number >= 2);
+		cl_assert(hunk->final_start_line_number + hunk->lines_in_hunk - 1 <= 7);
+		hunks[count++] = hunk;
+	}
+	cl_assert_equal_i(GIT_ITEROVER, error);
+
+	assert_same_as_full_blame(hunks, count, &opts, 6);
+}
+
+void test_blame_incremental__invalid_line_range(void)
+{
+	git_blame_options opts = GIT_BLAME_OPTIONS_INIT;
+
+	opts.min_line = 10;
+	opts.max_line = 16;
+	cl_git_fail(git_blame_file_start(&g_blame, g_repo, "b.txt", &opts));
+	cl_git_fail(git_blame_file(&g_blame, g_repo, "b.txt", &opts));
+
+	opts.min_line = 8;
+	opts.max_line = 7;
+	cl_git_fail(git_blame_file(&g_blame, g_repo, "b.txt", &opts));
+
+	opts.min_line = 16;
+	opts.max_line = 0;
+	cl_git_fail(git_blame_file(&g_blame, g_repo, "b.txt", &opts));
+}
+
+typedef struct {
+	uint32_t last_blamed;
+	uint32_t total;
+	int calls;
+	int cancel_after;
+} progress_data;
+
+static int progress_cb(uint32_t lines_blamed, uint32_t total_lines, void *payload)
+{
+	progress_data *data = payload;
+
+	cl_assert(lines_blamed >= data->last_blamed);
+	cl_assert(lines_blamed <= total_lines);
+
+	data->last_blamed = lines_blamed;
+	data->total = total_lines;
+
+	return (++data->calls == data->cancel_after) ? -1 : 0;
+}
+
+void test_blame_incremental__progress(void)
+{
+	git_blame_options opts = GIT_BLAME_OPTIONS_INIT;
+	progress_data data = {0};
+
+	opts.progress_cb = progress_cb;
+	opts.progress_payload = &data;
+
+	cl_git_pass(git_blame_file(&g_blame, g_repo, "b.txt", &opts));
+
+	cl_assert(data.calls > 0);
+	cl_assert_equal_i(15, data.total);
+	cl_assert_equal_i(15, data.last_blamed);
+}
+
+void test_blame_incremental__version_1_options_have_no_progress(void)
+{
+	git_blame_options dflt = GIT_BLAME_OPTIONS_INIT, *opts;
+
+	/* what follows the version 1 fields is not the caller's to read */
+	opts = git__malloc(sizeof(git_blame_options));
+	cl_assert(opts);
+	memset(opts, 0xff, sizeof(git_blame_options));
+	memcpy(opts, &dflt, offsetof(git_blame_options, progress_cb));
+	opts->version = 1;
+
+	cl_git_pass(git_blame_file(&g_blame, g_repo, "b.txt", opts));
+	cl_assert_equal_i(4, git_blame_get_hunk_count(g_blame));
+
+	git__free(opts);
+}
+
+void test_blame_incremental__cancel_and_resume(void)
+{
+	git_blame_options opts = GIT_BLAME_OPTIONS_INIT;
+	progress_data data = {0};
+	const git_blame_hunk *hunk;
+	int error;
+
+	opts.progress_cb = progress_cb;
+	opts.progress_payload = &data;
+	data.cancel_after = 1;
+
+	cl_assert_equal_i(GIT_EUSER, git_blame_file(&g_blame, g_repo, "b.txt", &opts));
+	cl_assert(g_blame == NULL);
+
+	data.calls = 0;
+	data.last_blamed = 0;
+	cl_git_pass(git_blame_file_start(&g_blame, g_repo, "b.txt", &opts));
+	cl_assert_equal_i(GIT_EUSER, git_blame_next(&hunk, g_blame));
+	cl_assert(hunk == NULL);
+
+	/* the lines blamed before the cancellation are not lost */
+	while ((error = git_blame_next(&hunk, g_blame)) == 0)
+		/* keep going */;
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert_equal_i(15, data.last_blamed);
+	cl_assert_equal_i(4, git_blame_get_hunk_count(g_blame));
+}
+
+void test_blame_incremental__free_before_the_end(void)
+{
+	const git_blame_hunk *hunk;
+
+	cl_git_pass(git_blame_file_start(&g_blame, g_repo, "b.txt", NULL));
+	cl_git_pass(git_blame_next(&hunk, g_blame));
+	cl_assert(hunk != NULL);
+
+	git_blame_free(g_blame);
+	g_blame = NULL;
+}
@@ -32,6 +32,27 @@ void test_blame_simple__trivial_testrepo(void)
 	check_blame_hunk_index(g_repo, g_blame, 1, 2, 1, 0, "a65fedf3", "branch_file.txt");
 }
 
+void test_blame_simple__trivial_testrepo_with_path_filters(void)
+{
+	git_repository *repo = cl_git_sandbox_init("testrepo.git");
+	git_revwalk *walk;
+
+	cl_git_pass(git_revwalk_new(&walk, repo));
+	cl_git_pass(git_revwalk_push_glob(walk, "heads"));
+	cl_git_pass(git_revwalk_write_path_filters(walk));
+	git_revwalk_free(walk);
+
+	cl_git_pass(git_blame_file(&g_blame, repo, "branch_file.txt", NULL));
+
+	cl_assert_equal_i(2, git_blame_get_hunk_count(g_blame));
+	check_blame_hunk_index(repo, g_blame, 0, 1, 1, 0, "c47800c7", "branch_file.txt");
+	check_blame_hunk_index(repo, g_blame, 1, 2, 1, 0, "a65fedf3", "branch_file.txt");
+
+	git_blame_free(g_blame);
+	g_blame = NULL;
+	cl_git_sandbox_cleanup();
+}
+
 /*
  * $ git blame -n b.txt
  *    orig line no                          final line no
@@ -411,3 +411,39 @@ committer Vicent Marti <tanoku@gmail.com> 1273848544 +0200\n\
 	cl_assert_equal_s(raw_message, git_commit_message_raw(commit));
 	git_commit__free(commit);
 }
+
+void test_commit_parse__scan_header(void)
+{
+	git_commit__header header;
+	git_oid oid;
+	const char *buffer =
+"tree 1810dff58d8a660512d4832e740f692884338ccd\n\
+parent e90810b8df3e80c413d903f631643c716887138d\n\
+parent 05452d6349abcd67aa396dfb28660d765d8b2a36\n\
+parent 05452D6349ABCD67AA396DFB28660D765D8B2A3X\n\
+author Vicent Marti <tanoku@gmail.com> 1273848544 +0200\n\
+committer Vicent Marti <tanoku@gmail.com> 1273848544 +0200\n\
+\n\
+a commit with three parents\n";
+
+	cl_git_pass(git_commit__scan_header(&header, buffer, strlen(buffer)));
+
+	cl_git_pass(git_oid__fromhex(&oid, header.tree));
+	cl_assert(git_oid_streq(&oid, "1810dff58d8a660512d4832e740f692884338ccd") == 0);
+
+	cl_assert_equal_i(3, header.parent_count);
+	cl_git_pass(git_commit__header_parent(&oid, &header, 0));
+	cl_assert(git_oid_streq(&oid, "e90810b8df3e80c413d903f631643c716887138d") == 0);
+	cl_git_pass(git_commit__header_parent(&oid, &header, 1));
+	cl_assert(git_oid_streq(&oid, "05452d6349abcd67aa396dfb28660d765d8b2a36") == 0);
+	cl_git_fail(git_commit__header_parent(&oid, &header, 2));
+
+	cl_assert(git__prefixcmp(header.author, "author Vicent") == 0);
+	cl_assert(git__prefixcmp(header.committer, "committer Vicent") == 0);
+	cl_assert(git__prefixcmp(header.committer_end, "\n\na commit") == 0);
+
+	/* every line up to the committer has to be complete */
+	cl_git_fail(git_commit__scan_header(&header, buffer, 40));
+	cl_git_fail(git_commit__scan_header(&header, buffer, strlen(buffer) - 40));
+	cl_git_fail(git_commit__scan_header(&header, buffer + 1, strlen(buffer) - 1));
+}
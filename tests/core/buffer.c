@@ -1002,6 +1002,79 @@ void test_core_buffer__similarity_metric_whitespace(void)
 	git_buf_free(&buf);
 }
 
+#define SIMILARITY_INDEX_FILES 48
+
+/* Files in families sharing more or fewer of their lines */
+static void similarity_index_file(git_buf *buf, int i)
+{
+	unsigned int seed = 17 * i + 1;
+	int line, lines = (i % 5) ? 80 : 12;
+
+	git_buf_clear(buf);
+
+	for (line = 0; line < lines; ++line) {
+		seed = seed * 1103515245 + 12345;
+
+		if ((int)((seed >> 16) % 8) < i % 8)
+			git_buf_printf(buf, "file %d own line %d\n", i, line);
+		else
+			git_buf_printf(buf, "family %d line %d\n", i % 6, line);
+	}
+}
+
+void test_core_buffer__similarity_index(void)
+{
+	git_hashsig *sigs[SIMILARITY_INDEX_FILES];
+	git_hashsig_index *index;
+	git_hashsig_ids found = GIT_ARRAY_INIT;
+	git_buf buf = GIT_BUF_INIT;
+	int thresholds[] = { 1, 30, 50, 80 };
+	size_t i, j, k, t, candidates;
+
+	for (i = 0; i < SIMILARITY_INDEX_FILES; ++i) {
+		similarity_index_file(&buf, (int)i);
+		cl_git_pass(git_hashsig_create(
+			&sigs[i], buf.ptr, buf.size, GIT_HASHSIG_NORMAL));
+	}
+
+	for (t = 0; t < ARRAY_SIZE(thresholds); ++t) {
+		cl_git_pass(git_hashsig_index_new(&index, thresholds[t]));
+
+		for (i = 0; i < SIMILARITY_INDEX_FILES; ++i)
+			cl_git_pass(git_hashsig_index_add(index, sigs[i], i));
+
+		candidates = 0;
+
+		for (i = 0; i < SIMILARITY_INDEX_FILES; ++i) {
+			found.size = 0;
+			cl_git_pass(git_hashsig_index_lookup(&found, index, sigs[i]));
+			candidates += found.size;
+
+			/* every similar enough file is found, in order */
+			for (j = 0, k = 0; j < SIMILARITY_INDEX_FILES; ++j) {
+				while (k < found.size && found.ptr[k] < j)
+					++k;
+
+				if (git_hashsig_compare(sigs[j], sigs[i]) >= thresholds[t])
+					cl_assert(k < found.size && found.ptr[k] == j);
+			}
+		}
+
+		/* but not every file */
+		if (thresholds[t] >= 50)
+			cl_assert(candidates <
+				SIMILARITY_INDEX_FILES * SIMILARITY_INDEX_FILES / 2);
+
+		git_hashsig_index_free(index);
+	}
+
+	for (i = 0; i < SIMILARITY_INDEX_FILES; ++i)
+		git_hashsig_free(sigs[i]);
+
+	git_array_clear(found);
+	git_buf_free(&buf);
+}
+
 #include "../filter/crlf.h"
 
 #define check_buf(expected,buf) do { \
@@ -0,0 +1,187 @@
+#include "clar_libgit2.h"
+#include "git2/describe.h"
+#include "buffer.h"
+
+static git_repository *_repo;
+
+void test_describe_describe__initialize(void)
+{
+	git_object *target;
+	git_signature *tagger;
+	git_oid tag_id;
+
+	_repo = cl_git_sandbox_init("testrepo.git");
+
+	/* an annotated tag below master, and a lightweight one above it */
+	cl_git_pass(git_signature_new(&tagger, "Tagger", "tagger@example.com", 1400000000, 0));
+	cl_git_pass(git_revparse_single(&target, _repo, "5b5b025"));
+	cl_git_pass(git_tag_create(&tag_id, _repo, "v1", target, tagger, "v1\n", 0));
+	git_object_free(target);
+	git_signature_free(tagger);
+
+	cl_git_pass(git_revparse_single(&target, _repo, "c47800c"));
+	cl_git_pass(git_tag_create_lightweight(&tag_id, _repo, "light", target, 0));
+	git_object_free(target);
+}
+
+void test_describe_describe__cleanup(void)
+{
+	cl_git_sandbox_cleanup();
+}
+
+static void assert_describe(
+	const char *expected,
+	const char *spec,
+	git_describe_options *opts,
+	git_describe_format_options *fmt_opts)
+{
+	git_object *object;
+	git_describe_result *result;
+	git_buf buf = GIT_BUF_INIT;
+
+	cl_git_pass(git_revparse_single(&object, _repo, spec));
+
+	cl_git_pass(git_describe_commit(&result, object, opts));
+	cl_git_pass(git_describe_format(&buf, result, fmt_opts));
+	cl_assert_equal_s(expected, git_buf_cstr(&buf));
+
+	git_describe_result_free(result);
+	git_object_free(object);
+	git_buf_free(&buf);
+}
+
+void test_describe_describe__annotated_tags(void)
+{
+	assert_describe("v1-4-gbe3563a", "be3563a", NULL, NULL);
+	assert_describe("v1-4-ga4a7dce", "a4a7dce", NULL, NULL);
+	assert_describe("v1-2-g9fd738e", "9fd738e", NULL, NULL);
+	assert_describe("v1-1-gc47800c", "c47800c", NULL, NULL);
+	assert_describe("v1-2-g763d71a", "763d71a", NULL, NULL);
+	assert_describe("hard_tag", "a65fedf", NULL, NULL);
+	assert_describe("v1", "5b5b025", NULL, NULL);
+}
+
+void test_describe_describe__lightweight_tags(void)
+{
+	git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+
+	opts.describe_strategy = GIT_DESCRIBE_TAGS;
+
+	assert_describe("light-3-gbe3563a", "be3563a", &opts, NULL);
+	assert_describe("light-3-ga4a7dce", "a4a7dce", &opts, NULL);
+	assert_describe("v1-2-g9fd738e", "9fd738e", &opts, NULL);
+	assert_describe("light", "c47800c", &opts, NULL);
+	assert_describe("light-1-g763d71a", "763d71a", &opts, NULL);
+}
+
+void test_describe_describe__all_references(void)
+{
+	git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+
+	opts.describe_strategy = GIT_DESCRIBE_ALL;
+
+	assert_describe("heads/br2", "a4a7dce", &opts, NULL);
+	assert_describe("tags/light", "c47800c", &opts, NULL);
+	assert_describe("tags/hard_tag", "a65fedf", &opts, NULL);
+	assert_describe("heads/subtrees", "763d71a", &opts, NULL);
+}
+
+void test_describe_describe__first_parent(void)
+{
+	git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+
+	opts.only_follow_first_parent = 1;
+
+	assert_describe("v1-3-gbe3563a", "be3563a", &opts, NULL);
+	assert_describe("v1-2-ga4a7dce", "a4a7dce", &opts, NULL);
+}
+
+void test_describe_describe__pattern(void)
+{
+	git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+
+	opts.describe_strategy = GIT_DESCRIBE_TAGS;
+	opts.pattern = "v*";
+
+	assert_describe("v1-4-gbe3563a", "be3563a", &opts, NULL);
+	assert_describe("v1-5-ga65fedf", "a65fedf", &opts, NULL);
+}
+
+void test_describe_describe__formatting(void)
+{
+	git_describe_format_options fmt_opts = GIT_DESCRIBE_FORMAT_OPTIONS_INIT;
+
+	fmt_opts.abbreviated_size = 0;
+	assert_describe("v1", "be3563a", NULL, &fmt_opts);
+
+	fmt_opts.abbreviated_size = 10;
+	fmt_opts.always_use_long_format = 1;
+	assert_describe("v1-4-gbe3563ae3f", "be3563a", NULL, &fmt_opts);
+	assert_describe("hard_tag-0-ga65fedf39a", "a65fedf", NULL, &fmt_opts);
+}
+
+void test_describe_describe__no_tags(void)
+{
+	git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+	git_describe_result *result;
+	git_object *object;
+
+	cl_git_pass(git_revparse_single(&object, _repo, "8496071"));
+	cl_assert_equal_i(GIT_ENOTFOUND, git_describe_commit(&result, object, &opts));
+
+	opts.show_commit_oid_as_fallback = 1;
+	git_object_free(object);
+
+	assert_describe("8496071", "8496071", &opts, NULL);
+}
+
+void test_describe_describe__exact_match_only(void)
+{
+	git_describe_options opts = GIT_DESCRIBE_OPTIONS_INIT;
+	git_describe_result *result;
+	git_object *object;
+
+	opts.max_candidates_tags = 0;
+
+	assert_describe("hard_tag", "a65fedf", &opts, NULL);
+
+	cl_git_pass(git_revparse_single(&object, _repo, "be3563a"));
+	cl_assert_equal_i(GIT_ENOTFOUND, git_describe_commit(&result, object, &opts));
+	git_object_free(object);
+}
+
+void test_describe_describe__many(void)
+{
+	const char *specs[] = { "be3563a", "a4a7dce", "9fd738e", "a65fedf", "763d71a" };
+	const char *expected[] = {
+		"v1-4-gbe3563a", "v1-4-ga4a7dce", "v1-2-g9fd738e", "hard_tag", "v1-2-g763d71a"
+	};
+	git_describe_result *results[5];
+	git_oid ids[5];
+	git_buf buf = GIT_BUF_INIT;
+	git_object *object;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(specs); ++i) {
+		cl_git_pass(git_revparse_single(&object, _repo, specs[i]));
+		git_oid_cpy(&ids[i], git_object_id(object));
+		git_object_free(object);
+	}
+
+	cl_git_pass(git_describe_many(results, _repo, ids, ARRAY_SIZE(ids), NULL));
+
+	for (i = 0; i < ARRAY_SIZE(specs); ++i) {
+		cl_git_pass(git_describe_format(&buf, results[i], NULL));
+		cl_assert_equal_s(expected[i], git_buf_cstr(&buf));
+		git_describe_result_free(results[i]);
+	}
+
+	/* one commit which can't be described fails them all */
+	cl_git_pass(git_oid_fromstr(&ids[2], "8496071c1b46c854b31185ea97743be6a8774479"));
+	cl_assert_equal_i(GIT_ENOTFOUND,
+		git_describe_many(results, _repo, ids, ARRAY_SIZE(ids), NULL));
+	for (i = 0; i < ARRAY_SIZE(specs); ++i)
+		cl_assert(results[i] == NULL);
+
+	git_buf_free(&buf);
+}
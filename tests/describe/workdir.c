@@ -0,0 +1,75 @@
+#include "clar_libgit2.h"
+#include "git2/describe.h"
+#include "buffer.h"
+
+static git_repository *_repo;
+
+void test_describe_workdir__initialize(void)
+{
+	git_object *head;
+	git_signature *tagger;
+	git_oid tag_id;
+
+	_repo = cl_git_sandbox_init("testrepo");
+
+	cl_git_pass(git_signature_new(&tagger, "Tagger", "tagger@example.com", 1400000000, 0));
+	cl_git_pass(git_revparse_single(&head, _repo, "HEAD"));
+	cl_git_pass(git_tag_create(&tag_id, _repo, "v2", head, tagger, "v2\n", 0));
+
+	/* the index of the fixture doesn't match HEAD */
+	cl_git_pass(git_reset(_repo, head, GIT_RESET_HARD, NULL, NULL));
+	git_object_free(head);
+	git_signature_free(tagger);
+}
+
+void test_describe_workdir__cleanup(void)
+{
+	cl_git_sandbox_cleanup();
+}
+
+static void assert_workdir_describe(const char *expected)
+{
+	git_describe_format_options fmt_opts = GIT_DESCRIBE_FORMAT_OPTIONS_INIT;
+	git_describe_result *result;
+	git_buf buf = GIT_BUF_INIT;
+
+	fmt_opts.dirty_suffix = "-dirty";
+
+	cl_git_pass(git_describe_workdir(&result, _repo, NULL));
+	cl_git_pass(git_describe_format(&buf, result, &fmt_opts));
+	cl_assert_equal_s(expected, git_buf_cstr(&buf));
+
+	git_describe_result_free(result);
+	git_buf_free(&buf);
+}
+
+void test_describe_workdir__clean(void)
+{
+	assert_workdir_describe("v2");
+}
+
+void test_describe_workdir__changed_file(void)
+{
+	cl_git_append2file("testrepo/README", "a change\n");
+	assert_workdir_describe("v2-dirty");
+}
+
+void test_describe_workdir__staged_change(void)
+{
+	git_index *index;
+
+	cl_git_append2file("testrepo/README", "a change\n");
+
+	cl_git_pass(git_repository_index(&index, _repo));
+	cl_git_pass(git_index_add_bypath(index, "README"));
+	cl_git_pass(git_index_write(index));
+	git_index_free(index);
+
+	assert_workdir_describe("v2-dirty");
+}
+
+void test_describe_workdir__untracked_files_are_not_changes(void)
+{
+	cl_git_mkfile("testrepo/untracked", "new\n");
+	assert_workdir_describe("v2");
+}
@@ -1,5 +1,7 @@
 #include "clar_libgit2.h"
 #include "diff_helpers.h"
+#include "buffer.h"
+#include "diff_xdiff.h"
 
 static git_repository *g_repo = NULL;
 static diff_expects expected;
@@ -1006,3 +1008,149 @@ void test_diff_blob__can_compare_buffer_to_buffer(void)
 		&opts, diff_file_cb, diff_hunk_cb, diff_line_cb, &expected));
 	assert_one_modified(4, 9, 0, 5, 4, &expected);
 }
+
+static void assert_same_patch_as_blobs(
+	git_blob *old_blob, git_blob *new_blob, git_diff_options *diffopts,
+	const git_diff_options *prepareopts)
+{
+	git_diff_prepared_blob *old_prepared, *new_prepared;
+	git_patch *p;
+	git_buf expected_patch = GIT_BUF_INIT, actual_patch = GIT_BUF_INIT;
+	diff_expects actual;
+
+	cl_git_pass(git_diff_prepared_blob_new(
+		&old_prepared, old_blob, "file", prepareopts));
+	cl_git_pass(git_diff_prepared_blob_new(
+		&new_prepared, new_blob, "file", prepareopts));
+
+	cl_git_pass(git_patch_from_blobs(
+		&p, old_blob, "file", new_blob, "file", diffopts));
+	cl_git_pass(git_patch_to_buf(&expected_patch, p));
+	git_patch_free(p);
+
+	cl_git_pass(git_patch_from_prepared_blobs(
+		&p, old_prepared, new_prepared, diffopts));
+	cl_git_pass(git_patch_to_buf(&actual_patch, p));
+	git_patch_free(p);
+
+	cl_assert_equal_s(expected_patch.ptr, actual_patch.ptr);
+
+	memset(&expected, 0, sizeof(expected));
+	cl_git_pass(git_diff_blobs(
+		old_blob, "file", new_blob, "file", diffopts,
+		diff_file_cb, diff_hunk_cb, diff_line_cb, &expected));
+
+	memset(&actual, 0, sizeof(actual));
+	cl_git_pass(git_diff_prepared_blobs(
+		old_prepared, new_prepared, diffopts,
+		diff_file_cb, diff_hunk_cb, diff_line_cb, &actual));
+
+	cl_assert(memcmp(&expected, &actual, sizeof(actual)) == 0);
+
+	git_buf_free(&expected_patch);
+	git_buf_free(&actual_patch);
+	git_diff_prepared_blob_free(old_prepared);
+	git_diff_prepared_blob_free(new_prepared);
+}
+
+void test_diff_blob__prepared_blobs_give_the_same_result(void)
+{
+	git_blob *blobs[6];
+	git_oid oid;
+	git_diff_options prepareopts = GIT_DIFF_OPTIONS_INIT;
+	uint32_t flags[] = {
+		0,
+		GIT_DIFF_REVERSE,
+		GIT_DIFF_PATIENCE,
+		GIT_DIFF_MINIMAL,
+		GIT_DIFF_IGNORE_WHITESPACE,
+		GIT_DIFF_IGNORE_WHITESPACE_CHANGE | GIT_DIFF_INCLUDE_UNMODIFIED,
+	};
+	size_t i, j, f;
+
+	/* tests/resources/attr/root_test1 to root_test3 */
+	cl_git_pass(git_oid_fromstrn(&oid, "45141a79", 8));
+	cl_git_pass(git_blob_lookup_prefix(&blobs[0], g_repo, &oid, 4));
+	cl_git_pass(git_oid_fromstrn(&oid, "4d713dc4", 8));
+	cl_git_pass(git_blob_lookup_prefix(&blobs[1], g_repo, &oid, 4));
+	cl_git_pass(git_oid_fromstrn(&oid, "c96bbb2c2557a832", 16));
+	cl_git_pass(git_blob_lookup_prefix(&blobs[2], g_repo, &oid, 8));
+	blobs[3] = d;
+	blobs[4] = alien;
+	blobs[5] = NULL;
+
+	for (f = 0; f < ARRAY_SIZE(flags); ++f) {
+		opts.flags = flags[f];
+
+		for (i = 0; i < ARRAY_SIZE(blobs); ++i) {
+			for (j = 0; j < ARRAY_SIZE(blobs); ++j) {
+				/* prepared for these very diffs, or for others */
+				prepareopts.flags = flags[f];
+				assert_same_patch_as_blobs(
+					blobs[i], blobs[j], &opts, &prepareopts);
+				assert_same_patch_as_blobs(
+					blobs[i], blobs[j], &opts, NULL);
+			}
+		}
+	}
+
+	for (i = 0; i < 3; ++i)
+		git_blob_free(blobs[i]);
+}
+
+void test_diff_blob__prepared_blobs_keep_their_lines(void)
+{
+	const char *old_content = "a\nb\nc\nd\ne\n";
+	const char *new_content = "a\nb\nc\nd\ne\nf\n";
+	git_diff_prepared_blob *old_prepared, *new_prepared;
+	git_blob *old_blob, *new_blob;
+	git_oid oid;
+	long i;
+
+	cl_git_pass(git_blob_create_frombuffer(
+		&oid, g_repo, old_content, strlen(old_content)));
+	cl_git_pass(git_blob_lookup(&old_blob, g_repo, &oid));
+	cl_git_pass(git_blob_create_frombuffer(
+		&oid, g_repo, new_content, strlen(new_content)));
+	cl_git_pass(git_blob_lookup(&new_blob, g_repo, &oid));
+
+	cl_git_pass(git_diff_prepared_blob_new(
+		&old_prepared, old_blob, NULL, NULL));
+	cl_git_pass(git_diff_prepared_blob_new(
+		&new_prepared, new_blob, NULL, NULL));
+	cl_assert_equal_i(5, old_prepared->lines.nrec);
+	cl_assert_equal_i(6, new_prepared->lines.nrec);
+
+	memset(&expected, 0, sizeof(expected));
+	cl_git_pass(git_diff_prepared_blobs(
+		old_prepared, new_prepared, &opts,
+		diff_file_cb, diff_hunk_cb, diff_line_cb, &expected));
+	cl_assert_equal_i(1, expected.line_adds);
+	cl_assert_equal_i(0, expected.line_dels);
+
+	/* lines hashed differently are no longer the same lines */
+	for (i = 0; i < old_prepared->lines.nrec; ++i)
+		new_prepared->lines.ha[i] = ~old_prepared->lines.ha[i];
+
+	memset(&expected, 0, sizeof(expected));
+	cl_git_pass(git_diff_prepared_blobs(
+		old_prepared, new_prepared, &opts,
+		diff_file_cb, diff_hunk_cb, diff_line_cb, &expected));
+	cl_assert_equal_i(6, expected.line_adds);
+	cl_assert_equal_i(5, expected.line_dels);
+
+	/* unless the whitespace flags differ, and the lines are hashed anew */
+	opts.flags |= GIT_DIFF_IGNORE_WHITESPACE_EOL;
+
+	memset(&expected, 0, sizeof(expected));
+	cl_git_pass(git_diff_prepared_blobs(
+		old_prepared, new_prepared, &opts,
+		diff_file_cb, diff_hunk_cb, diff_line_cb, &expected));
+	cl_assert_equal_i(1, expected.line_adds);
+	cl_assert_equal_i(0, expected.line_dels);
+
+	git_diff_prepared_blob_free(old_prepared);
+	git_diff_prepared_blob_free(new_prepared);
+	git_blob_free(old_blob);
+	git_blob_free(new_blob);
+}
@@ -1,3 +1,5 @@
+#include <stddef.h>
+
 #include "clar_libgit2.h"
 #include "git2/sys/repository.h"
 
@@ -610,3 +612,188 @@ void test_diff_patch__line_counts_with_eofnl(void)
 
 	git_buf_free(&content);
 }
+
+#define MANY_FILES 40
+
+/* Make two trees in which many files are changed */
+static void make_trees_with_many_changes(git_tree **one, git_tree **two)
+{
+	git_treebuilder *builder;
+	git_buf path = GIT_BUF_INIT, content = GIT_BUF_INIT;
+	git_oid id;
+	int i, side, line;
+
+	for (side = 0; side < 2; ++side) {
+		cl_git_pass(git_treebuilder_create(&builder, NULL));
+
+		for (i = 0; i < MANY_FILES; ++i) {
+			git_buf_clear(&path);
+			git_buf_clear(&content);
+
+			cl_git_pass(git_buf_printf(&path, "file%02d.txt", i));
+
+			/* every seventh line changes, and a file in ten is binary */
+			for (line = 0; line < 100; ++line)
+				git_buf_printf(&content, "line %d of file %d%s\n", line, i,
+					(side && line % 7 == i % 7) ? " changed" : "");
+			if (i % 10 == 9)
+				git_buf_putc(&content, '\0');
+			cl_assert(!git_buf_oom(&content));
+
+			/* one file is only on each side */
+			if (i == side * 5)
+				continue;
+
+			cl_git_pass(git_blob_create_frombuffer(
+				&id, g_repo, content.ptr, content.size));
+			cl_git_pass(git_treebuilder_insert(
+				NULL, builder, path.ptr, &id, GIT_FILEMODE_BLOB));
+		}
+
+		cl_git_pass(git_treebuilder_write(&id, g_repo, builder));
+		cl_git_pass(git_tree_lookup(side ? two : one, g_repo, &id));
+		git_treebuilder_free(builder);
+	}
+
+	git_buf_free(&path);
+	git_buf_free(&content);
+}
+
+static void print_diff(
+	git_buf *out, git_tree *one, git_tree *two, git_diff_options *opts)
+{
+	git_diff *diff;
+
+	git_buf_clear(out);
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, one, two, opts));
+	cl_git_pass(git_diff_print(diff, GIT_DIFF_FORMAT_PATCH,
+		git_diff_print_callback__to_buf, out));
+
+	git_diff_free(diff);
+}
+
+void test_diff_patch__generating_on_threads_gives_the_same_output(void)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_buf expected = GIT_BUF_INIT, actual = GIT_BUF_INIT;
+	git_tree *one, *two;
+	git_diff *diff;
+	diff_expects exp[2];
+	unsigned int threads[] = { 2, 3, 8 };
+	size_t i;
+
+	g_repo = cl_git_sandbox_init("empty_standard_repo");
+	make_trees_with_many_changes(&one, &two);
+
+	print_diff(&expected, one, two, &opts);
+	cl_assert(expected.size > 0);
+
+	for (i = 0; i < ARRAY_SIZE(threads); ++i) {
+		opts.threads = threads[i];
+		print_diff(&actual, one, two, &opts);
+		cl_assert_equal_s(expected.ptr, actual.ptr);
+	}
+
+	/* with the lines and no hunks, and the other way round */
+	for (i = 0; i < 2; ++i) {
+		opts.threads = i ? 4 : 1;
+		cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, one, two, &opts));
+
+		memset(&exp[i], 0, sizeof(exp[i]));
+		cl_git_pass(git_diff_foreach(
+			diff, NULL, NULL, diff_line_cb, &exp[i]));
+		cl_git_pass(git_diff_foreach(
+			diff, diff_file_cb, diff_hunk_cb, NULL, &exp[i]));
+
+		git_diff_free(diff);
+	}
+
+	cl_assert_equal_i(MANY_FILES, exp[0].files);
+	cl_assert(exp[0].files_binary > 0);
+	cl_assert_equal_i(exp[0].files, exp[1].files);
+	cl_assert_equal_i(exp[0].file_status[GIT_DELTA_MODIFIED],
+		exp[1].file_status[GIT_DELTA_MODIFIED]);
+	cl_assert_equal_i(exp[0].files_binary, exp[1].files_binary);
+	cl_assert_equal_i(exp[0].hunks, exp[1].hunks);
+	cl_assert_equal_i(exp[0].lines, exp[1].lines);
+	cl_assert_equal_i(exp[0].line_adds, exp[1].line_adds);
+	cl_assert_equal_i(exp[0].line_dels, exp[1].line_dels);
+
+	git_buf_free(&expected);
+	git_buf_free(&actual);
+	git_tree_free(one);
+	git_tree_free(two);
+}
+
+void test_diff_patch__version_1_options_have_no_threads(void)
+{
+	git_diff_options dflt = GIT_DIFF_OPTIONS_INIT, *opts;
+	git_tree *one, *two;
+	git_diff *diff;
+	git_patch *patch;
+
+	g_repo = cl_git_sandbox_init("empty_standard_repo");
+	make_trees_with_many_changes(&one, &two);
+
+	/* what follows the version 1 fields is not the caller's to read */
+	opts = git__malloc(sizeof(git_diff_options));
+	cl_assert(opts);
+	memset(opts, 0xff, sizeof(git_diff_options));
+	memcpy(opts, &dflt, offsetof(git_diff_options, threads));
+	opts->version = 1;
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, one, two, opts));
+	cl_assert_equal_i(1, diff->opts.version);
+	cl_assert_equal_i(0, diff->opts.threads);
+	git_diff_free(diff);
+
+	cl_git_pass(git_patch_from_buffers(
+		&patch, "a\n", 2, "one", "b\n", 2, "two", opts));
+	cl_assert_equal_i(1, git_patch_num_hunks(patch));
+	git_patch_free(patch);
+
+	git__free(opts);
+	git_tree_free(one);
+	git_tree_free(two);
+}
+
+static int stop_after_lines_cb(
+	const git_diff_delta *delta,
+	const git_diff_hunk *hunk,
+	const git_diff_line *line,
+	void *payload)
+{
+	int *lines_left = payload;
+
+	GIT_UNUSED(delta); GIT_UNUSED(hunk); GIT_UNUSED(line);
+
+	return (--(*lines_left) == 0) ? -4242 : 0;
+}
+
+void test_diff_patch__can_cancel_generating_on_threads(void)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_tree *one, *two;
+	git_diff *diff;
+	int lines_left;
+
+	g_repo = cl_git_sandbox_init("empty_standard_repo");
+	make_trees_with_many_changes(&one, &two);
+
+	opts.threads = 4;
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, one, two, &opts));
+
+	lines_left = 50;
+	cl_git_fail_with(git_diff_foreach(
+		diff, NULL, NULL, stop_after_lines_cb, &lines_left), -4242);
+	cl_assert_equal_i(0, lines_left);
+
+	lines_left = 1;
+	cl_git_fail_with(git_diff_print(diff, GIT_DIFF_FORMAT_PATCH,
+		stop_after_lines_cb, &lines_left), -4242);
+
+	git_diff_free(diff);
+	git_tree_free(one);
+	git_tree_free(two);
+}
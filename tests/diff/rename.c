@@ -1,6 +1,10 @@
+#include <stddef.h>
+
 #include "clar_libgit2.h"
 #include "diff_helpers.h"
 #include "buf_text.h"
+#include "diff.h"
+#include "global.h"
 
 static git_repository *g_repo = NULL;
 
@@ -1586,3 +1590,234 @@ void test_diff_rename__by_config_doesnt_mess_with_whitespace_settings(void)
 	git_tree_free(tree1);
 	git_tree_free(tree2);
 }
+
+void test_diff_rename__exact_renames_ignore_rename_limit(void)
+{
+	git_index *index;
+	git_tree *tree1, *tree2;
+	git_oid id;
+	git_diff *diff;
+	git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
+	git_buf path = GIT_BUF_INIT, content = GIT_BUF_INIT;
+	diff_expects exp;
+	int i;
+
+	cl_git_pass(git_repository_index(&index, g_repo));
+
+	for (i = 0; i < 20; ++i) {
+		cl_git_pass(git_buf_printf(&path, "renames/old%02d.txt", i));
+		cl_git_pass(git_buf_printf(&content,
+			"file %d\nwith\nsome\nlines\nto compare\n", i));
+		cl_git_mkfile(path.ptr, content.ptr);
+		cl_git_pass(git_index_add_bypath(index, path.ptr + strlen("renames/")));
+		git_buf_clear(&path);
+		git_buf_clear(&content);
+	}
+
+	cl_git_pass(git_index_write_tree(&id, index));
+	cl_git_pass(git_tree_lookup(&tree1, g_repo, &id));
+
+	for (i = 0; i < 20; ++i) {
+		cl_git_pass(git_buf_printf(&path, "old%02d.txt", i));
+		cl_git_pass(git_index_remove_bypath(index, path.ptr));
+		git_buf_clear(&path);
+
+		cl_git_pass(git_buf_printf(&path, "renames/new%02d.txt", i));
+		cl_git_pass(git_buf_printf(&content,
+			"file %d\nwith\nsome\nlines\nto compare\n", i));
+		cl_git_mkfile(path.ptr, content.ptr);
+		cl_git_pass(git_index_add_bypath(index, path.ptr + strlen("renames/")));
+		git_buf_clear(&path);
+		git_buf_clear(&content);
+	}
+
+	cl_git_pass(git_index_write_tree(&id, index));
+	cl_git_pass(git_tree_lookup(&tree2, g_repo, &id));
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, tree1, tree2, NULL));
+
+	/* each target only gets to compare a couple of sources */
+	opts.flags = GIT_DIFF_FIND_RENAMES;
+	opts.rename_limit = 1;
+	cl_git_pass(git_diff_find_similar(diff, &opts));
+
+	memset(&exp, 0, sizeof(exp));
+	cl_git_pass(git_diff_foreach(diff, diff_file_cb, NULL, NULL, &exp));
+
+	cl_assert_equal_i(20, exp.files);
+	cl_assert_equal_i(20, exp.file_status[GIT_DELTA_RENAMED]);
+
+	git_diff_free(diff);
+	git_tree_free(tree1);
+	git_tree_free(tree2);
+	git_index_free(index);
+	git_buf_free(&path);
+	git_buf_free(&content);
+}
+
+static void assert_same_with_threads(
+	git_tree *old_tree, git_tree *new_tree, git_diff_find_options *opts)
+{
+	git_diff_options diffopts = GIT_DIFF_OPTIONS_INIT;
+	git_diff *serial, *threaded;
+	const git_diff_delta *expected, *actual;
+	size_t i;
+
+	diffopts.flags = GIT_DIFF_INCLUDE_UNMODIFIED;
+
+	cl_git_pass(git_diff_tree_to_tree(
+		&serial, g_repo, old_tree, new_tree, &diffopts));
+	cl_git_pass(git_diff_tree_to_tree(
+		&threaded, g_repo, old_tree, new_tree, &diffopts));
+
+	opts->threads = 1;
+	cl_git_pass(git_diff_find_similar(serial, opts));
+	opts->threads = 4;
+	cl_git_pass(git_diff_find_similar(threaded, opts));
+
+	cl_assert_equal_i(git_diff_num_deltas(serial), git_diff_num_deltas(threaded));
+
+	for (i = 0; i < git_diff_num_deltas(serial); ++i) {
+		expected = git_diff_get_delta(serial, i);
+		actual = git_diff_get_delta(threaded, i);
+
+		cl_assert_equal_i(expected->status, actual->status);
+		cl_assert_equal_i(expected->similarity, actual->similarity);
+		cl_assert_equal_s(expected->old_file.path, actual->old_file.path);
+		cl_assert_equal_s(expected->new_file.path, actual->new_file.path);
+	}
+
+	git_diff_free(serial);
+	git_diff_free(threaded);
+}
+
+void test_diff_rename__threads_give_the_same_result(void)
+{
+	const char *shas[] = {
+		"31e47d8c1fa36d7f8d537b96158e3f024de0a9f2",
+		"2bc7f351d20b53f1c72c16c4b036e491c478c49a",
+		"1c068dee5790ef1580cfc4cd670915b48d790084",
+		"19dd32dfb1520a64e5bbaae8dce6ef423dfa2f13",
+	};
+	uint32_t flags[] = {
+		GIT_DIFF_FIND_RENAMES,
+		GIT_DIFF_FIND_RENAMES | GIT_DIFF_FIND_COPIES |
+			GIT_DIFF_FIND_COPIES_FROM_UNMODIFIED,
+		GIT_DIFF_FIND_ALL,
+		GIT_DIFF_FIND_ALL | GIT_DIFF_FIND_IGNORE_WHITESPACE,
+	};
+	git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
+	git_tree *trees[ARRAY_SIZE(shas)];
+	size_t i, j, f;
+
+	for (i = 0; i < ARRAY_SIZE(shas); ++i)
+		cl_assert((trees[i] = resolve_commit_oid_to_tree(g_repo, shas[i])) != NULL);
+
+	for (f = 0; f < ARRAY_SIZE(flags); ++f) {
+		for (i = 0; i < ARRAY_SIZE(shas); ++i) {
+			for (j = 0; j < ARRAY_SIZE(shas); ++j) {
+				if (i == j)
+					continue;
+
+				opts.flags = flags[f];
+				opts.rename_limit = 0;
+				assert_same_with_threads(trees[i], trees[j], &opts);
+
+				/* the scores computed ahead must stop at the same place */
+				opts.rename_limit = 1;
+				assert_same_with_threads(trees[i], trees[j], &opts);
+			}
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(shas); ++i)
+		git_tree_free(trees[i]);
+}
+
+typedef struct {
+	git_global_st *caller;
+	int elsewhere;
+} metric_threads;
+
+static void note_thread(void *payload)
+{
+	metric_threads *seen = payload;
+
+	/* each thread has its own global state */
+	if (GIT_GLOBAL != seen->caller)
+		seen->elsewhere = 1;
+}
+
+static int noted_file_signature(
+	void **out, const git_diff_file *file, const char *fullpath, void *payload)
+{
+	note_thread(payload);
+	return git_diff_find_similar__hashsig_for_file(out, file, fullpath,
+		(void *)GIT_HASHSIG_SMART_WHITESPACE);
+}
+
+static int noted_buffer_signature(
+	void **out, const git_diff_file *file,
+	const char *buf, size_t buflen, void *payload)
+{
+	note_thread(payload);
+	return git_diff_find_similar__hashsig_for_buf(out, file, buf, buflen,
+		(void *)GIT_HASHSIG_SMART_WHITESPACE);
+}
+
+static void noted_free_signature(void *sig, void *payload)
+{
+	note_thread(payload);
+	git_diff_find_similar__hashsig_free(sig, NULL);
+}
+
+static int noted_similarity(int *score, void *siga, void *sigb, void *payload)
+{
+	note_thread(payload);
+	return git_diff_find_similar__calc_similarity(score, siga, sigb, NULL);
+}
+
+void test_diff_rename__version_1_options_have_no_threads(void)
+{
+	git_diff_find_options dflt = GIT_DIFF_FIND_OPTIONS_INIT, *opts;
+	git_diff_similarity_metric metric;
+	metric_threads seen;
+	git_tree *old_tree, *new_tree;
+	git_diff *diff;
+
+	old_tree = resolve_commit_oid_to_tree(
+		g_repo, "31e47d8c1fa36d7f8d537b96158e3f024de0a9f2");
+	new_tree = resolve_commit_oid_to_tree(
+		g_repo, "2bc7f351d20b53f1c72c16c4b036e491c478c49a");
+	cl_assert(old_tree && new_tree);
+
+	seen.caller = GIT_GLOBAL;
+	seen.elsewhere = 0;
+
+	metric.file_signature = noted_file_signature;
+	metric.buffer_signature = noted_buffer_signature;
+	metric.free_signature = noted_free_signature;
+	metric.similarity = noted_similarity;
+	metric.payload = &seen;
+
+	/* what follows the version 1 fields is not the caller's to read */
+	opts = git__malloc(sizeof(git_diff_find_options));
+	cl_assert(opts);
+	memset(opts, 0xff, sizeof(git_diff_find_options));
+	memcpy(opts, &dflt, offsetof(git_diff_find_options, threads));
+	opts->version = 1;
+	opts->flags = GIT_DIFF_FIND_ALL;
+	opts->metric = &metric;
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, old_tree, new_tree, NULL));
+	cl_git_pass(git_diff_find_similar(diff, opts));
+
+	/* a metric given by an old caller is only ever run on its thread */
+	cl_assert(git_diff_num_deltas(diff) > 0);
+	cl_assert_equal_i(0, seen.elsewhere);
+
+	git_diff_free(diff);
+	git__free(opts);
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+}
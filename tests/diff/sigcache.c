@@ -0,0 +1,267 @@
+#include "clar_libgit2.h"
+#include "diff_helpers.h"
+#include "repository.h"
+#include "fileops.h"
+#include "hashsig.h"
+
+#define CACHE_FILE "renames/.git/signatures"
+
+static git_repository *g_repo = NULL;
+
+static const char *g_commits[] = {
+	"31e47d8c1fa36d7f8d537b96158e3f024de0a9f2",
+	"2bc7f351d20b53f1c72c16c4b036e491c478c49a",
+	"1c068dee5790ef1580cfc4cd670915b48d790084",
+	"19dd32dfb1520a64e5bbaae8dce6ef423dfa2f13",
+};
+
+void test_diff_sigcache__initialize(void)
+{
+	g_repo = cl_git_sandbox_init("renames");
+}
+
+void test_diff_sigcache__cleanup(void)
+{
+	cl_git_sandbox_cleanup();
+}
+
+/* Find the renames and copies between two of the commits */
+static git_diff *find_similar(size_t from, size_t to, uint32_t flags)
+{
+	git_diff_options diffopts = GIT_DIFF_OPTIONS_INIT;
+	git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
+	git_tree *old_tree, *new_tree;
+	git_diff *diff;
+
+	cl_assert((old_tree = resolve_commit_oid_to_tree(g_repo, g_commits[from])) != NULL);
+	cl_assert((new_tree = resolve_commit_oid_to_tree(g_repo, g_commits[to])) != NULL);
+
+	diffopts.flags = GIT_DIFF_INCLUDE_UNMODIFIED;
+	cl_git_pass(git_diff_tree_to_tree(
+		&diff, g_repo, old_tree, new_tree, &diffopts));
+
+	opts.flags = flags;
+	cl_git_pass(git_diff_find_similar(diff, &opts));
+
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+
+	return diff;
+}
+
+static void assert_same_diff(git_diff *expected, git_diff *actual)
+{
+	const git_diff_delta *e, *a;
+	size_t i;
+
+	cl_assert_equal_i(git_diff_num_deltas(expected), git_diff_num_deltas(actual));
+
+	for (i = 0; i < git_diff_num_deltas(expected); ++i) {
+		e = git_diff_get_delta(expected, i);
+		a = git_diff_get_delta(actual, i);
+
+		cl_assert_equal_i(e->status, a->status);
+		cl_assert_equal_i(e->similarity, a->similarity);
+		cl_assert_equal_s(e->old_file.path, a->old_file.path);
+		cl_assert_equal_s(e->new_file.path, a->new_file.path);
+		cl_assert_equal_i(e->old_file.size, a->old_file.size);
+		cl_assert_equal_i(e->new_file.size, a->new_file.size);
+	}
+}
+
+static void assert_all_diffs_same(void)
+{
+	uint32_t flags[] = {
+		GIT_DIFF_FIND_ALL,
+		GIT_DIFF_FIND_ALL | GIT_DIFF_FIND_IGNORE_WHITESPACE,
+		GIT_DIFF_FIND_ALL | GIT_DIFF_FIND_DONT_IGNORE_WHITESPACE,
+	};
+	git_sigcache *cache = g_repo->sigcache;
+	git_diff *expected, *actual;
+	size_t i, j, f;
+
+	for (f = 0; f < ARRAY_SIZE(flags); ++f) {
+		for (i = 0; i < ARRAY_SIZE(g_commits); ++i) {
+			for (j = i + 1; j < ARRAY_SIZE(g_commits); ++j) {
+				g_repo->sigcache = NULL;
+				expected = find_similar(i, j, flags[f]);
+				g_repo->sigcache = cache;
+
+				actual = find_similar(i, j, flags[f]);
+
+				assert_same_diff(expected, actual);
+
+				git_diff_free(expected);
+				git_diff_free(actual);
+			}
+		}
+	}
+}
+
+void test_diff_sigcache__gives_the_same_result(void)
+{
+	size_t size;
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, NULL));
+	cl_assert_equal_i(0, git_sigcache_size(g_repo->sigcache));
+
+	/* a cold cache is filled, and a warm one used */
+	assert_all_diffs_same();
+	cl_assert((size = git_sigcache_size(g_repo->sigcache)) > 0);
+
+	assert_all_diffs_same();
+	cl_assert_equal_i(size, git_sigcache_size(g_repo->sigcache));
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 0, NULL));
+	cl_assert(g_repo->sigcache == NULL);
+}
+
+static int count_renames(git_diff *diff)
+{
+	size_t i;
+	int renames = 0;
+
+	for (i = 0; i < git_diff_num_deltas(diff); ++i)
+		if (git_diff_get_delta(diff, i)->status == GIT_DELTA_RENAMED)
+			renames++;
+
+	return renames;
+}
+
+void test_diff_sigcache__unused_for_exact_renames(void)
+{
+	git_diff *diff;
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, NULL));
+
+	/* the one rename is exact, so no contents are compared at all */
+	diff = find_similar(0, 1, GIT_DIFF_FIND_RENAMES);
+	cl_assert_equal_i(1, count_renames(diff));
+	git_diff_free(diff);
+	cl_assert_equal_i(0, git_sigcache_size(g_repo->sigcache));
+
+	/* nor are they with every target paired, looking for copies */
+	diff = find_similar(0, 1, GIT_DIFF_FIND_ALL);
+	git_diff_free(diff);
+	cl_assert_equal_i(0, git_sigcache_size(g_repo->sigcache));
+}
+
+void test_diff_sigcache__drops_least_recently_used(void)
+{
+	git_diff *diff;
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 2, NULL));
+
+	diff = find_similar(0, 3, GIT_DIFF_FIND_ALL);
+	git_diff_free(diff);
+	cl_assert_equal_i(2, git_sigcache_size(g_repo->sigcache));
+
+	assert_all_diffs_same();
+	cl_assert_equal_i(2, git_sigcache_size(g_repo->sigcache));
+}
+
+void test_diff_sigcache__saved_to_a_file(void)
+{
+	git_diff *diff;
+	size_t size;
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, CACHE_FILE));
+	cl_assert(!git_path_exists(CACHE_FILE));
+
+	diff = find_similar(0, 3, GIT_DIFF_FIND_ALL);
+	git_diff_free(diff);
+	cl_assert((size = git_sigcache_size(g_repo->sigcache)) > 0);
+	cl_assert(git_path_isfile(CACHE_FILE));
+
+	/* another cache loads what the first one saved */
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, CACHE_FILE));
+	cl_assert_equal_i(size, git_sigcache_size(g_repo->sigcache));
+
+	/* and appends what it learns */
+	diff = find_similar(1, 2, GIT_DIFF_FIND_ALL);
+	git_diff_free(diff);
+	cl_assert(git_sigcache_size(g_repo->sigcache) > size);
+	size = git_sigcache_size(g_repo->sigcache);
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, CACHE_FILE));
+	cl_assert_equal_i(size, git_sigcache_size(g_repo->sigcache));
+
+	assert_all_diffs_same();
+}
+
+/* Count the records in the cache file */
+static size_t count_records(void)
+{
+	git_buf contents = GIT_BUF_INIT;
+	git_hashsig *sig;
+	const char *data, *end;
+	size_t records = 0, sig_len;
+
+	cl_git_pass(git_futils_readbuffer(&contents, CACHE_FILE));
+
+	data = contents.ptr + 8;
+	end = contents.ptr + contents.size;
+
+	while (data < end) {
+		data += GIT_OID_RAWSZ + 3 * sizeof(uint32_t);
+		cl_git_pass(git_hashsig_read(&sig, data, end - data, &sig_len));
+		git_hashsig_free(sig);
+
+		data += sig_len;
+		records++;
+	}
+
+	git_buf_free(&contents);
+	return records;
+}
+
+void test_diff_sigcache__file_holds_no_more_than_the_cache(void)
+{
+	git_diff *diff;
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 2, CACHE_FILE));
+
+	/* signatures dropped and added again are not appended forever */
+	assert_all_diffs_same();
+	assert_all_diffs_same();
+	cl_assert(count_records() <= 2);
+
+	/* and what is new since the last save is still appended */
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, CACHE_FILE));
+	diff = find_similar(0, 3, GIT_DIFF_FIND_ALL);
+	git_diff_free(diff);
+	cl_assert(count_records() > 2);
+	cl_assert_equal_sz(git_sigcache_size(g_repo->sigcache), count_records());
+}
+
+void test_diff_sigcache__ignores_a_damaged_file(void)
+{
+	git_buf contents = GIT_BUF_INIT;
+	git_diff *diff;
+	size_t size;
+
+	cl_git_mkfile(CACHE_FILE, "this is not a signature cache");
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, CACHE_FILE));
+	cl_assert_equal_i(0, git_sigcache_size(g_repo->sigcache));
+
+	/* the file is rewritten on the next save */
+	diff = find_similar(0, 3, GIT_DIFF_FIND_ALL);
+	git_diff_free(diff);
+	size = git_sigcache_size(g_repo->sigcache);
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, CACHE_FILE));
+	cl_assert_equal_i(size, git_sigcache_size(g_repo->sigcache));
+
+	/* a record cut short is left out */
+	cl_git_pass(git_futils_readbuffer(&contents, CACHE_FILE));
+	git_buf_truncate(&contents, contents.size - 10);
+	cl_git_pass(git_futils_writebuffer(&contents, CACHE_FILE, 0, 0));
+
+	cl_git_pass(git_repository_set_signature_cache(g_repo, 100, CACHE_FILE));
+	cl_assert_equal_i(size - 1, git_sigcache_size(g_repo->sigcache));
+
+	assert_all_diffs_same();
+
+	git_buf_free(&contents);
+}
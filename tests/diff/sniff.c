@@ -0,0 +1,168 @@
+#include "clar_libgit2.h"
+#include "repository.h"
+#include "fileops.h"
+
+#define BLOB_SIZE (256 * 1024)
+
+static git_repository *g_repo = NULL;
+static git_oid g_old_tree, g_new_tree;
+static git_oid g_old_binary, g_new_text;
+
+static void make_binary(git_oid *out, uint32_t seed)
+{
+	git_buf buf = GIT_BUF_INIT;
+
+	/* noise, which doesn't compress, after a NUL */
+	cl_git_pass(git_buf_putc(&buf, '\0'));
+	while (buf.size < BLOB_SIZE) {
+		seed = seed * 1103515245 + 12345;
+		cl_git_pass(git_buf_putc(&buf, (char)(seed >> 16)));
+	}
+
+	cl_git_pass(git_blob_create_frombuffer(out, g_repo, buf.ptr, buf.size));
+	git_buf_free(&buf);
+}
+
+static void make_text(git_oid *out, int changed_line)
+{
+	git_buf buf = GIT_BUF_INIT;
+	int line;
+
+	for (line = 0; buf.size < BLOB_SIZE; ++line)
+		cl_git_pass(git_buf_printf(&buf, "%s %d\n",
+			line == changed_line ? "LINE" : "line", line));
+
+	cl_git_pass(git_blob_create_frombuffer(out, g_repo, buf.ptr, buf.size));
+	git_buf_free(&buf);
+}
+
+static void make_tree(git_oid *out, const git_oid *binary, const git_oid *text)
+{
+	git_treebuilder *builder;
+
+	cl_git_pass(git_treebuilder_create(&builder, NULL));
+	cl_git_pass(git_treebuilder_insert(
+		NULL, builder, "asset.bin", binary, GIT_FILEMODE_BLOB));
+	cl_git_pass(git_treebuilder_insert(
+		NULL, builder, "notes.txt", text, GIT_FILEMODE_BLOB));
+	cl_git_pass(git_treebuilder_write(out, g_repo, builder));
+	git_treebuilder_free(builder);
+}
+
+void test_diff_sniff__initialize(void)
+{
+	git_oid new_binary, old_text;
+
+	g_repo = cl_git_sandbox_init("empty_standard_repo");
+
+	make_binary(&g_old_binary, 1);
+	make_binary(&new_binary, 2);
+	make_text(&old_text, -1);
+	make_text(&g_new_text, 1000);
+
+	make_tree(&g_old_tree, &g_old_binary, &old_text);
+	make_tree(&g_new_tree, &new_binary, &g_new_text);
+}
+
+void test_diff_sniff__cleanup(void)
+{
+	cl_git_sandbox_cleanup();
+}
+
+/* Diff the two trees, checking which files are binary */
+static void assert_diff(bool text_is_binary)
+{
+	git_tree *old_tree, *new_tree;
+	git_diff *diff;
+	git_patch *patch;
+	const git_diff_delta *delta;
+
+	cl_git_pass(git_tree_lookup(&old_tree, g_repo, &g_old_tree));
+	cl_git_pass(git_tree_lookup(&new_tree, g_repo, &g_new_tree));
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, old_tree, new_tree, NULL));
+	cl_assert_equal_i(2, git_diff_num_deltas(diff));
+
+	cl_git_pass(git_patch_from_diff(&patch, diff, 0));
+	delta = git_patch_get_delta(patch);
+	cl_assert_equal_s("asset.bin", delta->new_file.path);
+	cl_assert((delta->flags & GIT_DIFF_FLAG_BINARY) != 0);
+	cl_assert_equal_i(BLOB_SIZE, delta->old_file.size);
+	cl_assert_equal_i(BLOB_SIZE, delta->new_file.size);
+	cl_assert_equal_i(0, git_patch_num_hunks(patch));
+	git_patch_free(patch);
+
+	cl_git_pass(git_patch_from_diff(&patch, diff, 1));
+	delta = git_patch_get_delta(patch);
+	cl_assert_equal_s("notes.txt", delta->new_file.path);
+	if (text_is_binary) {
+		cl_assert((delta->flags & GIT_DIFF_FLAG_BINARY) != 0);
+		cl_assert_equal_i(0, git_patch_num_hunks(patch));
+	} else {
+		cl_assert((delta->flags & GIT_DIFF_FLAG_NOT_BINARY) != 0);
+		cl_assert_equal_i(1, git_patch_num_hunks(patch));
+	}
+	git_patch_free(patch);
+
+	git_diff_free(diff);
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+}
+
+static void truncate_loose_object(const git_oid *id)
+{
+	git_buf path = GIT_BUF_INIT, contents = GIT_BUF_INIT;
+	char hex[GIT_OID_HEXSZ + 1];
+
+	git_oid_tostr(hex, sizeof(hex), id);
+	cl_git_pass(git_buf_printf(&path, "%sobjects/%.2s/%s",
+		git_repository_path(g_repo), hex, hex + 2));
+
+	cl_git_pass(git_futils_readbuffer(&contents, path.ptr));
+	git_buf_truncate(&contents, contents.size / 2);
+
+	cl_must_pass(p_chmod(path.ptr, 0644));
+	cl_git_pass(git_futils_writebuffer(&contents, path.ptr, 0, 0));
+
+	git_buf_free(&contents);
+	git_buf_free(&path);
+}
+
+void test_diff_sniff__binary_blobs_are_not_loaded(void)
+{
+	git_blob *blob;
+
+	/* only the start of the blob is left to read */
+	truncate_loose_object(&g_old_binary);
+	cl_git_fail(git_blob_lookup(&blob, g_repo, &g_old_binary));
+
+	assert_diff(false);
+}
+
+void test_diff_sniff__gives_the_same_result(void)
+{
+	cl_git_pass(git_repository_set_binary_cache(g_repo, 100));
+	cl_assert_equal_i(0, git_binarycache_size(g_repo->binarycache));
+
+	/* a cold cache is filled, and a warm one used */
+	assert_diff(false);
+	cl_assert_equal_i(4, git_binarycache_size(g_repo->binarycache));
+
+	assert_diff(false);
+	cl_assert_equal_i(4, git_binarycache_size(g_repo->binarycache));
+
+	cl_git_pass(git_repository_set_binary_cache(g_repo, 0));
+	cl_assert(g_repo->binarycache == NULL);
+}
+
+void test_diff_sniff__is_trusted(void)
+{
+	cl_git_pass(git_repository_set_binary_cache(g_repo, 100));
+	cl_git_pass(git_binarycache_put(g_repo->binarycache, &g_new_text, 1));
+
+	assert_diff(true);
+
+	/* a full cache is emptied */
+	cl_git_pass(git_repository_set_binary_cache(g_repo, 1));
+	assert_diff(false);
+	cl_assert_equal_i(1, git_binarycache_size(g_repo->binarycache));
+}
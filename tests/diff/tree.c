@@ -1,5 +1,8 @@
 #include "clar_libgit2.h"
 #include "diff_helpers.h"
+#include "diff.h"
+#include "iterator.h"
+#include "fileops.h"
 
 static git_repository *g_repo = NULL;
 static git_diff_options opts;
@@ -524,3 +527,152 @@ void test_diff_tree__diff_configs(void)
 	cl_assert_equal_i(7, expect.line_adds);
 	cl_assert_equal_i(15, expect.line_dels);
 }
+
+/* Diff two trees with iterators which expand every subtree */
+static git_diff *diff_expanding_all_trees(git_tree *old_tree, git_tree *new_tree)
+{
+	git_iterator *old_iter, *new_iter;
+	git_diff *expected;
+
+	cl_git_pass(git_iterator_for_tree(
+		&old_iter, old_tree, GIT_ITERATOR_DONT_IGNORE_CASE, NULL, NULL));
+	cl_git_pass(git_iterator_for_tree(
+		&new_iter, new_tree, GIT_ITERATOR_DONT_IGNORE_CASE, NULL, NULL));
+
+	cl_git_pass(git_diff__from_iterators(
+		&expected, g_repo, old_iter, new_iter, &opts));
+
+	git_iterator_free(old_iter);
+	git_iterator_free(new_iter);
+
+	return expected;
+}
+
+static void assert_same_deltas(git_diff *expected, git_diff *actual)
+{
+	const git_diff_delta *e, *a;
+	size_t i;
+
+	cl_assert_equal_i(git_diff_num_deltas(expected), git_diff_num_deltas(actual));
+
+	for (i = 0; i < git_diff_num_deltas(expected); ++i) {
+		e = git_diff_get_delta(expected, i);
+		a = git_diff_get_delta(actual, i);
+
+		cl_assert_equal_i(e->status, a->status);
+		cl_assert_equal_s(e->old_file.path, a->old_file.path);
+		cl_assert_equal_s(e->new_file.path, a->new_file.path);
+		cl_assert_equal_i(e->old_file.mode, a->old_file.mode);
+		cl_assert_equal_i(e->new_file.mode, a->new_file.mode);
+		cl_assert(git_oid_equal(&e->old_file.id, &a->old_file.id));
+		cl_assert(git_oid_equal(&e->new_file.id, &a->new_file.id));
+	}
+}
+
+void test_diff_tree__skipping_same_subtrees_gives_the_same_result(void)
+{
+	uint32_t flags[] = {
+		0,
+		GIT_DIFF_INCLUDE_UNMODIFIED,
+		GIT_DIFF_INCLUDE_TYPECHANGE,
+		GIT_DIFF_INCLUDE_TYPECHANGE | GIT_DIFF_INCLUDE_TYPECHANGE_TREES,
+	};
+	char *pathspec = "d*";
+	git_tree *trees[16];
+	git_revwalk *walk;
+	git_oid id;
+	git_commit *commit;
+	git_diff *expected;
+	size_t count = 0, i, j, f, p;
+
+	g_repo = cl_git_sandbox_init("typechanges");
+
+	cl_git_pass(git_revwalk_new(&walk, g_repo));
+	cl_git_pass(git_revwalk_push_head(walk));
+
+	while (count < ARRAY_SIZE(trees) && !git_revwalk_next(&id, walk)) {
+		cl_git_pass(git_commit_lookup(&commit, g_repo, &id));
+		cl_git_pass(git_commit_tree(&trees[count++], commit));
+		git_commit_free(commit);
+	}
+	git_revwalk_free(walk);
+
+	cl_assert(count > 2);
+
+	for (p = 0; p < 2; ++p) {
+		opts.pathspec.strings = &pathspec;
+		opts.pathspec.count = p;
+
+		for (f = 0; f < ARRAY_SIZE(flags); ++f) {
+			opts.flags = flags[f];
+
+			for (i = 0; i < count; ++i) {
+				for (j = 0; j < count; ++j) {
+					expected = diff_expanding_all_trees(trees[i], trees[j]);
+					cl_git_pass(git_diff_tree_to_tree(
+						&diff, g_repo, trees[i], trees[j], &opts));
+
+					assert_same_deltas(expected, diff);
+
+					git_diff_free(expected);
+					git_diff_free(diff);
+					diff = NULL;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < count; ++i)
+		git_tree_free(trees[i]);
+}
+
+void test_diff_tree__does_not_read_same_subtrees(void)
+{
+	git_treebuilder *builder;
+	git_oid blob_a, blob_b, subtree, tree_id;
+	git_buf path = GIT_BUF_INIT;
+	char *hex;
+
+	g_repo = cl_git_sandbox_init("attr");
+
+	cl_git_pass(git_blob_create_frombuffer(&blob_a, g_repo, "a\n", 2));
+	cl_git_pass(git_blob_create_frombuffer(&blob_b, g_repo, "b\n", 2));
+
+	/* a subtree which is in both trees */
+	cl_git_pass(git_treebuilder_create(&builder, NULL));
+	cl_git_pass(git_treebuilder_insert(
+		NULL, builder, "file", &blob_a, GIT_FILEMODE_BLOB));
+	cl_git_pass(git_treebuilder_write(&subtree, g_repo, builder));
+	git_treebuilder_free(builder);
+
+	cl_git_pass(git_treebuilder_create(&builder, NULL));
+	cl_git_pass(git_treebuilder_insert(
+		NULL, builder, "sub", &subtree, GIT_FILEMODE_TREE));
+	cl_git_pass(git_treebuilder_insert(
+		NULL, builder, "top", &blob_a, GIT_FILEMODE_BLOB));
+	cl_git_pass(git_treebuilder_write(&tree_id, g_repo, builder));
+	cl_git_pass(git_tree_lookup(&a, g_repo, &tree_id));
+
+	cl_git_pass(git_treebuilder_insert(
+		NULL, builder, "top", &blob_b, GIT_FILEMODE_BLOB));
+	cl_git_pass(git_treebuilder_write(&tree_id, g_repo, builder));
+	cl_git_pass(git_tree_lookup(&b, g_repo, &tree_id));
+	git_treebuilder_free(builder);
+
+	/* take the subtree out of the repository */
+	hex = git_oid_allocfmt(&subtree);
+	cl_git_pass(git_buf_printf(&path, "attr/.git/objects/%.2s/%s", hex, hex + 2));
+	cl_git_pass(p_unlink(path.ptr));
+	git__free(hex);
+	git_buf_free(&path);
+
+	cl_git_pass(git_diff_tree_to_tree(&diff, g_repo, a, b, NULL));
+	cl_assert_equal_i(1, git_diff_num_deltas(diff));
+	cl_assert_equal_s("top", git_diff_get_delta(diff, 0)->new_file.path);
+	git_diff_free(diff);
+	diff = NULL;
+
+	/* listing unmodified files has to read the subtree */
+	opts.flags = GIT_DIFF_INCLUDE_UNMODIFIED;
+	cl_git_fail(git_diff_tree_to_tree(&diff, g_repo, a, b, &opts));
+}
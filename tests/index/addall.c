@@ -2,8 +2,11 @@
 #include "../status/status_helpers.h"
 #include "posix.h"
 #include "fileops.h"
+#include "index.h"
+#include "git2/sys/filter.h"
 
 static git_repository *g_repo = NULL;
+static git_filter *g_filter = NULL;
 #define TEST_DIR "addall"
 
 void test_index_addall__initialize(void)
@@ -12,6 +15,13 @@ void test_index_addall__initialize(void)
 
 void test_index_addall__cleanup(void)
 {
+	git_index__preload_per_thread = 500;
+
+	if (g_filter) {
+		cl_git_pass(git_filter_unregister("count"));
+		g_filter = NULL;
+	}
+
 	git_repository_free(g_repo);
 	g_repo = NULL;
 
@@ -354,3 +364,125 @@ void test_index_addall__callback_filtering(void)
 
 	git_index_free(index);
 }
+
+static void check_blob_id(
+	git_index *index, const char *path, const char *content)
+{
+	const git_index_entry *entry;
+	git_oid expected;
+
+	cl_assert((entry = git_index_get_bypath(index, path, 0)) != NULL);
+	cl_git_pass(git_odb_hash(
+		&expected, content, strlen(content), GIT_OBJ_BLOB));
+	cl_assert(git_oid_equal(&expected, &entry->id));
+}
+
+void test_index_addall__preloads_many_files(void)
+{
+	git_index *index;
+	git_buf path = GIT_BUF_INIT;
+	int i;
+
+	/* hash on as many threads as possible, if threads are available */
+	git_index__preload_per_thread = 1;
+
+	cl_git_pass(git_repository_init(&g_repo, TEST_DIR, false));
+	cl_git_mkfile(TEST_DIR "/.gitattributes", "*.txt text\n");
+
+	for (i = 0; i < 100; ++i) {
+		cl_git_pass(git_buf_printf(&path, TEST_DIR "/%s%d.txt",
+			(i % 3) ? "dir/file" : "file", i));
+		if (i == 1)
+			cl_git_pass(git_futils_mkpath2file(path.ptr, 0777));
+		cl_git_mkfile(path.ptr, "crlf\r\ncontent\r\n");
+		git_buf_clear(&path);
+	}
+
+	cl_git_pass(git_repository_index(&index, g_repo));
+	cl_git_pass(git_index_add_all(index, NULL, 0, NULL, NULL));
+	cl_assert_equal_i(101, (int)git_index_entrycount(index));
+	check_status(g_repo, 101, 0, 0, 0, 0, 0, 0);
+
+	/* the files were filtered before hashing */
+	check_blob_id(index, "file0.txt", "crlf\ncontent\n");
+	check_blob_id(index, "dir/file1.txt", "crlf\ncontent\n");
+
+	cl_git_rewritefile(TEST_DIR "/file3.txt", "changed\r\n");
+	cl_git_rewritefile(TEST_DIR "/dir/file98.txt", "changed too\r\n");
+	cl_must_pass(p_unlink(TEST_DIR "/dir/file2.txt"));
+	check_status(g_repo, 101, 0, 0, 0, 1, 2, 0);
+
+	cl_git_pass(git_index_update_all(index, NULL, NULL, NULL));
+	cl_assert_equal_i(100, (int)git_index_entrycount(index));
+	check_status(g_repo, 100, 0, 0, 0, 0, 0, 0);
+
+	check_blob_id(index, "file3.txt", "changed\n");
+	check_blob_id(index, "dir/file98.txt", "changed too\n");
+	check_stat_data(index, TEST_DIR "/dir/file98.txt", true);
+
+	git_buf_free(&path);
+	git_index_free(index);
+}
+
+static git_filter count_filter;
+static git_atomic filter_applied;
+
+static int count_filter_apply(
+	git_filter *self,
+	void **payload,
+	git_buf *to,
+	const git_buf *from,
+	const git_filter_source *src)
+{
+	GIT_UNUSED(self); GIT_UNUSED(payload); GIT_UNUSED(to);
+	GIT_UNUSED(from); GIT_UNUSED(src);
+
+	git_atomic_inc(&filter_applied);
+	return GIT_PASSTHROUGH;
+}
+
+void test_index_addall__preload_reads_files_once(void)
+{
+	git_index *index;
+	git_buf path = GIT_BUF_INIT, content = GIT_BUF_INIT;
+	int i;
+
+	git_index__preload_per_thread = 1;
+
+	memset(&count_filter, 0, sizeof(count_filter));
+	count_filter.version = GIT_FILTER_VERSION;
+	count_filter.attributes = "+count";
+	count_filter.apply = count_filter_apply;
+	cl_git_pass(git_filter_register("count", &count_filter, 0));
+	g_filter = &count_filter;
+	git_atomic_set(&filter_applied, 0);
+
+	cl_git_pass(git_repository_init(&g_repo, TEST_DIR, false));
+	cl_git_mkfile(TEST_DIR "/.gitattributes", "*.txt count\n");
+
+	for (i = 0; i < 100; ++i) {
+		cl_git_pass(git_buf_printf(&path, TEST_DIR "/file%d.txt", i));
+		cl_git_pass(git_buf_printf(&content, "content %d\n", i));
+		cl_git_mkfile(path.ptr, content.ptr);
+		git_buf_clear(&path);
+		git_buf_clear(&content);
+	}
+
+	/* the blobs of new files are written as they are filtered, rather
+	 * than filtered (and hashed) a second time to write them */
+	cl_git_pass(git_repository_index(&index, g_repo));
+	cl_git_pass(git_index_add_all(index, NULL, 0, NULL, NULL));
+	cl_assert_equal_i(101, (int)git_index_entrycount(index));
+	cl_assert_equal_i(100, git_atomic_get(&filter_applied));
+
+	cl_git_rewritefile(TEST_DIR "/file3.txt", "changed\n");
+	cl_git_rewritefile(TEST_DIR "/file98.txt", "changed too\n");
+
+	cl_git_pass(git_index_update_all(index, NULL, NULL, NULL));
+	check_blob_id(index, "file3.txt", "changed\n");
+	check_status(g_repo, 101, 0, 0, 0, 0, 0, 0);
+
+	git_buf_free(&path);
+	git_buf_free(&content);
+	git_index_free(index);
+}
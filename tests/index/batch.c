@@ -0,0 +1,183 @@
+#include "clar_libgit2.h"
+#include "index.h"
+#include "git2/repository.h"
+#include "git2/sys/index.h"
+
+static git_repository *repo;
+static git_index *repo_index;
+
+#define TEST_OID "f00ff00ff00ff00ff00ff00ff00ff00ff00ff00f"
+#define TEST_OTHER_OID "b44bb44bb44bb44bb44bb44bb44bb44bb44bb44b"
+
+#define CONFLICTS_ONE_ANCESTOR_OID "1f85ca51b8e0aac893a621b61a9c2661d6aa6d81"
+
+void test_index_batch__initialize(void)
+{
+	repo = cl_git_sandbox_init("mergedrepo");
+	cl_git_pass(git_repository_index(&repo_index, repo));
+}
+
+void test_index_batch__cleanup(void)
+{
+	git_index_free(repo_index);
+	repo_index = NULL;
+
+	cl_git_sandbox_cleanup();
+}
+
+static void batch_add(
+	git_index_batch *batch, const char *path, int stage, const char *oid)
+{
+	git_index_entry entry;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.path = path;
+	entry.mode = GIT_FILEMODE_BLOB;
+	GIT_IDXENTRY_STAGE_SET(&entry, stage);
+	cl_git_pass(git_oid_fromstr(&entry.id, oid));
+
+	cl_git_pass(git_index_batch_add(batch, &entry));
+}
+
+static void assert_entry(git_index *index, const char *path, const char *oid)
+{
+	const git_index_entry *entry;
+	git_oid expected;
+
+	cl_assert((entry = git_index_get_bypath(index, path, 0)) != NULL);
+	cl_git_pass(git_oid_fromstr(&expected, oid));
+	cl_assert(git_oid_equal(&expected, &entry->id));
+}
+
+void test_index_batch__adds_many_entries(void)
+{
+	git_index *index;
+	git_index_batch *batch;
+	char path[64];
+	int i;
+
+	cl_git_pass(git_index_new(&index));
+	cl_git_pass(git_index_batch_new(&batch, index));
+
+	/* add in reverse order, each path twice */
+	for (i = 9999; i >= 0; --i) {
+		p_snprintf(path, sizeof(path), "dir%d/file%d", i % 10, i);
+		batch_add(batch, path, 0, TEST_OID);
+		batch_add(batch, path, 0, TEST_OTHER_OID);
+	}
+
+	/* nothing shows up before the commit */
+	cl_assert_equal_i(0, (int)git_index_entrycount(index));
+
+	cl_git_pass(git_index_batch_commit(batch));
+	cl_assert_equal_i(10000, (int)git_index_entrycount(index));
+
+	for (i = 1; i < 10000; ++i) {
+		const git_index_entry *prev = git_index_get_byindex(index, i - 1);
+		const git_index_entry *cur = git_index_get_byindex(index, i);
+		cl_assert(strcmp(prev->path, cur->path) < 0);
+	}
+
+	/* the last change to a path wins */
+	assert_entry(index, "dir7/file1337", TEST_OTHER_OID);
+
+	/* the batch is empty after a commit */
+	cl_git_pass(git_index_batch_commit(batch));
+	cl_assert_equal_i(10000, (int)git_index_entrycount(index));
+
+	git_index_batch_free(batch);
+	git_index_free(index);
+}
+
+void test_index_batch__updates_and_removes_entries(void)
+{
+	git_index_batch *batch;
+	size_t count = git_index_entrycount(repo_index);
+	const git_index_entry *before;
+
+	cl_assert((before = git_index_get_bypath(repo_index, "one.txt", 0)) != NULL);
+
+	cl_git_pass(git_index_batch_new(&batch, repo_index));
+	batch_add(batch, "one.txt", 0, TEST_OID);
+	batch_add(batch, "new.txt", 0, TEST_OID);
+	cl_git_pass(git_index_batch_remove(batch, "two.txt", 0));
+	cl_git_pass(git_index_batch_remove(batch, "does-not-exist.txt", 0));
+	cl_git_pass(git_index_batch_commit(batch));
+	git_index_batch_free(batch);
+
+	cl_assert_equal_i(count, git_index_entrycount(repo_index));
+
+	/* updated entries are updated in place */
+	cl_assert(before == git_index_get_bypath(repo_index, "one.txt", 0));
+	assert_entry(repo_index, "one.txt", TEST_OID);
+	assert_entry(repo_index, "new.txt", TEST_OID);
+	cl_assert(git_index_get_bypath(repo_index, "two.txt", 0) == NULL);
+}
+
+void test_index_batch__replaces_colliding_entries(void)
+{
+	git_index_batch *batch;
+
+	cl_git_pass(git_index_batch_new(&batch, repo_index));
+	batch_add(batch, "a", 0, TEST_OID);
+	batch_add(batch, "b/c", 0, TEST_OID);
+	batch_add(batch, "b-c", 0, TEST_OID);
+	cl_git_pass(git_index_batch_commit(batch));
+
+	/* files replace directories and directories replace files */
+	batch_add(batch, "a/b", 0, TEST_OTHER_OID);
+	batch_add(batch, "b", 0, TEST_OTHER_OID);
+	cl_git_pass(git_index_batch_commit(batch));
+	git_index_batch_free(batch);
+
+	cl_assert(git_index_get_bypath(repo_index, "a", 0) == NULL);
+	cl_assert(git_index_get_bypath(repo_index, "b/c", 0) == NULL);
+	assert_entry(repo_index, "a/b", TEST_OTHER_OID);
+	assert_entry(repo_index, "b", TEST_OTHER_OID);
+	assert_entry(repo_index, "b-c", TEST_OID);
+}
+
+void test_index_batch__fails_on_collisions_within_the_batch(void)
+{
+	git_index_batch *batch;
+	size_t count = git_index_entrycount(repo_index);
+
+	cl_git_pass(git_index_batch_new(&batch, repo_index));
+	batch_add(batch, "new.txt", 0, TEST_OID);
+	batch_add(batch, "a", 0, TEST_OID);
+	batch_add(batch, "a-b", 0, TEST_OID);
+	batch_add(batch, "a/b", 0, TEST_OID);
+	cl_git_fail(git_index_batch_commit(batch));
+	git_index_batch_free(batch);
+
+	/* nothing is changed */
+	cl_assert_equal_i(count, git_index_entrycount(repo_index));
+	cl_assert(git_index_get_bypath(repo_index, "new.txt", 0) == NULL);
+}
+
+void test_index_batch__bypath_resolves_conflicts(void)
+{
+	git_index_batch *batch;
+	const git_index_reuc_entry *reuc;
+	git_oid oid;
+
+	cl_assert(git_index_has_conflicts(repo_index));
+	cl_assert_equal_i(2, (int)git_index_reuc_entrycount(repo_index));
+	cl_assert(!git_index_reuc_get_bypath(repo_index, "conflicts-one.txt"));
+
+	cl_git_pass(git_index_batch_new(&batch, repo_index));
+	cl_git_pass(git_index_batch_add_bypath(batch, "conflicts-one.txt"));
+	cl_git_pass(git_index_batch_remove_bypath(batch, "conflicts-two.txt"));
+	cl_git_pass(git_index_batch_commit(batch));
+	git_index_batch_free(batch);
+
+	cl_assert(!git_index_has_conflicts(repo_index));
+	cl_assert_equal_i(4, (int)git_index_reuc_entrycount(repo_index));
+	cl_assert(git_index_reuc_get_bypath(repo_index, "conflicts-two.txt"));
+	cl_assert(reuc = git_index_reuc_get_bypath(repo_index, "conflicts-one.txt"));
+	git_oid_fromstr(&oid, CONFLICTS_ONE_ANCESTOR_OID);
+	cl_assert(git_oid_equal(&oid, &reuc->oid[0]));
+
+	cl_assert(git_index_get_bypath(repo_index, "conflicts-one.txt", 0));
+	cl_assert(!git_index_get_bypath(repo_index, "conflicts-two.txt", 0));
+}
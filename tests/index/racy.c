@@ -0,0 +1,122 @@
+#include "clar_libgit2.h"
+#include "fileops.h"
+#include "index.h"
+#include "git2/diff.h"
+
+#ifdef GIT_WIN32
+# include <sys/utime.h>
+#else
+# include <utime.h>
+#endif
+
+static git_repository *g_repo;
+static git_index *g_index;
+
+#define RACY_TIME 1234567890
+
+void test_index_racy__initialize(void)
+{
+	g_repo = cl_git_sandbox_init("testrepo");
+	cl_repo_set_bool(g_repo, "core.trustctime", false);
+	cl_git_pass(git_repository_index(&g_index, g_repo));
+}
+
+void test_index_racy__cleanup(void)
+{
+	git_index_free(g_index);
+	g_index = NULL;
+
+	cl_git_sandbox_cleanup();
+}
+
+static void set_mtime(const char *path, time_t when)
+{
+	struct utimbuf times;
+
+	times.actime = when;
+	times.modtime = when;
+	cl_must_pass(utime(path, &times));
+}
+
+/* add a file to the index, then rewrite it with contents of the same size
+ * and the same timestamp, leaving its stat data unchanged */
+static void add_then_rewrite_in_place(void)
+{
+	cl_git_mkfile("testrepo/racy", "original\n");
+	set_mtime("testrepo/racy", RACY_TIME);
+	cl_git_pass(git_index_add_bypath(g_index, "racy"));
+
+	cl_git_rewritefile("testrepo/racy", "modified\n");
+	set_mtime("testrepo/racy", RACY_TIME);
+}
+
+/* pretend that the index was last written at `when` */
+static void set_index_stamp(time_t when)
+{
+	g_index->stamp.mtime = when;
+	g_index->stamp.mtime_nsec = 0;
+}
+
+static size_t count_racy_file_changes(void)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_diff *diff;
+	char *paths[] = { "racy" };
+	size_t count;
+
+	opts.pathspec.strings = paths;
+	opts.pathspec.count = 1;
+
+	cl_git_pass(git_diff_index_to_workdir(&diff, g_repo, g_index, &opts));
+	count = git_diff_num_deltas(diff);
+	git_diff_free(diff);
+
+	return count;
+}
+
+void test_index_racy__stat_data_is_trusted_for_older_entries(void)
+{
+	add_then_rewrite_in_place();
+	set_index_stamp(RACY_TIME + 1);
+
+	/* identical stat data hides the change */
+	cl_assert(!git_index__entry_is_racy(
+		g_index, git_index_get_bypath(g_index, "racy", 0)));
+	cl_assert_equal_i(0, count_racy_file_changes());
+}
+
+void test_index_racy__racy_entries_are_checked(void)
+{
+	add_then_rewrite_in_place();
+	set_index_stamp(RACY_TIME);
+
+	cl_assert(git_index__entry_is_racy(
+		g_index, git_index_get_bypath(g_index, "racy", 0)));
+	cl_assert_equal_i(1, count_racy_file_changes());
+}
+
+void test_index_racy__write_smudges_modified_racy_entries(void)
+{
+	const git_index_entry *entry;
+
+	cl_git_mkfile("testrepo/clean", "unchanged\n");
+	set_mtime("testrepo/clean", RACY_TIME);
+	cl_git_pass(git_index_add_bypath(g_index, "clean"));
+
+	add_then_rewrite_in_place();
+	set_index_stamp(RACY_TIME);
+
+	cl_git_pass(git_index_write(g_index));
+	cl_git_pass(git_index_read(g_index, true));
+
+	/* the index is now newer than the entries, but the modified one can
+	 * no longer be mistaken for being unchanged */
+	cl_assert(g_index->stamp.mtime > RACY_TIME);
+
+	cl_assert((entry = git_index_get_bypath(g_index, "racy", 0)) != NULL);
+	cl_assert_equal_i(0, entry->file_size);
+	cl_assert((entry = git_index_get_bypath(g_index, "clean", 0)) != NULL);
+	cl_assert_equal_i(strlen("unchanged\n"), entry->file_size);
+
+	cl_assert_equal_i(1, count_racy_file_changes());
+}
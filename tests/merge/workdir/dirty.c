@@ -5,6 +5,12 @@
 #include "../merge_helpers.h"
 #include "posix.h"
 
+#ifdef GIT_WIN32
+# include <sys/utime.h>
+#else
+# include <utime.h>
+#endif
+
 #define TEST_REPO_PATH "merge-resolve"
 #define MERGE_BRANCH_OID "7cb63eed597130ba4abb87b3e544b85021905520"
 
@@ -130,6 +136,7 @@ static void hack_index(char *files[])
 {
 	char *filename;
 	struct stat statbuf;
+	struct utimbuf times;
 	git_buf path = GIT_BUF_INIT;
 	git_index_entry *entry;
 	size_t i;
@@ -137,6 +144,9 @@ static void hack_index(char *files[])
 	/* Update the index to suggest that checkout placed these files on
 	 * disk, keeping the object id but updating the cache, which will
 	 * emulate a Git implementation's different filter.
+	 *
+	 * The files are moved back in time first, so that they are not
+	 * racily clean once the index is written.
 	 */
 	for (i = 0, filename = files[i]; filename; filename = files[++i]) {
 		git_buf_clear(&path);
@@ -147,10 +157,19 @@ static void hack_index(char *files[])
 		cl_git_pass(git_buf_printf(&path, "%s/%s", TEST_REPO_PATH, filename));
 		cl_git_pass(p_stat(path.ptr, &statbuf));
 
+		times.actime = times.modtime = statbuf.st_mtime - 5;
+		cl_must_pass(utime(path.ptr, &times));
+		cl_git_pass(p_stat(path.ptr, &statbuf));
+
 		entry->ctime.seconds = (git_time_t)statbuf.st_ctime;
-		entry->ctime.nanoseconds = 0;
 		entry->mtime.seconds = (git_time_t)statbuf.st_mtime;
+#if defined(GIT_USE_NSEC)
+		entry->ctime.nanoseconds = statbuf.st_ctime_nsec;
+		entry->mtime.nanoseconds = statbuf.st_mtime_nsec;
+#else
+		entry->ctime.nanoseconds = 0;
 		entry->mtime.nanoseconds = 0;
+#endif
 		entry->dev = statbuf.st_dev;
 		entry->ino = statbuf.st_ino;
 		entry->uid  = statbuf.st_uid;
@@ -0,0 +1,70 @@
+#include "clar_libgit2.h"
+#include "transports/smart.h"
+#include "remote.h"
+
+void test_network_shallow__parse_shallow_lines(void)
+{
+	const char *line = "0035shallow be3563ae3f795b2b4353bcce3a527ad0a4f7f644\n";
+	const char *end;
+	git_pkt_shallow *pkt;
+	git_oid expected;
+
+	cl_git_pass(git_oid_fromstr(&expected, "be3563ae3f795b2b4353bcce3a527ad0a4f7f644"));
+
+	cl_git_pass(git_pkt_parse_line((git_pkt **)&pkt, line, &end, strlen(line)));
+	cl_assert_equal_i(GIT_PKT_SHALLOW, pkt->type);
+	cl_assert(git_oid_equal(&expected, &pkt->oid));
+	cl_assert(end == line + strlen(line));
+	git_pkt_free((git_pkt *)pkt);
+
+	line = "0037unshallow be3563ae3f795b2b4353bcce3a527ad0a4f7f644\n";
+	cl_git_pass(git_pkt_parse_line((git_pkt **)&pkt, line, &end, strlen(line)));
+	cl_assert_equal_i(GIT_PKT_UNSHALLOW, pkt->type);
+	cl_assert(git_oid_equal(&expected, &pkt->oid));
+	git_pkt_free((git_pkt *)pkt);
+
+	line = "0010shallow xyz\n";
+	cl_git_fail(git_pkt_parse_line((git_pkt **)&pkt, line, &end, strlen(line)));
+}
+
+void test_network_shallow__buffer_shallow_and_deepen(void)
+{
+	git_buf buf = GIT_BUF_INIT;
+	git_oid roots[2];
+
+	cl_git_pass(git_oid_fromstr(&roots[0], "9fd738e8f7967c078dceed8190330fc8648ee56a"));
+	cl_git_pass(git_oid_fromstr(&roots[1], "c47800c7266a2be04c571c04d5a6614691ea99bd"));
+
+	cl_git_pass(git_pkt_buffer_shallow(roots, 2, 1, &buf));
+	cl_assert_equal_s(
+		"0035shallow 9fd738e8f7967c078dceed8190330fc8648ee56a\n"
+		"0035shallow c47800c7266a2be04c571c04d5a6614691ea99bd\n"
+		"000ddeepen 1\n", git_buf_cstr(&buf));
+
+	git_buf_clear(&buf);
+	cl_git_pass(git_pkt_buffer_shallow(NULL, 0, 0, &buf));
+	cl_assert_equal_s("", git_buf_cstr(&buf));
+
+	git_buf_free(&buf);
+}
+
+void test_network_shallow__remote_depth(void)
+{
+	git_repository *repo;
+	git_remote *remote, *dup;
+
+	cl_git_pass(git_repository_open(&repo, cl_fixture("testrepo.git")));
+	cl_git_pass(git_remote_create_anonymous(
+		&remote, repo, "git://github.com/libgit2/libgit2", NULL));
+
+	cl_assert_equal_i(0, git_remote_fetch_depth(remote));
+	git_remote_set_fetch_depth(remote, 1);
+	cl_assert_equal_i(1, git_remote_fetch_depth(remote));
+
+	cl_git_pass(git_remote_dup(&dup, remote));
+	cl_assert_equal_i(1, git_remote_fetch_depth(dup));
+
+	git_remote_free(dup);
+	git_remote_free(remote);
+	git_repository_free(repo);
+}
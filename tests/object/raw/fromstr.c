@@ -2,6 +2,7 @@
 #include "clar_libgit2.h"
 
 #include "odb.h"
+#include "oid.h"
 
 void test_object_raw_fromstr__fail_on_invalid_oid_string(void)
 {
@@ -28,3 +29,25 @@ void test_object_raw_fromstr__succeed_on_valid_oid_string(void)
 	cl_git_pass(memcmp(out.id, exp, sizeof(out.id)));
 
 }
+
+void test_object_raw_fromstr__decode_full_ids(void)
+{
+	git_oid out, expected;
+	const char *valid = "16a67770b7d8d72317c4b775213c23a8bd74f5e0";
+	char invalid[GIT_OID_HEXSZ + 1];
+	size_t i;
+
+	cl_git_pass(git_oid_fromstr(&expected, valid));
+	cl_git_pass(git_oid__fromhex(&out, valid));
+	cl_assert(git_oid_equal(&expected, &out));
+
+	cl_git_pass(git_oid__fromhex(&out, "16A67770B7D8D72317C4b775213C23A8BD74F5E0"));
+	cl_assert(git_oid_equal(&expected, &out));
+
+	/* a bad digit is found at any position */
+	for (i = 0; i < GIT_OID_HEXSZ; ++i) {
+		memcpy(invalid, valid, sizeof(invalid));
+		invalid[i] = (i % 2) ? 'g' : '\xff';
+		cl_git_fail(git_oid__fromhex(&out, invalid));
+	}
+}
@@ -0,0 +1,78 @@
+#include "clar_libgit2.h"
+#include "git2/odb_backend.h"
+#include "buffer.h"
+
+static git_repository *repo;
+static git_odb *odb;
+
+void test_odb_streamread__initialize(void)
+{
+	repo = cl_git_sandbox_init("testrepo.git");
+	cl_git_pass(git_repository_odb(&odb, repo));
+}
+
+void test_odb_streamread__cleanup(void)
+{
+	git_odb_free(odb);
+	cl_git_sandbox_cleanup();
+}
+
+typedef struct {
+	size_t streamed, unsupported;
+} stream_counts;
+
+static int stream_object(const git_oid *oid, void *payload)
+{
+	stream_counts *counts = payload;
+	git_odb_stream *stream;
+	git_odb_object *obj;
+	git_buf contents = GIT_BUF_INIT;
+	char chunk[7];
+	int read;
+
+	cl_git_pass(git_odb_read(&obj, odb, oid));
+
+	if (git_odb_open_rstream(&stream, odb, oid) < 0) {
+		giterr_clear();
+		counts->unsupported++;
+		git_odb_object_free(obj);
+		return 0;
+	}
+
+	cl_assert_equal_sz(git_odb_object_size(obj), stream->declared_size);
+
+	/* read in small chunks, to cross the end of every buffer */
+	while ((read = git_odb_stream_read(stream, chunk, sizeof(chunk))) > 0)
+		cl_git_pass(git_buf_put(&contents, chunk, read));
+
+	cl_git_pass(read);
+	cl_assert_equal_sz(git_odb_object_size(obj), contents.size);
+	cl_assert(memcmp(git_odb_object_data(obj), contents.ptr, contents.size) == 0);
+
+	counts->streamed++;
+
+	git_buf_free(&contents);
+	git_odb_stream_free(stream);
+	git_odb_object_free(obj);
+	return 0;
+}
+
+void test_odb_streamread__reads_objects_in_chunks(void)
+{
+	stream_counts counts = { 0, 0 };
+
+	cl_git_pass(git_odb_foreach(odb, stream_object, &counts));
+
+	/* loose and packed objects are streamed, deltas are not */
+	cl_assert(counts.streamed > 47);
+	cl_assert(counts.unsupported > 0);
+}
+
+void test_odb_streamread__fails_for_missing_objects(void)
+{
+	git_odb_stream *stream;
+	git_oid oid;
+
+	cl_git_pass(git_oid_fromstr(&oid, "deadbeefdeadbeefdeadbeefdeadbeefdeadbeef"));
+	cl_git_fail(git_odb_open_rstream(&stream, odb, &oid));
+}
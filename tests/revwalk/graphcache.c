@@ -0,0 +1,141 @@
+#include "clar_libgit2.h"
+#include "repository.h"
+
+#define MAX_COMMITS 32
+
+static git_repository *_repo;
+
+void test_revwalk_graphcache__initialize(void)
+{
+	cl_git_pass(git_repository_open(&_repo, cl_fixture("testrepo.git")));
+}
+
+void test_revwalk_graphcache__cleanup(void)
+{
+	git_repository_free(_repo);
+	_repo = NULL;
+}
+
+static size_t walk_heads(git_oid *out)
+{
+	git_revwalk *walk;
+	size_t count = 0;
+	int error;
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME);
+	cl_git_pass(git_revwalk_push_glob(walk, "heads"));
+
+	while ((error = git_revwalk_next(&out[count], walk)) == 0)
+		cl_assert(++count < MAX_COMMITS);
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	git_revwalk_free(walk);
+
+	return count;
+}
+
+static void assert_same_walk(
+	const git_oid *expected, size_t expected_count,
+	const git_oid *actual, size_t actual_count)
+{
+	size_t i;
+
+	cl_assert_equal_i(expected_count, actual_count);
+
+	for (i = 0; i < actual_count; ++i)
+		cl_assert(git_oid_equal(&expected[i], &actual[i]));
+}
+
+void test_revwalk_graphcache__walks_are_the_same(void)
+{
+	git_oid expected[MAX_COMMITS], actual[MAX_COMMITS];
+	size_t expected_count, actual_count;
+
+	expected_count = walk_heads(expected);
+
+	cl_git_pass(git_repository_set_graph_cache(_repo, 100));
+	cl_assert_equal_i(0, git_graphcache_size(_repo->graphcache));
+
+	/* a cold walk fills the cache, and a warm one uses it */
+	actual_count = walk_heads(actual);
+	assert_same_walk(expected, expected_count, actual, actual_count);
+	cl_assert_equal_i(expected_count, git_graphcache_size(_repo->graphcache));
+
+	actual_count = walk_heads(actual);
+	assert_same_walk(expected, expected_count, actual, actual_count);
+}
+
+void test_revwalk_graphcache__commits_come_from_the_cache(void)
+{
+	git_revwalk *walk;
+	git_oid master, oid;
+
+	cl_git_pass(git_repository_set_graph_cache(_repo, 100));
+
+	/* pretend the tip of master is a root commit */
+	cl_git_pass(git_oid_fromstr(&master, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750"));
+	cl_git_pass(git_graphcache_put(
+		_repo->graphcache, &master, 1312943626, 0, NULL, 0));
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	cl_git_pass(git_revwalk_push(walk, &master));
+
+	cl_git_pass(git_revwalk_next(&oid, walk));
+	cl_assert(git_oid_equal(&master, &oid));
+	cl_assert_equal_i(GIT_ITEROVER, git_revwalk_next(&oid, walk));
+
+	git_revwalk_free(walk);
+}
+
+void test_revwalk_graphcache__full_cache_is_emptied(void)
+{
+	git_oid expected[MAX_COMMITS], actual[MAX_COMMITS];
+	size_t expected_count, actual_count;
+
+	expected_count = walk_heads(expected);
+
+	cl_git_pass(git_repository_set_graph_cache(_repo, 4));
+
+	actual_count = walk_heads(actual);
+	assert_same_walk(expected, expected_count, actual, actual_count);
+	cl_assert(git_graphcache_size(_repo->graphcache) <= 4);
+
+	actual_count = walk_heads(actual);
+	assert_same_walk(expected, expected_count, actual, actual_count);
+}
+
+void test_revwalk_graphcache__merge_base_and_descendant_of(void)
+{
+	git_oid one, two, expected, result;
+	int round;
+
+	cl_git_pass(git_oid_fromstr(&one, "763d71aadf09a7951596c9746c024e7eece7c7af"));
+	cl_git_pass(git_oid_fromstr(&two, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750"));
+	cl_git_pass(git_oid_fromstr(&expected, "c47800c7266a2be04c571c04d5a6614691ea99bd"));
+
+	cl_git_pass(git_repository_set_graph_cache(_repo, 100));
+
+	for (round = 0; round < 2; ++round) {
+		cl_git_pass(git_merge_base(&result, _repo, &one, &two));
+		cl_assert(git_oid_equal(&expected, &result));
+
+		cl_assert_equal_i(1, git_graph_descendant_of(_repo, &two, &expected));
+		cl_assert_equal_i(0, git_graph_descendant_of(_repo, &one, &two));
+	}
+
+	cl_assert(git_graphcache_size(_repo->graphcache) > 0);
+}
+
+void test_revwalk_graphcache__can_be_disabled(void)
+{
+	git_oid ids[MAX_COMMITS];
+
+	cl_git_pass(git_repository_set_graph_cache(_repo, 100));
+	walk_heads(ids);
+	cl_assert(_repo->graphcache != NULL);
+
+	cl_git_pass(git_repository_set_graph_cache(_repo, 0));
+	cl_assert(_repo->graphcache == NULL);
+	walk_heads(ids);
+}
@@ -0,0 +1,216 @@
+#include "clar_libgit2.h"
+#include "bloom.h"
+#include "revwalk.h"
+
+#define MAX_COMMITS 32
+
+static git_repository *_repo;
+static git_revwalk *_walk;
+
+void test_revwalk_incremental__initialize(void)
+{
+	_repo = cl_git_sandbox_init("testrepo.git");
+	cl_git_pass(git_revwalk_new(&_walk, _repo));
+}
+
+void test_revwalk_incremental__cleanup(void)
+{
+	git_revwalk_free(_walk);
+	_walk = NULL;
+
+	cl_git_sandbox_cleanup();
+}
+
+/* use a walker of its own, so that _walk hasn't parsed any commits */
+static void write_generations_for(const char *glob)
+{
+	git_revwalk *walk;
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	cl_git_pass(git_revwalk_push_glob(walk, glob));
+	cl_git_pass(git_revwalk_write_path_filters(walk));
+	git_revwalk_free(walk);
+}
+
+static uint32_t generation_of(git_bloom_file *file, const char *commit)
+{
+	git_oid id;
+
+	cl_git_pass(git_oid_fromstr(&id, commit));
+	return git_bloom_file_generation(file, &id);
+}
+
+static size_t walk_all(git_oid *out, unsigned int sorting, const char *hide)
+{
+	size_t count = 0;
+	int error;
+
+	git_revwalk_sorting(_walk, sorting);
+	cl_git_pass(git_revwalk_push_glob(_walk, "heads"));
+	if (hide)
+		cl_git_pass(git_revwalk_hide_ref(_walk, hide));
+
+	while ((error = git_revwalk_next(&out[count], _walk)) == 0)
+		cl_assert(++count < MAX_COMMITS);
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	return count;
+}
+
+static int find_commit(const git_oid *ids, size_t count, const git_oid *id)
+{
+	size_t i;
+
+	for (i = 0; i < count; ++i)
+		if (git_oid_equal(&ids[i], id))
+			return (int)i;
+
+	return -1;
+}
+
+/* every commit must come before all of its parents which were returned */
+static void assert_topological(const git_oid *ids, size_t count)
+{
+	git_commit *commit;
+	unsigned int p;
+	int pos;
+	size_t i;
+
+	for (i = 0; i < count; ++i) {
+		cl_git_pass(git_commit_lookup(&commit, _repo, &ids[i]));
+
+		for (p = 0; p < git_commit_parentcount(commit); ++p) {
+			pos = find_commit(ids, count, git_commit_parent_id(commit, p));
+			cl_assert(pos < 0 || (size_t)pos > i);
+		}
+
+		git_commit_free(commit);
+	}
+}
+
+static void assert_same_commits(
+	const git_oid *expected, size_t expected_count,
+	const git_oid *actual, size_t actual_count)
+{
+	size_t i;
+
+	cl_assert_equal_i(expected_count, actual_count);
+
+	for (i = 0; i < actual_count; ++i)
+		cl_assert(find_commit(expected, expected_count, &actual[i]) >= 0);
+}
+
+void test_revwalk_incremental__record_generations(void)
+{
+	git_bloom_file *file;
+
+	write_generations_for("heads");
+	cl_git_pass(git_bloom_file_open(&file, _repo));
+
+	cl_assert_equal_i(1,
+		generation_of(file, "8496071c1b46c854b31185ea97743be6a8774479"));
+	cl_assert_equal_i(2,
+		generation_of(file, "5b5b025afb0b4c913b4c338a42934a3863bf3644"));
+	cl_assert_equal_i(3,
+		generation_of(file, "c47800c7266a2be04c571c04d5a6614691ea99bd"));
+	cl_assert_equal_i(4,
+		generation_of(file, "9fd738e8f7967c078dceed8190330fc8648ee56a"));
+
+	/* one more than the longest of both sides of the merge */
+	cl_assert_equal_i(5,
+		generation_of(file, "be3563ae3f795b2b4353bcce3a527ad0a4f7f644"));
+	cl_assert_equal_i(6,
+		generation_of(file, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750"));
+
+	cl_assert_equal_i(GIT_BLOOM_GENERATION_UNKNOWN,
+		generation_of(file, "d07b0f9a8c89f1d9e74dc4fce6421dec5ef8a659"));
+
+	git_bloom_file_free(file);
+}
+
+void test_revwalk_incremental__return_commits_before_walking_history(void)
+{
+	git_oid id, ids[MAX_COMMITS];
+	git_commit_list_node *root;
+	char str[GIT_OID_HEXSZ + 1];
+	size_t count = 0;
+	int error;
+
+	write_generations_for("heads");
+
+	git_revwalk_sorting(_walk, GIT_SORT_TOPOLOGICAL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/master"));
+
+	cl_git_pass(git_revwalk_next(&ids[count++], _walk));
+	cl_assert_equal_s("a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		git_oid_tostr(str, sizeof(str), &ids[0]));
+
+	/* the root commit wasn't needed for the first commit */
+	cl_git_pass(git_oid_fromstr(&id, "8496071c1b46c854b31185ea97743be6a8774479"));
+	cl_assert((root = git_revwalk__commit_lookup(_walk, &id)) != NULL);
+	cl_assert(!root->parsed);
+
+	while ((error = git_revwalk_next(&ids[count], _walk)) == 0)
+		cl_assert(++count < MAX_COMMITS);
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert_equal_i(7, count);
+	assert_topological(ids, count);
+}
+
+void test_revwalk_incremental__same_commits_as_a_full_walk(void)
+{
+	git_oid expected[MAX_COMMITS], actual[MAX_COMMITS];
+	size_t expected_count, actual_count;
+
+	expected_count = walk_all(expected, GIT_SORT_TOPOLOGICAL, NULL);
+	assert_topological(expected, expected_count);
+
+	/* generations are only known for part of the history */
+	write_generations_for("heads/br2");
+
+	actual_count = walk_all(actual, GIT_SORT_TOPOLOGICAL, NULL);
+	assert_topological(actual, actual_count);
+	assert_same_commits(expected, expected_count, actual, actual_count);
+
+	write_generations_for("heads");
+
+	actual_count = walk_all(actual, GIT_SORT_TOPOLOGICAL, NULL);
+	assert_topological(actual, actual_count);
+	assert_same_commits(expected, expected_count, actual, actual_count);
+
+	actual_count = walk_all(actual, GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME, NULL);
+	assert_topological(actual, actual_count);
+	assert_same_commits(expected, expected_count, actual, actual_count);
+}
+
+void test_revwalk_incremental__hidden_commits(void)
+{
+	git_oid expected[MAX_COMMITS], actual[MAX_COMMITS];
+	size_t expected_count, actual_count;
+
+	expected_count = walk_all(
+		expected, GIT_SORT_TOPOLOGICAL, "refs/heads/packed-test");
+
+	write_generations_for("heads");
+
+	actual_count = walk_all(
+		actual, GIT_SORT_TOPOLOGICAL, "refs/heads/packed-test");
+	assert_topological(actual, actual_count);
+	assert_same_commits(expected, expected_count, actual, actual_count);
+}
+
+void test_revwalk_incremental__limited_to_paths(void)
+{
+	char *strings[] = { "README" };
+	git_strarray paths = { strings, 1 };
+	git_oid ids[MAX_COMMITS];
+	char str[8];
+
+	write_generations_for("heads");
+	cl_git_pass(git_revwalk_limit_paths(_walk, &paths));
+
+	cl_assert_equal_i(2, walk_all(ids, GIT_SORT_TOPOLOGICAL, NULL));
+	cl_assert_equal_s("4a202b3", git_oid_tostr(str, sizeof(str), &ids[0]));
+	cl_assert_equal_s("8496071", git_oid_tostr(str, sizeof(str), &ids[1]));
+}
@@ -0,0 +1,185 @@
+#include "clar_libgit2.h"
+
+/*
+	*   a65fedf [master]
+	*   be3563a Merge branch 'br2'
+	|\
+	| *   a4a7dce [br2] Merge branch 'master' into br2
+	| |\
+	| |/
+	|/|
+	* | c47800c branch commit one (adds branch_file.txt)
+	| * 9fd738e a fourth commit (changes new.txt)
+	| * 4a202b3 a third commit (changes README)
+	|/
+	* 5b5b025 another commit (adds new.txt)
+	* 8496071 testing (adds README)
+
+	* 763d71a [subtrees] adds ab/4.txt, ab/c/3.txt, ab/de/2.txt and
+	|                    ab/de/fgh/1.txt on top of c47800c
+*/
+
+static git_repository *_repo;
+static git_revwalk *_walk;
+
+void test_revwalk_limit__initialize(void)
+{
+	cl_git_pass(git_repository_open(&_repo, cl_fixture("testrepo.git")));
+	cl_git_pass(git_revwalk_new(&_walk, _repo));
+}
+
+void test_revwalk_limit__cleanup(void)
+{
+	git_revwalk_free(_walk);
+	_walk = NULL;
+
+	git_repository_free(_repo);
+	_repo = NULL;
+}
+
+static void limit_to(const char *path1, const char *path2)
+{
+	char *strings[2];
+	git_strarray paths;
+
+	strings[0] = (char *)path1;
+	strings[1] = (char *)path2;
+	paths.strings = strings;
+	paths.count = path2 ? 2 : 1;
+
+	cl_git_pass(git_revwalk_limit_paths(_walk, &paths));
+}
+
+static void assert_walk(const char *expected[])
+{
+	git_oid id;
+	char str[8];
+	int i = 0, error;
+
+	while ((error = git_revwalk_next(&id, _walk)) == 0) {
+		cl_assert(expected[i] != NULL);
+		cl_assert_equal_s(expected[i], git_oid_tostr(str, sizeof(str), &id));
+		i++;
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert(expected[i] == NULL);
+}
+
+void test_revwalk_limit__only_commits_modifying_the_path(void)
+{
+	const char *readme[] = { "4a202b3", "8496071", NULL };
+	const char *branch_file[] = { "a65fedf", "c47800c", NULL };
+
+	git_revwalk_sorting(_walk, GIT_SORT_TIME);
+
+	limit_to("README", NULL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/master"));
+	assert_walk(readme);
+
+	limit_to("branch_file.txt", NULL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/master"));
+	assert_walk(branch_file);
+}
+
+void test_revwalk_limit__merges_follow_a_matching_parent(void)
+{
+	const char *readme[] = { "4a202b3", "8496071", NULL };
+	const char *branch_file[] = { "c47800c", NULL };
+
+	git_revwalk_sorting(_walk, GIT_SORT_TIME);
+
+	/* a4a7dce takes README from 9fd738e, and branch_file.txt from
+	 * c47800c, so only the history of that parent is walked */
+	limit_to("README", NULL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/br2"));
+	assert_walk(readme);
+
+	limit_to("branch_file.txt", NULL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/br2"));
+	assert_walk(branch_file);
+}
+
+void test_revwalk_limit__multiple_paths(void)
+{
+	const char *expected[] = {
+		"9fd738e", "4a202b3", "5b5b025", "8496071", NULL
+	};
+
+	git_revwalk_sorting(_walk, GIT_SORT_TIME);
+
+	limit_to("README", "new.txt");
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/master"));
+	assert_walk(expected);
+}
+
+void test_revwalk_limit__directories(void)
+{
+	const char *expected[] = { "763d71a", NULL };
+	const char *nothing[] = { NULL };
+
+	limit_to("ab", NULL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/subtrees"));
+	assert_walk(expected);
+
+	limit_to("ab/de/", NULL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/subtrees"));
+	assert_walk(expected);
+
+	limit_to("ab/de/fgh/1.txt", NULL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/subtrees"));
+	assert_walk(expected);
+
+	limit_to("README/ab", "does-not-exist");
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/subtrees"));
+	assert_walk(nothing);
+}
+
+void test_revwalk_limit__topological_and_reverse(void)
+{
+	const char *expected[] = { "5b5b025", "9fd738e", NULL };
+
+	git_revwalk_sorting(_walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+
+	limit_to("new.txt", NULL);
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/master"));
+	assert_walk(expected);
+}
+
+void test_revwalk_limit__with_hidden_commits(void)
+{
+	const char *expected[] = { "9fd738e", NULL };
+
+	limit_to("README", "new.txt");
+	cl_git_pass(git_revwalk_push_range(_walk, "4a202b3..master"));
+	assert_walk(expected);
+}
+
+void test_revwalk_limit__can_be_removed(void)
+{
+	git_oid id;
+	int count = 0;
+
+	limit_to("README", NULL);
+	cl_git_pass(git_revwalk_limit_paths(_walk, NULL));
+
+	cl_git_pass(git_revwalk_push_ref(_walk, "refs/heads/master"));
+	while (git_revwalk_next(&id, _walk) == 0)
+		count++;
+
+	cl_assert_equal_i(7, count);
+}
+
+void test_revwalk_limit__invalid_paths(void)
+{
+	char *empty[] = { "" }, *absolute[] = { "/README" };
+	git_strarray paths;
+
+	paths.count = 1;
+
+	paths.strings = empty;
+	cl_git_fail(git_revwalk_limit_paths(_walk, &paths));
+
+	paths.strings = absolute;
+	cl_git_fail(git_revwalk_limit_paths(_walk, &paths));
+}
@@ -272,6 +272,103 @@ void test_revwalk_mergebase__octopus_merge_branch(void)
 	assert_mergebase_octopus("8496071c1b46c854b31185ea97743be6a8774479", 3, "849607", "a65fed", "763d71");
 }
 
+static const char *testrepo_tips[] = {
+	"a4a7dce85cf63874e984719f4fdd239f5145052f",
+	"e90810b8df3e80c413d903f631643c716887138d",
+	"258f0e2a959a364e40ed6603d5d44fbb24765b10",
+	"a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+	"41bc8c69075bbdb46c5c6f0566cc8cc5b46e8bd9",
+	"4a202b346bb0fb0db7eff3cffeb3c70babbd2045",
+	"763d71aadf09a7951596c9746c024e7eece7c7af",
+	"9fd738e8f7967c078dceed8190330fc8648ee56a",
+	"be3563ae3f795b2b4353bcce3a527ad0a4f7f644",
+	"5b5b025afb0b4c913b4c338a42934a3863bf3644",
+};
+
+/* the tips against the base, as counted by `git rev-list --left-right` */
+static const size_t testrepo_counts[][ARRAY_SIZE(testrepo_tips)][2] = {
+	/* a65fedf */
+	{ {1, 2}, {2, 7}, {1, 1}, {0, 0}, {2, 7},
+	  {0, 4}, {1, 4}, {0, 3}, {0, 1}, {0, 5} },
+	/* 763d71a */
+	{ {3, 1}, {2, 4}, {4, 1}, {4, 1}, {2, 4},
+	  {1, 2}, {0, 0}, {2, 2}, {3, 1}, {0, 2} },
+};
+
+static void assert_ahead_behind_many(
+	const char *base_sha, const size_t (*counts)[2],
+	size_t count, unsigned int threads)
+{
+	git_oid base, *tips, *merge_bases, expected;
+	size_t *ahead, *behind, i, n = ARRAY_SIZE(testrepo_tips);
+	int error;
+
+	tips = git__calloc(count, sizeof(git_oid));
+	merge_bases = git__calloc(count, sizeof(git_oid));
+	ahead = git__calloc(count, sizeof(size_t));
+	behind = git__calloc(count, sizeof(size_t));
+	cl_assert(tips && merge_bases && ahead && behind);
+
+	cl_git_pass(git_oid_fromstr(&base, base_sha));
+	for (i = 0; i < count; ++i)
+		cl_git_pass(git_oid_fromstr(&tips[i], testrepo_tips[i % n]));
+
+	cl_git_pass(git_graph_ahead_behind_many(
+		ahead, behind, merge_bases, _repo, &base, tips, count, threads));
+
+	for (i = 0; i < count; ++i) {
+		cl_assert_equal_sz(counts[i % n][0], ahead[i]);
+		cl_assert_equal_sz(counts[i % n][1], behind[i]);
+
+		error = git_merge_base(&expected, _repo, &tips[i], &base);
+		if (error == GIT_ENOTFOUND)
+			cl_assert(git_oid_iszero(&merge_bases[i]));
+		else {
+			cl_git_pass(error);
+			cl_assert(git_oid_equal(&expected, &merge_bases[i]));
+		}
+	}
+
+	git__free(tips);
+	git__free(merge_bases);
+	git__free(ahead);
+	git__free(behind);
+}
+
+void test_revwalk_mergebase__ahead_behind_many(void)
+{
+	assert_ahead_behind_many("a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		testrepo_counts[0], ARRAY_SIZE(testrepo_tips), 1);
+	assert_ahead_behind_many("763d71aadf09a7951596c9746c024e7eece7c7af",
+		testrepo_counts[1], ARRAY_SIZE(testrepo_tips), 1);
+}
+
+void test_revwalk_mergebase__ahead_behind_many_in_chunks(void)
+{
+	/* enough tips for more than one chunk, and more than a word of bits */
+	assert_ahead_behind_many("a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		testrepo_counts[0], 150, 2);
+	assert_ahead_behind_many("763d71aadf09a7951596c9746c024e7eece7c7af",
+		testrepo_counts[1], 150, 0);
+}
+
+void test_revwalk_mergebase__ahead_behind_many_without_merge_bases(void)
+{
+	git_oid base, tips[2];
+	size_t ahead[2], behind[2];
+
+	cl_git_pass(git_oid_fromstr(&base, "c47800c7266a2be04c571c04d5a6614691ea99bd"));
+	cl_git_pass(git_oid_fromstr(&tips[0], "9fd738e8f7967c078dceed8190330fc8648ee56a"));
+	cl_git_pass(git_oid_fromstr(&tips[1], "c47800c7266a2be04c571c04d5a6614691ea99bd"));
+
+	cl_git_pass(git_graph_ahead_behind_many(
+		ahead, behind, NULL, _repo, &base, tips, 2, 0));
+	cl_assert_equal_sz(2, ahead[0]);
+	cl_assert_equal_sz(1, behind[0]);
+	cl_assert_equal_sz(0, ahead[1]);
+	cl_assert_equal_sz(0, behind[1]);
+}
+
 /*
  * testrepo.git $ git log --graph --all
  * * commit 763d71aadf09a7951596c9746c024e7eece7c7af
@@ -0,0 +1,137 @@
+#include "clar_libgit2.h"
+#include "bloom.h"
+
+static git_repository *_repo;
+static git_revwalk *_walk;
+
+void test_revwalk_pathfilters__initialize(void)
+{
+	_repo = cl_git_sandbox_init("testrepo.git");
+	cl_git_pass(git_revwalk_new(&_walk, _repo));
+}
+
+void test_revwalk_pathfilters__cleanup(void)
+{
+	git_revwalk_free(_walk);
+	_walk = NULL;
+
+	cl_git_sandbox_cleanup();
+}
+
+static void write_filters_for(const char *refname)
+{
+	cl_git_pass(git_revwalk_push_ref(_walk, refname));
+	cl_git_pass(git_revwalk_write_path_filters(_walk));
+}
+
+static bool filter_contains(
+	git_bloom_file *file, const char *commit, const char *path)
+{
+	git_bloom_filter filter;
+	git_bloom_key key;
+	git_oid id;
+
+	cl_git_pass(git_oid_fromstr(&id, commit));
+	cl_git_pass(git_bloom_file_lookup(&filter, file, &id));
+
+	git_bloom_key_init(&key, path, strlen(path));
+	return git_bloom_filter_contains(&filter, &key);
+}
+
+static bool has_filter(git_bloom_file *file, const char *commit)
+{
+	git_bloom_filter filter;
+	git_oid id;
+
+	cl_git_pass(git_oid_fromstr(&id, commit));
+	return (git_bloom_file_lookup(&filter, file, &id) == 0);
+}
+
+void test_revwalk_pathfilters__record_changed_paths(void)
+{
+	git_bloom_file *file;
+
+	cl_assert_equal_i(GIT_ENOTFOUND, git_bloom_file_open(&file, _repo));
+
+	write_filters_for("refs/heads/subtrees");
+	cl_git_pass(git_bloom_file_open(&file, _repo));
+
+	/* 763d71a adds ab/4.txt, ab/c/3.txt, ab/de/2.txt, ab/de/fgh/1.txt */
+	cl_assert(filter_contains(file,
+		"763d71aadf09a7951596c9746c024e7eece7c7af", "ab/de/fgh/1.txt"));
+	cl_assert(filter_contains(file,
+		"763d71aadf09a7951596c9746c024e7eece7c7af", "ab/de/fgh"));
+	cl_assert(filter_contains(file,
+		"763d71aadf09a7951596c9746c024e7eece7c7af", "ab"));
+	cl_assert(!filter_contains(file,
+		"763d71aadf09a7951596c9746c024e7eece7c7af", "README"));
+
+	/* c47800c only adds branch_file.txt */
+	cl_assert(filter_contains(file,
+		"c47800c7266a2be04c571c04d5a6614691ea99bd", "branch_file.txt"));
+	cl_assert(!filter_contains(file,
+		"c47800c7266a2be04c571c04d5a6614691ea99bd", "new.txt"));
+
+	/* the root commit adds README */
+	cl_assert(filter_contains(file,
+		"8496071c1b46c854b31185ea97743be6a8774479", "README"));
+
+	git_bloom_file_free(file);
+}
+
+void test_revwalk_pathfilters__keep_existing_filters(void)
+{
+	git_bloom_file *file;
+
+	write_filters_for("refs/heads/packed-test");
+	write_filters_for("refs/heads/subtrees");
+
+	cl_git_pass(git_bloom_file_open(&file, _repo));
+	cl_assert(has_filter(file, "763d71aadf09a7951596c9746c024e7eece7c7af"));
+	cl_assert(has_filter(file, "4a202b346bb0fb0db7eff3cffeb3c70babbd2045"));
+	cl_assert(has_filter(file, "8496071c1b46c854b31185ea97743be6a8774479"));
+	cl_assert(!has_filter(file, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750"));
+	git_bloom_file_free(file);
+}
+
+static void assert_limited_walk(
+	const char *refname, const char *path, const char *expected[])
+{
+	char *strings[1];
+	git_strarray paths;
+	git_oid id;
+	char str[8];
+	int i = 0, error;
+
+	strings[0] = (char *)path;
+	paths.strings = strings;
+	paths.count = 1;
+
+	git_revwalk_sorting(_walk, GIT_SORT_TIME);
+	cl_git_pass(git_revwalk_limit_paths(_walk, &paths));
+	cl_git_pass(git_revwalk_push_ref(_walk, refname));
+
+	while ((error = git_revwalk_next(&id, _walk)) == 0) {
+		cl_assert(expected[i] != NULL);
+		cl_assert_equal_s(expected[i], git_oid_tostr(str, sizeof(str), &id));
+		i++;
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert(expected[i] == NULL);
+}
+
+void test_revwalk_pathfilters__limited_walks_use_filters(void)
+{
+	const char *readme[] = { "4a202b3", "8496071", NULL };
+	const char *branch_file[] = { "c47800c", NULL };
+	const char *subtree[] = { "763d71a", NULL };
+
+	cl_git_pass(git_revwalk_push_glob(_walk, "heads"));
+	cl_git_pass(git_revwalk_write_path_filters(_walk));
+
+	assert_limited_walk("refs/heads/master", "README", readme);
+	assert_limited_walk("refs/heads/br2", "README", readme);
+	assert_limited_walk("refs/heads/br2", "branch_file.txt", branch_file);
+	assert_limited_walk("refs/heads/subtrees", "ab/de", subtree);
+}
@@ -0,0 +1,116 @@
+#include "clar_libgit2.h"
+
+#define MAX_COMMITS 64
+
+static git_repository *_repo;
+
+void test_revwalk_reachability__cleanup(void)
+{
+	git_repository_free(_repo);
+	_repo = NULL;
+}
+
+static size_t all_commits(git_oid *out)
+{
+	git_revwalk *walk;
+	size_t count = 0;
+	int error;
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	cl_git_pass(git_revwalk_push_glob(walk, "*"));
+
+	while ((error = git_revwalk_next(&out[count], walk)) == 0)
+		cl_assert(++count < MAX_COMMITS);
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	git_revwalk_free(walk);
+
+	return count;
+}
+
+static void assert_same_answers(
+	git_graph_reachability *index, const git_oid *ids, size_t count)
+{
+	size_t i, j;
+
+	for (i = 0; i < count; ++i) {
+		for (j = 0; j < count; ++j) {
+			cl_assert_equal_i(
+				git_graph_descendant_of(_repo, &ids[i], &ids[j]),
+				git_graph_reachability_descendant_of(index, &ids[i], &ids[j]));
+		}
+	}
+}
+
+static void assert_index_of_everything(const char *fixture)
+{
+	git_graph_reachability *index;
+	git_oid ids[MAX_COMMITS];
+	size_t count;
+
+	cl_git_pass(git_repository_open(&_repo, cl_fixture(fixture)));
+	count = all_commits(ids);
+
+	cl_git_pass(git_graph_reachability_new(&index, _repo, ids, count));
+	cl_assert_equal_i(count, git_graph_reachability_size(index));
+
+	assert_same_answers(index, ids, count);
+	git_graph_reachability_free(index);
+}
+
+void test_revwalk_reachability__same_as_descendant_of(void)
+{
+	assert_index_of_everything("testrepo.git");
+}
+
+void test_revwalk_reachability__same_as_descendant_of_with_merges(void)
+{
+	assert_index_of_everything("twowaymerge.git");
+}
+
+void test_revwalk_reachability__commits_outside_of_the_index(void)
+{
+	git_graph_reachability *index;
+	git_oid ids[MAX_COMMITS], tip;
+	size_t count;
+
+	cl_git_pass(git_repository_open(&_repo, cl_fixture("testrepo.git")));
+	count = all_commits(ids);
+
+	/* only the history of one branch; the rest is walked */
+	cl_git_pass(git_oid_fromstr(&tip, "9fd738e8f7967c078dceed8190330fc8648ee56a"));
+	cl_git_pass(git_graph_reachability_new(&index, _repo, &tip, 1));
+	cl_assert_equal_i(4, git_graph_reachability_size(index));
+
+	assert_same_answers(index, ids, count);
+	git_graph_reachability_free(index);
+}
+
+void test_revwalk_reachability__empty(void)
+{
+	git_graph_reachability *index;
+	git_oid one, two;
+
+	cl_git_pass(git_repository_open(&_repo, cl_fixture("testrepo.git")));
+
+	cl_git_pass(git_graph_reachability_new(&index, _repo, NULL, 0));
+	cl_assert_equal_i(0, git_graph_reachability_size(index));
+
+	cl_git_pass(git_oid_fromstr(&one, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750"));
+	cl_git_pass(git_oid_fromstr(&two, "8496071c1b46c854b31185ea97743be6a8774479"));
+	cl_assert_equal_i(1, git_graph_reachability_descendant_of(index, &one, &two));
+	cl_assert_equal_i(0, git_graph_reachability_descendant_of(index, &two, &one));
+
+	git_graph_reachability_free(index);
+}
+
+void test_revwalk_reachability__missing_tip(void)
+{
+	git_graph_reachability *index;
+	git_oid tip;
+
+	cl_git_pass(git_repository_open(&_repo, cl_fixture("testrepo.git")));
+
+	cl_git_pass(git_oid_fromstr(&tip, "deadbeefdeadbeefdeadbeefdeadbeefdeadbeef"));
+	cl_git_fail(git_graph_reachability_new(&index, _repo, &tip, 1));
+}
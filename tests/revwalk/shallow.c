@@ -0,0 +1,192 @@
+#include "clar_libgit2.h"
+#include "grafts.h"
+#include "fileops.h"
+
+static git_repository *_repo;
+
+void test_revwalk_shallow__initialize(void)
+{
+	_repo = cl_git_sandbox_init("testrepo.git");
+}
+
+void test_revwalk_shallow__cleanup(void)
+{
+	cl_git_sandbox_cleanup();
+}
+
+static void assert_walk(const char *tip, const char **expected, size_t count)
+{
+	git_revwalk *walk;
+	git_oid oid, expected_oid;
+	size_t i = 0;
+	int error;
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL);
+	cl_git_pass(git_revwalk_push_ref(walk, tip));
+
+	while ((error = git_revwalk_next(&oid, walk)) == 0) {
+		cl_assert(i < count);
+		cl_git_pass(git_oid_fromstr(&expected_oid, expected[i++]));
+		cl_assert(git_oid_equal(&expected_oid, &oid));
+	}
+
+	cl_assert_equal_i(GIT_ITEROVER, error);
+	cl_assert_equal_i(count, i);
+
+	git_revwalk_free(walk);
+}
+
+static const char *full_history[] = {
+	"a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+	"be3563ae3f795b2b4353bcce3a527ad0a4f7f644",
+	"c47800c7266a2be04c571c04d5a6614691ea99bd",
+	"9fd738e8f7967c078dceed8190330fc8648ee56a",
+	"4a202b346bb0fb0db7eff3cffeb3c70babbd2045",
+	"5b5b025afb0b4c913b4c338a42934a3863bf3644",
+	"8496071c1b46c854b31185ea97743be6a8774479",
+};
+
+void test_revwalk_shallow__not_shallow(void)
+{
+	cl_assert_equal_i(0, git_repository_is_shallow(_repo));
+	assert_walk("refs/heads/master", full_history, ARRAY_SIZE(full_history));
+}
+
+void test_revwalk_shallow__stops_at_the_boundary(void)
+{
+	const char *expected[] = {
+		"a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644",
+	};
+
+	cl_git_mkfile("testrepo.git/shallow",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644\n");
+
+	cl_assert_equal_i(1, git_repository_is_shallow(_repo));
+	assert_walk("refs/heads/master", expected, ARRAY_SIZE(expected));
+}
+
+void test_revwalk_shallow__boundary_on_each_side_of_a_merge(void)
+{
+	const char *expected[] = {
+		"a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644",
+		"c47800c7266a2be04c571c04d5a6614691ea99bd",
+		"9fd738e8f7967c078dceed8190330fc8648ee56a",
+	};
+
+	cl_git_mkfile("testrepo.git/shallow",
+		"9fd738e8f7967c078dceed8190330fc8648ee56a\n"
+		"c47800c7266a2be04c571c04d5a6614691ea99bd\n");
+
+	assert_walk("refs/heads/master", expected, ARRAY_SIZE(expected));
+}
+
+void test_revwalk_shallow__grafts(void)
+{
+	const char *expected[] = {
+		"a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644",
+		"c47800c7266a2be04c571c04d5a6614691ea99bd",
+		"5b5b025afb0b4c913b4c338a42934a3863bf3644",
+		"8496071c1b46c854b31185ea97743be6a8774479",
+	};
+
+	/* the merge loses its first parent */
+	cl_git_pass(git_futils_mkdir_r("testrepo.git/info", NULL, 0777));
+	cl_git_mkfile("testrepo.git/info/grafts",
+		"# a comment\n"
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644 "
+		"c47800c7266a2be04c571c04d5a6614691ea99bd\n");
+
+	cl_assert_equal_i(0, git_repository_is_shallow(_repo));
+	assert_walk("refs/heads/master", expected, ARRAY_SIZE(expected));
+}
+
+void test_revwalk_shallow__invalid_grafts(void)
+{
+	git_revwalk *walk;
+
+	cl_git_mkfile("testrepo.git/shallow",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644 trailing garbage\n");
+
+	cl_git_fail(git_revwalk_new(&walk, _repo));
+}
+
+void test_revwalk_shallow__reloads_changed_files(void)
+{
+	const char *expected[] = {
+		"a65fedf39aefe402d3bb6e24df4d4f5fe4547750",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644",
+	};
+
+	/* the parents cached by the first walk are not the grafted ones */
+	cl_git_pass(git_repository_set_graph_cache(_repo, 100));
+
+	assert_walk("refs/heads/master", full_history, ARRAY_SIZE(full_history));
+
+	cl_git_mkfile("testrepo.git/shallow",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644\n");
+	assert_walk("refs/heads/master", expected, ARRAY_SIZE(expected));
+
+	cl_must_pass(p_unlink("testrepo.git/shallow"));
+	assert_walk("refs/heads/master", full_history, ARRAY_SIZE(full_history));
+}
+
+void test_revwalk_shallow__graph_queries(void)
+{
+	git_oid tip, root;
+
+	cl_git_pass(git_oid_fromstr(&tip, "a65fedf39aefe402d3bb6e24df4d4f5fe4547750"));
+	cl_git_pass(git_oid_fromstr(&root, "8496071c1b46c854b31185ea97743be6a8774479"));
+
+	cl_assert_equal_i(1, git_graph_descendant_of(_repo, &tip, &root));
+
+	cl_git_mkfile("testrepo.git/shallow",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644\n");
+
+	cl_assert_equal_i(0, git_graph_descendant_of(_repo, &tip, &root));
+}
+
+void test_revwalk_shallow__no_path_filters_with_grafts(void)
+{
+	git_revwalk *walk;
+
+	cl_git_mkfile("testrepo.git/shallow",
+		"be3563ae3f795b2b4353bcce3a527ad0a4f7f644\n");
+
+	cl_git_pass(git_revwalk_new(&walk, _repo));
+	cl_git_pass(git_revwalk_push_ref(walk, "refs/heads/master"));
+	cl_git_fail(git_revwalk_write_path_filters(walk));
+	git_revwalk_free(walk);
+}
+
+void test_revwalk_shallow__update_shallow_file(void)
+{
+	git_buf contents = GIT_BUF_INIT;
+	git_oid ids[3];
+
+	cl_git_pass(git_oid_fromstr(&ids[0], "c47800c7266a2be04c571c04d5a6614691ea99bd"));
+	cl_git_pass(git_oid_fromstr(&ids[1], "9fd738e8f7967c078dceed8190330fc8648ee56a"));
+	cl_git_pass(git_oid_fromstr(&ids[2], "be3563ae3f795b2b4353bcce3a527ad0a4f7f644"));
+
+	/* a fetch which cut the history at the merge */
+	cl_git_pass(git_grafts_update_shallow(_repo, &ids[2], 1, NULL, 0));
+	cl_assert_equal_i(1, git_repository_is_shallow(_repo));
+
+	/* deepening it moves the boundary to the parents of the merge */
+	cl_git_pass(git_grafts_update_shallow(_repo, ids, 2, &ids[2], 1));
+
+	cl_git_pass(git_futils_readbuffer(&contents, "testrepo.git/shallow"));
+	cl_assert_equal_s(
+		"9fd738e8f7967c078dceed8190330fc8648ee56a\n"
+		"c47800c7266a2be04c571c04d5a6614691ea99bd\n",
+		contents.ptr);
+	git_buf_free(&contents);
+
+	/* and unshallowing everything removes the file */
+	cl_git_pass(git_grafts_update_shallow(_repo, NULL, 0, ids, 2));
+	cl_assert_equal_i(0, git_repository_is_shallow(_repo));
+	cl_assert(!git_path_exists("testrepo.git/shallow"));
+}
@@ -0,0 +1,338 @@
+#include "clar_libgit2.h"
+#include "fileops.h"
+#include "index.h"
+#include "repository.h"
+#include "git2/sys/diff.h"
+#include "git2/sys/fsmonitor.h"
+
+static git_repository *g_repo = NULL;
+
+/* a monitor that reports whatever paths the test tells it to */
+
+typedef struct {
+	git_fsmonitor parent;
+	int queries;
+	bool forget;
+	const char **changed;
+} mock_fsmonitor;
+
+static mock_fsmonitor *g_monitor = NULL;
+
+static int mock_query(
+	git_buf *token_out,
+	git_fsmonitor *fsmonitor,
+	const char *token,
+	git_fsmonitor_changed_cb changed_cb,
+	void *payload)
+{
+	mock_fsmonitor *monitor = (mock_fsmonitor *)fsmonitor;
+	const char **path;
+	int error;
+
+	monitor->queries++;
+	git_buf_clear(token_out);
+	git_buf_printf(token_out, "mock:%d", monitor->queries);
+
+	if (!token || monitor->forget)
+		return GIT_ENOTFOUND;
+
+	for (path = monitor->changed; path && *path; ++path)
+		if ((error = changed_cb(*path, payload)) != 0)
+			return error;
+
+	return 0;
+}
+
+static void mock_free(git_fsmonitor *fsmonitor)
+{
+	git__free(fsmonitor);
+}
+
+static void set_mock_fsmonitor(void)
+{
+	g_monitor = git__calloc(1, sizeof(mock_fsmonitor));
+	cl_assert(g_monitor);
+
+	cl_git_pass(git_fsmonitor_init(&g_monitor->parent, GIT_FSMONITOR_VERSION));
+	g_monitor->parent.query = mock_query;
+	g_monitor->parent.free = mock_free;
+
+	cl_git_pass(git_repository_set_fsmonitor(g_repo, &g_monitor->parent));
+}
+
+void test_status_fsmonitor__initialize(void)
+{
+	g_repo = cl_git_sandbox_init("status");
+	set_mock_fsmonitor();
+}
+
+void test_status_fsmonitor__cleanup(void)
+{
+	g_monitor = NULL;
+	cl_git_sandbox_cleanup();
+}
+
+typedef struct {
+	const char *path;
+	unsigned int status;
+	int found;
+} status_for_path;
+
+static int cb_status__for_path(const char *p, unsigned int s, void *payload)
+{
+	status_for_path *data = payload;
+
+	if (!strcmp(p, data->path)) {
+		data->status = s;
+		data->found++;
+	}
+
+	return 0;
+}
+
+/* look up the status of a file through a full status run, returning the
+ * number of stat calls it took in `stat_calls` */
+static unsigned int whole_status_of(const char *path, size_t *stat_calls)
+{
+	git_status_list *status;
+	git_diff_perfdata perf = GIT_DIFF_PERFDATA_INIT;
+	status_for_path data;
+	size_t i;
+
+	memset(&data, 0, sizeof(data));
+	data.path = path;
+
+	cl_git_pass(git_status_list_new(&status, g_repo, NULL));
+
+	for (i = 0; i < git_status_list_entrycount(status); ++i) {
+		const git_status_entry *entry = git_status_byindex(status, i);
+		const git_diff_delta *delta = entry->index_to_workdir ?
+			entry->index_to_workdir : entry->head_to_index;
+
+		cb_status__for_path(delta->new_file.path, entry->status, &data);
+	}
+
+	cl_git_pass(git_status_list_get_perfdata(&perf, status));
+	if (stat_calls)
+		*stat_calls = perf.stat_calls;
+
+	git_status_list_free(status);
+
+	cl_assert(data.found <= 1);
+	return data.found ? data.status : GIT_STATUS_CURRENT;
+}
+
+static const git_index_entry *index_entry(const char *path)
+{
+	git_index *index;
+	cl_git_pass(git_repository_index__weakptr(&index, g_repo));
+	return git_index_get_bypath(index, path, 0);
+}
+
+static bool is_fsmonitor_valid(const char *path)
+{
+	const git_index_entry *entry = index_entry(path);
+	cl_assert(entry);
+	return (entry->flags_extended & GIT_IDXENTRY_FSMONITOR_VALID) != 0;
+}
+
+void test_status_fsmonitor__unchanged_files_are_not_examined_again(void)
+{
+	size_t first_stats, second_stats;
+
+	cl_assert_equal_i(GIT_STATUS_WT_MODIFIED,
+		whole_status_of("modified_file", &first_stats));
+	cl_assert_equal_i(1, g_monitor->queries);
+
+	cl_assert(is_fsmonitor_valid("current_file"));
+	cl_assert(is_fsmonitor_valid("subdir/current_file"));
+	cl_assert(!is_fsmonitor_valid("modified_file"));
+
+	cl_assert_equal_i(GIT_STATUS_WT_MODIFIED,
+		whole_status_of("modified_file", &second_stats));
+	cl_assert_equal_i(2, g_monitor->queries);
+	cl_assert(second_stats < first_stats);
+}
+
+void test_status_fsmonitor__only_reported_paths_are_examined(void)
+{
+	const char *changed[] = { "current_file", NULL };
+
+	cl_assert_equal_i(GIT_STATUS_CURRENT, whole_status_of("current_file", NULL));
+
+	/* a change the monitor keeps quiet about goes unnoticed... */
+	cl_git_rewritefile("status/current_file", "changed behind our back\n");
+	cl_assert_equal_i(GIT_STATUS_CURRENT, whole_status_of("current_file", NULL));
+	cl_assert(is_fsmonitor_valid("current_file"));
+
+	/* ...until it is reported */
+	g_monitor->changed = changed;
+	cl_assert_equal_i(
+		GIT_STATUS_WT_MODIFIED, whole_status_of("current_file", NULL));
+	cl_assert(!is_fsmonitor_valid("current_file"));
+}
+
+void test_status_fsmonitor__reported_directories_cover_their_contents(void)
+{
+	const char *changed[] = { "subdir/", NULL };
+
+	cl_assert_equal_i(
+		GIT_STATUS_CURRENT, whole_status_of("subdir/current_file", NULL));
+	cl_assert(is_fsmonitor_valid("subdir/current_file"));
+	cl_assert(is_fsmonitor_valid("current_file"));
+
+	cl_git_rewritefile("status/subdir/current_file", "changed\n");
+	g_monitor->changed = changed;
+
+	cl_assert_equal_i(
+		GIT_STATUS_WT_MODIFIED, whole_status_of("subdir/current_file", NULL));
+	cl_assert(is_fsmonitor_valid("current_file"));
+}
+
+void test_status_fsmonitor__unknown_changes_examine_everything(void)
+{
+	cl_assert_equal_i(GIT_STATUS_CURRENT, whole_status_of("current_file", NULL));
+	cl_assert(is_fsmonitor_valid("current_file"));
+
+	cl_git_rewritefile("status/current_file", "changed\n");
+	g_monitor->forget = true;
+
+	cl_assert_equal_i(
+		GIT_STATUS_WT_MODIFIED, whole_status_of("current_file", NULL));
+}
+
+void test_status_fsmonitor__is_written_and_read_with_the_index(void)
+{
+	git_index *index;
+
+	cl_assert_equal_i(GIT_STATUS_CURRENT, whole_status_of("current_file", NULL));
+
+	cl_git_pass(git_repository_index(&index, g_repo));
+	cl_git_pass(git_index_write(index));
+	git_index_free(index);
+
+	g_repo = cl_git_sandbox_reopen();
+
+	cl_git_pass(git_repository_index__weakptr(&index, g_repo));
+	cl_assert_equal_s("mock:1", index->fsmonitor_token);
+	cl_assert(is_fsmonitor_valid("current_file"));
+	cl_assert(is_fsmonitor_valid("subdir/current_file"));
+	cl_assert(!is_fsmonitor_valid("modified_file"));
+
+	/* the token is handed to the next monitor */
+	set_mock_fsmonitor();
+	g_monitor->queries = 1;
+
+	cl_git_rewritefile("status/current_file", "changed\n");
+	cl_assert_equal_i(GIT_STATUS_CURRENT, whole_status_of("current_file", NULL));
+	cl_assert_equal_s("mock:2", index->fsmonitor_token);
+}
+
+void test_status_fsmonitor__new_entries_are_not_trusted(void)
+{
+	git_index *index;
+
+	cl_assert_equal_i(GIT_STATUS_CURRENT, whole_status_of("current_file", NULL));
+
+	cl_git_pass(git_repository_index(&index, g_repo));
+	cl_git_pass(git_index_add_bypath(index, "new_file"));
+	cl_assert(!is_fsmonitor_valid("new_file"));
+	git_index_free(index);
+
+	cl_git_rewritefile("status/new_file", "changed\n");
+	cl_assert_equal_i(GIT_STATUS_INDEX_NEW | GIT_STATUS_WT_MODIFIED,
+		whole_status_of("new_file", NULL));
+}
+
+#ifdef GIT_USE_INOTIFY
+static int collect_paths(const char *path, void *payload)
+{
+	return git_vector_insert(payload, git__strdup(path));
+}
+
+static bool vector_contains(git_vector *paths, const char *path)
+{
+	size_t i;
+	const char *p;
+
+	git_vector_foreach(paths, i, p)
+		if (!strcmp(p, path))
+			return true;
+
+	return false;
+}
+#endif
+
+void test_status_fsmonitor__inotify_reports_changes(void)
+{
+#ifdef GIT_USE_INOTIFY
+	git_fsmonitor *monitor;
+	git_buf token = GIT_BUF_INIT, next = GIT_BUF_INIT;
+	git_vector paths = GIT_VECTOR_INIT;
+	size_t i;
+	char *p;
+
+	cl_git_pass(git_fsmonitor_inotify_new(
+		&monitor, git_repository_workdir(g_repo)));
+
+	cl_assert_equal_i(GIT_ENOTFOUND,
+		monitor->query(&token, monitor, NULL, collect_paths, &paths));
+	cl_assert(token.size > 0);
+	cl_assert_equal_i(0, (int)paths.length);
+
+	cl_git_rewritefile("status/current_file", "changed\n");
+	cl_git_pass(p_mkdir("status/newdir", 0777));
+	cl_git_mkfile("status/newdir/file", "new\n");
+	cl_git_mkfile("status/subdir/another_file", "new\n");
+
+	cl_git_pass(
+		monitor->query(&next, monitor, token.ptr, collect_paths, &paths));
+	cl_assert(vector_contains(&paths, "current_file"));
+	cl_assert(vector_contains(&paths, "newdir/"));
+	cl_assert(vector_contains(&paths, "subdir/another_file"));
+	cl_assert(!vector_contains(&paths, "modified_file"));
+
+	git_vector_foreach(&paths, i, p)
+		git__free(p);
+	git_vector_clear(&paths);
+
+	/* nothing changed since the last query */
+	cl_git_pass(
+		monitor->query(&token, monitor, next.ptr, collect_paths, &paths));
+	cl_assert_equal_i(0, (int)paths.length);
+
+	/* tokens from another monitor are not understood */
+	cl_assert_equal_i(GIT_ENOTFOUND, monitor->query(
+		&next, monitor, "mock:1", collect_paths, &paths));
+
+	git_vector_foreach(&paths, i, p)
+		git__free(p);
+	git_vector_free(&paths);
+	git_buf_free(&token);
+	git_buf_free(&next);
+	monitor->free(monitor);
+#endif
+}
+
+void test_status_fsmonitor__inotify_keeps_status_accurate(void)
+{
+#ifdef GIT_USE_INOTIFY
+	git_fsmonitor *monitor;
+
+	cl_git_pass(git_fsmonitor_inotify_new(
+		&monitor, git_repository_workdir(g_repo)));
+	cl_git_pass(git_repository_set_fsmonitor(g_repo, monitor));
+	g_monitor = NULL;
+
+	cl_assert_equal_i(GIT_STATUS_CURRENT, whole_status_of("current_file", NULL));
+	cl_assert(is_fsmonitor_valid("current_file"));
+
+	cl_git_rewritefile("status/current_file", "changed\n");
+	cl_assert_equal_i(
+		GIT_STATUS_WT_MODIFIED, whole_status_of("current_file", NULL));
+
+	cl_git_mkfile("status/subdir/another_file", "new\n");
+	cl_assert_equal_i(
+		GIT_STATUS_WT_NEW, whole_status_of("subdir/another_file", NULL));
+#endif
+}
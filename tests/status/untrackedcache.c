@@ -0,0 +1,278 @@
+#include "clar_libgit2.h"
+#include "fileops.h"
+#include "index.h"
+#include "repository.h"
+#include "status_helpers.h"
+
+#ifdef GIT_WIN32
+# include <sys/utime.h>
+#else
+# include <utime.h>
+#endif
+
+static git_repository *g_repo = NULL;
+
+/* entries for a plain copy of tests/resources/status */
+
+static const char *entry_paths0[] = {
+	"file_deleted",
+	"ignored_file",
+	"modified_file",
+	"new_file",
+	"staged_changes",
+	"staged_changes_file_deleted",
+	"staged_changes_modified_file",
+	"staged_delete_file_deleted",
+	"staged_delete_modified_file",
+	"staged_new_file",
+	"staged_new_file_deleted_file",
+	"staged_new_file_modified_file",
+
+	"subdir/deleted_file",
+	"subdir/modified_file",
+	"subdir/new_file",
+
+	"\xe8\xbf\x99",
+};
+
+static const unsigned int entry_statuses0[] = {
+	GIT_STATUS_WT_DELETED,
+	GIT_STATUS_IGNORED,
+	GIT_STATUS_WT_MODIFIED,
+	GIT_STATUS_WT_NEW,
+	GIT_STATUS_INDEX_MODIFIED,
+	GIT_STATUS_INDEX_MODIFIED | GIT_STATUS_WT_DELETED,
+	GIT_STATUS_INDEX_MODIFIED | GIT_STATUS_WT_MODIFIED,
+	GIT_STATUS_INDEX_DELETED,
+	GIT_STATUS_INDEX_DELETED | GIT_STATUS_WT_NEW,
+	GIT_STATUS_INDEX_NEW,
+	GIT_STATUS_INDEX_NEW | GIT_STATUS_WT_DELETED,
+	GIT_STATUS_INDEX_NEW | GIT_STATUS_WT_MODIFIED,
+
+	GIT_STATUS_WT_DELETED,
+	GIT_STATUS_WT_MODIFIED,
+	GIT_STATUS_WT_NEW,
+
+	GIT_STATUS_WT_NEW,
+};
+
+static const int entry_count0 = 16;
+
+void test_status_untrackedcache__initialize(void)
+{
+	g_repo = cl_git_sandbox_init("status");
+	cl_repo_set_bool(g_repo, "core.untrackedcache", true);
+}
+
+void test_status_untrackedcache__cleanup(void)
+{
+	cl_git_sandbox_cleanup();
+}
+
+/* directories modified in the current second are never trusted, so push
+ * them back in time to let the cache remember them */
+static void set_dir_mtime(const char *path, time_t when)
+{
+	struct utimbuf times;
+
+	times.actime = when;
+	times.modtime = when;
+	cl_must_pass(utime(path, &times));
+}
+
+static void age_workdir(time_t when)
+{
+	set_dir_mtime("status", when);
+	set_dir_mtime("status/subdir", when);
+}
+
+static void assert_whole_repository_status(void)
+{
+	status_entry_counts counts;
+
+	status_counts_init(counts, entry_paths0, entry_statuses0);
+	counts.expected_entry_count = entry_count0;
+
+	cl_git_pass(git_status_foreach(g_repo, cb_status__normal, &counts));
+
+	cl_assert_equal_i(counts.expected_entry_count, counts.entry_count);
+	cl_assert_equal_i(0, counts.wrong_status_flags_count);
+	cl_assert_equal_i(0, counts.wrong_sorted_path);
+}
+
+static git_untracked_cache *repo_untracked_cache(void)
+{
+	git_index *index;
+	cl_git_pass(git_repository_index__weakptr(&index, g_repo));
+	return index->untracked;
+}
+
+typedef struct {
+	const char *path;
+	unsigned int status;
+	int found;
+} status_for_path;
+
+static int cb_status__for_path(const char *p, unsigned int s, void *payload)
+{
+	status_for_path *data = payload;
+
+	if (!strcmp(p, data->path)) {
+		data->status = s;
+		data->found++;
+	}
+
+	return 0;
+}
+
+/* look up the status of a file through a full (unlimited) status run, as
+ * limiting the status to a path bypasses the cache */
+static unsigned int whole_status_of(const char *path)
+{
+	status_for_path data;
+
+	memset(&data, 0, sizeof(data));
+	data.path = path;
+
+	cl_git_pass(git_status_foreach(g_repo, cb_status__for_path, &data));
+	cl_assert(data.found <= 1);
+
+	return data.found ? data.status : GIT_STATUS_CURRENT;
+}
+
+void test_status_untrackedcache__records_untracked_entries(void)
+{
+	git_untracked_cache *uc;
+	git_untracked_cache_dir *dir;
+	size_t pos;
+
+	age_workdir(time(NULL) - 3600);
+	assert_whole_repository_status();
+
+	cl_assert((uc = repo_untracked_cache()) != NULL);
+	cl_assert(git_untracked_cache_is_usable(
+		uc, git_repository_workdir(g_repo)));
+
+	cl_assert((dir = git_untracked_cache_lookup(uc, "", false)) != NULL);
+	cl_assert(dir->valid);
+	cl_git_pass(git_vector_bsearch(&pos, &dir->untracked, "new_file"));
+	cl_git_pass(git_vector_bsearch(&pos, &dir->untracked, "ignored_file"));
+	cl_git_pass(git_vector_bsearch(&pos, &dir->untracked, ".git/"));
+	cl_assert_equal_i(
+		GIT_ENOTFOUND, git_vector_bsearch(&pos, &dir->untracked, "subdir/"));
+	cl_assert_equal_i(GIT_ENOTFOUND,
+		git_vector_bsearch(&pos, &dir->untracked, "current_file"));
+
+	cl_assert((dir = git_untracked_cache_lookup(uc, "subdir/", false)) != NULL);
+	cl_assert(dir->valid);
+	cl_assert_equal_i(1, (int)dir->untracked.length);
+	cl_assert_equal_s("new_file", git_vector_get(&dir->untracked, 0));
+
+	/* a second run is served from the cache */
+	assert_whole_repository_status();
+}
+
+void test_status_untrackedcache__is_written_and_read_with_the_index(void)
+{
+	git_index *index;
+	git_untracked_cache *uc;
+	git_untracked_cache_dir *dir;
+
+	age_workdir(time(NULL) - 3600);
+	assert_whole_repository_status();
+
+	cl_git_pass(git_repository_index(&index, g_repo));
+	cl_git_pass(git_index_write(index));
+	git_index_free(index);
+
+	g_repo = cl_git_sandbox_reopen();
+
+	cl_assert((uc = repo_untracked_cache()) != NULL);
+	cl_assert(git_untracked_cache_is_usable(
+		uc, git_repository_workdir(g_repo)));
+
+	cl_assert((dir = git_untracked_cache_lookup(uc, "subdir", false)) != NULL);
+	cl_assert(dir->valid);
+	cl_assert_equal_i(1, (int)dir->untracked.length);
+	cl_assert_equal_s("new_file", git_vector_get(&dir->untracked, 0));
+
+	assert_whole_repository_status();
+}
+
+void test_status_untrackedcache__skips_reading_unchanged_directories(void)
+{
+	time_t when = time(NULL) - 3600;
+
+	age_workdir(when);
+	assert_whole_repository_status();
+
+	/* sneak in a file without changing the directory's stat data; only
+	 * a cached listing can miss it */
+	cl_git_mkfile("status/subdir/sneaky_file", "sneaky\n");
+	set_dir_mtime("status/subdir", when);
+
+	cl_assert_equal_i(
+		GIT_STATUS_CURRENT, whole_status_of("subdir/sneaky_file"));
+
+	/* once the directory is seen to change, it is read again */
+	set_dir_mtime("status/subdir", when + 60);
+
+	cl_assert_equal_i(
+		GIT_STATUS_WT_NEW, whole_status_of("subdir/sneaky_file"));
+}
+
+void test_status_untrackedcache__index_changes_invalidate_directories(void)
+{
+	git_index *index;
+
+	age_workdir(time(NULL) - 3600);
+	assert_whole_repository_status();
+
+	cl_git_pass(git_repository_index(&index, g_repo));
+
+	/* a file that is no longer tracked must show up as untracked */
+	cl_git_pass(git_index_remove_bypath(index, "subdir/current_file"));
+	cl_assert_equal_i(GIT_STATUS_INDEX_DELETED | GIT_STATUS_WT_NEW,
+		whole_status_of("subdir/current_file"));
+
+	/* and a newly tracked file must not be reported twice */
+	cl_git_pass(git_index_add_bypath(index, "subdir/new_file"));
+	cl_assert_equal_i(
+		GIT_STATUS_INDEX_NEW, whole_status_of("subdir/new_file"));
+
+	git_index_free(index);
+}
+
+void test_status_untrackedcache__ignores_caches_for_other_locations(void)
+{
+	git_index *index;
+	git_untracked_cache *uc;
+	git_untracked_cache_dir *dir;
+	git_vector names = GIT_VECTOR_INIT;
+	struct stat st;
+
+	age_workdir(time(NULL) - 3600);
+
+	/* a cache for another working directory, claiming that the root of
+	 * the working directory only contains a bogus file */
+	cl_git_pass(git_untracked_cache_new(&uc, "/some/other/workdir/"));
+	cl_assert(!git_untracked_cache_is_usable(
+		uc, git_repository_workdir(g_repo)));
+
+	cl_git_pass(p_stat("status", &st));
+	cl_git_pass(git_vector_insert(&names, git__strdup("bogus_file")));
+	cl_assert((dir = git_untracked_cache_lookup(uc, "", true)) != NULL);
+	cl_git_pass(git_untracked_cache_dir_set(dir, &st, &names));
+	git_vector_free(&names);
+
+	cl_git_pass(git_repository_index__weakptr(&index, g_repo));
+	git_untracked_cache_free(index->untracked);
+	index->untracked = uc;
+
+	assert_whole_repository_status();
+
+	/* the foreign cache was replaced by one for this working directory */
+	cl_assert((uc = repo_untracked_cache()) != NULL);
+	cl_assert(git_untracked_cache_is_usable(
+		uc, git_repository_workdir(g_repo)));
+}
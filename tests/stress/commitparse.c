@@ -0,0 +1,170 @@
+#include "clar_libgit2.h"
+#include "commit.h"
+#include "odb.h"
+#include "oid.h"
+#include "git2/sys/mempack.h"
+#include "stress_helpers.h"
+
+/*
+ * Benchmarks for the commit header parsers: the quick one used by the
+ * revision walker, and the full one behind git_commit_lookup.  The
+ * history is kept in memory so that only parsing is measured.
+ */
+
+#define COMMIT_COUNT 20000
+#define ROUNDS 10
+#define EMPTY_TREE "4b825dc642cb6eb9a060e54bf8d69288fbee4904"
+
+static git_repository *g_repo;
+static git_odb *g_odb;
+static git_oid g_ids[COMMIT_COUNT];
+
+/* a linear history in which every eighth commit is a merge */
+static void build_history(void)
+{
+	git_buf buf = GIT_BUF_INIT;
+	char hex[GIT_OID_HEXSZ + 1];
+	int i;
+
+	for (i = 0; i < COMMIT_COUNT; ++i) {
+		git_buf_clear(&buf);
+		git_buf_puts(&buf, "tree " EMPTY_TREE "\n");
+
+		if (i > 0)
+			git_buf_printf(&buf, "parent %s\n",
+				git_oid_tostr(hex, sizeof(hex), &g_ids[i - 1]));
+		if (i >= 5 && i % 8 == 0)
+			git_buf_printf(&buf, "parent %s\n",
+				git_oid_tostr(hex, sizeof(hex), &g_ids[i - 5]));
+
+		git_buf_printf(&buf,
+			"author A U Thor <author@example.com> %d +0000\n"
+			"committer C O Mitter <committer@example.com> %d +0000\n"
+			"\ncommit number %d\n", 1234567890 + i, 1234567890 + i, i);
+		cl_assert(!git_buf_oom(&buf));
+
+		cl_git_pass(git_odb_write(
+			&g_ids[i], g_odb, buf.ptr, buf.size, GIT_OBJ_COMMIT));
+	}
+
+	git_buf_free(&buf);
+}
+
+void test_stress_commitparse__initialize(void)
+{
+	git_odb_backend *backend;
+
+	cl_git_pass(git_repository_init(&g_repo, "commitparse.git", true));
+	cl_git_pass(git_repository_odb(&g_odb, g_repo));
+
+	cl_git_pass(git_mempack_new(&backend));
+	cl_git_pass(git_odb_add_backend(g_odb, backend, 1000));
+
+	build_history();
+}
+
+void test_stress_commitparse__cleanup(void)
+{
+	git_odb_free(g_odb);
+	g_odb = NULL;
+
+	git_repository_free(g_repo);
+	g_repo = NULL;
+
+	cl_fixture_cleanup("commitparse.git");
+}
+
+void test_stress_commitparse__oid_decoding(void)
+{
+	char *hex;
+	git_oid oid;
+	double start;
+	int round, i;
+
+	hex = git__malloc(COMMIT_COUNT * GIT_OID_HEXSZ);
+	cl_assert(hex);
+
+	for (i = 0; i < COMMIT_COUNT; ++i)
+		git_oid_fmt(hex + i * GIT_OID_HEXSZ, &g_ids[i]);
+
+	start = git__timer();
+	for (round = 0; round < ROUNDS; ++round)
+		for (i = 0; i < COMMIT_COUNT; ++i)
+			cl_git_pass(git_oid_fromstrn(
+				&oid, hex + i * GIT_OID_HEXSZ, GIT_OID_HEXSZ));
+	stress_report(ROUNDS * COMMIT_COUNT, git__timer() - start,
+		"git_oid_fromstrn");
+
+	start = git__timer();
+	for (round = 0; round < ROUNDS; ++round)
+		for (i = 0; i < COMMIT_COUNT; ++i)
+			cl_git_pass(git_oid__fromhex(&oid, hex + i * GIT_OID_HEXSZ));
+	stress_report(ROUNDS * COMMIT_COUNT, git__timer() - start,
+		"git_oid__fromhex");
+
+	cl_assert(git_oid_equal(&oid, &g_ids[COMMIT_COUNT - 1]));
+	git__free(hex);
+}
+
+void test_stress_commitparse__revwalk(void)
+{
+	git_revwalk *walk;
+	git_oid oid;
+	double start;
+	int round, count;
+
+	start = git__timer();
+
+	for (round = 0; round < ROUNDS; ++round) {
+		cl_git_pass(git_revwalk_new(&walk, g_repo));
+		cl_git_pass(git_revwalk_push(walk, &g_ids[COMMIT_COUNT - 1]));
+
+		count = 0;
+		while (git_revwalk_next(&oid, walk) == 0)
+			count++;
+
+		cl_assert_equal_i(COMMIT_COUNT, count);
+		git_revwalk_free(walk);
+	}
+
+	stress_report(ROUNDS * COMMIT_COUNT, git__timer() - start,
+		"revwalk quick parse");
+}
+
+void test_stress_commitparse__full_parse(void)
+{
+	git_odb_object **objects;
+	git_commit *commit;
+	double start;
+	int round, i;
+
+	objects = git__calloc(COMMIT_COUNT, sizeof(git_odb_object *));
+	cl_assert(objects);
+
+	for (i = 0; i < COMMIT_COUNT; ++i)
+		cl_git_pass(git_odb_read(&objects[i], g_odb, &g_ids[i]));
+
+	start = git__timer();
+
+	for (round = 0; round < ROUNDS; ++round) {
+		for (i = 0; i < COMMIT_COUNT; ++i) {
+			commit = git__calloc(1, sizeof(git_commit));
+			cl_assert(commit);
+			commit->object.repo = g_repo;
+
+			cl_git_pass(git_commit__parse(commit, objects[i]));
+			cl_assert_equal_i(
+				(i >= 5 && i % 8 == 0) ? 2 : (i > 0),
+				git_commit_parentcount(commit));
+
+			git_commit__free(commit);
+		}
+	}
+
+	stress_report(ROUNDS * COMMIT_COUNT, git__timer() - start,
+		"git_commit__parse");
+
+	for (i = 0; i < COMMIT_COUNT; ++i)
+		git_odb_object_free(objects[i]);
+	git__free(objects);
+}
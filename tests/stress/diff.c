@@ -1,5 +1,7 @@
 #include "clar_libgit2.h"
 #include "../diff/diff_helpers.h"
+#include "buffer.h"
+#include "stress_helpers.h"
 
 static git_repository *g_repo = NULL;
 
@@ -144,3 +146,234 @@ void test_stress_diff__rename_many_files(void)
 
 	test_with_many(2500);
 }
+
+#define FILE_COUNT 2000
+#define FILE_LINES 400
+#define ROUNDS 2
+
+static void fill_file(git_buf *content, int n, void *payload)
+{
+	int side = *(int *)payload, line;
+	uint32_t seed = (uint32_t)n, value;
+
+	for (line = 0; line < FILE_LINES; ++line) {
+		value = stress_rand(&seed);
+		git_buf_printf(content, "\tstatic int value_%u = %d;\n",
+			value % 1000, line);
+
+		if (side && value % 50 == 0)
+			git_buf_puts(content, "\t/* changed */\n");
+	}
+}
+
+static void make_tree(git_tree **out, int side)
+{
+	stress_make_tree(out, g_repo, FILE_COUNT, "file%04d.c", fill_file, &side);
+}
+
+static int count_line(
+	const git_diff_delta *delta,
+	const git_diff_hunk *hunk,
+	const git_diff_line *line,
+	void *payload)
+{
+	size_t *lines = payload;
+
+	GIT_UNUSED(delta); GIT_UNUSED(hunk); GIT_UNUSED(line);
+
+	(*lines)++;
+	return 0;
+}
+
+/*
+ * Generating the text of a diff with many changed files on a number of
+ * threads.  The files are made up text, with a few lines changed in each.
+ */
+void test_stress_diff__foreach_on_threads(void)
+{
+	unsigned int threads[] = { 1, 2, 4, 8 };
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_tree *old_tree, *new_tree;
+	git_diff *diff;
+	size_t i, lines, expected = 0;
+	double start, elapsed;
+	int round;
+
+	g_repo = cl_git_sandbox_init("empty_standard_repo");
+	make_tree(&old_tree, 0);
+	make_tree(&new_tree, 1);
+
+	for (i = 0; i < ARRAY_SIZE(threads); ++i) {
+		opts.threads = threads[i];
+		elapsed = 0;
+
+		for (round = 0; round < ROUNDS; ++round) {
+			/* a new diff each time, so no blob is already loaded */
+			cl_git_pass(git_diff_tree_to_tree(
+				&diff, g_repo, old_tree, new_tree, &opts));
+			cl_assert_equal_i(FILE_COUNT, git_diff_num_deltas(diff));
+
+			lines = 0;
+			start = git__timer();
+			cl_git_pass(git_diff_foreach(diff, NULL, NULL, count_line, &lines));
+			elapsed += git__timer() - start;
+
+			git_diff_free(diff);
+
+			if (!expected)
+				expected = lines;
+			cl_assert_equal_i(expected, lines);
+		}
+
+		stress_report(FILE_COUNT * ROUNDS, elapsed,
+			"git_diff_foreach (%u threads)", threads[i]);
+	}
+
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+}
+
+#define REFORMAT_FILE_COUNT 400
+#define REFORMAT_FILE_LINES 2000
+
+/* every line of every file reindented, as in a mass reformat */
+static void fill_reformatted_file(git_buf *content, int n, void *payload)
+{
+	int side = *(int *)payload, line;
+
+	for (line = 0; line < REFORMAT_FILE_LINES; ++line)
+		git_buf_printf(content, side ?
+			"\tint value_%d = %d;\n" : "  int value_%d=%d;\n", line, n);
+}
+
+static void make_reformatted_tree(git_tree **out, int side)
+{
+	stress_make_tree(out, g_repo, REFORMAT_FILE_COUNT, "file%04d.c",
+		fill_reformatted_file, &side);
+}
+
+static int count_bytes(
+	const git_diff_delta *delta,
+	const git_diff_hunk *hunk,
+	const git_diff_line *line,
+	void *payload)
+{
+	size_t *bytes = payload;
+
+	GIT_UNUSED(delta); GIT_UNUSED(hunk);
+
+	*bytes += line->content_len;
+	return 0;
+}
+
+/*
+ * Printing the patch of a mass reformat, which is much larger than any
+ * of its files.  The patch is handed out as it is generated, without
+ * ever being held in memory as a whole.
+ */
+void test_stress_diff__print_mass_reformat(void)
+{
+	unsigned int threads[] = { 1, 4 };
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_tree *old_tree, *new_tree;
+	git_diff *diff;
+	size_t i, bytes, expected = 0;
+	double start, elapsed;
+
+	g_repo = cl_git_sandbox_init("empty_standard_repo");
+	make_reformatted_tree(&old_tree, 0);
+	make_reformatted_tree(&new_tree, 1);
+
+	for (i = 0; i < ARRAY_SIZE(threads); ++i) {
+		opts.threads = threads[i];
+
+		cl_git_pass(git_diff_tree_to_tree(
+			&diff, g_repo, old_tree, new_tree, &opts));
+
+		bytes = 0;
+		start = git__timer();
+		cl_git_pass(git_diff_print(
+			diff, GIT_DIFF_FORMAT_PATCH, count_bytes, &bytes));
+		elapsed = git__timer() - start;
+
+		git_diff_free(diff);
+
+		if (!expected)
+			expected = bytes;
+		cl_assert_equal_i(expected, bytes);
+
+		stress_report_bytes(bytes, elapsed,
+			"git_diff_print (%u threads)", threads[i]);
+	}
+
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+}
+
+#define ASSET_COUNT 32
+#define ASSET_SIZE (1024 * 1024)
+
+/* large files of noise, as images or archives would be */
+static void fill_asset(git_buf *content, int n, void *payload)
+{
+	int side = *(int *)payload;
+	uint32_t seed = (uint32_t)(n * 2 + side);
+
+	while (content->size < ASSET_SIZE)
+		git_buf_putc(content, (char)stress_rand(&seed));
+}
+
+static void make_asset_tree(git_tree **out, int side)
+{
+	stress_make_tree(out, g_repo, ASSET_COUNT, "asset%04d.bin",
+		fill_asset, &side);
+}
+
+/*
+ * Generating the patches between two versions of many large binary
+ * files, which only needs the first bytes of each of them, and none of
+ * them once the repository remembers which blobs are binary.
+ */
+void test_stress_diff__patch_binary_assets(void)
+{
+	const char *rounds[] = { "no cache", "cold cache", "warm cache" };
+	git_tree *old_tree, *new_tree;
+	git_diff *diff;
+	git_patch *patch;
+	size_t i, d, count;
+	double start, elapsed;
+
+	g_repo = cl_git_sandbox_init("empty_standard_repo");
+	make_asset_tree(&old_tree, 0);
+	make_asset_tree(&new_tree, 1);
+
+	for (i = 0; i < ARRAY_SIZE(rounds); ++i) {
+		if (i == 1)
+			cl_git_pass(git_repository_set_binary_cache(g_repo, 1000));
+
+		cl_git_pass(git_diff_tree_to_tree(
+			&diff, g_repo, old_tree, new_tree, NULL));
+
+		count = 0;
+		start = git__timer();
+
+		for (d = 0; d < git_diff_num_deltas(diff); ++d) {
+			cl_git_pass(git_patch_from_diff(&patch, diff, d));
+			if (git_patch_get_delta(patch)->flags & GIT_DIFF_FLAG_BINARY)
+				count++;
+			git_patch_free(patch);
+		}
+
+		elapsed = git__timer() - start;
+
+		git_diff_free(diff);
+
+		cl_assert_equal_i(ASSET_COUNT, count);
+
+		stress_report(ASSET_COUNT, elapsed,
+			"git_patch_from_diff (%s)", rounds[i]);
+	}
+
+	git_tree_free(old_tree);
+	git_tree_free(new_tree);
+}
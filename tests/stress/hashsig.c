@@ -0,0 +1,177 @@
+#include "clar_libgit2.h"
+#include "hashsig.h"
+#include "path.h"
+#include "fileops.h"
+#include "stress_helpers.h"
+
+/*
+ * Benchmarks for building and comparing similarity signatures, which is
+ * most of the time spent finding renames.  The corpus is made up text,
+ * unless GITTEST_HASHSIG_CORPUS names a directory of files to use.
+ */
+
+#define FILE_COUNT 256
+#define FILE_SIZE (32 * 1024)
+#define ROUNDS 4
+
+typedef struct {
+	char *data;
+	size_t len;
+} corpus_file;
+
+static corpus_file g_files[FILE_COUNT];
+static size_t g_count;
+
+/* indented lines of words, as in source code */
+static void make_file(corpus_file *file, uint32_t seed)
+{
+	static const char *words[] = {
+		"if", "(error", "<", "0)", "return", "error;", "git_buf", "size_t",
+		"len", "=", "0;", "for", "{", "}", "while", "const", "char", "*ptr",
+		"static", "int", "goto", "done;", "NULL", "&&", "||", "->",
+	};
+	git_buf buf = GIT_BUF_INIT;
+	int depth = 0, i, count;
+
+	while (buf.size < FILE_SIZE) {
+		for (i = 0; i < depth; ++i)
+			git_buf_putc(&buf, '\t');
+
+		for (count = 1 + stress_rand(&seed) % 8; count > 0; --count) {
+			git_buf_puts(&buf, words[stress_rand(&seed) % ARRAY_SIZE(words)]);
+			git_buf_putc(&buf, count > 1 ? ' ' : '\n');
+		}
+
+		depth = (int)(stress_rand(&seed) % 4);
+	}
+
+	cl_assert(!git_buf_oom(&buf));
+
+	file->len = buf.size;
+	file->data = git_buf_detach(&buf);
+}
+
+static int load_file(void *payload, git_buf *path)
+{
+	git_buf contents = GIT_BUF_INIT;
+
+	GIT_UNUSED(payload);
+
+	if (g_count == FILE_COUNT || !git_path_isfile(path->ptr))
+		return 0;
+
+	cl_git_pass(git_futils_readbuffer(&contents, path->ptr));
+
+	g_files[g_count].len = contents.size;
+	g_files[g_count].data = git_buf_detach(&contents);
+	g_count++;
+
+	return 0;
+}
+
+void test_stress_hashsig__initialize(void)
+{
+	char *corpus = cl_getenv("GITTEST_HASHSIG_CORPUS");
+	git_buf path = GIT_BUF_INIT;
+
+	g_count = 0;
+
+	if (corpus != NULL) {
+		cl_git_pass(git_buf_sets(&path, corpus));
+		cl_git_pass(git_path_direach(&path, 0, load_file, NULL));
+		git_buf_free(&path);
+	} else {
+		for (g_count = 0; g_count < FILE_COUNT; ++g_count)
+			make_file(&g_files[g_count], (uint32_t)g_count);
+	}
+
+	cl_assert(g_count > 0);
+}
+
+void test_stress_hashsig__cleanup(void)
+{
+	size_t i;
+
+	for (i = 0; i < g_count; ++i)
+		git__free(g_files[i].data);
+
+	memset(g_files, 0, sizeof(g_files));
+	g_count = 0;
+}
+
+static void bench_create(const char *what, git_hashsig_option_t opt)
+{
+	git_hashsig *sig;
+	char *copy;
+	size_t i, bytes = 0;
+	double start, elapsed = 0;
+	int round;
+
+	for (round = 0; round < ROUNDS; ++round) {
+		for (i = 0; i < g_count; ++i) {
+			/* whitespace may be removed from the buffer being hashed */
+			copy = git__malloc(g_files[i].len);
+			cl_assert(copy);
+			memcpy(copy, g_files[i].data, g_files[i].len);
+
+			start = git__timer();
+			if (git_hashsig_create(&sig, copy, g_files[i].len, opt) == 0) {
+				elapsed += git__timer() - start;
+				git_hashsig_free(sig);
+			} else {
+				giterr_clear();
+			}
+
+			bytes += g_files[i].len;
+			git__free(copy);
+		}
+	}
+
+	stress_report_bytes(bytes, elapsed, "%s", what);
+}
+
+void test_stress_hashsig__create(void)
+{
+	bench_create("git_hashsig_create (normal)", GIT_HASHSIG_NORMAL);
+	bench_create("git_hashsig_create (ignore whitespace)",
+		GIT_HASHSIG_IGNORE_WHITESPACE);
+	bench_create("git_hashsig_create (smart whitespace)",
+		GIT_HASHSIG_SMART_WHITESPACE);
+}
+
+void test_stress_hashsig__compare(void)
+{
+	git_hashsig **sigs;
+	size_t i, j, count = 0;
+	double start;
+	int round, score;
+
+	sigs = git__calloc(g_count, sizeof(git_hashsig *));
+	cl_assert(sigs);
+
+	for (i = 0; i < g_count; ++i)
+		if (git_hashsig_create(&sigs[i], g_files[i].data,
+				g_files[i].len, GIT_HASHSIG_NORMAL) < 0)
+			giterr_clear();
+
+	start = git__timer();
+
+	for (round = 0; round < ROUNDS; ++round) {
+		for (i = 0; i < g_count; ++i) {
+			for (j = 0; j < g_count; ++j) {
+				if (!sigs[i] || !sigs[j])
+					continue;
+
+				score = git_hashsig_compare(sigs[i], sigs[j]);
+				cl_assert(score >= 0 && score <= 100);
+				count++;
+			}
+		}
+	}
+
+	stress_report(count, git__timer() - start, "git_hashsig_compare");
+
+	for (i = 0; i < g_count; ++i)
+		git_hashsig_free(sigs[i]);
+	git__free(sigs);
+}
@@ -0,0 +1,79 @@
+#include "clar_libgit2.h"
+#include "stress_helpers.h"
+
+uint32_t stress_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 16;
+}
+
+void stress_report(size_t count, double elapsed, const char *fmt, ...)
+{
+	git_buf out = GIT_BUF_INIT;
+	va_list ap;
+
+	va_start(ap, fmt);
+	cl_git_pass(git_buf_vprintf(&out, fmt, ap));
+	va_end(ap);
+
+	cl_git_pass(git_buf_printf(&out, ": %u in %.3fs (%.0f/s)",
+		(unsigned int)count, elapsed, elapsed > 0 ? count / elapsed : 0.0));
+
+	printf("\n%s\n", out.ptr);
+	git_buf_free(&out);
+}
+
+void stress_report_bytes(size_t bytes, double elapsed, const char *fmt, ...)
+{
+	git_buf out = GIT_BUF_INIT;
+	va_list ap;
+
+	va_start(ap, fmt);
+	cl_git_pass(git_buf_vprintf(&out, fmt, ap));
+	va_end(ap);
+
+	cl_git_pass(git_buf_printf(&out, ": %.1f MB in %.3fs (%.1f MB/s)",
+		bytes / (1024.0 * 1024.0), elapsed,
+		elapsed > 0 ? bytes / elapsed / (1024 * 1024) : 0.0));
+
+	printf("\n%s\n", out.ptr);
+	git_buf_free(&out);
+}
+
+void stress_make_tree(
+	git_tree **out,
+	git_repository *repo,
+	int count,
+	const char *name_fmt,
+	void (*fill)(git_buf *content, int n, void *payload),
+	void *payload)
+{
+	git_treebuilder *builder;
+	git_buf path = GIT_BUF_INIT, content = GIT_BUF_INIT;
+	git_oid id;
+	int n;
+
+	cl_git_pass(git_treebuilder_create(&builder, NULL));
+
+	for (n = 0; n < count; ++n) {
+		git_buf_clear(&path);
+		git_buf_clear(&content);
+
+		fill(&content, n, payload);
+
+		cl_git_pass(git_buf_printf(&path, name_fmt, n));
+		cl_assert(!git_buf_oom(&content));
+
+		cl_git_pass(git_blob_create_frombuffer(
+			&id, repo, content.ptr, content.size));
+		cl_git_pass(git_treebuilder_insert(
+			NULL, builder, path.ptr, &id, GIT_FILEMODE_BLOB));
+	}
+
+	cl_git_pass(git_treebuilder_write(&id, repo, builder));
+	cl_git_pass(git_tree_lookup(out, repo, &id));
+
+	git_treebuilder_free(builder);
+	git_buf_free(&path);
+	git_buf_free(&content);
+}
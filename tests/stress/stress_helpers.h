@@ -0,0 +1,29 @@
+#include "common.h"
+#include "buffer.h"
+
+/* The next number of a made up sequence, which `*seed` starts */
+extern uint32_t stress_rand(uint32_t *seed);
+
+/*
+ * Print how long the benchmark described by `fmt` took to get through
+ * `count` items, and how many it did a second.
+ */
+extern void stress_report(size_t count, double elapsed, const char *fmt, ...)
+	GIT_FORMAT_PRINTF(3, 4);
+
+/* Likewise, for a benchmark getting through `bytes` of data */
+extern void stress_report_bytes(
+	size_t bytes, double elapsed, const char *fmt, ...)
+	GIT_FORMAT_PRINTF(3, 4);
+
+/*
+ * Write a tree of `count` files, named by `name_fmt` from their number,
+ * each holding what `fill` puts in the (empty) buffer it is given.
+ */
+extern void stress_make_tree(
+	git_tree **out,
+	git_repository *repo,
+	int count,
+	const char *name_fmt,
+	void (*fill)(git_buf *content, int n, void *payload),
+	void *payload);
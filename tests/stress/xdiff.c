@@ -0,0 +1,178 @@
+#include "clar_libgit2.h"
+#include "buffer.h"
+#include "xdiff/xdiff.h"
+#include "stress_helpers.h"
+
+/*
+ * Benchmarks for the line diff itself, with each of the algorithms
+ * xdiff implements, over made up files changed the way files usually
+ * are: a few lines edited, blocks of lines moved, or most of it
+ * rewritten.
+ */
+
+#define LINE_COUNT 20000
+#define ROUNDS 8
+
+typedef struct {
+	const char *what;
+	mmfile_t old_file, new_file;
+} bench_pair;
+
+typedef struct {
+	const char *what;
+	unsigned long flags;
+} bench_algorithm;
+
+static const bench_algorithm g_algorithms[] = {
+	{ "myers", 0 },
+	{ "minimal", XDF_NEED_MINIMAL },
+	{ "patience", XDF_PATIENCE_DIFF },
+	{ "histogram", XDF_HISTOGRAM_DIFF },
+};
+
+static bench_pair g_pairs[3];
+
+static void put_line(git_buf *buf, uint32_t n)
+{
+	static const char *words[] = {
+		"if", "(error", "<", "0)", "return", "error;", "git_buf", "size_t",
+		"len", "=", "0;", "for", "{", "}", "while", "const", "char", "*ptr",
+	};
+	uint32_t count;
+
+	git_buf_putc(buf, '\t');
+
+	for (count = 1 + n % 6; count > 0; --count) {
+		git_buf_puts(buf, words[n % ARRAY_SIZE(words)]);
+		git_buf_putc(buf, ' ');
+		n = n * 2654435761u + 1;
+	}
+
+	git_buf_printf(buf, "/* %u */\n", n % 1000);
+}
+
+static void set_file(mmfile_t *file, git_buf *buf)
+{
+	cl_assert(!git_buf_oom(buf));
+
+	file->size = buf->size;
+	file->ptr = git_buf_detach(buf);
+}
+
+static void make_pair(bench_pair *pair, const char *what, int kind)
+{
+	git_buf old_buf = GIT_BUF_INIT, new_buf = GIT_BUF_INIT;
+	uint32_t i, seed = 42, moved = LINE_COUNT / 2;
+
+	for (i = 0; i < LINE_COUNT; ++i) {
+		put_line(&old_buf, i);
+
+		switch (kind) {
+		case 0: /* one line in fifty edited */
+			put_line(&new_buf, stress_rand(&seed) % 50 ? i : i + LINE_COUNT);
+			break;
+		case 1: /* blocks of a hundred lines swapped around */
+			put_line(&new_buf, (i / 100) % 2 ? i - 100 :
+				(i + 100 < LINE_COUNT ? i + 100 : i));
+			if (i == moved)
+				put_line(&new_buf, i + LINE_COUNT);
+			break;
+		default: /* most lines rewritten */
+			put_line(&new_buf, stress_rand(&seed) % 4 ? i + LINE_COUNT : i);
+			break;
+		}
+	}
+
+	pair->what = what;
+	set_file(&pair->old_file, &old_buf);
+	set_file(&pair->new_file, &new_buf);
+}
+
+void test_stress_xdiff__initialize(void)
+{
+	make_pair(&g_pairs[0], "small edits", 0);
+	make_pair(&g_pairs[1], "moved blocks", 1);
+	make_pair(&g_pairs[2], "rewrite", 2);
+}
+
+void test_stress_xdiff__cleanup(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(g_pairs); ++i) {
+		git__free(g_pairs[i].old_file.ptr);
+		git__free(g_pairs[i].new_file.ptr);
+	}
+
+	memset(g_pairs, 0, sizeof(g_pairs));
+}
+
+typedef struct {
+	size_t added, removed;
+} line_counts;
+
+static int count_lines(void *priv, mmbuffer_t *bufs, int nbuf)
+{
+	line_counts *counts = priv;
+
+	/* a line is given with its origin in the first buffer */
+	if (nbuf >= 2 && bufs[0].size == 1) {
+		if (bufs[0].ptr[0] == '+')
+			counts->added++;
+		else if (bufs[0].ptr[0] == '-')
+			counts->removed++;
+	}
+
+	return 0;
+}
+
+static void bench_diff(const bench_pair *pair, const bench_algorithm *algo)
+{
+	xpparam_t xpp;
+	xdemitconf_t xecfg;
+	xdemitcb_t ecb;
+	line_counts counts;
+	size_t bytes = 0;
+	double start, elapsed;
+	int round;
+
+	memset(&xpp, 0, sizeof(xpp));
+	memset(&xecfg, 0, sizeof(xecfg));
+	memset(&ecb, 0, sizeof(ecb));
+
+	xpp.flags = algo->flags;
+	xecfg.ctxlen = 3;
+	ecb.outf = count_lines;
+	ecb.priv = &counts;
+
+	start = git__timer();
+
+	for (round = 0; round < ROUNDS; ++round) {
+		memset(&counts, 0, sizeof(counts));
+
+		cl_assert(xdl_diff((mmfile_t *)&pair->old_file,
+			(mmfile_t *)&pair->new_file, &xpp, &xecfg, &ecb) == 0);
+
+		bytes += pair->old_file.size + pair->new_file.size;
+	}
+
+	elapsed = git__timer() - start;
+
+	/* whichever the algorithm, the diff turns one file into the other */
+	cl_assert_equal_i(
+		LINE_COUNT + (pair == &g_pairs[1]),
+		LINE_COUNT - counts.removed + counts.added);
+
+	stress_report_bytes(bytes, elapsed, "%s, %s: -%u +%u",
+		pair->what, algo->what,
+		(unsigned int)counts.removed, (unsigned int)counts.added);
+}
+
+void test_stress_xdiff__algorithms(void)
+{
+	size_t i, j;
+
+	for (i = 0; i < ARRAY_SIZE(g_pairs); ++i)
+		for (j = 0; j < ARRAY_SIZE(g_algorithms); ++j)
+			bench_diff(&g_pairs[i], &g_algorithms[j]);
+}